@@ -0,0 +1,121 @@
+#include "async_baker.h"
+#include "parallel.h"
+#include "profiler.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+AsyncBaker::AsyncBaker(SDFCache& cache, uint32_t num_threads) :
+    m_cache(cache), m_num_pending(0), m_stop(false), m_job_system(std::max(2u, resolve_thread_count(num_threads)))
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+AsyncBaker::~AsyncBaker()
+{
+    m_stop = true;
+
+    // Jobs that haven't started return right away once m_stop is set.
+    m_job_system.wait(m_group);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void AsyncBaker::submit(uint32_t id, std::shared_ptr<const SDFMesh> mesh, const BakeSettings& settings, SDFEncoding encoding, uint64_t key)
+{
+    auto now = std::chrono::high_resolution_clock::now();
+
+    // The coarse volume is only a stand-in, so it is never cached. It is encoded like the full one, since both are uploaded to
+    // atlas pages of that encoding, with a range of its own.
+    BakeSettings coarse_settings = settings;
+
+    coarse_settings.grid_step_size = settings.grid_step_size * ASYNC_BAKE_COARSE_SCALE;
+    coarse_settings.padding        = (settings.padding + ASYNC_BAKE_COARSE_SCALE - 1) / ASYNC_BAKE_COARSE_SCALE;
+    coarse_settings.narrow_band    = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_coarse.push_back({ id, BakeStage::COARSE, mesh, coarse_settings, encoding, 0, now });
+        m_full.push_back({ id, BakeStage::FULL, mesh, settings, encoding, key, now });
+        m_num_pending += 2;
+    }
+
+    for (int i = 0; i < 2; i++)
+        m_job_system.submit([this]() { run_next(); }, m_group);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void AsyncBaker::run_next()
+{
+    if (m_stop)
+        return;
+
+    Request request;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        std::deque<Request>& queue = m_coarse.empty() ? m_full : m_coarse;
+
+        request = std::move(queue.front());
+        queue.pop_front();
+    }
+
+    AsyncBakeResult result;
+
+    result.id      = request.id;
+    result.stage   = request.stage;
+    result.wait_ms = elapsed_ms(request.submit_time);
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Runs inside a job, so the rows of the volume are spread over the pool.
+    SDFVolume volume = bake_sdf(*request.mesh, request.settings);
+
+    result.volume = encode_sdf(volume, request.encoding);
+
+    if (request.stage == BakeStage::FULL)
+    {
+        result.data = m_cache.store(request.key, result.volume);
+
+        if (result.data)
+            result.volume = QuantizedSDFVolume();
+    }
+
+    // The texture mips are built from the decoded texels, like a volume loaded from the cache.
+    result.pyramid = build_sdf_pyramid(request.encoding == SDFEncoding::FLOAT32 ? volume : decode_sdf(result.view()));
+    result.bake_ms = elapsed_ms(start);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_results.push_back(std::move(result));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::vector<AsyncBakeResult> AsyncBaker::poll(uint32_t max_results)
+{
+    std::vector<AsyncBakeResult> results;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    while (!m_results.empty() && results.size() < max_results)
+    {
+        results.push_back(std::move(m_results.front()));
+        m_results.pop_front();
+        m_num_pending--;
+    }
+
+    return results;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t AsyncBaker::num_pending() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_num_pending;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
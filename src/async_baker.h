@@ -0,0 +1,83 @@
+#pragma once
+
+#include "sdf_cache.h"
+#include "sdf_pyramid.h"
+#include "job_system.h"
+
+#include <chrono>
+#include <deque>
+
+// Grid step of the coarse bake relative to the full one. At 4 the coarse volume has 1/64 of the voxels.
+#define ASYNC_BAKE_COARSE_SCALE 4
+
+enum class BakeStage
+{
+    COARSE,
+    FULL
+};
+
+// A finished bake with everything the GL thread needs to upload it.
+struct AsyncBakeResult
+{
+    uint32_t                         id      = 0; // As passed to AsyncBaker::submit().
+    BakeStage                        stage   = BakeStage::COARSE;
+    std::shared_ptr<const MappedSDF> data;          // Cached file of a full bake. Null for coarse bakes, or if the cache write failed.
+    QuantizedSDFVolume               volume;        // The encoded volume when data is null.
+    SDFPyramid                       pyramid;       // Decoded levels for the texture mips.
+    double                           wait_ms = 0.0; // Time in the queue before the bake started.
+    double                           bake_ms = 0.0; // Bake, encoding, cache write and pyramid.
+
+    inline SDFVolumeView view() const { return data ? data->view() : volume.view(); }
+};
+
+// Bakes meshes on a background pool while the caller keeps rendering. Every submitted mesh gets a cheap coarse bake first, and
+// the coarse bakes of all meshes run before any full bake, so every instance has a usable volume as early as possible. Results
+// are collected with poll(), which never waits for a bake.
+class AsyncBaker
+{
+public:
+    // num_threads = 0 uses all cores. The pool always has at least one worker, so bakes never run on the thread calling
+    // submit() or poll().
+    explicit AsyncBaker(SDFCache& cache, uint32_t num_threads = 0);
+
+    // Drops the bakes that haven't started and waits for the running ones.
+    ~AsyncBaker();
+
+    AsyncBaker(const AsyncBaker&) = delete;
+    AsyncBaker& operator=(const AsyncBaker&) = delete;
+
+    // Queues the coarse and the full bake of mesh. The full bake is written to the cache under key.
+    void submit(uint32_t id, std::shared_ptr<const SDFMesh> mesh, const BakeSettings& settings, SDFEncoding encoding, uint64_t key);
+
+    // Up to max_results finished bakes, in the order they finished.
+    std::vector<AsyncBakeResult> poll(uint32_t max_results = UINT32_MAX);
+
+    // Bakes that were submitted and not yet returned by poll().
+    uint32_t num_pending() const;
+
+private:
+    struct Request
+    {
+        uint32_t                                       id;
+        BakeStage                                      stage;
+        std::shared_ptr<const SDFMesh>                 mesh;
+        BakeSettings                                   settings;
+        SDFEncoding                                    encoding;
+        uint64_t                                       key;
+        std::chrono::high_resolution_clock::time_point submit_time;
+    };
+
+    // Runs the most urgent queued request. Every submitted job runs exactly one, whichever is first in line by then.
+    void run_next();
+
+private:
+    SDFCache&                   m_cache;
+    mutable std::mutex          m_mutex;
+    std::deque<Request>         m_coarse;
+    std::deque<Request>         m_full;
+    std::deque<AsyncBakeResult> m_results;
+    uint32_t                    m_num_pending;
+    std::atomic<bool>           m_stop;
+    JobSystem                   m_job_system;
+    JobGroup                    m_group;
+};
@@ -0,0 +1,402 @@
+#include "obj_loader.h"
+#include "sdf_file.h"
+#include "sdf_cache.h"
+#include "streaming_bake.h"
+#include "job_system.h"
+#include "bake_planner.h"
+#include "mesh_preprocess.h"
+#include "profiler.h"
+
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+struct MeshBake
+{
+    std::string input;
+    std::string output;
+    size_t      file_bytes    = 0;
+    float       step          = 0.0f; // Grid step from the scene budget's plan, 0 = --step.
+    bool        success       = false;
+    uint32_t    num_triangles = 0;
+    uint32_t    removed       = 0; // Degenerate and duplicate triangles dropped by preprocess_mesh().
+    uint64_t    num_voxels    = 0;
+    double      load_ms       = 0.0;
+    double      bake_ms       = 0.0;
+    double      write_ms      = 0.0;
+    bool        streamed      = false;
+    BakeStats   stats; // Phases and queries of an in-memory bake, streamed bakes only have bake_ms.
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void bake_mesh(MeshBake& bake, BakeSettings settings, SDFEncoding encoding, size_t memory_budget, bool preprocess)
+{
+    if (bake.step > 0.0f)
+        settings.grid_step_size = bake.step;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    SDFMesh mesh;
+
+    if (!load_obj(bake.input, mesh))
+    {
+        printf("Failed to load %s\n", bake.input.c_str());
+        return;
+    }
+
+    if (preprocess)
+    {
+        MeshPreprocessSettings preprocess_settings;
+        MeshPreprocessStats    stats;
+
+        preprocess_settings.keep_normals = settings.sign_mode == SignMode::NORMALS;
+
+        preprocess_mesh(mesh, preprocess_settings, &stats);
+
+        bake.removed = stats.removed_triangles();
+    }
+
+    bake.load_ms       = elapsed_ms(start);
+    bake.num_triangles = mesh.num_triangles();
+
+    start = std::chrono::high_resolution_clock::now();
+
+    // With a budget the volume is never in memory as a whole: slabs go straight to the file, so baking and writing are one step.
+    if (memory_budget > 0)
+    {
+        StreamingBakeStats stats;
+
+        if (!bake_sdf_streaming(mesh, settings, encoding, memory_budget, bake.output, &stats))
+        {
+            printf("Failed to bake %s to %s, a slab needs %.1f MB\n", bake.input.c_str(), bake.output.c_str(), double(stats.peak_bytes) / (1024.0 * 1024.0));
+            return;
+        }
+
+        if (stats.resumed_slices > 0)
+            printf("Resumed %s after %u z-slices\n", bake.input.c_str(), stats.resumed_slices);
+
+        bake.bake_ms    = elapsed_ms(start);
+        bake.num_voxels = stats.num_voxels;
+        bake.streamed   = true;
+        bake.success    = true;
+        return;
+    }
+
+    // Runs inside a job, so the rows of the volume are spread over the shared pool.
+    SDFVolume volume = bake_sdf(mesh, settings, &bake.stats);
+
+    bake.bake_ms    = elapsed_ms(start);
+    bake.num_voxels = volume.num_voxels();
+
+    start = std::chrono::high_resolution_clock::now();
+
+    if (!write_sdf_file(bake.output, encode_sdf(volume, encoding), sdf_cache_key(mesh, settings, encoding)))
+    {
+        printf("Failed to write %s\n", bake.output.c_str());
+        return;
+    }
+
+    bake.write_ms = elapsed_ms(start);
+    bake.success  = true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Loads every mesh for its extents and triangle count, plans a step per mesh for a scene budget of budget_mb and prints the plan.
+static bool plan_scene(std::vector<MeshBake>& bakes, const BakeSettings& settings, SDFEncoding encoding, uint32_t num_threads, double budget_mb)
+{
+    std::vector<BakePlanInput> inputs(bakes.size());
+
+    for (size_t i = 0; i < bakes.size(); i++)
+    {
+        SDFMesh mesh;
+
+        if (!load_obj(bakes[i].input, mesh))
+        {
+            printf("Failed to load %s\n", bakes[i].input.c_str());
+            return false;
+        }
+
+        compute_extents(mesh, inputs[i].min_extents, inputs[i].max_extents);
+
+        inputs[i].num_triangles = mesh.num_triangles();
+    }
+
+    BakePlanSettings plan_settings;
+
+    plan_settings.budget_bytes = static_cast<uint64_t>(budget_mb * 1024.0 * 1024.0);
+    plan_settings.encoding     = encoding;
+    plan_settings.padding      = settings.padding;
+    plan_settings.num_threads  = num_threads;
+
+    BakePlan plan = plan_bake(inputs, plan_settings);
+
+    printf("%-40s %10s %10s %16s %10s %12s\n", "mesh", "triangles", "step", "volume", "MB", "est. bake ms");
+
+    for (size_t i = 0; i < bakes.size(); i++)
+    {
+        const BakePlanEntry& entry = plan.entries[i];
+
+        printf("%-40s %10u %10.4f %5dx%4dx%5d %10.2f %12.1f\n", bakes[i].input.c_str(), inputs[i].num_triangles, entry.grid_step_size, entry.volume_size.x, entry.volume_size.y, entry.volume_size.z, double(entry.bytes) / (1024.0 * 1024.0), entry.bake_ms);
+
+        bakes[i].step = entry.grid_step_size;
+    }
+
+    printf("plan: %.2f of %.2f MB, estimated %.1f ms\n\n", double(plan.bytes) / (1024.0 * 1024.0), budget_mb, plan.bake_ms);
+
+    if (!plan.fits)
+    {
+        printf("The scene budget is too small, every mesh at the coarsest step needs %.2f MB\n", double(plan.bytes) / (1024.0 * 1024.0));
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Records every successful bake under bake.<mesh name> and the whole run under total, then writes them to path as JSON.
+static bool write_profile(const std::string& path, const std::vector<MeshBake>& bakes, double total_ms)
+{
+    Profiler profiler;
+
+    for (const auto& bake : bakes)
+    {
+        if (!bake.success)
+            continue;
+
+        const std::string name = "bake." + mesh_name(bake.input);
+
+        if (bake.streamed)
+        {
+            profiler.add_time(name, bake.bake_ms);
+            profiler.add_counter(name + ".voxels", bake.num_voxels);
+        }
+        else
+        {
+            profile_bake(profiler, name, bake.stats, bake.num_voxels);
+            profiler.add_time(name + ".write", bake.write_ms);
+        }
+
+        profiler.add_time(name + ".load", bake.load_ms);
+        profiler.add_counter(name + ".triangles", bake.num_triangles);
+    }
+
+    profiler.add_time("total", total_ms);
+
+    return profiler.write_json(path);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void print_usage()
+{
+    printf("usage: SDFBake [options] <mesh.obj | directory>...\n"
+           "  --step F           grid step size (default 0.025)\n"
+           "  --padding N        voxels of padding around the mesh (default 4)\n"
+           "  --output DIR       directory the .sdf files are written to, named after their meshes (default sdf)\n"
+           "  --threads N        threads shared by all bakes, 0 = all cores (default 0)\n"
+           "  --sign MODE        normals or winding (default normals)\n"
+           "  --narrow-band N    only bake voxels within N voxels of the surface exactly (default 0 = all)\n"
+           "  --encoding E       float32, float16, unorm16 or unorm8 (default float32)\n"
+           "  --memory-budget MB bake in z-slabs that fit in MB per mesh and write them as they finish; an interrupted bake\n"
+           "                     resumes from its last slab (default 0 = whole volume in memory)\n"
+           "  --no-preprocess    bake meshes as loaded, without welding, removing degenerate and duplicate triangles and\n"
+           "                     reordering them along a Morton curve\n"
+           "  --scene-budget MB  pick a step per mesh so all encoded volumes fit in MB together, the plan is printed before\n"
+           "                     baking and replaces --step (default 0 = --step for every mesh)\n"
+           "  --profile FILE     write the phase times and distance query counters of every bake to FILE as JSON\n");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    BakeSettings             settings;
+    SDFEncoding              encoding    = SDFEncoding::FLOAT32;
+    std::string              output_dir  = "sdf";
+    uint32_t                 num_threads = 0;
+    size_t                   budget_mb   = 0;
+    double                   scene_mb    = 0.0;
+    bool                     preprocess  = true;
+    std::string              profile_path;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool has_value = i + 1 < argc;
+
+        if (strcmp(argv[i], "--step") == 0 && has_value)
+            settings.grid_step_size = static_cast<float>(atof(argv[++i]));
+        else if (strcmp(argv[i], "--padding") == 0 && has_value)
+            settings.padding = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--output") == 0 && has_value)
+            output_dir = argv[++i];
+        else if (strcmp(argv[i], "--threads") == 0 && has_value)
+            num_threads = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (strcmp(argv[i], "--memory-budget") == 0 && has_value)
+            budget_mb = static_cast<size_t>(atoll(argv[++i]));
+        else if (strcmp(argv[i], "--no-preprocess") == 0)
+            preprocess = false;
+        else if (strcmp(argv[i], "--scene-budget") == 0 && has_value)
+            scene_mb = atof(argv[++i]);
+        else if (strcmp(argv[i], "--profile") == 0 && has_value)
+            profile_path = argv[++i];
+        else if (strcmp(argv[i], "--narrow-band") == 0 && has_value)
+            settings.narrow_band = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (strcmp(argv[i], "--sign") == 0 && has_value)
+        {
+            i++;
+
+            if (strcmp(argv[i], "normals") == 0)
+                settings.sign_mode = SignMode::NORMALS;
+            else if (strcmp(argv[i], "winding") == 0)
+                settings.sign_mode = SignMode::WINDING_NUMBER;
+            else
+            {
+                print_usage();
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--encoding") == 0 && has_value)
+        {
+            const char* names[] = { "float32", "float16", "unorm16", "unorm8" };
+            bool        found   = false;
+
+            i++;
+
+            for (int j = 0; j < 4; j++)
+            {
+                if (strcmp(argv[i], names[j]) == 0)
+                {
+                    encoding = static_cast<SDFEncoding>(j);
+                    found    = true;
+                }
+            }
+
+            if (!found)
+            {
+                print_usage();
+                return 1;
+            }
+        }
+        else if (argv[i][0] == '-')
+        {
+            print_usage();
+            return strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+        else
+        {
+            std::vector<std::string> files = list_files(argv[i], ".obj");
+
+            if (files.empty())
+                inputs.push_back(argv[i]);
+            else
+                inputs.insert(inputs.end(), files.begin(), files.end());
+        }
+    }
+
+    if (inputs.empty() || settings.grid_step_size <= 0.0f || settings.padding < 0)
+    {
+        print_usage();
+        return 1;
+    }
+
+    if (!create_directory(output_dir))
+    {
+        printf("Failed to create %s\n", output_dir.c_str());
+        return 1;
+    }
+
+    std::vector<MeshBake> bakes(inputs.size());
+
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        MappedFile file;
+
+        bakes[i].input  = inputs[i];
+        bakes[i].output = output_dir + "/" + mesh_name(inputs[i]) + ".sdf";
+
+        if (file.open(inputs[i]))
+            bakes[i].file_bytes = file.size();
+    }
+
+    // Meshes with the same file name would be baked concurrently into the same output and progress files.
+    std::unordered_map<std::string, size_t> outputs;
+
+    for (size_t i = 0; i < bakes.size(); i++)
+    {
+        auto it = outputs.insert({ bakes[i].output, i }).first;
+
+        if (it->second != i)
+        {
+            printf("%s and %s would both be written to %s, bake them into separate --output directories\n", bakes[it->second].input.c_str(), bakes[i].input.c_str(), bakes[i].output.c_str());
+            return 1;
+        }
+    }
+
+    if (scene_mb > 0.0 && !plan_scene(bakes, settings, encoding, num_threads, scene_mb))
+        return 1;
+
+    // Biggest meshes first, so a large bake doesn't start last and leave the other threads idle at the end. Idle threads steal
+    // the oldest queued jobs first.
+    std::vector<size_t> order(bakes.size());
+
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return bakes[a].file_bytes > bakes[b].file_bytes; });
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    {
+        JobSystem job_system(num_threads);
+        JobGroup  group;
+
+        for (size_t i : order)
+            job_system.submit([&, i]() { bake_mesh(bakes[i], settings, encoding, budget_mb * 1024 * 1024, preprocess); }, group);
+
+        job_system.wait(group);
+
+        num_threads = job_system.num_threads();
+    }
+
+    double total_ms = elapsed_ms(start);
+
+    printf("%-40s %10s %8s %12s %10s %10s %10s %14s %8s\n", "mesh", "triangles", "removed", "voxels", "load ms", "bake ms", "write ms", "Mvox*tri/s", "tri/vox");
+
+    double   work     = 0.0;
+    uint32_t failures = 0;
+
+    for (const auto& bake : bakes)
+    {
+        if (!bake.success)
+        {
+            printf("%-40s failed\n", bake.input.c_str());
+            failures++;
+            continue;
+        }
+
+        double mesh_work = double(bake.num_voxels) * double(bake.num_triangles);
+
+        work += mesh_work;
+
+        printf("%-40s %10u %8u %12llu %10.1f %10.1f %10.1f %14.1f %8.1f\n", bake.input.c_str(), bake.num_triangles, bake.removed, static_cast<unsigned long long>(bake.num_voxels), bake.load_ms, bake.bake_ms, bake.write_ms, mesh_work / (bake.bake_ms * 1000.0), bake.stats.triangles_per_voxel());
+    }
+
+    printf("%zu meshes on %u threads in %.1f ms, %.1f Mvox*tri/s overall\n", bakes.size() - failures, num_threads, total_ms, work / (total_ms * 1000.0));
+
+    if (!profile_path.empty() && !write_profile(profile_path, bakes, total_ms))
+    {
+        printf("Failed to write %s\n", profile_path.c_str());
+        return 1;
+    }
+
+    return failures > 0 ? 1 : 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,135 @@
+#include "bake_planner.h"
+#include "sdf_baker.h"
+#include "parallel.h"
+
+#include <math.h>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float predicted_bake_error(const BakePlanInput& input, float grid_step_size)
+{
+    glm::vec3 size = input.max_extents - input.min_extents;
+    float     area = 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+
+    // Edge length of an average triangle if they covered the bounding box.
+    float feature_size = sqrtf(area / float(std::max(1u, input.num_triangles)));
+
+    if (feature_size <= 0.0f)
+        return 0.0f;
+
+    return input.importance * grid_step_size * std::min(1.0f, grid_step_size / feature_size);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+double estimate_bake_ms(uint32_t num_triangles, uint64_t num_voxels)
+{
+    return double(num_voxels) * (BAKE_PLAN_VOXEL_NS + BAKE_PLAN_TRIANGLE_NS * sqrt(double(num_triangles))) * 1e-6;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static BakePlanEntry plan_entry(const BakePlanInput& input, float grid_step_size, const BakePlanSettings& settings)
+{
+    SDFGrid grid = compute_grid(input.min_extents, input.max_extents, grid_step_size, settings.padding);
+
+    bool normalized = settings.encoding == SDFEncoding::UNORM16 || settings.encoding == SDFEncoding::UNORM8;
+
+    BakePlanEntry entry;
+
+    entry.grid_step_size = grid_step_size;
+    entry.volume_size    = grid.volume_size;
+    entry.bytes          = grid.num_voxels() * encoding_size(settings.encoding) + (normalized ? sizeof(glm::vec2) : 0);
+    entry.error          = predicted_bake_error(input, grid_step_size);
+    entry.bake_ms        = estimate_bake_ms(input.num_triangles, grid.num_voxels()) / double(resolve_thread_count(settings.num_threads));
+
+    return entry;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+BakePlan plan_bake(const std::vector<BakePlanInput>& inputs, const BakePlanSettings& settings)
+{
+    const float max_step = std::max(settings.max_step, settings.min_step);
+
+    // The same ladder of steps for every mesh, ending exactly at min_step.
+    std::vector<float> steps;
+
+    for (int k = 0;; k++)
+    {
+        float step = max_step * exp2f(-float(k) / float(BAKE_PLAN_STEPS_PER_OCTAVE));
+
+        if (step <= settings.min_step)
+        {
+            steps.push_back(settings.min_step);
+            break;
+        }
+
+        steps.push_back(step);
+    }
+
+    std::vector<std::vector<BakePlanEntry>> candidates(inputs.size());
+
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        for (float step : steps)
+            candidates[i].push_back(plan_entry(inputs[i], step, settings));
+    }
+
+    // Without a budget every mesh gets the finest step.
+    std::vector<size_t> level(inputs.size(), settings.budget_bytes == 0 ? steps.size() - 1 : 0);
+    uint64_t            bytes = 0;
+
+    for (size_t i = 0; i < inputs.size(); i++)
+        bytes += candidates[i][level[i]].bytes;
+
+    if (settings.budget_bytes > 0)
+    {
+        while (true)
+        {
+            size_t best       = inputs.size();
+            double best_ratio = -1.0;
+
+            for (size_t i = 0; i < inputs.size(); i++)
+            {
+                if (level[i] + 1 == steps.size())
+                    continue;
+
+                const BakePlanEntry& current = candidates[i][level[i]];
+                const BakePlanEntry& next    = candidates[i][level[i] + 1];
+
+                if (bytes - current.bytes + next.bytes > settings.budget_bytes)
+                    continue;
+
+                double ratio = double(current.error - next.error) / double(std::max<uint64_t>(1, next.bytes - current.bytes));
+
+                if (ratio > best_ratio)
+                {
+                    best       = i;
+                    best_ratio = ratio;
+                }
+            }
+
+            if (best == inputs.size())
+                break;
+
+            bytes += candidates[best][level[best] + 1].bytes - candidates[best][level[best]].bytes;
+            level[best]++;
+        }
+    }
+
+    BakePlan plan;
+
+    plan.fits = settings.budget_bytes == 0 || bytes <= settings.budget_bytes;
+
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        plan.entries.push_back(candidates[i][level[i]]);
+        plan.bytes += plan.entries.back().bytes;
+        plan.bake_ms += plan.entries.back().bake_ms;
+    }
+
+    return plan;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
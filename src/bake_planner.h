@@ -0,0 +1,60 @@
+#pragma once
+
+#include "sdf_encoding.h"
+
+// Candidate grid steps are max_step * 2^(-k / BAKE_PLAN_STEPS_PER_OCTAVE), down to min_step.
+#define BAKE_PLAN_STEPS_PER_OCTAVE 4
+
+// Single thread bake cost of one voxel in nanoseconds: BAKE_PLAN_VOXEL_NS + BAKE_PLAN_TRIANGLE_NS * sqrt(triangles). Fitted to
+// BVH bakes with normal signs of the bundled meshes and of generated ones with up to 200k triangles.
+#define BAKE_PLAN_VOXEL_NS 300.0
+#define BAKE_PLAN_TRIANGLE_NS 50.0
+
+// What the planner needs to know about a mesh, all of it available before baking.
+struct BakePlanInput
+{
+    glm::vec3 min_extents   = glm::vec3(0.0f);
+    glm::vec3 max_extents   = glm::vec3(0.0f);
+    uint32_t  num_triangles = 0;
+    float     importance    = 1.0f; // Weight of the mesh's error, for example its pixels per world unit on screen.
+};
+
+struct BakePlanSettings
+{
+    uint64_t    budget_bytes = 0; // Total for all meshes, 0 = every mesh at min_step.
+    SDFEncoding encoding     = SDFEncoding::FLOAT32;
+    int         padding      = 4;
+    float       min_step     = 0.005f;
+    float       max_step     = 0.2f;
+    uint32_t    num_threads  = 0; // Threads the bake time is estimated for, 0 = all cores.
+};
+
+struct BakePlanEntry
+{
+    float      grid_step_size = 0.0f;
+    glm::ivec3 volume_size    = glm::ivec3(0);
+    uint64_t   bytes          = 0;
+    float      error          = 0.0f; // Predicted error, see predicted_bake_error().
+    double     bake_ms        = 0.0;  // Estimated time of a CPU bake.
+};
+
+struct BakePlan
+{
+    std::vector<BakePlanEntry> entries; // One per input, in the same order.
+    uint64_t                   bytes   = 0;
+    double                     bake_ms = 0.0;
+    bool                       fits    = true; // False if even every mesh at max_step is over the budget.
+};
+
+// Predicted error of baking a mesh at grid_step_size: the trilinear error of a surface whose detail is the size of an average
+// triangle grows with the square of the step, and with the step itself once voxels are larger than the triangles. Weighted by
+// importance.
+float predicted_bake_error(const BakePlanInput& input, float grid_step_size);
+
+// Single thread estimate of a CPU bake of a mesh with num_triangles into num_voxels voxels.
+double estimate_bake_ms(uint32_t num_triangles, uint64_t num_voxels);
+
+// Picks a grid step per mesh so the encoded volumes fit in settings.budget_bytes with the least total predicted error. Every
+// mesh starts at max_step, then the mesh with the most error removed per added byte moves to its next finer step until
+// nothing more fits. Nothing is baked.
+BakePlan plan_bake(const std::vector<BakePlanInput>& inputs, const BakePlanSettings& settings);
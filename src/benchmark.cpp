@@ -0,0 +1,1963 @@
+#include "obj_loader.h"
+#include "mapped_file.h"
+#include "sdf_sampler.h"
+#include "bvh.h"
+#include "triangle_batch.h"
+#include "sparse_volume.h"
+#include "sdf_rebaker.h"
+#include "ray_march.h"
+#include "sdf_clipmap.h"
+#include "sdf_query.h"
+#include "mesh_preprocess.h"
+#include "shadow_culling.h"
+#include "profiler.h"
+#include "parallel.h"
+
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+#if defined(SDF_BENCHMARK_ASSIMP)
+#    include <assimp/Importer.hpp>
+#    include <assimp/scene.h>
+#    include <assimp/postprocess.h>
+#endif
+
+#define BENCHMARK_DEFAULT_REPEATS 3
+#define BENCHMARK_NORMAL_SAMPLES 100000
+#define BENCHMARK_NORMAL_BAND 2.0f // Points are taken within this many voxels of the surface, where shading reads normals.
+#define BENCHMARK_NORMAL_EPSILON 0.0001f // Offset of the 6-tap differences, the eps of the old calculate_normal().
+#define BENCHMARK_FILTER_WEIGHT_BITS 8 // Fraction bits of the texture unit's filter weights.
+#define BENCHMARK_REFERENCE_EPSILON 0.01f // Offset of the reference normal's differences of the exact distance, in voxels.
+#define BENCHMARK_MARCH_RESOLUTION 256
+#define BENCHMARK_QUERY_COUNT 100000
+#define BENCHMARK_PREPROCESS_RESOLUTION 64 // Voxels along the longest side of the preprocessing suite's bakes.
+#define BENCHMARK_SHADOW_GRID 8 // Copies of the scene along x and z in the shadow tile suite.
+#define BENCHMARK_BAKE_RESOLUTION 32 // Voxels along the longest side of the bake suite's volumes.
+#define BENCHMARK_BAKE_BAND 4
+#define BENCHMARK_BAKE_SYNTHETIC_TRIANGLES 20000
+#define BENCHMARK_SPARSE_RESOLUTION 64 // Voxels along the longest side of the sparse suite's bakes.
+#define BENCHMARK_SPARSE_BAND 4 // Voxels around the surface whose bricks the sparse volume keeps.
+#define BENCHMARK_KERNEL_POINTS 2000 // Query points per mesh of the kernel suite, half of them near the surface.
+#define BENCHMARK_REBAKE_EDITS 4 // Edits per mesh and bake mode of the rebake suite.
+#define BENCHMARK_REBAKE_VERTICES 3 // Vertices moved by every edit.
+#define BENCHMARK_REBAKE_MOVE 2.0f // Largest distance a vertex moves along each axis, in voxels.
+#define BENCHMARK_CLIPMAP_FRAMES 16 // Frames of the clipmap suite's animation.
+#define BENCHMARK_CLIPMAP_POINTS 10000 // Random points per frame at which the clipmap suite compares scene distances.
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Rings of a bumpy UV sphere with at least num_triangles triangles, which has twice as many segments.
+static uint32_t bumpy_sphere_rings(uint64_t num_triangles)
+{
+    return std::max(2u, static_cast<uint32_t>(ceil(sqrt(double(num_triangles) / 4.0))));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Vertex j of ring i of the bumpy sphere, with the normal of the sphere underneath.
+static glm::vec3 bumpy_sphere_vertex(uint32_t i, uint32_t j, uint32_t rings, glm::vec3& n)
+{
+    float theta = 3.14159265f * float(i) / float(rings);
+    float phi   = 3.14159265f * float(j) / float(rings);
+    float r     = 1.0f + 0.05f * sinf(7.0f * theta) * cosf(5.0f * phi);
+
+    n = glm::vec3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+
+    return n * r;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Writes a bumpy UV sphere with at least num_triangles triangles, in the layout exporters use: separate v, vt and vn lists and
+// v/vt/vn faces, with the seam and pole vertices duplicated.
+static bool generate_obj(const std::string& path, uint64_t num_triangles)
+{
+    FILE* f = fopen(path.c_str(), "wb");
+
+    if (!f)
+        return false;
+
+    uint32_t rings    = bumpy_sphere_rings(num_triangles);
+    uint32_t segments = 2 * rings;
+
+    for (uint32_t i = 0; i <= rings; i++)
+    {
+        for (uint32_t j = 0; j <= segments; j++)
+        {
+            glm::vec3 n;
+            glm::vec3 p = bumpy_sphere_vertex(i, j, rings, n);
+
+            fprintf(f, "v %f %f %f\nvt %f %f\nvn %f %f %f\n", p.x, p.y, p.z, float(j) / float(segments), float(i) / float(rings), n.x, n.y, n.z);
+        }
+    }
+
+    for (uint32_t i = 0; i < rings; i++)
+    {
+        for (uint32_t j = 0; j < segments; j++)
+        {
+            uint32_t a = i * (segments + 1) + j + 1;
+            uint32_t b = a + 1;
+            uint32_t c = a + segments + 1;
+            uint32_t d = c + 1;
+
+            fprintf(f, "f %u/%u/%u %u/%u/%u %u/%u/%u\nf %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c, b, b, b, d, d, d, c, c, c);
+        }
+    }
+
+    fclose(f);
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// The mesh generate_obj() writes, without the rounding of its text.
+static SDFMesh generate_mesh(uint64_t num_triangles)
+{
+    uint32_t rings    = bumpy_sphere_rings(num_triangles);
+    uint32_t segments = 2 * rings;
+
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t>  indices;
+
+    for (uint32_t i = 0; i <= rings; i++)
+    {
+        for (uint32_t j = 0; j <= segments; j++)
+        {
+            glm::vec3 n;
+            positions.push_back(bumpy_sphere_vertex(i, j, rings, n));
+        }
+    }
+
+    for (uint32_t i = 0; i < rings; i++)
+    {
+        for (uint32_t j = 0; j < segments; j++)
+        {
+            uint32_t a = i * (segments + 1) + j;
+            uint32_t b = a + 1;
+            uint32_t c = a + segments + 1;
+            uint32_t d = c + 1;
+
+            indices.insert(indices.end(), { a, b, c, b, d, c });
+        }
+    }
+
+    return make_sdf_mesh(positions, indices);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(SDF_BENCHMARK_ASSIMP)
+// Loads through assimp with the post processing the viewer's meshes get (triangulation, normals and tangent frames), then
+// copies the positions and indices out like create_sdf_mesh() in main.cpp.
+static bool load_obj_assimp(const std::string& path, SDFMesh& mesh)
+{
+    Assimp::Importer importer;
+
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices);
+
+    if (!scene)
+        return false;
+
+    mesh.positions.clear();
+    mesh.indices.clear();
+
+    for (uint32_t i = 0; i < scene->mNumMeshes; i++)
+    {
+        const aiMesh* ai_mesh = scene->mMeshes[i];
+        uint32_t      base    = static_cast<uint32_t>(mesh.positions.size());
+
+        for (uint32_t j = 0; j < ai_mesh->mNumVertices; j++)
+            mesh.positions.push_back(glm::vec3(ai_mesh->mVertices[j].x, ai_mesh->mVertices[j].y, ai_mesh->mVertices[j].z));
+
+        for (uint32_t j = 0; j < ai_mesh->mNumFaces; j++)
+        {
+            const aiFace& face = ai_mesh->mFaces[j];
+
+            if (face.mNumIndices != 3)
+                continue;
+
+            for (uint32_t k = 0; k < 3; k++)
+                mesh.indices.push_back(base + face.mIndices[k]);
+        }
+    }
+
+    compute_vertex_normals(mesh);
+
+    return true;
+}
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void benchmark_obj_loading(const std::vector<std::string>& paths, uint32_t num_threads, uint32_t num_repeats)
+{
+    printf("%-40s %10s %10s %10s %10s %10s %10s %8s\n", "mesh", "triangles", "vertices", "MB", "mmap ms", "MB/s", "assimp ms", "speedup");
+
+    for (const auto& path : paths)
+    {
+        SDFMesh      mesh;
+        ObjLoadStats stats;
+        double       best = 1e30;
+
+        for (uint32_t i = 0; i < num_repeats; i++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+
+            if (!load_obj(path, mesh, num_threads, &stats))
+            {
+                printf("%-40s failed to load\n", path.c_str());
+                break;
+            }
+
+            best = std::min(best, elapsed_ms(start));
+        }
+
+        if (best == 1e30)
+            continue;
+
+        double megabytes = double(stats.file_bytes) / (1024.0 * 1024.0);
+        double assimp    = 0.0;
+
+#if defined(SDF_BENCHMARK_ASSIMP)
+        SDFMesh assimp_mesh;
+
+        assimp = 1e30;
+
+        for (uint32_t i = 0; i < num_repeats; i++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+
+            if (!load_obj_assimp(path, assimp_mesh))
+                break;
+
+            assimp = std::min(assimp, elapsed_ms(start));
+        }
+
+        if (assimp_mesh.num_triangles() != mesh.num_triangles())
+            printf("%-40s triangle count differs: assimp %u, mmap %u\n", path.c_str(), assimp_mesh.num_triangles(), mesh.num_triangles());
+#endif
+
+        printf("%-40s %10u %10zu %10.2f %10.2f %10.1f %10.2f %8.2f\n", path.c_str(), mesh.num_triangles(), mesh.positions.size(), megabytes, best, megabytes / (best / 1000.0), assimp, assimp > 0.0 ? assimp / best : 0.0);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// How a filtered sample is taken for the 6-tap normal: in float, or with the filter weights rounded like a texture unit does.
+enum class NormalFilter
+{
+    EXACT,
+    TEXTURE_UNIT
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static float sample_counted(const SDFVolume& volume, const glm::vec3& os_p, NormalFilter filter, uint64_t& num_fetches)
+{
+    glm::vec3 texel = texel_coordinate(volume, os_p);
+
+    if (filter == NormalFilter::TEXTURE_UNIT)
+    {
+        const float steps = float(1 << BENCHMARK_FILTER_WEIGHT_BITS);
+        glm::vec3   base  = glm::floor(texel);
+
+        texel = base + glm::floor((texel - base) * steps + glm::vec3(0.5f)) / steps;
+    }
+
+    return sample_trilinear(volume.volume_size, texel, [&](int x, int y, int z) {
+        num_fetches++;
+        return volume.voxel(x, y, z);
+    });
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// The normal calculate_normal() in mesh_fs.glsl used to take: central differences of 6 filtered samples.
+static glm::vec3 normal_six_tap(const SDFVolume& volume, const glm::vec3& os_p, NormalFilter filter, uint64_t& num_fetches)
+{
+    const glm::vec3 dx = glm::vec3(BENCHMARK_NORMAL_EPSILON, 0.0f, 0.0f);
+    const glm::vec3 dy = glm::vec3(0.0f, BENCHMARK_NORMAL_EPSILON, 0.0f);
+    const glm::vec3 dz = glm::vec3(0.0f, 0.0f, BENCHMARK_NORMAL_EPSILON);
+
+    glm::vec3 n = glm::vec3(sample_counted(volume, os_p + dx, filter, num_fetches) - sample_counted(volume, os_p - dx, filter, num_fetches),
+                            sample_counted(volume, os_p + dy, filter, num_fetches) - sample_counted(volume, os_p - dy, filter, num_fetches),
+                            sample_counted(volume, os_p + dz, filter, num_fetches) - sample_counted(volume, os_p - dz, filter, num_fetches));
+
+    return glm::length(n) > 0.0f ? glm::normalize(n) : n;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static glm::vec3 normal_fused(const SDFVolume& volume, const glm::vec3& os_p, uint64_t& num_fetches)
+{
+    glm::vec3 gradient;
+
+    sample_trilinear_gradient(volume.volume_size, texel_coordinate(volume, os_p), [&](int x, int y, int z) {
+        num_fetches++;
+        return volume.voxel(x, y, z);
+    }, gradient);
+
+    gradient *= glm::vec3(volume.volume_size) / (volume.max_extents - volume.min_extents);
+
+    return glm::length(gradient) > 0.0f ? glm::normalize(gradient) : gradient;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Angle between two normals in degrees, or between the lines along them when unoriented is set. A zero normal, which the
+// 6-tap path gives when all its samples round to the same value, counts as 90 degrees off.
+static double angle_degrees(const glm::vec3& a, const glm::vec3& b, bool unoriented = false)
+{
+    if (glm::length(a) == 0.0f || glm::length(b) == 0.0f)
+        return 90.0;
+
+    double cosine = double(glm::dot(a, b));
+
+    if (unoriented)
+        cosine = fabs(cosine);
+
+    return acos(std::max(-1.0, std::min(1.0, cosine))) * 180.0 / 3.14159265358979323846;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Normals of the fused value and gradient sampler against the 6-tap finite differences, at points near the surface of every
+// mesh's bake. Errors are measured against the gradient of the exact distance to the mesh, as lines.
+static void benchmark_normals(const std::vector<std::string>& paths, uint32_t num_threads, uint32_t num_repeats)
+{
+    printf("%-40s %8s %8s %8s %9s %9s %9s %9s %9s %9s %9s\n", "mesh", "points", "fused", "6-tap", "fused ms", "6-tap ms", "vs 6-tap", "fused err", "6-tap err", "tex err", "tex zero");
+
+    for (const auto& path : paths)
+    {
+        SDFMesh mesh;
+
+        if (!load_obj(path, mesh, num_threads))
+        {
+            printf("%-40s failed to load\n", path.c_str());
+            continue;
+        }
+
+        BakeSettings settings;
+
+        settings.num_threads = num_threads;
+
+        SDFVolume volume = bake_sdf(mesh, settings);
+        BVH       bvh;
+
+        bvh.build(mesh);
+
+        // Random points in the volume's box that are close to the surface, with the gradient of the exact unsigned distance there.
+        // The sign of the bake flips between nearby points close to some surfaces, so the errors ignore orientation.
+        std::mt19937                          rng(1);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        std::vector<glm::vec3>                points;
+        std::vector<glm::vec3>                references;
+
+        for (uint32_t i = 0; i < 100 * BENCHMARK_NORMAL_SAMPLES && points.size() < BENCHMARK_NORMAL_SAMPLES; i++)
+        {
+            glm::vec3 p = volume.min_extents + glm::vec3(uniform(rng), uniform(rng), uniform(rng)) * (volume.max_extents - volume.min_extents);
+
+            if (fabsf(sample_sdf(volume, p)) > BENCHMARK_NORMAL_BAND * volume.grid_step_size)
+                continue;
+
+            const float eps = BENCHMARK_REFERENCE_EPSILON * volume.grid_step_size;
+
+            auto distance = [&](const glm::vec3& q) { return bvh.closest_triangle(q).distance; };
+
+            glm::vec3 n = glm::vec3(distance(p + glm::vec3(eps, 0.0f, 0.0f)) - distance(p - glm::vec3(eps, 0.0f, 0.0f)),
+                                    distance(p + glm::vec3(0.0f, eps, 0.0f)) - distance(p - glm::vec3(0.0f, eps, 0.0f)),
+                                    distance(p + glm::vec3(0.0f, 0.0f, eps)) - distance(p - glm::vec3(0.0f, 0.0f, eps)));
+
+            if (glm::length(n) == 0.0f)
+                continue;
+
+            points.push_back(p);
+            references.push_back(glm::normalize(n));
+        }
+
+        std::vector<glm::vec3> fused(points.size());
+        std::vector<glm::vec3> six_tap(points.size());
+        std::vector<glm::vec3> texture_unit(points.size());
+        uint64_t               fused_fetches   = 0;
+        uint64_t               six_tap_fetches = 0;
+        uint64_t               unused_fetches  = 0;
+        double                 fused_ms        = 1e30;
+        double                 six_tap_ms      = 1e30;
+
+        for (uint32_t r = 0; r < num_repeats; r++)
+        {
+            fused_fetches   = 0;
+            six_tap_fetches = 0;
+
+            auto start = std::chrono::high_resolution_clock::now();
+
+            for (size_t i = 0; i < points.size(); i++)
+                fused[i] = normal_fused(volume, points[i], fused_fetches);
+
+            fused_ms = std::min(fused_ms, elapsed_ms(start));
+            start    = std::chrono::high_resolution_clock::now();
+
+            for (size_t i = 0; i < points.size(); i++)
+                six_tap[i] = normal_six_tap(volume, points[i], NormalFilter::EXACT, six_tap_fetches);
+
+            six_tap_ms = std::min(six_tap_ms, elapsed_ms(start));
+        }
+
+        for (size_t i = 0; i < points.size(); i++)
+            texture_unit[i] = normal_six_tap(volume, points[i], NormalFilter::TEXTURE_UNIT, unused_fetches);
+
+        double   difference    = 0.0;
+        double   fused_error   = 0.0;
+        double   six_tap_error = 0.0;
+        double   texture_error = 0.0;
+        uint64_t texture_zero  = 0;
+        double   num_points    = double(std::max<size_t>(points.size(), 1));
+
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            difference += angle_degrees(fused[i], six_tap[i]);
+            fused_error += angle_degrees(fused[i], references[i], true);
+            six_tap_error += angle_degrees(six_tap[i], references[i], true);
+            texture_error += angle_degrees(texture_unit[i], references[i], true);
+
+            if (glm::length(texture_unit[i]) == 0.0f)
+                texture_zero++;
+        }
+
+        printf("%-40s %8zu %8.1f %8.1f %9.2f %9.2f %9.4f %9.3f %9.3f %9.3f %9llu\n",
+               path.c_str(),
+               points.size(),
+               double(fused_fetches) / num_points,
+               double(six_tap_fetches) / num_points,
+               fused_ms,
+               six_tap_ms,
+               difference / num_points,
+               fused_error / num_points,
+               six_tap_error / num_points,
+               texture_error / num_points,
+               (unsigned long long)texture_zero);
+    }
+
+    printf("\nfused and 6-tap: texel fetches per normal. vs 6-tap: mean angle between the two normals in degrees. err: mean angle to the\n"
+           "line along the gradient of the exact distance in degrees, tex for the 6-tap normal with %d bit filter weights, tex zero counts its zero normals.\n",
+           BENCHMARK_FILTER_WEIGHT_BITS);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool write_pgm(const std::string& path, const std::vector<float>& values, uint32_t width, uint32_t height)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+
+    if (!file)
+        return false;
+
+    std::vector<uint8_t> pixels(values.size());
+
+    for (size_t i = 0; i < values.size(); i++)
+        pixels[i] = static_cast<uint8_t>(std::max(0.0f, std::min(1.0f, values[i])) * 255.0f + 0.5f);
+
+    fprintf(file, "P5\n%u %u\n255\n", width, height);
+
+    bool ok = fwrite(pixels.data(), 1, pixels.size(), file) == pixels.size();
+
+    fclose(file);
+
+    return ok;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Scene made of the meshes for the CPU ray march and query benchmarks. Meshes flatter than they are wide are laid at the origin
+// as a floor, the rest stand in a row 4 units apart like the viewer's scene.
+struct BenchmarkScene
+{
+    std::vector<SDFVolume>   volumes;
+    std::vector<SDFInstance> instances;
+    InstanceBVH              bvh;
+    glm::vec3                min_extents = glm::vec3(SDF_INFINITY);
+    glm::vec3                max_extents = glm::vec3(-SDF_INFINITY);
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool build_benchmark_scene(const std::vector<std::string>& paths, uint32_t num_threads, BenchmarkScene& scene)
+{
+    std::vector<bool> floors;
+
+    scene.volumes.reserve(paths.size());
+
+    for (const auto& path : paths)
+    {
+        SDFMesh mesh;
+
+        if (!load_obj(path, mesh, num_threads))
+        {
+            printf("%-40s failed to load\n", path.c_str());
+            continue;
+        }
+
+        // The vertex normals of a box as coarse as ground.obj give the wrong sign over most of its faces.
+        BakeSettings settings;
+
+        settings.num_threads = num_threads;
+        settings.sign_mode   = SignMode::WINDING_NUMBER;
+
+        glm::vec3 min_extents;
+        glm::vec3 max_extents;
+
+        compute_extents(mesh, min_extents, max_extents);
+
+        glm::vec3 size = max_extents - min_extents;
+
+        scene.volumes.push_back(bake_sdf(mesh, settings));
+        floors.push_back(size.y < 0.25f * std::max(size.x, size.z));
+    }
+
+    uint32_t num_standing = static_cast<uint32_t>(std::count(floors.begin(), floors.end(), false));
+    uint32_t column       = 0;
+
+    std::vector<InstanceBox> boxes;
+
+    for (size_t i = 0; i < scene.volumes.size(); i++)
+    {
+        glm::vec3 position = glm::vec3(0.0f);
+
+        if (!floors[i])
+            position = glm::vec3(4.0f * (float(column++) - 0.5f * float(num_standing - 1)), 0.0f, 1.0f);
+
+        scene.instances.push_back(make_sdf_instance(&scene.volumes[i], glm::translate(glm::mat4(1.0f), position)));
+        boxes.push_back(instance_box(scene.instances.back()));
+
+        glm::vec3 min_extents;
+        glm::vec3 max_extents;
+
+        instance_box_extents(boxes.back(), min_extents, max_extents);
+
+        scene.min_extents = glm::min(scene.min_extents, min_extents);
+        scene.max_extents = glm::max(scene.max_extents, max_extents);
+    }
+
+    if (scene.instances.empty())
+        return false;
+
+    scene.bvh.build(boxes);
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Renders the shadow and AO buffers of the benchmark scene with the CPU ray march engine, from the viewer's initial camera, at
+// every power of two thread count up to num_threads.
+static void benchmark_ray_march(const std::vector<std::string>& paths, uint32_t num_threads, uint32_t num_repeats, const std::string& image_prefix, Profiler& profiler)
+{
+    BenchmarkScene scene;
+
+    if (!build_benchmark_scene(paths, num_threads, scene))
+        return;
+
+    RayMarchScene march_scene;
+
+    march_scene.instances = &scene.instances;
+    march_scene.bvh       = &scene.bvh;
+
+    const glm::mat4 view_proj = glm::perspective(glm::radians(60.0f), 1.0f, 1.0f, 1000.0f) * glm::lookAt(glm::vec3(0.0f, 3.0f, 15.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const glm::vec3 light_pos = glm::vec3(0.0f, 30.0f, 35.0f);
+
+    printf("%zu instances, %ux%u pixels, packets of %d rays\n", scene.instances.size(), BENCHMARK_MARCH_RESOLUTION, BENCHMARK_MARCH_RESOLUTION, RAY_PACKET_WIDTH);
+    printf("%8s %12s %12s %12s %14s %14s %10s\n", "threads", "primary/s", "shadow/s", "ao/s", "shadow steps", "shadow lanes", "refills");
+
+    ShadowAOBuffers buffers;
+    RayMarchStats   shadow_stats;
+    uint32_t        max_threads = resolve_thread_count(num_threads);
+
+    for (uint32_t threads = 1;; threads = std::min(threads * 2, max_threads))
+    {
+        RayMarchSettings settings;
+
+        settings.num_threads = threads;
+
+        ShadowAOStats best;
+
+        best.primary_ms = best.shadow_ms = best.ao_ms = 1e30;
+
+        for (uint32_t r = 0; r < num_repeats; r++)
+        {
+            ShadowAOStats stats;
+
+            render_shadow_ao(march_scene, view_proj, light_pos, BENCHMARK_MARCH_RESOLUTION, BENCHMARK_MARCH_RESOLUTION, settings, buffers, &stats);
+
+            best.primary    = stats.primary;
+            best.shadow     = stats.shadow;
+            best.ao         = stats.ao;
+            best.primary_ms = std::min(best.primary_ms, stats.primary_ms);
+            best.shadow_ms  = std::min(best.shadow_ms, stats.shadow_ms);
+            best.ao_ms      = std::min(best.ao_ms, stats.ao_ms);
+        }
+
+        std::string name = "march.threads_" + std::to_string(threads);
+
+        profile_ray_march(profiler, name + ".primary", best.primary, best.primary_ms);
+        profile_ray_march(profiler, name + ".shadow", best.shadow, best.shadow_ms);
+        profile_ray_march(profiler, name + ".ao", best.ao, best.ao_ms);
+
+        shadow_stats = best.shadow;
+
+        auto per_second = [](uint64_t rays, double ms) { return ms > 0.0 ? double(rays) / (ms / 1000.0) : 0.0; };
+
+        printf("%8u %12.0f %12.0f %12.0f %14.1f %13.1f%% %10llu\n",
+               threads,
+               per_second(best.primary.num_rays, best.primary_ms),
+               per_second(best.shadow.num_rays, best.shadow_ms),
+               per_second(best.ao.num_rays, best.ao_ms),
+               double(best.shadow.num_samples) / double(std::max<uint64_t>(best.shadow.num_rays, 1)),
+               100.0 * double(best.shadow.num_samples) / double(std::max<uint64_t>(best.shadow.lane_steps, 1)),
+               (unsigned long long)best.shadow.num_refills);
+
+        if (threads == max_threads)
+            break;
+    }
+
+    printf("\nshadow rays by steps:");
+
+    for (uint32_t i = 0; i < RAY_MARCH_STEP_BINS; i++)
+    {
+        uint32_t first = i == 0 ? 0 : 1u << (i - 1);
+
+        if (i == RAY_MARCH_STEP_BINS - 1)
+            printf(" %u+: %llu", first, (unsigned long long)shadow_stats.step_histogram[i]);
+        else
+            printf(" %u-%u: %llu", first, i == 0 ? 0 : (1u << i) - 1, (unsigned long long)shadow_stats.step_histogram[i]);
+    }
+
+    printf("\n\nshadow steps: scene samples per shadow ray. shadow lanes: active lanes over all lanes of every packet step.\n");
+
+    if (!image_prefix.empty())
+    {
+        if (!write_pgm(image_prefix + "_shadow.pgm", buffers.shadow, buffers.width, buffers.height) || !write_pgm(image_prefix + "_ao.pgm", buffers.ao, buffers.width, buffers.height))
+            printf("Failed to write %s_shadow.pgm and %s_ao.pgm\n", image_prefix.c_str(), image_prefix.c_str());
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Batched point and sphere queries against the benchmark scene, at random positions in a box 1 unit larger than the scene's,
+// in queries per second with and without sorting. Sorted results must match the unsorted ones exactly.
+static void benchmark_queries(const std::vector<std::string>& paths, uint32_t num_threads, uint32_t num_repeats)
+{
+    BenchmarkScene scene;
+
+    if (!build_benchmark_scene(paths, num_threads, scene))
+        return;
+
+    std::mt19937                          rng(1);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<glm::vec3>                points(BENCHMARK_QUERY_COUNT);
+    std::vector<glm::vec4>                spheres(BENCHMARK_QUERY_COUNT);
+
+    const glm::vec3 min_extents = scene.min_extents - glm::vec3(1.0f);
+    const glm::vec3 size        = scene.max_extents + glm::vec3(1.0f) - min_extents;
+
+    for (uint32_t i = 0; i < BENCHMARK_QUERY_COUNT; i++)
+    {
+        points[i]  = min_extents + glm::vec3(uniform(rng), uniform(rng), uniform(rng)) * size;
+        spheres[i] = glm::vec4(min_extents + glm::vec3(uniform(rng), uniform(rng), uniform(rng)) * size, 0.1f + 0.4f * uniform(rng));
+    }
+
+    printf("%zu instances, %d queries\n", scene.instances.size(), BENCHMARK_QUERY_COUNT);
+    printf("%8s %14s %14s %10s %14s %14s %12s %10s\n", "threads", "points/s", "sorted/s", "sort ms", "spheres/s", "sorted/s", "instances", "mismatches");
+
+    std::vector<SDFQueryResult> unsorted(BENCHMARK_QUERY_COUNT);
+    std::vector<SDFQueryResult> sorted(BENCHMARK_QUERY_COUNT);
+    uint32_t                    max_threads = resolve_thread_count(num_threads);
+
+    for (uint32_t threads = 1;; threads = std::min(threads * 2, max_threads))
+    {
+        double   best[4]    = { 1e30, 1e30, 1e30, 1e30 };
+        double   sort_ms    = 1e30;
+        uint64_t evaluated  = 0;
+        uint64_t mismatches = 0;
+
+        for (uint32_t r = 0; r < num_repeats; r++)
+        {
+            for (uint32_t mode = 0; mode < 4; mode++)
+            {
+                SDFQuerySettings settings;
+                SDFQueryStats    stats;
+
+                settings.num_threads = threads;
+                settings.sort        = (mode & 1) != 0;
+
+                std::vector<SDFQueryResult>& results = settings.sort ? sorted : unsorted;
+
+                if (mode < 2)
+                    query_sdf_points(scene.instances, scene.bvh, points.data(), BENCHMARK_QUERY_COUNT, results.data(), settings, &stats);
+                else
+                    query_sdf_spheres(scene.instances, scene.bvh, spheres.data(), BENCHMARK_QUERY_COUNT, results.data(), settings, &stats);
+
+                best[mode] = std::min(best[mode], stats.sort_ms + stats.query_ms);
+
+                if (settings.sort)
+                {
+                    sort_ms   = std::min(sort_ms, stats.sort_ms);
+                    evaluated = stats.instances_evaluated;
+
+                    for (uint32_t i = 0; i < BENCHMARK_QUERY_COUNT; i++)
+                    {
+                        if (sorted[i].distance != unsorted[i].distance || sorted[i].gradient != unsorted[i].gradient || sorted[i].instance != unsorted[i].instance)
+                            mismatches++;
+                    }
+                }
+            }
+        }
+
+        auto per_second = [](double ms) { return ms > 0.0 ? double(BENCHMARK_QUERY_COUNT) / (ms / 1000.0) : 0.0; };
+
+        printf("%8u %14.0f %14.0f %10.2f %14.0f %14.0f %12.2f %10llu\n",
+               threads,
+               per_second(best[0]),
+               per_second(best[1]),
+               sort_ms,
+               per_second(best[2]),
+               per_second(best[3]),
+               double(evaluated) / double(BENCHMARK_QUERY_COUNT),
+               (unsigned long long)mismatches);
+
+        if (threads == max_threads)
+            break;
+    }
+
+    printf("\nsorted/s includes the sort. instances: instances evaluated per sphere query.\n");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// A clipmap of the benchmark scene over BENCHMARK_CLIPMAP_FRAMES frames in which the first instance circles and turns and the
+// center scrolls along x and z, updated incrementally. Every frame, every voxel of every level must equal a clipmap built from
+// scratch at the same center, and evaluate_scene_clipmap() is compared with the exact scene distance clamped to the band of
+// the level it samples at BENCHMARK_CLIPMAP_POINTS random points. Trilinear filtering keeps that error below a voxel of the level.
+static void benchmark_clipmap(const std::vector<std::string>& paths, uint32_t num_threads, uint32_t num_repeats)
+{
+    BenchmarkScene scene;
+
+    if (!build_benchmark_scene(paths, num_threads, scene))
+        return;
+
+    const glm::vec3 scene_center = 0.5f * (scene.min_extents + scene.max_extents);
+    const glm::vec3 scene_size   = scene.max_extents - scene.min_extents;
+    const glm::mat4 transform    = scene.instances[0].transform;
+
+    std::vector<InstanceBox> boxes(scene.instances.size());
+
+    for (size_t i = 0; i < scene.instances.size(); i++)
+        boxes[i] = instance_box(scene.instances[i]);
+
+    SDFClipmap clipmap(SDF_CLIPMAP_LEVELS, SDF_CLIPMAP_RESOLUTION, SDF_CLIPMAP_VOXEL_SIZE, num_threads);
+
+    clipmap.update(scene.instances, {}, scene_center);
+
+    std::mt19937                          rng(1);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    printf("%-6s %8s %12s %12s %8s %10s %10s %10s %10s %10s %10s\n", "frame", "scrolled", "recomposed", "total", "%", "update ms", "full ms", "mismatch", "max err", "refined", "ref diff");
+
+    uint64_t total_recomposed = 0;
+    uint64_t total_voxels     = 0;
+    uint64_t total_mismatches = 0;
+    double   max_error        = 0.0;
+
+    for (uint32_t frame = 1; frame <= BENCHMARK_CLIPMAP_FRAMES; frame++)
+    {
+        const float     angle  = glm::two_pi<float>() * float(frame) / float(BENCHMARK_CLIPMAP_FRAMES);
+        const glm::vec3 center = scene_center + glm::vec3(0.3f * float(frame), 0.0f, -0.2f * float(frame));
+
+        glm::mat4 animated = glm::translate(glm::mat4(1.0f), glm::vec3(2.0f * sinf(angle), 0.0f, 2.0f * (cosf(angle) - 1.0f))) * transform;
+
+        animated = glm::rotate(animated, angle, glm::vec3(0.0f, 1.0f, 0.0f));
+
+        scene.instances[0] = make_sdf_instance(scene.instances[0].volume, animated);
+        boxes[0]           = instance_box(scene.instances[0]);
+
+        scene.bvh.refit(boxes);
+
+        SDFClipmapUpdateStats stats;
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        clipmap.update(scene.instances, { 0 }, center, &stats);
+
+        double update_ms = elapsed_ms(start);
+        double full_ms   = 1e30;
+
+        SDFClipmap reference(SDF_CLIPMAP_LEVELS, SDF_CLIPMAP_RESOLUTION, SDF_CLIPMAP_VOXEL_SIZE, num_threads);
+
+        for (uint32_t r = 0; r < num_repeats; r++)
+        {
+            reference = SDFClipmap(SDF_CLIPMAP_LEVELS, SDF_CLIPMAP_RESOLUTION, SDF_CLIPMAP_VOXEL_SIZE, num_threads);
+            start     = std::chrono::high_resolution_clock::now();
+
+            reference.update(scene.instances, {}, center);
+
+            full_ms = std::min(full_ms, elapsed_ms(start));
+        }
+
+        uint64_t mismatches = 0;
+
+        for (uint32_t level = 0; level < clipmap.num_levels(); level++)
+        {
+            if (clipmap.origin(level) != reference.origin(level))
+            {
+                mismatches += uint64_t(clipmap.resolution()) * clipmap.resolution() * clipmap.resolution();
+                continue;
+            }
+
+            const glm::ivec3 origin = clipmap.origin(level);
+            const int        r      = static_cast<int>(clipmap.resolution());
+
+            for (int z = 0; z < r; z++)
+            {
+                for (int y = 0; y < r; y++)
+                {
+                    for (int x = 0; x < r; x++)
+                    {
+                        glm::ivec3 c = origin + glm::ivec3(x, y, z);
+
+                        mismatches += clipmap.voxel(level, c) != reference.voxel(level, c) ? 1 : 0;
+                    }
+                }
+            }
+        }
+
+        // Points in the scene's box grown by a quarter on every side, which also covers the animated instance.
+        double   frame_error     = 0.0;
+        uint32_t refined         = 0;
+        uint32_t refined_differs = 0;
+
+        for (uint32_t i = 0; i < BENCHMARK_CLIPMAP_POINTS; i++)
+        {
+            glm::vec3 p     = scene_center + (glm::vec3(uniform(rng), uniform(rng), uniform(rng)) - glm::vec3(0.5f)) * 1.5f * scene_size;
+            uint32_t  level = clipmap.find_level(p);
+            float     exact = evaluate_scene_sdf(scene.instances, scene.bvh, p).distance;
+            float     h     = evaluate_scene_clipmap(scene.instances, scene.bvh, clipmap, p);
+
+            if (level == UINT32_MAX || h <= SDF_CLIPMAP_REFINE_VOXELS * clipmap.voxel_size(level))
+            {
+                // Evaluated from the instances, which must give the exact distance.
+                refined_differs += h != exact ? 1 : 0;
+                refined++;
+                continue;
+            }
+
+            frame_error = std::max(frame_error, fabs(double(h) - double(std::min(exact, clipmap.band(level)))) / double(clipmap.voxel_size(level)));
+        }
+
+        total_recomposed += stats.recomposed_voxels;
+        total_voxels += stats.total_voxels;
+        total_mismatches += mismatches + refined_differs;
+        max_error = std::max(max_error, frame_error);
+
+        printf("%-6u %8u %12llu %12llu %8.2f %10.2f %10.2f %10llu %10.3f %10u %10u\n",
+               frame,
+               stats.scrolled_levels,
+               (unsigned long long)stats.recomposed_voxels,
+               (unsigned long long)stats.total_voxels,
+               100.0 * double(stats.recomposed_voxels) / double(std::max<uint64_t>(stats.total_voxels, 1)),
+               update_ms,
+               full_ms,
+               (unsigned long long)mismatches,
+               frame_error,
+               refined,
+               refined_differs);
+    }
+
+    printf("\nall    %8s %12llu %12llu %8.2f %10s %10s %10llu %10.3f\n",
+           "",
+           (unsigned long long)total_recomposed,
+           (unsigned long long)total_voxels,
+           100.0 * double(total_recomposed) / double(std::max<uint64_t>(total_voxels, 1)),
+           "",
+           "",
+           (unsigned long long)total_mismatches,
+           max_error);
+
+    printf("\nscrolled: levels whose origin moved. recomposed and total: voxels update() composed and voxels of all levels. full ms:\n"
+           "building the clipmap from scratch. mismatch: voxels that differ from it, must be 0. max err: largest difference of\n"
+           "evaluate_scene_clipmap() from the exact distance clamped to the band, in voxels of the sampled level, below 1 from\n"
+           "trilinear filtering. refined: points close enough to the surface to be evaluated from the instances, ref diff: those\n"
+           "that differ from the exact distance, must be 0. The mismatch total includes them. %u levels of %u^3 voxels, %.3f apart in level 0.\n",
+           SDF_CLIPMAP_LEVELS,
+           SDF_CLIPMAP_RESOLUTION,
+           SDF_CLIPMAP_VOXEL_SIZE);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// The mesh the way an exporter that splits vertices at every face writes it: three vertices per triangle, in random order. With
+// face_normals every vertex gets the normal of its triangle, like a mesh with hard edges everywhere.
+static SDFMesh unweld_and_shuffle(const SDFMesh& mesh, bool face_normals)
+{
+    std::vector<uint32_t> order(mesh.num_triangles());
+
+    for (uint32_t i = 0; i < order.size(); i++)
+        order[i] = i;
+
+    std::mt19937 rng(1);
+    std::shuffle(order.begin(), order.end(), rng);
+
+    SDFMesh result;
+
+    for (uint32_t t : order)
+    {
+        const glm::vec3* p      = &mesh.positions[0];
+        const uint32_t*  v      = &mesh.indices[3 * t];
+        glm::vec3        normal = glm::cross(p[v[1]] - p[v[0]], p[v[2]] - p[v[0]]);
+        float            length = glm::length(normal);
+
+        for (int j = 0; j < 3; j++)
+        {
+            result.indices.push_back(static_cast<uint32_t>(result.positions.size()));
+            result.positions.push_back(p[v[j]]);
+            result.normals.push_back(face_normals && length > 0.0f ? normal / length : mesh.normals[v[j]]);
+        }
+    }
+
+    return result;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// preprocess_mesh() on every mesh as loaded and unwelded and shuffled: what it removes, how long it takes, and bake times before
+// and after, with the largest difference between the two volumes.
+static void benchmark_preprocess(const std::vector<std::string>& paths, uint32_t num_threads, uint32_t num_repeats)
+{
+    printf("%-40s %-9s %10s %10s %8s %8s %12s %10s %10s %8s %10s\n", "mesh", "input", "triangles", "welded", "degen", "dup", "preprocess", "bake ms", "after ms", "speedup", "max diff");
+
+    for (const auto& path : paths)
+    {
+        SDFMesh loaded;
+
+        if (!load_obj(path, loaded, num_threads))
+        {
+            printf("Failed to load %s\n", path.c_str());
+            continue;
+        }
+
+        glm::vec3 min_extents, max_extents;
+
+        compute_extents(loaded, min_extents, max_extents);
+
+        glm::vec3    size = max_extents - min_extents;
+        BakeSettings settings;
+
+        settings.grid_step_size = std::max(size.x, std::max(size.y, size.z)) / float(BENCHMARK_PREPROCESS_RESOLUTION);
+        settings.num_threads    = num_threads;
+
+        const char* inputs[] = { "loaded", "shuffled", "faceted" };
+
+        for (int input = 0; input < 3; input++)
+        {
+            SDFMesh mesh = input == 0 ? loaded : unweld_and_shuffle(loaded, input == 2);
+
+            MeshPreprocessSettings preprocess_settings;
+            MeshPreprocessStats    stats;
+            SDFMesh                preprocessed;
+            double                 preprocess_ms = 1e30;
+
+            preprocess_settings.num_threads  = num_threads;
+            preprocess_settings.keep_normals = settings.sign_mode == SignMode::NORMALS;
+
+            for (uint32_t r = 0; r < num_repeats; r++)
+            {
+                preprocessed = mesh;
+                preprocess_mesh(preprocessed, preprocess_settings, &stats);
+                preprocess_ms = std::min(preprocess_ms, stats.ms);
+            }
+
+            SDFVolume before, after;
+            double    before_ms = 1e30;
+            double    after_ms  = 1e30;
+
+            for (uint32_t r = 0; r < num_repeats; r++)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                before     = bake_sdf(mesh, settings);
+                before_ms  = std::min(before_ms, elapsed_ms(start));
+
+                start    = std::chrono::high_resolution_clock::now();
+                after    = bake_sdf(preprocessed, settings);
+                after_ms = std::min(after_ms, elapsed_ms(start));
+            }
+
+            float max_diff = 0.0f;
+
+            for (size_t i = 0; i < before.distances.size(); i++)
+                max_diff = std::max(max_diff, fabsf(before.distances[i] - after.distances[i]));
+
+            printf("%-40s %-9s %10u %10u %8u %8u %12.2f %10.1f %10.1f %8.2f %10.6f\n",
+                   path.c_str(),
+                   inputs[input],
+                   stats.input_triangles,
+                   stats.welded_vertices,
+                   stats.degenerate_triangles,
+                   stats.duplicate_triangles,
+                   preprocess_ms,
+                   before_ms,
+                   after_ms,
+                   before_ms / after_ms,
+                   max_diff);
+        }
+    }
+
+    printf("\nshuffled: three vertices per triangle in random order. faceted: the same with face normals, so no vertices can be welded\n"
+           "without changing the normals that decide the sign. Bakes are %d voxels along the longest side.\n",
+           BENCHMARK_PREPROCESS_RESOLUTION);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Every mesh baked at BENCHMARK_SPARSE_RESOLUTION voxels and converted to a sparse volume with a band of BENCHMARK_SPARSE_BAND
+// voxels: bricks kept, memory against the dense volume and samples at random points against the dense ones. Points whose 8
+// texels are all within the band read stored bricks only, so their samples must be equal. Everywhere else a sample must not be
+// further from the surface than the dense one.
+static void benchmark_sparse(const std::vector<std::string>& paths, uint32_t num_threads, uint32_t num_repeats)
+{
+    printf("%-40s %8s %8s %10s %10s %8s %10s %8s %10s %8s %10s\n", "mesh", "bricks", "stored", "dense MB", "sparse MB", "ratio", "build ms", "in band", "mismatch", "outside", "violation");
+
+    uint32_t failures = 0;
+
+    for (const auto& path : paths)
+    {
+        SDFMesh mesh;
+
+        if (!load_obj(path, mesh, num_threads))
+        {
+            printf("%-40s failed to load\n", path.c_str());
+            continue;
+        }
+
+        glm::vec3 min_extents, max_extents;
+
+        compute_extents(mesh, min_extents, max_extents);
+
+        glm::vec3    size = max_extents - min_extents;
+        BakeSettings settings;
+
+        settings.grid_step_size = std::max(size.x, std::max(size.y, size.z)) / float(BENCHMARK_SPARSE_RESOLUTION);
+        settings.num_threads    = num_threads;
+
+        SDFVolume       volume = bake_sdf(mesh, settings);
+        SparseSDFVolume sparse;
+        double          build_ms = 1e30;
+
+        const float band_distance = float(BENCHMARK_SPARSE_BAND) * volume.grid_step_size;
+
+        for (uint32_t r = 0; r < num_repeats; r++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            sparse     = build_sparse_volume(volume, band_distance, num_threads);
+            build_ms   = std::min(build_ms, elapsed_ms(start));
+        }
+
+        // Texels are at most a voxel diagonal from the sample point and the distances change by at most that much across it.
+        const float inner_band = band_distance - sqrtf(3.0f) * volume.grid_step_size;
+        const float tolerance  = 1e-6f * volume.grid_step_size;
+
+        std::mt19937                          rng(1);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        uint64_t                              in_band    = 0;
+        uint64_t                              outside    = 0;
+        uint64_t                              mismatches = 0;
+        uint64_t                              violations = 0;
+
+        for (uint32_t i = 0; i < BENCHMARK_NORMAL_SAMPLES; i++)
+        {
+            glm::vec3 p      = volume.min_extents + glm::vec3(uniform(rng), uniform(rng), uniform(rng)) * (volume.max_extents - volume.min_extents);
+            float     dense  = sample_sdf(volume, p);
+            float     sample = sample_sdf(sparse, p);
+
+            if (fabsf(dense) <= inner_band)
+            {
+                in_band++;
+                mismatches += sample != dense ? 1 : 0;
+            }
+            else
+            {
+                outside++;
+                violations += fabsf(sample) > fabsf(dense) + tolerance ? 1 : 0;
+            }
+        }
+
+        failures += mismatches + violations > 0 ? 1 : 0;
+
+        printf("%-40s %8u %8u %10.2f %10.2f %7.1f%% %10.2f %8llu %10llu %8llu %10llu\n",
+               path.c_str(),
+               sparse.num_bricks(),
+               sparse.num_stored_bricks(),
+               double(sparse.dense_memory_bytes()) / (1024.0 * 1024.0),
+               double(sparse.memory_bytes()) / (1024.0 * 1024.0),
+               100.0 * double(sparse.memory_bytes()) / double(sparse.dense_memory_bytes()),
+               build_ms,
+               (unsigned long long)in_band,
+               (unsigned long long)mismatches,
+               (unsigned long long)outside,
+               (unsigned long long)violations);
+    }
+
+    printf("\nratio: sparse memory over dense memory. in band: samples whose texels are all within the band, mismatch counts those that\n"
+           "differ from the dense sample. violation: samples outside it further from the surface than the dense sample.%s\n",
+           failures > 0 ? " FAILED" : "");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// sdf_triangle_batch() against the scalar sdf_triangle(), the expression of bake_sdf_cs.glsl, for every triangle of every mesh
+// from BENCHMARK_KERNEL_POINTS points: half anywhere in the mesh's box grown by a quarter on every side, half within a voxel of
+// a random point on a random triangle, where the distances are small and relative errors show. Also compares the closest
+// triangle over all batches with the scalar closest_triangle_brute_force(). Build with SDF_BAKER_AVX2 or SDF_BAKER_NO_SIMD to
+// check the other paths.
+static void benchmark_kernel(const std::vector<std::string>& paths, uint32_t num_threads, uint32_t num_repeats)
+{
+    printf("kernel: %u lanes (%s)\n\n", triangle_batch_lanes(), triangle_batch_lanes() == 8 ? "AVX2" : triangle_batch_lanes() == 4 ? "SSE2" : "scalar");
+    printf("%-40s %10s %12s %12s %12s %10s %10s %10s %10s\n", "mesh", "triangles", "pairs", "max abs", "max rel", "closest", "max diff", "scalar ns", "batch ns");
+
+    for (const auto& path : paths)
+    {
+        SDFMesh mesh;
+
+        if (!load_obj(path, mesh, num_threads))
+        {
+            printf("%-40s failed to load\n", path.c_str());
+            continue;
+        }
+
+        if (mesh.num_triangles() == 0)
+            continue;
+
+        glm::vec3 min_extents, max_extents;
+
+        compute_extents(mesh, min_extents, max_extents);
+
+        const glm::vec3 size  = max_extents - min_extents;
+        const float     voxel = std::max(size.x, std::max(size.y, size.z)) / float(BENCHMARK_BAKE_RESOLUTION);
+
+        std::mt19937                          rng(1);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        std::vector<glm::vec3>                points(BENCHMARK_KERNEL_POINTS);
+
+        for (uint32_t i = 0; i < BENCHMARK_KERNEL_POINTS; i++)
+        {
+            if (i % 2 == 0)
+                points[i] = min_extents - 0.25f * size + glm::vec3(uniform(rng), uniform(rng), uniform(rng)) * 1.5f * size;
+            else
+            {
+                const uint32_t* v = &mesh.indices[3 * std::min(uint32_t(uniform(rng) * float(mesh.num_triangles())), mesh.num_triangles() - 1)];
+                float           s = uniform(rng);
+                float           t = uniform(rng);
+
+                if (s + t > 1.0f)
+                {
+                    s = 1.0f - s;
+                    t = 1.0f - t;
+                }
+
+                glm::vec3 on_triangle = mesh.positions[v[0]] + s * (mesh.positions[v[1]] - mesh.positions[v[0]]) + t * (mesh.positions[v[2]] - mesh.positions[v[0]]);
+
+                points[i] = on_triangle + (glm::vec3(uniform(rng), uniform(rng), uniform(rng)) * 2.0f - glm::vec3(1.0f)) * voxel;
+            }
+        }
+
+        const std::vector<TriangleBatch> batches = make_triangle_batches(mesh);
+
+        std::vector<float>    abs_errors(points.size());
+        std::vector<float>    rel_errors(points.size());
+        std::vector<float>    closest_diffs(points.size());
+        std::vector<uint32_t> closest_mismatches(points.size());
+
+        parallel_for(static_cast<uint32_t>(points.size()), num_threads, [&](uint32_t i) {
+            const glm::vec3& p = points[i];
+
+            float max_abs = 0.0f;
+            float max_rel = 0.0f;
+
+            for (const auto& batch : batches)
+            {
+                float distances[TRIANGLE_BATCH_WIDTH];
+                sdf_triangle_batch(p, batch, distances);
+
+                for (uint32_t l = 0; l < TRIANGLE_BATCH_WIDTH; l++)
+                {
+                    const uint32_t* v         = &mesh.indices[3 * batch.triangle[l]];
+                    float           reference = sdf_triangle(p, mesh.positions[v[0]], mesh.positions[v[1]], mesh.positions[v[2]]);
+                    float           error     = fabsf(distances[l] - reference);
+
+                    max_abs = std::max(max_abs, error);
+
+                    if (reference > 0.0f)
+                        max_rel = std::max(max_rel, error / reference);
+                }
+            }
+
+            TriangleHit scalar = closest_triangle_brute_force(p, mesh);
+            TriangleHit batch  = closest_triangle_brute_force(p, batches);
+
+            abs_errors[i]         = max_abs;
+            rel_errors[i]         = max_rel;
+            closest_diffs[i]      = fabsf(scalar.distance - batch.distance);
+            closest_mismatches[i] = scalar.triangle != batch.triangle ? 1 : 0;
+        }, 16);
+
+        // Closest triangle queries over all points, single threaded, to compare the cost per point/triangle pair.
+        double         scalar_ms = 1e30;
+        double         batch_ms  = 1e30;
+        volatile float sink = 0.0f; // Keeps the timed queries from being optimized away.
+
+        for (uint32_t r = 0; r < num_repeats; r++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+
+            for (const auto& p : points)
+                sink += closest_triangle_brute_force(p, mesh).distance;
+
+            scalar_ms = std::min(scalar_ms, elapsed_ms(start));
+            start     = std::chrono::high_resolution_clock::now();
+
+            for (const auto& p : points)
+                sink += closest_triangle_brute_force(p, batches).distance;
+
+            batch_ms = std::min(batch_ms, elapsed_ms(start));
+        }
+
+        const uint64_t pairs = uint64_t(points.size()) * uint64_t(mesh.num_triangles());
+
+        printf("%-40s %10u %12llu %12.3g %12.3g %10u %10.3g %10.2f %10.2f\n",
+               path.c_str(),
+               mesh.num_triangles(),
+               (unsigned long long)pairs,
+               *std::max_element(abs_errors.begin(), abs_errors.end()),
+               *std::max_element(rel_errors.begin(), rel_errors.end()),
+               uint32_t(std::count(closest_mismatches.begin(), closest_mismatches.end(), 1u)),
+               *std::max_element(closest_diffs.begin(), closest_diffs.end()),
+               scalar_ms * 1e6 / double(pairs),
+               batch_ms * 1e6 / double(pairs));
+    }
+
+    printf("\nmax abs and max rel: largest difference of a lane from sdf_triangle(), absolute and relative to its distance. closest:\n"
+           "points whose closest triangle differs, which only happens between triangles equally close up to rounding, max diff\n"
+           "the largest difference of the closest distance. scalar and batch ns: closest triangle search per pair, one thread.\n");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Bake modes of the accuracy suite, each compared against a brute force bake with normal signs, which is what bake_sdf_cs.glsl
+// computes.
+struct BenchmarkBakeMode
+{
+    const char*   name;
+    DistanceQuery distance_query;
+    SignMode      sign_mode;
+    uint32_t      narrow_band;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Every mesh, and a synthetic one of BENCHMARK_BAKE_SYNTHETIC_TRIANGLES triangles, baked in every mode at
+// BENCHMARK_BAKE_RESOLUTION voxels along the longest side. Reports throughput, the queries per voxel and the error against the
+// brute force reference. Narrow band errors only cover the voxels inside the band, outside it the volume holds lower bounds.
+static void benchmark_bake(const std::vector<std::string>& paths, uint32_t num_threads, uint32_t num_repeats, Profiler& profiler)
+{
+    const BenchmarkBakeMode modes[] = {
+        { "brute", DistanceQuery::BRUTE_FORCE, SignMode::NORMALS, 0 },
+        { "bvh", DistanceQuery::BVH, SignMode::NORMALS, 0 },
+        { "winding", DistanceQuery::BVH, SignMode::WINDING_NUMBER, 0 },
+        { "narrow", DistanceQuery::BVH, SignMode::NORMALS, BENCHMARK_BAKE_BAND },
+    };
+
+    std::vector<std::pair<std::string, SDFMesh>> meshes;
+
+    for (const auto& path : paths)
+    {
+        SDFMesh mesh;
+
+        if (!load_obj(path, mesh, num_threads))
+        {
+            printf("Failed to load %s\n", path.c_str());
+            continue;
+        }
+
+        meshes.push_back(std::make_pair(path, std::move(mesh)));
+    }
+
+    meshes.push_back(std::make_pair(std::string("synthetic"), generate_mesh(BENCHMARK_BAKE_SYNTHETIC_TRIANGLES)));
+
+    printf("%-40s %-8s %10s %10s %10s %10s %10s %10s %10s %8s\n", "mesh", "mode", "triangles", "ms", "Mvox/s", "tri/vox", "nodes/vox", "max err", "rms err", "flips");
+
+    for (const auto& entry : meshes)
+    {
+        const SDFMesh& mesh = entry.second;
+
+        glm::vec3 min_extents, max_extents;
+
+        compute_extents(mesh, min_extents, max_extents);
+
+        glm::vec3 size = max_extents - min_extents;
+        SDFVolume reference;
+
+        for (const auto& mode : modes)
+        {
+            BakeSettings settings;
+
+            settings.grid_step_size = std::max(size.x, std::max(size.y, size.z)) / float(BENCHMARK_BAKE_RESOLUTION);
+            settings.num_threads    = num_threads;
+            settings.distance_query = mode.distance_query;
+            settings.sign_mode      = mode.sign_mode;
+            settings.narrow_band    = mode.narrow_band;
+
+            SDFVolume volume;
+            BakeStats stats;
+            BakeStats best;
+
+            best.total_ms = 1e30;
+
+            for (uint32_t r = 0; r < num_repeats; r++)
+            {
+                volume = bake_sdf(mesh, settings, &stats);
+
+                if (stats.total_ms < best.total_ms)
+                    best = stats;
+            }
+
+            if (reference.distances.empty())
+                reference = volume;
+
+            // Errors against the reference, inside the band for narrow band bakes.
+            const float band_radius = float(mode.narrow_band) * settings.grid_step_size;
+
+            double   max_error  = 0.0;
+            double   sum_sq     = 0.0;
+            uint64_t num_errors = 0;
+            uint64_t sign_flips = 0;
+
+            for (size_t i = 0; i < volume.distances.size(); i++)
+            {
+                float expected = reference.distances[i];
+                float actual   = volume.distances[i];
+
+                if ((expected < 0.0f) != (actual < 0.0f))
+                    sign_flips++;
+
+                if (mode.narrow_band > 0 && fabsf(expected) > band_radius)
+                    continue;
+
+                double error = fabs(double(actual) - double(expected));
+
+                max_error = std::max(max_error, error);
+                sum_sq += error * error;
+                num_errors++;
+            }
+
+            double rms_error = sqrt(sum_sq / double(std::max<uint64_t>(num_errors, 1)));
+            double voxels    = double(volume.num_voxels());
+
+            std::string name = "bake." + mesh_name(entry.first) + "." + mode.name;
+
+            profile_bake(profiler, name, best, volume.num_voxels());
+            profiler.set_value(name + ".max_error", max_error);
+            profiler.set_value(name + ".rms_error", rms_error);
+            profiler.add_counter(name + ".sign_flips", sign_flips);
+
+            printf("%-40s %-8s %10u %10.1f %10.2f %10.1f %10.1f %10.6f %10.6f %8llu\n",
+                   entry.first.c_str(),
+                   mode.name,
+                   mesh.num_triangles(),
+                   best.total_ms,
+                   voxels / (best.total_ms * 1000.0),
+                   best.triangles_per_voxel(),
+                   best.nodes_per_voxel(),
+                   max_error,
+                   rms_error,
+                   (unsigned long long)sign_flips);
+        }
+    }
+
+    printf("\nbrute: every triangle with normal signs, the reference. tri/vox and nodes/vox: triangle distances and BVH nodes per voxel\n"
+           "queried, narrow band voxels found outside the band included. flips: voxels whose sign differs from the reference, which\n"
+           "itself has wrong signs where coarse vertex normals mislead it. Bakes are %d voxels along the longest side, narrow band\n"
+           "bakes are exact within %d voxels of the surface and their errors only cover those.\n",
+           BENCHMARK_BAKE_RESOLUTION,
+           BENCHMARK_BAKE_BAND);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Every mesh baked by an SDFRebaker in the bake suite's modes, then edited BENCHMARK_REBAKE_EDITS times by moving
+// BENCHMARK_REBAKE_VERTICES random vertices. After every update() the volume is compared with a full bake of the edited mesh.
+// Without a narrow band every voxel must be equal. With one, voxels within the band of the exact distance must be equal and
+// the others must keep their sign and not exceed the exact distance. Moved vertices stay inside the mesh's box and none of them
+// is on its bounds, so the full bake uses the same grid.
+static void benchmark_rebake(const std::vector<std::string>& paths, uint32_t num_threads, uint32_t num_repeats)
+{
+    const BenchmarkBakeMode modes[] = {
+        { "bvh", DistanceQuery::BVH, SignMode::NORMALS, 0 },
+        { "winding", DistanceQuery::BVH, SignMode::WINDING_NUMBER, 0 },
+        { "narrow", DistanceQuery::BVH, SignMode::NORMALS, BENCHMARK_BAKE_BAND },
+    };
+
+    printf("%-40s %-8s %10s %12s %12s %8s %10s %10s %8s %10s %10s\n", "mesh", "mode", "triangles", "rebaked", "total", "%", "update ms", "bake ms", "speedup", "mismatch", "over");
+
+    for (const auto& path : paths)
+    {
+        SDFMesh mesh;
+
+        if (!load_obj(path, mesh, num_threads))
+        {
+            printf("%-40s failed to load\n", path.c_str());
+            continue;
+        }
+
+        glm::vec3 min_extents, max_extents;
+
+        compute_extents(mesh, min_extents, max_extents);
+
+        const glm::vec3 size = max_extents - min_extents;
+
+        // Vertices that can move without changing the mesh's box.
+        std::vector<uint32_t> movable;
+
+        for (uint32_t v = 0; v < mesh.positions.size(); v++)
+        {
+            if (glm::all(glm::greaterThan(mesh.positions[v], min_extents)) && glm::all(glm::lessThan(mesh.positions[v], max_extents)))
+                movable.push_back(v);
+        }
+
+        if (movable.empty())
+        {
+            printf("%-40s no vertex inside the box to move\n", path.c_str());
+            continue;
+        }
+
+        for (const auto& mode : modes)
+        {
+            BakeSettings settings;
+
+            settings.grid_step_size = std::max(size.x, std::max(size.y, size.z)) / float(BENCHMARK_BAKE_RESOLUTION);
+            settings.num_threads    = num_threads;
+            settings.distance_query = mode.distance_query;
+            settings.sign_mode      = mode.sign_mode;
+            settings.narrow_band    = mode.narrow_band;
+
+            BakeSettings exact_settings = settings;
+
+            exact_settings.narrow_band = 0;
+
+            const float band_radius = float(mode.narrow_band) * settings.grid_step_size;
+
+            SDFRebaker rebaker;
+            SDFMesh    edited = mesh;
+
+            rebaker.bake(mesh, settings);
+
+            std::mt19937                          rng(1);
+            std::uniform_int_distribution<size_t> pick(0, movable.size() - 1);
+            std::uniform_real_distribution<float> offset(-BENCHMARK_REBAKE_MOVE * settings.grid_step_size, BENCHMARK_REBAKE_MOVE * settings.grid_step_size);
+
+            uint64_t rebaked_voxels = 0;
+            uint64_t total_voxels   = 0;
+            uint64_t mismatches     = 0;
+            uint64_t overestimates  = 0;
+            double   update_ms      = 0.0;
+            double   bake_ms        = 0.0;
+
+            for (uint32_t e = 0; e < BENCHMARK_REBAKE_EDITS; e++)
+            {
+                std::vector<uint32_t> moved;
+
+                for (uint32_t i = 0; i < BENCHMARK_REBAKE_VERTICES; i++)
+                {
+                    uint32_t v = movable[pick(rng)];
+
+                    edited.positions[v] = glm::clamp(edited.positions[v] + glm::vec3(offset(rng), offset(rng), offset(rng)), min_extents, max_extents);
+                    moved.push_back(v);
+                }
+
+                std::vector<uint32_t> changed_triangles;
+
+                for (uint32_t t = 0; t < edited.num_triangles(); t++)
+                {
+                    for (uint32_t j = 0; j < 3; j++)
+                    {
+                        if (std::find(moved.begin(), moved.end(), edited.indices[3 * t + j]) != moved.end())
+                        {
+                            changed_triangles.push_back(t);
+                            break;
+                        }
+                    }
+                }
+
+                compute_vertex_normals(edited);
+
+                RebakeStats rebake_stats;
+
+                auto start = std::chrono::high_resolution_clock::now();
+
+                if (!rebaker.update(edited.positions, changed_triangles, &rebake_stats))
+                {
+                    printf("%-40s %-8s edit %u was rejected\n", path.c_str(), mode.name, e);
+                    break;
+                }
+
+                update_ms += elapsed_ms(start);
+
+                double    best_ms = 1e30;
+                SDFVolume reference;
+
+                for (uint32_t r = 0; r < num_repeats; r++)
+                {
+                    start     = std::chrono::high_resolution_clock::now();
+                    reference = bake_sdf(edited, settings);
+                    best_ms   = std::min(best_ms, elapsed_ms(start));
+                }
+
+                bake_ms += best_ms;
+                rebaked_voxels += rebake_stats.rebaked_voxels;
+                total_voxels += rebake_stats.total_voxels;
+
+                const SDFVolume& volume = rebaker.volume();
+                const SDFVolume  exact  = mode.narrow_band > 0 ? bake_sdf(edited, exact_settings) : reference;
+
+                if (volume.volume_size != reference.volume_size || volume.grid_origin != reference.grid_origin)
+                {
+                    mismatches += volume.num_voxels();
+                    continue;
+                }
+
+                for (size_t i = 0; i < volume.distances.size(); i++)
+                {
+                    float actual   = volume.distances[i];
+                    float expected = exact.distances[i];
+
+                    if (mode.narrow_band == 0 || fabsf(expected) <= band_radius)
+                        mismatches += actual != expected ? 1 : 0;
+                    else
+                        overestimates += (actual < 0.0f) != (expected < 0.0f) || fabsf(actual) > fabsf(expected) ? 1 : 0;
+                }
+            }
+
+            printf("%-40s %-8s %10u %12llu %12llu %8.2f %10.2f %10.2f %8.1f %10llu %10llu\n",
+                   path.c_str(),
+                   mode.name,
+                   mesh.num_triangles(),
+                   (unsigned long long)rebaked_voxels,
+                   (unsigned long long)total_voxels,
+                   100.0 * double(rebaked_voxels) / double(std::max<uint64_t>(total_voxels, 1)),
+                   update_ms / double(BENCHMARK_REBAKE_EDITS),
+                   bake_ms / double(BENCHMARK_REBAKE_EDITS),
+                   bake_ms / std::max(update_ms, 1e-6),
+                   (unsigned long long)mismatches,
+                   (unsigned long long)overestimates);
+        }
+    }
+
+    printf("\nrebaked and total: voxels update() recomputed and voxels of the full bakes, over all %d edits of %d vertices moved up to\n"
+           "%.0f voxels. update ms and bake ms: per edit. mismatch: voxels that differ from the full bake, within the band for narrow\n"
+           "band bakes. over: voxels outside the band with a flipped sign or more than the exact distance. Both must be 0.\n",
+           BENCHMARK_REBAKE_EDITS,
+           BENCHMARK_REBAKE_VERTICES,
+           BENCHMARK_REBAKE_MOVE);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Shadow ray of a lit pixel like shadow_ray_march() in mesh_fs.glsl with shadow tiles, ending at t_max. evaluate(p) returns the
+// scene distance at p.
+template <typename Evaluate>
+static float march_shadow_ray(const glm::vec3& ro, const glm::vec3& rd, float t_max, const RayMarchSettings& settings, Evaluate&& evaluate)
+{
+    float res = 1.0f;
+
+    for (float t = settings.t_min; t < t_max;)
+    {
+        float h = evaluate(ro + rd * t);
+
+        if (h < RAY_MARCH_HIT_DISTANCE)
+            return 0.0f;
+
+        if (settings.soft_shadows)
+            res = std::min(res, settings.soft_shadows_k * h / t);
+
+        t += h;
+    }
+
+    return res;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// The benchmark scene repeated on a BENCHMARK_SHADOW_GRID x BENCHMARK_SHADOW_GRID grid, lit by the viewer's spotlight above its
+// centre and seen from above. Every lit pixel's shadow ray is marched through all instances, through the instance BVH and
+// through its tile's list from build_shadow_tiles(), in instances evaluated per ray. The tile lists must give the same hits as
+// all instances.
+static void benchmark_shadow_tiles(const std::vector<std::string>& paths, uint32_t num_threads, uint32_t num_repeats)
+{
+    BenchmarkScene base;
+
+    if (!build_benchmark_scene(paths, num_threads, base))
+        return;
+
+    const glm::vec3 spacing = base.max_extents - base.min_extents + glm::vec3(1.0f);
+    const glm::vec3 offset  = -0.5f * float(BENCHMARK_SHADOW_GRID - 1) * spacing;
+
+    std::vector<SDFInstance> instances;
+    std::vector<InstanceBox> boxes;
+    glm::vec3                min_extents = glm::vec3(SDF_INFINITY);
+    glm::vec3                max_extents = glm::vec3(-SDF_INFINITY);
+
+    for (int z = 0; z < BENCHMARK_SHADOW_GRID; z++)
+    {
+        for (int x = 0; x < BENCHMARK_SHADOW_GRID; x++)
+        {
+            glm::vec3 translation = offset + glm::vec3(float(x) * spacing.x, 0.0f, float(z) * spacing.z);
+
+            for (const auto& instance : base.instances)
+            {
+                instances.push_back(make_sdf_instance(instance.volume, glm::translate(glm::mat4(1.0f), translation) * instance.transform));
+                boxes.push_back(instance_box(instances.back()));
+
+                glm::vec3 box_min, box_max;
+                instance_box_extents(boxes.back(), box_min, box_max);
+
+                min_extents = glm::min(min_extents, box_min);
+                max_extents = glm::max(max_extents, box_max);
+            }
+        }
+    }
+
+    InstanceBVH bvh;
+    bvh.build(boxes);
+
+    ShadowLight light;
+    RayMarchSettings settings;
+
+    light.position       = glm::vec3(0.0f, 30.0f, 35.0f);
+    light.direction      = glm::normalize(glm::vec3(0.0f, -0.9f, -1.0f));
+    light.outer_cutoff   = cosf(glm::radians(8.7f));
+    light.soft_shadows_k = settings.soft_shadows_k;
+
+    const uint32_t  resolution = BENCHMARK_MARCH_RESOLUTION;
+    const glm::mat4 view_proj  = glm::perspective(glm::radians(60.0f), 1.0f, 1.0f, 1000.0f) * glm::lookAt(glm::vec3(0.0f, 25.0f, 30.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const glm::mat4 inv        = glm::inverse(view_proj);
+
+    // Pixels numbered from the bottom left like gl_FragCoord.
+    std::vector<glm::vec3> origins(resolution * resolution);
+    std::vector<glm::vec3> directions(resolution * resolution);
+    std::vector<float>     hit_t(resolution * resolution);
+
+    for (uint32_t y = 0; y < resolution; y++)
+    {
+        for (uint32_t x = 0; x < resolution; x++)
+        {
+            glm::vec2 ndc  = glm::vec2((float(x) + 0.5f) / float(resolution), (float(y) + 0.5f) / float(resolution)) * 2.0f - glm::vec2(1.0f);
+            glm::vec4 near = inv * glm::vec4(ndc, -1.0f, 1.0f);
+            glm::vec4 far  = inv * glm::vec4(ndc, 1.0f, 1.0f);
+
+            origins[x + y * resolution]    = glm::vec3(near) / near.w;
+            directions[x + y * resolution] = glm::normalize(glm::vec3(far) / far.w - origins[x + y * resolution]);
+        }
+    }
+
+    RayMarchScene march_scene;
+
+    march_scene.instances = &instances;
+    march_scene.bvh       = &bvh;
+    settings.num_threads  = num_threads;
+
+    march_primary_rays(march_scene, origins.data(), directions.data(), resolution * resolution, settings, hit_t.data());
+
+    // Lit pixels, the only ones the shader marches.
+    std::vector<uint32_t> lit;
+
+    for (uint32_t i = 0; i < resolution * resolution; i++)
+    {
+        if (hit_t[i] < 0.0f)
+            continue;
+
+        glm::vec3 p = origins[i] + directions[i] * hit_t[i];
+
+        if (glm::length(light.position - p) < light.range && glm::dot(glm::normalize(p - light.position), light.direction) > light.outer_cutoff)
+            lit.push_back(i);
+    }
+
+    ShadowTiles     tiles;
+    ShadowCullStats cull_stats;
+    double          build_ms = 1e30;
+
+    ShadowCullSettings cull_settings;
+
+    cull_settings.num_threads = num_threads;
+
+    for (uint32_t r = 0; r < num_repeats; r++)
+    {
+        build_shadow_tiles(boxes, bvh, view_proj, resolution, resolution, min_extents, max_extents, light, tiles, cull_settings, &cull_stats);
+        build_ms = std::min(build_ms, cull_stats.ms);
+    }
+
+    printf("%zu instances, %u lit, %ux%u pixels, %zu lit pixels\n", instances.size(), cull_stats.lit_instances, resolution, resolution, lit.size());
+    printf("%u tiles of %ux%u, %u empty, %.2f instances per tile, at most %u, built in %.2f ms\n",
+           cull_stats.num_tiles,
+           cull_settings.tile_size,
+           cull_settings.tile_size,
+           cull_stats.empty_tiles,
+           double(cull_stats.num_entries) / double(std::max(1u, cull_stats.num_tiles)),
+           cull_stats.max_tile_count,
+           build_ms);
+    printf("%-10s %12s %14s %12s %10s %10s\n", "mode", "ms", "instances/ray", "shadow/s", "hits", "max diff");
+
+    std::vector<float> reference(lit.size());
+    std::vector<float> visibility(lit.size());
+
+    const char* modes[] = { "all", "bvh", "tiles" };
+
+    for (int mode = 0; mode < 3; mode++)
+    {
+        std::vector<uint64_t> evaluated(lit.size());
+        double                best_ms = 1e30;
+
+        for (uint32_t r = 0; r < num_repeats; r++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+
+            parallel_for(static_cast<uint32_t>(lit.size()), num_threads, [&](uint32_t i) {
+                uint32_t  pixel    = lit[i];
+                glm::vec3 p        = origins[pixel] + directions[pixel] * hit_t[pixel];
+                glm::vec3 to_light = light.position - p;
+                uint64_t  count    = 0;
+
+                glm::uvec2 range = tiles.ranges[(pixel % resolution) / cull_settings.tile_size + (pixel / resolution) / cull_settings.tile_size * tiles.tiles_x];
+
+                auto evaluate = [&](const glm::vec3& q) {
+                    if (mode == 0)
+                    {
+                        count += instances.size();
+                        return evaluate_scene_sdf(instances, q).distance;
+                    }
+
+                    if (mode == 1)
+                    {
+                        InstanceQueryStats query_stats;
+                        float              h = evaluate_scene_sdf(instances, bvh, q, RAY_MARCH_HIT_DISTANCE, &query_stats).distance;
+
+                        count += query_stats.instances_evaluated;
+                        return h;
+                    }
+
+                    float h = SDF_INFINITY;
+
+                    for (uint32_t j = 0; j < range.y && h > RAY_MARCH_HIT_DISTANCE; j++)
+                        h = std::min(h, evaluate_mesh_sdf(instances[tiles.instances[range.x + j]], q));
+
+                    count += range.y;
+                    return h;
+                };
+
+                float v = 1.0f;
+
+                if (mode != 2 || range.y > 0)
+                    v = march_shadow_ray(p, glm::normalize(to_light), std::min(settings.t_max, glm::length(to_light)), settings, evaluate);
+
+                (mode == 0 ? reference : visibility)[i] = v;
+                evaluated[i]                            = count;
+            }, 64);
+
+            best_ms = std::min(best_ms, elapsed_ms(start));
+        }
+
+        uint64_t total_evaluated = 0;
+        uint32_t hit_mismatches  = 0;
+        float    max_diff        = 0.0f;
+
+        for (size_t i = 0; i < lit.size(); i++)
+        {
+            total_evaluated += evaluated[i];
+
+            if (mode > 0)
+            {
+                hit_mismatches += (reference[i] == 0.0f) != (visibility[i] == 0.0f) ? 1 : 0;
+                max_diff = std::max(max_diff, fabsf(reference[i] - visibility[i]));
+            }
+        }
+
+        printf("%-10s %12.2f %14.1f %12.0f %10u %10.4f\n",
+               modes[mode],
+               best_ms,
+               double(total_evaluated) / double(std::max<size_t>(lit.size(), 1)),
+               best_ms > 0.0 ? double(lit.size()) / (best_ms / 1000.0) : 0.0,
+               hit_mismatches,
+               max_diff);
+    }
+
+    printf("\nShadow rays of lit pixels end at the light. hits: rays that hit where the march through all instances doesn't, or the\n"
+           "other way around. max diff: largest visibility difference to it, from steps that differ once instances are left out.\n");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void print_usage()
+{
+    printf("usage: SDFBenchmark [options] [mesh.obj | directory]...\n"
+           "  --threads N               worker threads, 0 = all cores (default 0)\n"
+           "  --repeat N                runs per measurement, the fastest is reported (default %d)\n"
+           "  --generate TRIANGLES FILE write a synthetic OBJ with at least TRIANGLES triangles and add it to the inputs\n"
+           "  --normals                 compare SDF normals from the fused gradient sampler with 6-tap differences instead\n"
+           "  --march                   render shadow and AO buffers of a scene of the meshes on the CPU instead, in rays/s\n"
+           "  --images PREFIX           with --march, write the buffers to PREFIX_shadow.pgm and PREFIX_ao.pgm\n"
+           "  --query                   run batched point and sphere SDF queries against a scene of the meshes instead, in queries/s\n"
+           "  --clipmap                 animate an instance of a scene of the meshes and scroll a clipmap of it instead, and\n"
+           "                            compare every update with a clipmap built from scratch\n"
+           "  --preprocess              weld, clean up and reorder every mesh instead, and compare bakes before and after\n"
+           "  --shadow-tiles            march the shadow rays of a large scene of the meshes through per tile instance lists instead\n"
+           "  --sparse                  convert every mesh's bake to a sparse brick volume instead, and compare its memory and\n"
+           "                            samples with the dense volume\n"
+           "  --kernel                  compare the SIMD triangle distance kernel with the scalar sdf_triangle() for every mesh\n"
+           "                            instead, for error and time\n"
+           "  --rebake                  edit every mesh's vertices and update its bake with SDFRebaker instead, and compare the\n"
+           "                            result and time with a full bake\n"
+           "  --bake                    bake every mesh and a synthetic one in every bake mode instead, and compare each with the\n"
+           "                            brute force bake for throughput and error\n"
+           "  --json FILE               write the timers, counters and histograms of the --bake and --march suites to FILE\n"
+           "Without inputs, the meshes in %s are used.\n",
+           BENCHMARK_DEFAULT_REPEATS,
+           SDF_BENCHMARK_MESH_DIR);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    uint32_t                 num_threads = 0;
+    uint32_t                 num_repeats = BENCHMARK_DEFAULT_REPEATS;
+    bool                     normals     = false;
+    bool                     march       = false;
+    bool                     query       = false;
+    bool                     preprocess  = false;
+    bool                     shadow      = false;
+    bool                     bake        = false;
+    bool                     sparse      = false;
+    bool                     kernel      = false;
+    bool                     rebake      = false;
+    bool                     clipmap     = false;
+    std::string              images;
+    std::string              json;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            num_threads = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+            num_repeats = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--generate") == 0 && i + 2 < argc)
+        {
+            uint64_t    num_triangles = strtoull(argv[++i], nullptr, 10);
+            std::string path          = argv[++i];
+
+            if (!generate_obj(path, num_triangles))
+            {
+                printf("Failed to write %s\n", path.c_str());
+                return 1;
+            }
+
+            paths.push_back(path);
+        }
+        else if (strcmp(argv[i], "--normals") == 0)
+            normals = true;
+        else if (strcmp(argv[i], "--march") == 0)
+            march = true;
+        else if (strcmp(argv[i], "--query") == 0)
+            query = true;
+        else if (strcmp(argv[i], "--preprocess") == 0)
+            preprocess = true;
+        else if (strcmp(argv[i], "--shadow-tiles") == 0)
+            shadow = true;
+        else if (strcmp(argv[i], "--bake") == 0)
+            bake = true;
+        else if (strcmp(argv[i], "--sparse") == 0)
+            sparse = true;
+        else if (strcmp(argv[i], "--kernel") == 0)
+            kernel = true;
+        else if (strcmp(argv[i], "--rebake") == 0)
+            rebake = true;
+        else if (strcmp(argv[i], "--clipmap") == 0)
+            clipmap = true;
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            json = argv[++i];
+        else if (strcmp(argv[i], "--images") == 0 && i + 1 < argc)
+            images = argv[++i];
+        else if (strcmp(argv[i], "--help") == 0 || argv[i][0] == '-')
+        {
+            print_usage();
+            return strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+        else
+        {
+            std::vector<std::string> files = list_files(argv[i], ".obj");
+
+            if (files.empty())
+                paths.push_back(argv[i]);
+            else
+                paths.insert(paths.end(), files.begin(), files.end());
+        }
+    }
+
+    // The other suites print their results only, their file would be empty.
+    if (!json.empty() && !march && !bake)
+    {
+        printf("--json only records the --bake and --march suites\n");
+        return 1;
+    }
+
+    if (paths.empty())
+        paths = list_files(SDF_BENCHMARK_MESH_DIR, ".obj");
+
+    Profiler profiler;
+
+    if (normals)
+        benchmark_normals(paths, num_threads, num_repeats);
+    else if (march)
+        benchmark_ray_march(paths, num_threads, num_repeats, images, profiler);
+    else if (query)
+        benchmark_queries(paths, num_threads, num_repeats);
+    else if (preprocess)
+        benchmark_preprocess(paths, num_threads, num_repeats);
+    else if (shadow)
+        benchmark_shadow_tiles(paths, num_threads, num_repeats);
+    else if (bake)
+        benchmark_bake(paths, num_threads, num_repeats, profiler);
+    else if (sparse)
+        benchmark_sparse(paths, num_threads, num_repeats);
+    else if (kernel)
+        benchmark_kernel(paths, num_threads, num_repeats);
+    else if (rebake)
+        benchmark_rebake(paths, num_threads, num_repeats);
+    else if (clipmap)
+        benchmark_clipmap(paths, num_threads, num_repeats);
+    else
+        benchmark_obj_loading(paths, num_threads, num_repeats);
+
+    if (!json.empty() && !profiler.write_json(json))
+    {
+        printf("Failed to write %s\n", json.c_str());
+        return 1;
+    }
+
+    return 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,363 @@
+#include "bvh.h"
+#include <algorithm>
+
+#define BVH_NUM_BINS 16
+
+// Past this depth every split is a median split, which bounds the tree depth (and so the traversal stack) for any input.
+#define BVH_MAX_SAH_DEPTH 24
+
+// Box distances are only compared against sdf_triangle() results, which carry their own rounding error. Keep nodes that are
+// within this relative margin of the current best so a triangle that ties with the brute force result is never culled.
+#define BVH_PRUNE_SLACK 1.0001f
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static inline float surface_area(const glm::vec3& min_extents, const glm::vec3& max_extents)
+{
+    glm::vec3 d = max_extents - min_extents;
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void BVH::build(const SDFMesh& mesh, uint32_t max_leaf_size)
+{
+    uint32_t num_triangles = mesh.num_triangles();
+
+    m_nodes.clear();
+    m_triangles.resize(num_triangles);
+    m_centroids.resize(num_triangles);
+    m_tri_min.resize(num_triangles);
+    m_tri_max.resize(num_triangles);
+
+    for (uint32_t i = 0; i < num_triangles; i++)
+    {
+        const glm::vec3& a = mesh.positions[mesh.indices[3 * i]];
+        const glm::vec3& b = mesh.positions[mesh.indices[3 * i + 1]];
+        const glm::vec3& c = mesh.positions[mesh.indices[3 * i + 2]];
+
+        m_triangles[i] = i;
+        m_tri_min[i]   = glm::min(glm::min(a, b), c);
+        m_tri_max[i]   = glm::max(glm::max(a, b), c);
+        m_centroids[i] = (m_tri_min[i] + m_tri_max[i]) * 0.5f;
+    }
+
+    if (num_triangles > 0)
+    {
+        m_nodes.reserve(2 * (num_triangles / std::max(1u, max_leaf_size)) + 1);
+        build_recursive(0, num_triangles, std::max(1u, max_leaf_size), 0);
+    }
+
+    m_vertices.resize(num_triangles * 3);
+
+    for (uint32_t i = 0; i < num_triangles; i++)
+    {
+        for (uint32_t j = 0; j < 3; j++)
+            m_vertices[3 * i + j] = mesh.positions[mesh.indices[3 * m_triangles[i] + j]];
+    }
+
+    m_slots.resize(num_triangles);
+
+    for (uint32_t i = 0; i < num_triangles; i++)
+        m_slots[m_triangles[i]] = i;
+
+    m_leaf_batches.assign(m_nodes.size(), 0);
+
+    uint32_t num_batches = 0;
+
+    for (uint32_t i = 0; i < m_nodes.size(); i++)
+    {
+        if (m_nodes[i].is_leaf())
+        {
+            m_leaf_batches[i] = num_batches;
+            num_batches += (m_nodes[i].count + TRIANGLE_BATCH_WIDTH - 1) / TRIANGLE_BATCH_WIDTH;
+        }
+    }
+
+    m_batches.resize(num_batches);
+
+    for (uint32_t i = 0; i < m_nodes.size(); i++)
+    {
+        if (m_nodes[i].is_leaf())
+            pack_leaf(i);
+    }
+
+    m_centroids.clear();
+    m_centroids.shrink_to_fit();
+    m_tri_min.clear();
+    m_tri_min.shrink_to_fit();
+    m_tri_max.clear();
+    m_tri_max.shrink_to_fit();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void BVH::refit(const SDFMesh& mesh, const std::vector<uint32_t>& changed_triangles)
+{
+    std::vector<uint8_t> changed(m_triangles.size(), 0);
+
+    for (uint32_t tri : changed_triangles)
+    {
+        uint32_t slot = m_slots[tri];
+
+        for (uint32_t j = 0; j < 3; j++)
+            m_vertices[3 * slot + j] = mesh.positions[mesh.indices[3 * tri + j]];
+
+        changed[slot] = 1;
+    }
+
+    // Children come after their parent, so walking backwards updates both children before the parent.
+    for (uint32_t i = static_cast<uint32_t>(m_nodes.size()); i-- > 0;)
+    {
+        Node& node = m_nodes[i];
+
+        if (node.is_leaf())
+        {
+            if (std::find(changed.begin() + node.offset, changed.begin() + node.offset + node.count, 1) == changed.begin() + node.offset + node.count)
+                continue;
+
+            node.min_extents = glm::vec3(SDF_INFINITY);
+            node.max_extents = glm::vec3(-SDF_INFINITY);
+
+            for (uint32_t j = 3 * node.offset; j < 3 * (node.offset + node.count); j++)
+            {
+                node.min_extents = glm::min(node.min_extents, m_vertices[j]);
+                node.max_extents = glm::max(node.max_extents, m_vertices[j]);
+            }
+
+            pack_leaf(i);
+        }
+        else
+        {
+            const Node& first  = m_nodes[i + 1];
+            const Node& second = m_nodes[node.offset];
+
+            node.min_extents = glm::min(first.min_extents, second.min_extents);
+            node.max_extents = glm::max(first.max_extents, second.max_extents);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void BVH::pack_leaf(uint32_t node_idx)
+{
+    const Node& node  = m_nodes[node_idx];
+    uint32_t    batch = m_leaf_batches[node_idx];
+
+    for (uint32_t first = node.offset; first < node.offset + node.count; first += TRIANGLE_BATCH_WIDTH)
+    {
+        uint32_t count = std::min(node.offset + node.count - first, static_cast<uint32_t>(TRIANGLE_BATCH_WIDTH));
+
+        pack_triangle_batch(&m_vertices[3 * first], &m_triangles[first], count, m_batches[batch++]);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t BVH::build_recursive(uint32_t begin, uint32_t end, uint32_t max_leaf_size, uint32_t depth)
+{
+    uint32_t node_idx = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.push_back(Node());
+
+    glm::vec3 min_extents          = glm::vec3(SDF_INFINITY);
+    glm::vec3 max_extents          = glm::vec3(-SDF_INFINITY);
+    glm::vec3 centroid_min_extents = glm::vec3(SDF_INFINITY);
+    glm::vec3 centroid_max_extents = glm::vec3(-SDF_INFINITY);
+
+    for (uint32_t i = begin; i < end; i++)
+    {
+        uint32_t tri         = m_triangles[i];
+        min_extents          = glm::min(min_extents, m_tri_min[tri]);
+        max_extents          = glm::max(max_extents, m_tri_max[tri]);
+        centroid_min_extents = glm::min(centroid_min_extents, m_centroids[tri]);
+        centroid_max_extents = glm::max(centroid_max_extents, m_centroids[tri]);
+    }
+
+    m_nodes[node_idx].min_extents = min_extents;
+    m_nodes[node_idx].max_extents = max_extents;
+
+    uint32_t count = end - begin;
+
+    if (count <= max_leaf_size)
+    {
+        m_nodes[node_idx].offset = begin;
+        m_nodes[node_idx].count  = count;
+        return node_idx;
+    }
+
+    // Binned SAH split along the longest centroid axis.
+    glm::vec3 centroid_size = centroid_max_extents - centroid_min_extents;
+    int       axis          = centroid_size.x > centroid_size.y ? (centroid_size.x > centroid_size.z ? 0 : 2) : (centroid_size.y > centroid_size.z ? 1 : 2);
+    uint32_t  mid           = begin + count / 2;
+
+    if (centroid_size[axis] > 0.0f && depth < BVH_MAX_SAH_DEPTH)
+    {
+        glm::vec3 bin_min[BVH_NUM_BINS];
+        glm::vec3 bin_max[BVH_NUM_BINS];
+        uint32_t  bin_count[BVH_NUM_BINS];
+
+        for (int i = 0; i < BVH_NUM_BINS; i++)
+        {
+            bin_min[i]   = glm::vec3(SDF_INFINITY);
+            bin_max[i]   = glm::vec3(-SDF_INFINITY);
+            bin_count[i] = 0;
+        }
+
+        float scale = float(BVH_NUM_BINS) / centroid_size[axis];
+
+        auto bin_index = [&](uint32_t tri) {
+            int b = int((m_centroids[tri][axis] - centroid_min_extents[axis]) * scale);
+            return std::min(std::max(b, 0), BVH_NUM_BINS - 1);
+        };
+
+        for (uint32_t i = begin; i < end; i++)
+        {
+            uint32_t tri = m_triangles[i];
+            int      b   = bin_index(tri);
+
+            bin_min[b] = glm::min(bin_min[b], m_tri_min[tri]);
+            bin_max[b] = glm::max(bin_max[b], m_tri_max[tri]);
+            bin_count[b]++;
+        }
+
+        // Sweep from the right to get the cost of every right hand side, then from the left to pick the cheapest plane.
+        float     right_area[BVH_NUM_BINS];
+        uint32_t  right_count[BVH_NUM_BINS];
+        glm::vec3 acc_min   = glm::vec3(SDF_INFINITY);
+        glm::vec3 acc_max   = glm::vec3(-SDF_INFINITY);
+        uint32_t  acc_count = 0;
+
+        for (int i = BVH_NUM_BINS - 1; i > 0; i--)
+        {
+            acc_min = glm::min(acc_min, bin_min[i]);
+            acc_max = glm::max(acc_max, bin_max[i]);
+            acc_count += bin_count[i];
+
+            right_area[i]  = acc_count > 0 ? surface_area(acc_min, acc_max) : 0.0f;
+            right_count[i] = acc_count;
+        }
+
+        float best_cost  = SDF_INFINITY;
+        int   best_split = -1;
+
+        acc_min   = glm::vec3(SDF_INFINITY);
+        acc_max   = glm::vec3(-SDF_INFINITY);
+        acc_count = 0;
+
+        for (int i = 1; i < BVH_NUM_BINS; i++)
+        {
+            acc_min = glm::min(acc_min, bin_min[i - 1]);
+            acc_max = glm::max(acc_max, bin_max[i - 1]);
+            acc_count += bin_count[i - 1];
+
+            if (acc_count == 0 || right_count[i] == 0)
+                continue;
+
+            float cost = surface_area(acc_min, acc_max) * float(acc_count) + right_area[i] * float(right_count[i]);
+
+            if (cost < best_cost)
+            {
+                best_cost  = cost;
+                best_split = i;
+            }
+        }
+
+        if (best_split > 0)
+        {
+            auto it = std::partition(m_triangles.begin() + begin, m_triangles.begin() + end, [&](uint32_t tri) { return bin_index(tri) < best_split; });
+            mid     = static_cast<uint32_t>(it - m_triangles.begin());
+        }
+    }
+
+    // All centroids in one spot or a degenerate split: fall back to splitting the range in half.
+    if (mid == begin || mid == end)
+    {
+        mid = begin + count / 2;
+        std::nth_element(m_triangles.begin() + begin, m_triangles.begin() + mid, m_triangles.begin() + end, [&](uint32_t a, uint32_t b) { return m_centroids[a][axis] < m_centroids[b][axis]; });
+    }
+
+    build_recursive(begin, mid, max_leaf_size, depth + 1);
+    uint32_t second_child = build_recursive(mid, end, max_leaf_size, depth + 1);
+
+    m_nodes[node_idx].offset = second_child;
+    m_nodes[node_idx].count  = 0;
+
+    return node_idx;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TriangleHit BVH::closest_triangle(const glm::vec3& p, float max_distance, BVHQueryStats* stats) const
+{
+    TriangleHit hit;
+
+    if (m_nodes.empty())
+        return hit;
+
+    hit.distance = max_distance;
+
+    float best_sq = max_distance * max_distance * BVH_PRUNE_SLACK;
+
+    struct StackEntry
+    {
+        uint32_t node;
+        float    distance_sq;
+    };
+
+    StackEntry stack[64];
+    uint32_t   stack_size = 0;
+
+    stack[stack_size++] = { 0, distance_to_box_sq(p, m_nodes[0].min_extents, m_nodes[0].max_extents) };
+
+    while (stack_size > 0)
+    {
+        StackEntry entry = stack[--stack_size];
+
+        if (entry.distance_sq > best_sq)
+            continue;
+
+        const Node& node = m_nodes[entry.node];
+
+        if (stats)
+            stats->nodes_visited++;
+
+        if (node.is_leaf())
+        {
+            uint32_t first = m_leaf_batches[entry.node];
+            uint32_t end   = first + (node.count + TRIANGLE_BATCH_WIDTH - 1) / TRIANGLE_BATCH_WIDTH;
+
+            if (stats)
+                stats->triangles_tested += uint64_t(end - first) * TRIANGLE_BATCH_WIDTH;
+
+            for (uint32_t i = first; i < end; i++)
+            {
+                if (closest_triangle_batch(p, m_batches[i], hit))
+                    best_sq = hit.distance * hit.distance * BVH_PRUNE_SLACK;
+            }
+        }
+        else
+        {
+            uint32_t first  = entry.node + 1;
+            uint32_t second = node.offset;
+            float    d0     = distance_to_box_sq(p, m_nodes[first].min_extents, m_nodes[first].max_extents);
+            float    d1     = distance_to_box_sq(p, m_nodes[second].min_extents, m_nodes[second].max_extents);
+
+            // Push the farther child first so the nearer one is visited next.
+            if (d0 < d1)
+            {
+                stack[stack_size++] = { second, d1 };
+                stack[stack_size++] = { first, d0 };
+            }
+            else
+            {
+                stack[stack_size++] = { first, d0 };
+                stack[stack_size++] = { second, d1 };
+            }
+        }
+    }
+
+    return hit;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "triangle_batch.h"
+
+struct BVHQueryStats
+{
+    uint64_t nodes_visited    = 0;
+    uint64_t triangles_tested = 0; // Lanes of every batch tested, padding lanes of partly filled batches included.
+};
+
+// Bounding volume hierarchy over the triangles of an SDFMesh, stored as a flat depth-first node array. The first child of an
+// interior node is the node right after it, so only the second child index needs to be stored. Triangle positions are copied
+// into leaf order so a leaf touches a single contiguous range of memory, and packed into TriangleBatches per leaf for the distance
+// queries.
+class BVH
+{
+public:
+    struct Node
+    {
+        glm::vec3 min_extents;
+        uint32_t  offset; // Leaf: first triangle in leaf order. Interior: index of the second child.
+        glm::vec3 max_extents;
+        uint32_t  count; // Number of triangles in a leaf, 0 for interior nodes.
+
+        inline bool is_leaf() const { return count > 0; }
+    };
+
+    void build(const SDFMesh& mesh, uint32_t max_leaf_size = TRIANGLE_BATCH_WIDTH);
+
+    // Updates the tree after the positions of changed_triangles moved, keeping its topology. The boxes stay tight around the
+    // leaves but can overlap more than after a new build, so queries slow down after large deformations.
+    void refit(const SDFMesh& mesh, const std::vector<uint32_t>& changed_triangles);
+
+    // Closest triangle to p within max_distance. Distances come from sdf_triangle_batch(), and ties go to the lowest triangle
+    // index, so the result is the same as looping over every triangle in order. stats, if given, is added to.
+    TriangleHit closest_triangle(const glm::vec3& p, float max_distance = SDF_INFINITY, BVHQueryStats* stats = nullptr) const;
+
+    inline const std::vector<Node>&          nodes() const { return m_nodes; }
+    inline const std::vector<uint32_t>&      triangles() const { return m_triangles; }
+    inline const std::vector<glm::vec3>&     vertices() const { return m_vertices; }
+    inline const std::vector<TriangleBatch>& batches() const { return m_batches; }
+    inline uint32_t                          num_triangles() const { return static_cast<uint32_t>(m_triangles.size()); }
+
+    inline size_t memory_bytes() const
+    {
+        return m_nodes.size() * sizeof(Node) + (m_triangles.size() + m_slots.size() + m_leaf_batches.size()) * sizeof(uint32_t) + m_vertices.size() * sizeof(glm::vec3) + m_batches.size() * sizeof(TriangleBatch);
+    }
+
+private:
+    uint32_t build_recursive(uint32_t begin, uint32_t end, uint32_t max_leaf_size, uint32_t depth);
+    void     pack_leaf(uint32_t node_idx);
+
+private:
+    std::vector<Node>          m_nodes;
+    std::vector<uint32_t>      m_triangles;    // Source triangle index of each triangle in leaf order.
+    std::vector<uint32_t>      m_slots;        // Position in leaf order of each source triangle.
+    std::vector<glm::vec3>     m_vertices;     // Three positions per triangle in leaf order.
+    std::vector<TriangleBatch> m_batches;      // The triangles of every leaf as consecutive batches, in leaf order.
+    std::vector<uint32_t>      m_leaf_batches; // First batch of each leaf node, indexed like m_nodes.
+
+    // Build scratch data.
+    std::vector<glm::vec3> m_centroids;
+    std::vector<glm::vec3> m_tri_min;
+    std::vector<glm::vec3> m_tri_max;
+};
+
+// Squared distance from p to an axis aligned box, 0 when p is inside.
+inline float distance_to_box_sq(const glm::vec3& p, const glm::vec3& min_extents, const glm::vec3& max_extents)
+{
+    glm::vec3 d = glm::max(glm::max(min_extents - p, p - max_extents), glm::vec3(0.0f));
+    return glm::dot(d, d);
+}
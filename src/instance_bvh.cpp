@@ -0,0 +1,104 @@
+#include "instance_bvh.h"
+#include <algorithm>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void InstanceBVH::build(const std::vector<InstanceBox>& boxes)
+{
+    m_num_instances = static_cast<uint32_t>(boxes.size());
+    m_boxes         = boxes;
+
+    m_nodes.clear();
+    m_order.resize(m_num_instances);
+    m_centers.resize(m_num_instances);
+
+    for (uint32_t i = 0; i < m_num_instances; i++)
+    {
+        m_order[i]   = i;
+        m_centers[i] = boxes[i].center;
+    }
+
+    if (m_num_instances > 0)
+    {
+        m_nodes.reserve(2 * m_num_instances - 1);
+        build_recursive(0, m_num_instances);
+    }
+
+    m_order.clear();
+    m_order.shrink_to_fit();
+    m_centers.clear();
+    m_centers.shrink_to_fit();
+
+    refit(boxes);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void InstanceBVH::refit(const std::vector<InstanceBox>& boxes)
+{
+    m_boxes = boxes;
+
+    // Children are always stored after their parent, so a reverse sweep sees both children before the parent.
+    for (size_t i = m_nodes.size(); i-- > 0;)
+    {
+        Node& node = m_nodes[i];
+
+        if (node.is_leaf())
+            instance_box_extents(boxes[node.offset], node.min_extents, node.max_extents);
+        else
+        {
+            const Node& a = m_nodes[i + 1];
+            const Node& b = m_nodes[node.offset];
+
+            node.min_extents = glm::min(a.min_extents, b.min_extents);
+            node.max_extents = glm::max(a.max_extents, b.max_extents);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t InstanceBVH::build_recursive(uint32_t begin, uint32_t end)
+{
+    uint32_t node_idx = static_cast<uint32_t>(m_nodes.size());
+
+    m_nodes.push_back(Node());
+
+    if (end - begin == 1)
+    {
+        m_nodes[node_idx].offset = m_order[begin];
+        m_nodes[node_idx].count  = 1;
+
+        return node_idx;
+    }
+
+    // Median split along the longest axis of the centres. Instances move every frame, so a cheap balanced tree that stays
+    // reasonable under refitting is worth more than a SAH tree fitted to a single frame.
+    glm::vec3 min_center = m_centers[m_order[begin]];
+    glm::vec3 max_center = min_center;
+
+    for (uint32_t i = begin + 1; i < end; i++)
+    {
+        min_center = glm::min(min_center, m_centers[m_order[i]]);
+        max_center = glm::max(max_center, m_centers[m_order[i]]);
+    }
+
+    glm::vec3 size = max_center - min_center;
+    int       axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+    uint32_t  mid  = begin + (end - begin) / 2;
+
+    std::nth_element(m_order.begin() + begin, m_order.begin() + mid, m_order.begin() + end, [&](uint32_t a, uint32_t b) {
+        return m_centers[a][axis] < m_centers[b][axis];
+    });
+
+    build_recursive(begin, mid);
+
+    uint32_t second_child = build_recursive(mid, end);
+
+    m_nodes[node_idx].offset = second_child;
+    m_nodes[node_idx].count  = 0;
+
+    return node_idx;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "bvh.h"
+
+// Boxes closer than this are treated as containing the query point. Points on a box face can come out slightly outside after
+// the transform, and the distance inside a box can be negative, so they must never be pruned.
+#define INSTANCE_BVH_INSIDE_EPSILON 1e-4f
+
+// World space oriented bounding box of an instance, the same values update_transforms() in main.cpp computes for the shader.
+// The axes are unit length since instances are only rotated and translated.
+struct InstanceBox
+{
+    glm::vec3 center;
+    glm::vec3 axis[3];
+    glm::vec3 half_extents;
+};
+
+struct InstanceHit
+{
+    float    distance = SDF_INFINITY;
+    uint32_t instance = UINT32_MAX;
+};
+
+struct InstanceQueryStats
+{
+    uint32_t nodes_visited       = 0;
+    uint32_t instances_evaluated = 0;
+};
+
+// Distance from p to an oriented box, 0 when p is inside. Same closest point as find_closest_point_on_obb() in mesh_fs.glsl.
+inline float distance_to_obb(const glm::vec3& p, const InstanceBox& box)
+{
+    glm::vec3 d = p - box.center;
+    glm::vec3 q = box.center;
+
+    for (int i = 0; i < 3; i++)
+        q += glm::clamp(glm::dot(d, box.axis[i]), -box.half_extents[i], box.half_extents[i]) * box.axis[i];
+
+    return glm::length(p - q);
+}
+
+// Top level bounding volume hierarchy over instance boxes. Uses the node layout of BVH, with exactly one instance per leaf so a
+// leaf's offset is the instance index and the node array can be consumed by the shader as is (struct InstanceBVHNode in
+// mesh_fs.glsl). The tree is built once and refitted when the instances move.
+class InstanceBVH
+{
+public:
+    using Node = BVH::Node;
+
+    void build(const std::vector<InstanceBox>& boxes);
+
+    // Recomputes every node's bounds bottom up without changing the tree. boxes must have the size the tree was built with.
+    void refit(const std::vector<InstanceBox>& boxes);
+
+    // Smallest evaluate(instance) over all instances. Subtrees whose box is further away than the current best are skipped,
+    // which assumes evaluate() never returns less than the distance to the instance's box when p is outside it, like
+    // evaluate_mesh_sdf(). The traversal stops as soon as the best distance drops to early_out or below.
+    template <typename Evaluate>
+    InstanceHit nearest_instance(const glm::vec3& p, Evaluate&& evaluate, float early_out = -SDF_INFINITY, InstanceQueryStats* stats = nullptr) const;
+
+    inline const std::vector<Node>& nodes() const { return m_nodes; }
+    inline uint32_t                 num_instances() const { return m_num_instances; }
+
+private:
+    uint32_t build_recursive(uint32_t begin, uint32_t end);
+
+private:
+    std::vector<Node>        m_nodes;
+    std::vector<InstanceBox> m_boxes; // Copy of the boxes the tree was built or refitted with.
+    uint32_t                 m_num_instances = 0;
+
+    // Build scratch data.
+    std::vector<uint32_t>  m_order;
+    std::vector<glm::vec3> m_centers;
+};
+
+// Axis aligned bounds of an oriented box.
+inline void instance_box_extents(const InstanceBox& box, glm::vec3& min_extents, glm::vec3& max_extents)
+{
+    glm::vec3 extent = glm::abs(box.axis[0]) * box.half_extents.x + glm::abs(box.axis[1]) * box.half_extents.y + glm::abs(box.axis[2]) * box.half_extents.z;
+
+    min_extents = box.center - extent;
+    max_extents = box.center + extent;
+}
+
+template <typename Evaluate>
+InstanceHit InstanceBVH::nearest_instance(const glm::vec3& p, Evaluate&& evaluate, float early_out, InstanceQueryStats* stats) const
+{
+    InstanceHit hit;
+
+    if (m_nodes.empty())
+        return hit;
+
+    // One instance per leaf and median splits keep the depth at log2 of the instance count.
+    uint32_t stack[64];
+    uint32_t stack_size = 0;
+
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0)
+    {
+        const Node& node = m_nodes[stack[--stack_size]];
+
+        if (stats)
+            stats->nodes_visited++;
+
+        // Boxes that contain p are always visited since evaluate() can be negative inside them.
+        float d = distance_to_box_sq(p, node.min_extents, node.max_extents);
+
+        if (d > INSTANCE_BVH_INSIDE_EPSILON * INSTANCE_BVH_INSIDE_EPSILON && sqrtf(d) >= hit.distance)
+            continue;
+
+        if (node.is_leaf())
+        {
+            float box_distance = distance_to_obb(p, m_boxes[node.offset]);
+
+            if (box_distance > INSTANCE_BVH_INSIDE_EPSILON && box_distance >= hit.distance)
+                continue;
+
+            if (stats)
+                stats->instances_evaluated++;
+
+            float h = evaluate(node.offset);
+
+            if (h < hit.distance)
+            {
+                hit.distance = h;
+                hit.instance = node.offset;
+
+                if (h <= early_out)
+                    return hit;
+            }
+
+            continue;
+        }
+
+        // Visit the nearer child first so the far one is more likely to be pruned.
+        uint32_t    near_idx = static_cast<uint32_t>(&node - m_nodes.data()) + 1;
+        uint32_t    far_idx  = node.offset;
+        const Node& a        = m_nodes[near_idx];
+        const Node& b        = m_nodes[far_idx];
+
+        if (distance_to_box_sq(p, b.min_extents, b.max_extents) < distance_to_box_sq(p, a.min_extents, a.max_extents))
+            std::swap(near_idx, far_idx);
+
+        stack[stack_size++] = far_idx;
+        stack[stack_size++] = near_idx;
+    }
+
+    return hit;
+}
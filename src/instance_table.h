@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <algorithm>
+
+// Smallest number of elements a table's GPU buffer is allocated for.
+#define INSTANCE_TABLE_MIN_CAPACITY 64
+
+// Growable array mirrored in a GPU buffer, with a dirty flag per element. flush() only uploads the runs of elements that changed
+// since the last flush, and counts the bytes it wrote so uploads can be measured without a GPU.
+template <typename T>
+class InstanceTable
+{
+public:
+    inline uint32_t size() const { return static_cast<uint32_t>(m_elements.size()); }
+    inline uint32_t capacity() const { return m_capacity; } // Elements the GPU buffer currently holds.
+    inline uint32_t num_dirty() const { return m_num_dirty; }
+    inline bool     is_dirty(uint32_t i) const { return m_dirty[i] != 0; }
+    inline const T* data() const { return m_elements.data(); }
+
+    inline const T& operator[](uint32_t i) const { return m_elements[i]; }
+
+    uint32_t push_back(const T& value)
+    {
+        m_elements.push_back(value);
+        m_dirty.push_back(1);
+        m_num_dirty++;
+
+        return size() - 1;
+    }
+
+    // Writable access to an element, which is uploaded by the next flush.
+    inline T& modify(uint32_t i)
+    {
+        mark_dirty(i);
+        return m_elements[i];
+    }
+
+    inline void mark_dirty(uint32_t i)
+    {
+        m_num_dirty += m_dirty[i] == 0;
+        m_dirty[i] = 1;
+    }
+
+    void mark_all_dirty()
+    {
+        std::fill(m_dirty.begin(), m_dirty.end(), 1);
+        m_num_dirty = size();
+    }
+
+    // Brings the GPU copy up to date. If the table outgrew the buffer, resize(size_in_bytes) must reallocate it and every element
+    // is uploaded. upload(offset_in_bytes, data, size_in_bytes) is called once per run of consecutive dirty elements. Returns the
+    // number of bytes uploaded.
+    template <typename Resize, typename Upload>
+    size_t flush(Resize&& resize, Upload&& upload)
+    {
+        if (size() > m_capacity)
+        {
+            // Grow geometrically so adding instances one at a time doesn't reallocate every frame.
+            m_capacity = std::max(m_capacity, static_cast<uint32_t>(INSTANCE_TABLE_MIN_CAPACITY));
+
+            while (m_capacity < size())
+                m_capacity *= 2;
+
+            resize(size_t(m_capacity) * sizeof(T));
+            mark_all_dirty();
+        }
+
+        m_last_upload_bytes  = 0;
+        m_last_upload_ranges = 0;
+
+        for (uint32_t i = 0; i < size() && m_num_dirty > 0;)
+        {
+            if (!m_dirty[i])
+            {
+                i++;
+                continue;
+            }
+
+            uint32_t begin = i;
+
+            while (i < size() && m_dirty[i])
+                m_dirty[i++] = 0;
+
+            size_t bytes = size_t(i - begin) * sizeof(T);
+
+            upload(size_t(begin) * sizeof(T), &m_elements[begin], bytes);
+
+            m_num_dirty -= i - begin;
+            m_last_upload_bytes += bytes;
+            m_last_upload_ranges++;
+        }
+
+        m_total_upload_bytes += m_last_upload_bytes;
+
+        return m_last_upload_bytes;
+    }
+
+    inline size_t   last_upload_bytes() const { return m_last_upload_bytes; }
+    inline uint32_t last_upload_ranges() const { return m_last_upload_ranges; }
+    inline size_t   total_upload_bytes() const { return m_total_upload_bytes; }
+
+private:
+    std::vector<T>       m_elements;
+    std::vector<uint8_t> m_dirty;
+    uint32_t             m_num_dirty          = 0;
+    uint32_t             m_capacity           = 0;
+    size_t               m_last_upload_bytes  = 0;
+    uint32_t             m_last_upload_ranges = 0;
+    size_t               m_total_upload_bytes = 0;
+};
@@ -0,0 +1,237 @@
+#include "job_system.h"
+#include "parallel.h"
+
+// Pool and queue of the worker thread running this code, if any. Threads that aren't workers use queue 0.
+static thread_local JobSystem* t_worker_pool  = nullptr;
+static thread_local uint32_t   t_worker_queue = 0;
+
+// Pool of the job this thread is running.
+static thread_local JobSystem* t_current = nullptr;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+JobSystem::JobSystem(uint32_t num_threads) :
+    m_num_queued(0), m_next_queue(0), m_num_submitted(0), m_stop(false)
+{
+    num_threads = resolve_thread_count(num_threads);
+
+    for (uint32_t i = 0; i < num_threads; i++)
+        m_queues.emplace_back(new Queue());
+
+    // Queue 0 belongs to whoever submits from outside the pool and then waits, so that thread is the last of num_threads.
+    for (uint32_t i = 1; i < num_threads; i++)
+        m_workers.emplace_back(&JobSystem::worker_main, this, i);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_wake_mutex);
+        m_stop = true;
+    }
+
+    m_wake.notify_all();
+
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+JobSystem* JobSystem::current()
+{
+    return t_current;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t JobSystem::own_queue() const
+{
+    return t_worker_pool == this ? t_worker_queue : 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void JobSystem::submit(std::function<void()> job, JobGroup& group)
+{
+    group.pending++;
+
+    Queue& queue = *m_queues[own_queue()];
+
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back({ std::move(job), &group });
+    }
+
+    m_num_queued++;
+
+    // Taking the lock orders this with a worker or waiter that is about to sleep, so the notification can't be missed.
+    {
+        std::lock_guard<std::mutex> lock(m_wake_mutex);
+        m_num_submitted++;
+    }
+
+    m_wake.notify_one();
+    m_done.notify_all();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void JobSystem::wait(JobGroup& group)
+{
+    uint32_t queue_index = own_queue();
+
+    while (group.pending > 0)
+    {
+        uint32_t num_submitted;
+
+        {
+            std::lock_guard<std::mutex> lock(m_wake_mutex);
+            num_submitted = m_num_submitted;
+        }
+
+        if (try_run_job(queue_index, &group))
+            continue;
+
+        // None of the group's jobs are queued, so the rest are running elsewhere. A job submitted from here on may be one of the
+        // group's, queued by one of its running jobs, so that wakes this thread to look again as well as the group finishing.
+        std::unique_lock<std::mutex> lock(m_wake_mutex);
+        m_done.wait(lock, [&]() { return group.pending == 0 || m_num_submitted != num_submitted; });
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void JobSystem::parallel_for(uint32_t count, const std::function<void(uint32_t)>& func, uint32_t batch_size)
+{
+    batch_size = std::max(1u, batch_size);
+
+    uint32_t num_batches = (count + batch_size - 1) / batch_size;
+    uint32_t num_jobs    = std::min(num_threads(), num_batches);
+
+    std::atomic<uint32_t> next(0);
+
+    auto loop = [&]() {
+        while (true)
+        {
+            uint32_t begin = next.fetch_add(batch_size);
+
+            if (begin >= count)
+                break;
+
+            uint32_t end = std::min(count, begin + batch_size);
+
+            for (uint32_t i = begin; i < end; i++)
+                func(i);
+        }
+    };
+
+    JobGroup group;
+
+    for (uint32_t i = 1; i < num_jobs; i++)
+        submit(loop, group);
+
+    // The calling thread takes part, so a loop whose helper jobs are never stolen still finishes.
+    JobSystem* previous = t_current;
+
+    t_current = this;
+    loop();
+    t_current = previous;
+
+    wait(group);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void JobSystem::worker_main(uint32_t index)
+{
+    t_worker_pool  = this;
+    t_worker_queue = index;
+
+    while (!m_stop)
+    {
+        if (try_run_job(index, nullptr))
+            continue;
+
+        std::unique_lock<std::mutex> lock(m_wake_mutex);
+        m_wake.wait(lock, [&]() { return m_stop || m_num_queued > 0; });
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool JobSystem::try_run_job(uint32_t queue_index, const JobGroup* group)
+{
+    const uint32_t num_queues = num_threads();
+    const uint32_t start      = num_queues > 1 ? m_next_queue.fetch_add(1) % (num_queues - 1) : 0;
+
+    for (uint32_t i = 0; i < num_queues; i++)
+    {
+        // Start with the own queue, then go round the others from a rotating start so thieves spread out.
+        uint32_t victim = i == 0 ? queue_index : (queue_index + 1 + (start + i - 1) % (num_queues - 1)) % num_queues;
+
+        Queue& queue = *m_queues[victim];
+        Job    job;
+
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+
+            if (queue.jobs.empty())
+                continue;
+
+            if (!group)
+            {
+                // Newest job of the own queue, oldest of anyone else's: the oldest tend to be the biggest pieces of work.
+                if (victim == queue_index)
+                {
+                    job = std::move(queue.jobs.back());
+                    queue.jobs.pop_back();
+                }
+                else
+                {
+                    job = std::move(queue.jobs.front());
+                    queue.jobs.pop_front();
+                }
+            }
+            else
+            {
+                auto it = std::find_if(queue.jobs.begin(), queue.jobs.end(), [&](const Job& queued) { return queued.group == group; });
+
+                if (it == queue.jobs.end())
+                    continue;
+
+                job = std::move(*it);
+                queue.jobs.erase(it);
+            }
+        }
+
+        m_num_queued--;
+        run_job(job);
+
+        return true;
+    }
+
+    return false;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void JobSystem::run_job(Job& job)
+{
+    JobSystem* previous = t_current;
+
+    t_current = this;
+    job.func();
+    t_current = previous;
+
+    // The group may be gone as soon as its count reaches zero, so it isn't touched after the decrement.
+    if (--job.group->pending == 0)
+    {
+        std::lock_guard<std::mutex> lock(m_wake_mutex);
+        m_done.notify_all();
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
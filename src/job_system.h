@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+// Jobs waited on together. Must outlive every job submitted with it.
+struct JobGroup
+{
+    std::atomic<uint32_t> pending { 0 };
+};
+
+// Work stealing thread pool. Every worker owns a queue: it pushes and pops jobs at the back of its own queue and, once that is
+// empty, steals from the front of the others. Threads that wait on a group run that group's queued jobs in the meantime, so jobs
+// can submit and wait on nested jobs without tying up a thread, and a wait never picks up unrelated work that could keep it
+// busy long after its own jobs are done. parallel_for() called from inside a job runs on the same pool, which lets one pool serve
+// both many small bakes and the rows of a single big one.
+class JobSystem
+{
+public:
+    // num_threads = 0 starts one worker per core. Threads that wait on a group take part as well.
+    explicit JobSystem(uint32_t num_threads = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    void submit(std::function<void()> job, JobGroup& group);
+
+    // Runs the group's queued jobs until every job of the group has finished. Sleeps while the rest of them run on other threads,
+    // until one finishes the group or a new job is submitted that could belong to it.
+    void wait(JobGroup& group);
+
+    // Calls func(i) for every i in [0, count), handing out batches of batch_size items from a shared counter to as many jobs as
+    // there are threads. Returns when all items are done.
+    void parallel_for(uint32_t count, const std::function<void(uint32_t)>& func, uint32_t batch_size = 1);
+
+    inline uint32_t num_threads() const { return static_cast<uint32_t>(m_queues.size()); }
+
+    // The pool running the current thread's job, or nullptr outside of jobs.
+    static JobSystem* current();
+
+private:
+    struct Job
+    {
+        std::function<void()> func;
+        JobGroup*             group;
+    };
+
+    struct Queue
+    {
+        std::mutex      mutex;
+        std::deque<Job> jobs;
+    };
+
+    void worker_main(uint32_t index);
+    uint32_t own_queue() const;
+
+    // Runs one job, from the back of the own queue or stolen from the front of another. With a group, only jobs of that group.
+    bool try_run_job(uint32_t queue_index, const JobGroup* group);
+    void run_job(Job& job);
+
+private:
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread>            m_workers;
+    std::atomic<uint32_t>               m_num_queued;
+    std::atomic<uint32_t>               m_next_queue;
+    uint32_t                            m_num_submitted; // Guarded by m_wake_mutex, tells waiters a job was submitted.
+    std::atomic<bool>                   m_stop;
+    std::mutex                          m_wake_mutex;
+    std::condition_variable             m_wake;
+    std::condition_variable             m_done; // Wakes threads in wait(), kept apart from m_wake so they don't eat workers' wakeups.
+};
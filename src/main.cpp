@@ -11,10 +11,29 @@
 #include <chrono>
 #include <random>
 #include <fstream>
+#include <cstring>
+#include "sdf_baker.h"
+#include "sparse_volume.h"
+#include "sdf_encoding.h"
+#include "sdf_cache.h"
+#include "sdf_pyramid.h"
+#include "async_baker.h"
+#include "instance_bvh.h"
+#include "instance_table.h"
+#include "sdf_clipmap.h"
+#include "sdf_atlas.h"
+#include "bake_planner.h"
+#include "mesh_preprocess.h"
+#include "shadow_culling.h"
+#include "profiler.h"
+#include <unordered_map>
 
 #define CAMERA_FAR_PLANE 1000.0f
-#define NUM_INSTANCES 16
-#define NUM_SDFS 16
+#define CAMERA_START_POSITION glm::vec3(0.0f, 3.0f, 15.0f)
+
+// Grid step and padding of every volume unless --sdf-budget is given.
+#define SDF_GRID_STEP_SIZE 0.025f
+#define SDF_PADDING 4
 
 struct GlobalUniforms
 {
@@ -40,21 +59,55 @@ struct InstanceUniforms
     glm::vec4 ws_axis[3];
     DW_ALIGNED(16)
     glm::ivec4 sdf_idx;
+    DW_ALIGNED(16)
+    glm::vec4 sdf_range;
+    DW_ALIGNED(16)
+    glm::vec4 atlas_scale; // uvw in the volume's box to uvw in its atlas page: uvw * scale + offset.
+    DW_ALIGNED(16)
+    glm::vec4 atlas_offset;
+    DW_ALIGNED(16)
+    glm::ivec4 atlas_origin; // Corner of the volume's slot in its page, for the texel fetches of the coarser levels.
+    DW_ALIGNED(16)
+    glm::ivec4 volume_size;
+};
+
+// Level of the scene clipmap, ClipmapLevel in mesh_fs.glsl.
+struct ClipmapLevelUniforms
+{
+    glm::vec4 origin; // World voxel coordinate of the first voxel, voxel size in w.
+    uint64_t  handle;
+    float     band;
+    float     padding;
+};
+
+// What an instance's shadows are traced against while its volume is baked in the background.
+enum class SDFState
+{
+    BOUNDS, // Distance to the mesh bounds, there is no texture yet.
+    COARSE, // Low resolution bake, see ASYNC_BAKE_COARSE_SCALE.
+    FULL
 };
 
 struct Instance
 {
     // Mesh
+    std::string   name;
     dw::Mesh::Ptr mesh;
     glm::vec3     color;
 
-    // SDF
-    dw::gl::Texture3D::Ptr sdf;
-    glm::ivec3             volume_size;
-    glm::vec3              grid_origin;
-    float                  grid_step_size;
-    glm::vec3              min_extents;
-    glm::vec3              max_extents;
+    // SDF, shared by every instance baked from the same mesh and settings.
+    uint32_t   sdf_idx       = UINT32_MAX;
+    uint32_t   sdf_levels    = 1; // Mip levels of the conservative pyramid, see sdf_pyramid.h.
+    glm::ivec3 volume_size;
+    glm::vec3  grid_origin;
+    float      grid_step_size;
+    glm::vec3  min_extents;
+    glm::vec3  max_extents;
+    glm::vec2  sdf_range     = glm::vec2(0.0f, 1.0f); // Decodes normalized texels: bias + scale * value.
+    SDFState   sdf_state     = SDFState::BOUNDS;
+    float      sdf_padding   = 0.0f; // Distance between the mesh bounds and the volume's box.
+    double     coarse_sdf_ms = -1.0; // Time from startup until the coarse volume was in use, < 0 until then.
+    double     full_sdf_ms   = -1.0; // Same for the full resolution volume.
 
     // Transform
     bool      animate   = false;
@@ -70,6 +123,42 @@ protected:
 
     bool init(int argc, const char* argv[]) override
     {
+        m_start_time = std::chrono::high_resolution_clock::now();
+
+        for (int i = 1; i < argc; i++)
+        {
+            if (strcmp(argv[i], "--cpu-bake") == 0)
+                m_cpu_bake = true;
+            else if (strcmp(argv[i], "--sync-bake") == 0)
+                m_sync_bake = true;
+            else if (strcmp(argv[i], "--sdf-encoding") == 0 && i + 1 < argc)
+            {
+                i++;
+
+                // fp16 is kept as a short form of float16.
+                if (strcmp(argv[i], "float32") == 0)
+                    m_sdf_encoding = SDFEncoding::FLOAT32;
+                else if (strcmp(argv[i], "float16") == 0 || strcmp(argv[i], "fp16") == 0)
+                    m_sdf_encoding = SDFEncoding::FLOAT16;
+                else if (strcmp(argv[i], "unorm16") == 0)
+                    m_sdf_encoding = SDFEncoding::UNORM16;
+                else if (strcmp(argv[i], "unorm8") == 0)
+                    m_sdf_encoding = SDFEncoding::UNORM8;
+                else
+                {
+                    DW_LOG_FATAL(std::string("Unknown SDF encoding: ") + argv[i] + ", expected float32, float16, unorm16 or unorm8");
+                    return false;
+                }
+
+                // Encoded volumes are produced by the CPU baker.
+                m_cpu_bake = true;
+            }
+            else if (strcmp(argv[i], "--sdf-budget") == 0 && i + 1 < argc)
+                m_sdf_budget_mb = static_cast<float>(atof(argv[++i]));
+            else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+                m_profile_path = argv[++i];
+        }
+
         // Create GPU resources.
         if (!create_shaders())
             return false;
@@ -77,12 +166,16 @@ protected:
         if (!create_uniform_buffer())
             return false;
 
+        create_clipmap();
+
+        // Volumes that aren't in the cache are baked on the CPU in the background, the GL context belongs to this thread.
+        if (!m_sync_bake)
+            m_async_baker = std::make_unique<AsyncBaker>(m_sdf_cache);
+
         // Load scene.
         if (!load_scene())
             return false;
 
-        update_textures();
-
         // Create camera.
         create_camera();
 
@@ -93,6 +186,17 @@ protected:
 
     void update(double delta) override
     {
+        if (m_first_frame_ms < 0.0)
+        {
+            m_first_frame_ms = elapsed_ms();
+            m_profiler.set_value("first_frame_ms", m_first_frame_ms);
+            DW_LOG_INFO("First frame after " + std::to_string(m_first_frame_ms) + " ms");
+        }
+
+        ProfileScope frame_scope(&m_profiler, "frame");
+
+        update_sdf_bakes();
+
         if (m_debug_gui)
             debug_gui();
 
@@ -120,6 +224,29 @@ protected:
     {
         ImGui::Checkbox("Draw Bounding Boxes", &m_draw_bounding_boxes);
         ImGui::Checkbox("Soft Shadows", &m_soft_shadows);
+        ImGui::Checkbox("Coarse-to-Fine Shadows", &m_sdf_mips);
+        ImGui::Checkbox("Instance BVH", &m_use_instance_bvh);
+        ImGui::Checkbox("Scene Clipmap", &m_use_clipmap);
+        ImGui::Checkbox("Shadow Tiles", &m_use_shadow_tiles);
+
+        if (m_use_shadow_tiles)
+            ImGui::Text("Shadow tiles: %u of %u empty, %u lit instances, %.1f per tile (max %u), %.2f ms", m_shadow_stats.empty_tiles, m_shadow_stats.num_tiles, m_shadow_stats.lit_instances, double(m_shadow_stats.num_entries) / double(std::max(1u, m_shadow_stats.num_tiles)), m_shadow_stats.max_tile_count, m_shadow_stats.ms);
+
+        ImGui::Text("Clipmap: %llu of %llu voxels recomposed", static_cast<unsigned long long>(m_clipmap_stats.recomposed_voxels), static_cast<unsigned long long>(m_clipmap_stats.total_voxels));
+        ImGui::Text("Uploaded: %zu bytes", m_upload_bytes);
+
+        SDFAtlasStats atlas_stats    = m_atlas_packer.stats();
+        size_t        instance_bytes = 0;
+
+        for (const auto& instance : m_instances)
+            instance_bytes += m_sdf_textures[instance.sdf_idx].texture_bytes;
+
+        ImGui::Text("SDF atlas: %u pages, %.0f%% packed, %zu bytes (%zu as one texture per instance)", atlas_stats.num_pages, atlas_stats.efficiency() * 100.0, atlas_bytes(), instance_bytes);
+        ImGui::Text("First frame: %.1f ms", m_first_frame_ms);
+
+        if (m_async_baker)
+            ImGui::Text("Pending bakes: %u", m_async_baker->num_pending());
+
         ImGui::InputFloat("T-Min", &m_t_min);
         ImGui::InputFloat("T-Max", &m_t_max);
         ImGui::SliderFloat("Soft Shadows K", &m_soft_shadows_k, 1.0f, 16.0f);
@@ -143,7 +270,11 @@ protected:
             auto& instance = m_instances[i];
 
             ImGui::PushID(i);
-            ImGui::Text("Mesh %i", i);
+            ImGui::Text("Mesh %i: %s", i, instance.name.c_str());
+
+            const char* states[] = { "bounds", "coarse", "full" };
+
+            ImGui::Text("SDF: %s, coarse %.1f ms, full %.1f ms", states[static_cast<int>(instance.sdf_state)], instance.coarse_sdf_ms, instance.full_sdf_ms);
             ImGui::InputFloat3("Position", &instance.position.x);
             ImGui::SliderFloat("Rotation", &instance.rotation, -180.0f, 180.0f);
             ImGui::ColorEdit3("Color", &instance.color.x);
@@ -155,6 +286,19 @@ protected:
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
+    void shutdown() override
+    {
+        if (m_profile_path.empty())
+            return;
+
+        if (m_profiler.write_json(m_profile_path))
+            DW_LOG_INFO("Wrote profile: " + m_profile_path);
+        else
+            DW_LOG_WARNING("Failed to write profile: " + m_profile_path);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
     void window_resized(int width, int height) override
     {
         // Override window resized method to update camera projection.
@@ -282,56 +426,479 @@ private:
     {
         // Create uniform buffer for global data
         m_global_ubo   = dw::gl::Buffer::create(GL_UNIFORM_BUFFER, GL_MAP_WRITE_BIT, sizeof(GlobalUniforms));
-        m_instance_ubo = dw::gl::Buffer::create(GL_UNIFORM_BUFFER, GL_MAP_WRITE_BIT, sizeof(InstanceUniforms) * NUM_INSTANCES);
-        m_sdf_ubo      = dw::gl::Buffer::create(GL_UNIFORM_BUFFER, GL_MAP_WRITE_BIT, sizeof(uint64_t) * NUM_SDFS * 2);
+
+        // The instance, SDF handle and instance BVH storage buffers are sized by their tables on the first upload.
 
         return true;
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void bake_sdf(Instance& instance, float grid_step_size, int padding)
+    // One texture per level. GL_REPEAT does the toroidal addressing of the levels, see SDFClipmap.
+    void create_clipmap()
+    {
+        uint32_t resolution = m_clipmap.resolution();
+
+        m_clipmap_levels.resize(m_clipmap.num_levels());
+
+        for (uint32_t i = 0; i < m_clipmap.num_levels(); i++)
+        {
+            dw::gl::Texture3D::Ptr texture = dw::gl::Texture3D::create(resolution, resolution, resolution, 1, GL_R32F, GL_RED, GL_FLOAT);
+            texture->set_min_filter(GL_LINEAR);
+            texture->set_mag_filter(GL_LINEAR);
+            texture->set_wrapping(GL_REPEAT, GL_REPEAT, GL_REPEAT);
+
+            m_clipmap_levels[i].handle = texture->make_texture_handle_resident();
+            m_clipmap_levels[i].band   = m_clipmap.band(i);
+
+            m_clipmap_textures.push_back(texture);
+        }
+
+        m_clipmap_ssbo = dw::gl::Buffer::create(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_STORAGE_BIT, sizeof(ClipmapLevelUniforms) * m_clipmap_levels.size());
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    SDFMesh create_sdf_mesh(dw::Mesh::Ptr mesh)
+    {
+        SDFMesh sdf_mesh;
+
+        const auto& vertices = mesh->vertices();
+
+        sdf_mesh.positions.resize(vertices.size());
+        sdf_mesh.normals.resize(vertices.size());
+        sdf_mesh.indices = mesh->indices();
+
+        for (int i = 0; i < vertices.size(); i++)
+        {
+            sdf_mesh.positions[i] = glm::vec3(vertices[i].position);
+            sdf_mesh.normals[i]   = glm::vec3(vertices[i].normal);
+        }
+
+        return sdf_mesh;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void sdf_texture_format(SDFEncoding encoding, GLenum& internal_format, GLenum& type)
+    {
+        internal_format = GL_R32F;
+        type            = GL_FLOAT;
+
+        if (encoding == SDFEncoding::FLOAT16)
+        {
+            internal_format = GL_R16F;
+            type            = GL_HALF_FLOAT;
+        }
+        else if (encoding == SDFEncoding::UNORM16)
+        {
+            internal_format = GL_R16;
+            type            = GL_UNSIGNED_SHORT;
+        }
+        else if (encoding == SDFEncoding::UNORM8)
+        {
+            internal_format = GL_R8;
+            type            = GL_UNSIGNED_BYTE;
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Grows the texture of an atlas page to the size the packer gives it and copies the old contents over, mips included. The
+    // handle changes, and so does the atlas transform of every instance on the page since it depends on the page size.
+    void resize_atlas_page(uint32_t page)
+    {
+        glm::ivec3 size = m_atlas_packer.page_size(page);
+
+        if (page < m_atlas_pages.size() && m_atlas_page_sizes[page] == size)
+            return;
+
+        GLenum internal_format;
+        GLenum type;
+
+        sdf_texture_format(m_sdf_encoding, internal_format, type);
+
+        // Page sizes are multiples of SDF_ATLAS_ALIGNMENT, so every mip has exactly half the texels of the one above.
+        dw::gl::Texture3D::Ptr texture = dw::gl::Texture3D::create(size.x, size.y, size.z, SDF_PYRAMID_MAX_LEVELS, internal_format, GL_RED, type);
+        texture->set_min_filter(GL_LINEAR_MIPMAP_NEAREST);
+        texture->set_mag_filter(GL_LINEAR);
+        texture->set_wrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+
+        if (page < m_atlas_pages.size())
+        {
+            glm::ivec3 old_size = m_atlas_page_sizes[page];
+
+            for (int i = 0; i < SDF_PYRAMID_MAX_LEVELS; i++)
+                glCopyImageSubData(m_atlas_pages[page]->id(), GL_TEXTURE_3D, i, 0, 0, 0, texture->id(), GL_TEXTURE_3D, i, 0, 0, 0, old_size.x >> i, old_size.y >> i, old_size.z >> i);
+        }
+        else
+        {
+            m_atlas_pages.resize(page + 1);
+            m_atlas_page_sizes.resize(page + 1);
+
+            while (m_sdf_table.size() <= page)
+                m_sdf_table.push_back(0);
+        }
+
+        m_atlas_pages[page]      = texture;
+        m_atlas_page_sizes[page] = size;
+        m_sdf_table.modify(page) = texture->make_texture_handle_resident();
+
+        for (uint32_t i = 0; i < m_instances.size(); i++)
+        {
+            if (m_instances[i].sdf_idx != UINT32_MAX && m_sdf_textures[m_instances[i].sdf_idx].slot.page == page)
+                apply_shared_sdf(i);
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Places a volume in the atlas. Level 0 is uploaded in the volume's encoding with its border, the pyramid supplies the
+    // coarser levels, which go to the same offset shifted down in the mips of the page.
+    SDFAtlasSlot upload_to_atlas(const SDFVolumeView& volume, const SDFPyramid& pyramid)
+    {
+        SDFAtlasSlot slot = m_atlas_packer.insert(volume.volume_size);
+
+        resize_atlas_page(slot.page);
+
+        GLenum internal_format;
+        GLenum type;
+
+        sdf_texture_format(volume.encoding, internal_format, type);
+
+        glm::ivec3           bordered_size = volume.volume_size + glm::ivec3(2 * SDF_ATLAS_BORDER);
+        std::vector<uint8_t> bordered(size_t(bordered_size.x) * size_t(bordered_size.y) * size_t(bordered_size.z) * encoding_size(volume.encoding));
+
+        copy_with_border(volume.data, volume.volume_size, encoding_size(volume.encoding), bordered.data());
+
+        glBindTexture(GL_TEXTURE_3D, m_atlas_pages[slot.page]->id());
+
+        // Rows of 8 and 16 bit texels aren't necessarily 4 byte aligned.
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage3D(GL_TEXTURE_3D, 0, slot.offset.x, slot.offset.y, slot.offset.z, bordered_size.x, bordered_size.y, bordered_size.z, GL_RED, type, bordered.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        // GL converts the float texels to the texture format, so normalized encodings are mapped into their range first. Values
+        // below the range clamp to its minimum, which only happens deep inside the mesh where the march has already stopped.
+        for (uint32_t i = 1; i < pyramid.num_levels(); i++)
+        {
+            const SDFVolume&   level  = pyramid.levels[i];
+            std::vector<float> texels = level.distances;
+            glm::ivec3         offset = slot.offset >> int(i);
+
+            if (volume.ranges)
+            {
+                for (auto& d : texels)
+                    d = volume.ranges[0].y > 0.0f ? (d - volume.ranges[0].x) / volume.ranges[0].y : 0.0f;
+            }
+
+            glTexSubImage3D(GL_TEXTURE_3D, i, offset.x, offset.y, offset.z, level.volume_size.x, level.volume_size.y, level.volume_size.z, GL_RED, GL_FLOAT, texels.data());
+        }
+
+        glBindTexture(GL_TEXTURE_3D, 0);
+
+        return slot;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Memory of all atlas pages with their mips.
+    size_t atlas_bytes()
     {
-        glm::vec3  min_extents = instance.mesh->min_extents() - (glm::vec3(grid_step_size) * float(padding));
-        glm::vec3  max_extents = instance.mesh->max_extents() + (glm::vec3(grid_step_size) * float(padding));
-        glm::vec3  grid_origin = min_extents + glm::vec3(grid_step_size / 2.0f);
-        glm::vec3  box_size    = max_extents - min_extents;
-        glm::ivec3 volume_size = glm::ivec3(glm::ceil(box_size / glm::vec3(grid_step_size)));
+        size_t bytes = 0;
 
-        instance.volume_size    = volume_size;
-        instance.grid_origin    = grid_origin;
-        instance.grid_step_size = grid_step_size;
-        instance.min_extents    = min_extents;
-        instance.max_extents    = max_extents;
+        for (const auto& size : m_atlas_page_sizes)
+        {
+            for (int i = 0; i < SDF_PYRAMID_MAX_LEVELS; i++)
+                bytes += size_t(size.x >> i) * size_t(size.y >> i) * size_t(size.z >> i) * encoding_size(m_sdf_encoding);
+        }
 
-        instance.sdf = dw::gl::Texture3D::create(volume_size.x, volume_size.y, volume_size.z, 1, GL_R32F, GL_RED, GL_FLOAT);
-        instance.sdf->set_min_filter(GL_LINEAR);
-        instance.sdf->set_mag_filter(GL_LINEAR);
-        instance.sdf->set_wrapping(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+        return bytes;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Timed from the dispatch to the end of the readback, which waits for the dispatch to finish.
+    SDFVolume bake_sdf_gpu(dw::Mesh::Ptr mesh, const SDFGrid& grid)
+    {
+        ProfileScope scope(&m_profiler, "bake.gpu");
+
+        dw::gl::Texture3D::Ptr texture = dw::gl::Texture3D::create(grid.volume_size.x, grid.volume_size.y, grid.volume_size.z, 1, GL_R32F, GL_RED, GL_FLOAT);
 
         m_bake_sdf_program->use();
 
-        m_bake_sdf_program->set_uniform("u_GridStepSize", glm::vec3(grid_step_size));
-        m_bake_sdf_program->set_uniform("u_GridOrigin", grid_origin);
-        m_bake_sdf_program->set_uniform("u_NumTriangles", static_cast<uint32_t>(instance.mesh->indices().size() / 3));
-        m_bake_sdf_program->set_uniform("u_VolumeSize", volume_size);
+        m_bake_sdf_program->set_uniform("u_GridStepSize", glm::vec3(grid.grid_step_size));
+        m_bake_sdf_program->set_uniform("u_GridOrigin", grid.grid_origin);
+        m_bake_sdf_program->set_uniform("u_NumTriangles", static_cast<uint32_t>(mesh->indices().size() / 3));
+        m_bake_sdf_program->set_uniform("u_VolumeSize", grid.volume_size);
 
-        instance.sdf->bind_image(0, 0, 0, GL_READ_WRITE, instance.sdf->internal_format());
+        texture->bind_image(0, 0, 0, GL_READ_WRITE, texture->internal_format());
 
-        instance.mesh->vertex_buffer()->bind_base(GL_SHADER_STORAGE_BUFFER, 0);
-        instance.mesh->index_buffer()->bind_base(GL_SHADER_STORAGE_BUFFER, 1);
+        mesh->vertex_buffer()->bind_base(GL_SHADER_STORAGE_BUFFER, 0);
+        mesh->index_buffer()->bind_base(GL_SHADER_STORAGE_BUFFER, 1);
 
         const uint32_t NUM_THREADS_X = 8;
         const uint32_t NUM_THREADS_Y = 8;
         const uint32_t NUM_THREADS_Z = 1;
 
-        uint32_t size_x = static_cast<uint32_t>(ceil(float(volume_size.x) / float(NUM_THREADS_X)));
-        uint32_t size_y = static_cast<uint32_t>(ceil(float(volume_size.y) / float(NUM_THREADS_Y)));
-        uint32_t size_z = static_cast<uint32_t>(ceil(float(volume_size.z) / float(NUM_THREADS_Z)));
+        uint32_t size_x = static_cast<uint32_t>(ceil(float(grid.volume_size.x) / float(NUM_THREADS_X)));
+        uint32_t size_y = static_cast<uint32_t>(ceil(float(grid.volume_size.y) / float(NUM_THREADS_Y)));
+        uint32_t size_z = static_cast<uint32_t>(ceil(float(grid.volume_size.z) / float(NUM_THREADS_Z)));
 
         glDispatchCompute(size_x, size_y, size_z);
 
-        glFinish();
+        glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+        // Read the result back so it can be written to the cache.
+        SDFVolume volume;
+
+        static_cast<SDFGrid&>(volume) = grid;
+        volume.distances.resize(volume.num_voxels());
+
+        glBindTexture(GL_TEXTURE_3D, texture->id());
+        glGetTexImage(GL_TEXTURE_3D, 0, GL_RED, GL_FLOAT, volume.distances.data());
+        glBindTexture(GL_TEXTURE_3D, 0);
+
+        DW_LOG_INFO("GPU SDF bake of " + std::to_string(volume.num_voxels()) + " voxels in " + std::to_string(scope.elapsed_ms()) + " ms");
+
+        m_profiler.add_counter("bake.gpu.voxels", volume.num_voxels());
+
+        return volume;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    double elapsed_ms() const
+    {
+        return ::elapsed_ms(m_start_time);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Moves a shared volume to a new slot in the atlas and points every instance using it there. The old slot, usually that of
+    // the coarse bake, is left for later volumes.
+    void upload_sdf(uint32_t sdf_idx, const SDFVolumeView& volume, const SDFPyramid& pyramid, std::shared_ptr<const MappedSDF> data, SDFState state)
+    {
+        m_atlas_packer.remove(m_sdf_textures[sdf_idx].slot);
+        m_sdf_textures[sdf_idx].slot = SDFAtlasSlot();
+
+        SDFAtlasSlot slot = upload_to_atlas(volume, pyramid);
+
+        SharedSDF& shared = m_sdf_textures[sdf_idx];
+
+        shared.slot       = slot;
+        shared.volume     = pyramid.levels[0];
+        shared.data       = data;
+        shared.grid       = volume;
+        shared.range      = volume.ranges ? volume.ranges[0] : glm::vec2(0.0f, 1.0f);
+        shared.num_levels = pyramid.num_levels();
+        shared.state      = state;
+
+        // What the volume would take as a texture of its own, for comparison with the atlas.
+        shared.texture_bytes = pyramid.memory_bytes() / sizeof(float) * encoding_size(volume.encoding);
+
+        for (uint32_t i = 0; i < m_instances.size(); i++)
+        {
+            if (m_instances[i].sdf_idx == sdf_idx)
+                apply_shared_sdf(i);
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Copies the instance's shared volume into the instance and its uniforms. Marking the uniforms dirty also makes
+    // update_transforms() recompute the box, since the grid of a coarse bake doesn't match the full one.
+    void apply_shared_sdf(uint32_t instance_idx)
+    {
+        Instance&        instance = m_instances[instance_idx];
+        const SharedSDF& shared   = m_sdf_textures[instance.sdf_idx];
+
+        instance.sdf_levels     = shared.num_levels;
+        instance.volume_size    = shared.grid.volume_size;
+        instance.grid_origin    = shared.grid.grid_origin;
+        instance.grid_step_size = shared.grid.grid_step_size;
+        instance.min_extents    = shared.grid.min_extents;
+        instance.max_extents    = shared.grid.max_extents;
+        instance.sdf_range      = shared.range;
+        instance.sdf_padding    = shared.padding;
+        instance.sdf_state      = shared.state;
+
+        if (shared.state == SDFState::COARSE && instance.coarse_sdf_ms < 0.0)
+            instance.coarse_sdf_ms = elapsed_ms();
+        else if (shared.state == SDFState::FULL && instance.full_sdf_ms < 0.0)
+            instance.full_sdf_ms = elapsed_ms();
+
+        InstanceUniforms& uniform = m_instance_table.modify(instance_idx);
+
+        uniform.half_extents = glm::vec4((instance.max_extents - instance.min_extents) / 2.0f, 0.0f);
+        uniform.os_center    = glm::vec4((instance.max_extents + instance.min_extents) / 2.0f, 1.0f);
+        uniform.sdf_idx      = glm::ivec4(shared.slot.valid() ? shared.slot.page : 0, instance.sdf_levels - 1, shared.state == SDFState::BOUNDS ? 1 : 0, 0);
+        uniform.sdf_range    = glm::vec4(instance.sdf_range, instance.grid_step_size, instance.sdf_padding);
+
+        if (shared.slot.valid())
+        {
+            glm::vec3 page_size = glm::vec3(m_atlas_page_sizes[shared.slot.page]);
+
+            uniform.atlas_scale  = glm::vec4(glm::vec3(shared.slot.volume_size) / page_size, 0.0f);
+            uniform.atlas_offset = glm::vec4(glm::vec3(shared.slot.offset + glm::ivec3(SDF_ATLAS_BORDER)) / page_size, 0.0f);
+            uniform.atlas_origin = glm::ivec4(shared.slot.offset, 0);
+            uniform.volume_size  = glm::ivec4(shared.slot.volume_size, 0);
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool bake_sdf(uint32_t instance_idx, float grid_step_size, int padding)
+    {
+        Instance& instance = m_instances[instance_idx];
+
+        BakeSettings settings;
+
+        settings.grid_step_size = grid_step_size;
+        settings.padding        = padding;
+
+        SDFMesh sdf_mesh = create_sdf_mesh(instance.mesh);
+
+        // Only the CPU baker, which background bakes use too, gets the preprocessed mesh. The compute shader bakes the mesh as
+        // imported, so its volume is keyed by that.
+        if (m_cpu_bake || m_async_baker)
+        {
+            MeshPreprocessSettings preprocess_settings;
+            MeshPreprocessStats    preprocess_stats;
+
+            // The authored normals decide the sign, so hard edges stay split.
+            preprocess_settings.keep_normals = settings.sign_mode == SignMode::NORMALS;
+
+            preprocess_mesh(sdf_mesh, preprocess_settings, &preprocess_stats);
+
+            if (preprocess_stats.removed_triangles() > 0)
+                DW_LOG_INFO(instance.name + ": removed " + std::to_string(preprocess_stats.degenerate_triangles) + " degenerate and " + std::to_string(preprocess_stats.duplicate_triangles) + " duplicate triangles before baking");
+        }
+
+        uint64_t key = sdf_cache_key(sdf_mesh, settings, m_sdf_encoding);
+
+        // Every instance of the same mesh and settings shares one texture.
+        auto it = m_sdf_lookup.find(key);
+
+        if (it == m_sdf_lookup.end())
+        {
+            uint32_t sdf_idx = static_cast<uint32_t>(m_sdf_textures.size());
+
+            it = m_sdf_lookup.insert({ key, sdf_idx }).first;
+
+            // Until a volume is uploaded, the shadows use the distance to the mesh bounds inside the box the full bake will have.
+            SharedSDF shared;
+            glm::vec3 min_extents, max_extents;
+
+            compute_extents(sdf_mesh, min_extents, max_extents);
+
+            shared.key        = key;
+            shared.grid       = compute_grid(min_extents, max_extents, grid_step_size, padding);
+            shared.range      = glm::vec2(0.0f, 1.0f);
+            shared.num_levels = 1;
+            shared.padding    = grid_step_size * float(padding);
+            shared.state      = SDFState::BOUNDS;
+
+            m_sdf_textures.push_back(shared);
+
+            std::shared_ptr<const MappedSDF> sdf_data = m_sdf_cache.find(key);
+
+            // The shader decodes a volume with a single range, so per-brick files are baked again.
+            if (sdf_data && sdf_data->view().range_mode == SDFRangeMode::PER_BRICK && sdf_data->view().ranges)
+            {
+                DW_LOG_WARNING("Ignoring SDF with per-brick ranges: " + m_sdf_cache.path(key));
+                sdf_data.reset();
+            }
+
+            if (sdf_data)
+            {
+                DW_LOG_INFO("Loaded SDF from cache: " + m_sdf_cache.path(key));
+
+                // Conservative coarse levels for the far field of the shadow march.
+                upload_sdf(sdf_idx, sdf_data->view(), build_sdf_pyramid(decode_sdf(sdf_data->view())), sdf_data, SDFState::FULL);
+            }
+            else if (m_async_baker)
+                m_async_baker->submit(sdf_idx, std::make_shared<const SDFMesh>(std::move(sdf_mesh)), settings, m_sdf_encoding, key);
+            else
+            {
+                SDFVolume volume;
+
+                if (m_cpu_bake)
+                {
+                    BakeStats bake_stats;
+
+                    volume = ::bake_sdf(sdf_mesh, settings, &bake_stats);
+
+                    profile_bake(m_profiler, "bake.cpu", bake_stats, volume.num_voxels());
+                }
+                else
+                    volume = bake_sdf_gpu(instance.mesh, shared.grid);
+
+                // Memory a sparse layout with a 4 voxel band would take.
+                SparseSDFVolume sparse = build_sparse_volume(volume, 4.0f * volume.grid_step_size);
+
+                DW_LOG_INFO("Sparse SDF: " + std::to_string(sparse.num_stored_bricks()) + " of " + std::to_string(sparse.num_bricks()) + " bricks stored, " + std::to_string(sparse.memory_bytes()) + " bytes against " + std::to_string(sparse.dense_memory_bytes()) + " dense");
+
+                QuantizationError  error;
+                QuantizedSDFVolume quantized = encode_sdf(volume, m_sdf_encoding, SDFRangeMode::PER_VOLUME, &error);
+
+                if (m_sdf_encoding != SDFEncoding::FLOAT32)
+                    DW_LOG_INFO("SDF encoding error: max = " + std::to_string(error.max_error) + ", rms = " + std::to_string(error.rms_error) + ", bytes = " + std::to_string(quantized.memory_bytes()));
+
+                sdf_data = m_sdf_cache.store(key, quantized);
+
+                if (!sdf_data)
+                    DW_LOG_WARNING("Failed to write SDF cache: " + m_sdf_cache.path(key));
+
+                SDFVolumeView view = sdf_data ? sdf_data->view() : quantized.view();
+
+                upload_sdf(sdf_idx, view, build_sdf_pyramid(decode_sdf(view)), sdf_data, SDFState::FULL);
+            }
+        }
+
+        instance.sdf_idx = it->second;
+
+        apply_shared_sdf(instance_idx);
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Uploads at most one finished background bake per frame, so no frame pays for more than one texture upload.
+    void update_sdf_bakes()
+    {
+        if (!m_async_baker)
+            return;
+
+        for (const auto& result : m_async_baker->poll(1))
+        {
+            const SharedSDF& shared = m_sdf_textures[result.id];
+
+            // A coarse bake that finishes late never replaces the full volume.
+            if (result.stage == BakeStage::COARSE && shared.state == SDFState::FULL)
+                continue;
+
+            if (result.stage == BakeStage::FULL && !result.data)
+                DW_LOG_WARNING("Failed to write SDF cache: " + m_sdf_cache.path(shared.key));
+
+            upload_sdf(result.id, result.view(), result.pyramid, result.data, result.stage == BakeStage::COARSE ? SDFState::COARSE : SDFState::FULL);
+
+            const std::string name = result.stage == BakeStage::COARSE ? "bake.async.coarse" : "bake.async.full";
+
+            m_profiler.add_time(name, result.bake_ms);
+            m_profiler.add_time(name + ".wait", result.wait_ms);
+
+            for (const auto& instance : m_instances)
+            {
+                if (instance.sdf_idx != result.id)
+                    continue;
+
+                double ready_ms = result.stage == BakeStage::COARSE ? instance.coarse_sdf_ms : instance.full_sdf_ms;
+
+                DW_LOG_INFO(instance.name + ": " + (result.stage == BakeStage::COARSE ? "coarse" : "full") + " SDF in use after " + std::to_string(ready_ms) + " ms (queued " + std::to_string(result.wait_ms) + " ms, baked in " + std::to_string(result.bake_ms) + " ms)");
+            }
+        }
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
@@ -340,6 +907,7 @@ private:
     {
         Instance instance;
 
+        instance.name     = name;
         instance.mesh     = dw::Mesh::load("mesh/" + name + ".obj");
         instance.color    = color;
         instance.position = position;
@@ -351,20 +919,57 @@ private:
             return false;
         }
 
-        bake_sdf(instance, 0.025f, 4);
-
         m_instances.push_back(instance);
+        m_instance_table.push_back(InstanceUniforms());
 
-        InstanceUniforms uniform;
+        return true;
+    }
 
-        uniform.half_extents = glm::vec4((instance.max_extents - instance.min_extents) / 2.0f, 0.0f);
-        uniform.os_center    = glm::vec4((instance.max_extents + instance.min_extents) / 2.0f, 1.0f);
-        uniform.sdf_idx      = glm::ivec4(m_texture_uniforms.size(), 0, 0, 0);
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Grid step of every instance's volume. With --sdf-budget the steps are planned so the volumes fit in it, giving instances
+    // closer to the starting camera more of it, and the plan is logged before anything is baked.
+    std::vector<float> plan_sdf_steps()
+    {
+        if (m_sdf_budget_mb <= 0.0f)
+            return std::vector<float>(m_instances.size(), SDF_GRID_STEP_SIZE);
 
-        m_instance_uniforms.push_back(uniform);
-        m_texture_uniforms.push_back(instance.sdf->make_texture_handle_resident());
+        std::vector<BakePlanInput> inputs(m_instances.size());
 
-        return true;
+        for (size_t i = 0; i < m_instances.size(); i++)
+        {
+            const Instance& instance = m_instances[i];
+
+            inputs[i].min_extents   = instance.mesh->min_extents();
+            inputs[i].max_extents   = instance.mesh->max_extents();
+            inputs[i].num_triangles = static_cast<uint32_t>(instance.mesh->indices().size() / 3);
+            inputs[i].importance    = 1.0f / std::max(1.0f, glm::length(instance.position - CAMERA_START_POSITION));
+        }
+
+        BakePlanSettings settings;
+
+        settings.budget_bytes = static_cast<uint64_t>(double(m_sdf_budget_mb) * 1024.0 * 1024.0);
+        settings.encoding     = m_sdf_encoding;
+        settings.padding      = SDF_PADDING;
+
+        BakePlan           plan = plan_bake(inputs, settings);
+        std::vector<float> steps;
+
+        for (size_t i = 0; i < m_instances.size(); i++)
+        {
+            const BakePlanEntry& entry = plan.entries[i];
+
+            DW_LOG_INFO(m_instances[i].name + ": grid step " + std::to_string(entry.grid_step_size) + ", " + std::to_string(entry.volume_size.x) + "x" + std::to_string(entry.volume_size.y) + "x" + std::to_string(entry.volume_size.z) + " voxels, " + std::to_string(double(entry.bytes) / (1024.0 * 1024.0)) + " MB, estimated bake " + std::to_string(entry.bake_ms) + " ms");
+
+            steps.push_back(entry.grid_step_size);
+        }
+
+        DW_LOG_INFO("SDF plan: " + std::to_string(double(plan.bytes) / (1024.0 * 1024.0)) + " of " + std::to_string(m_sdf_budget_mb) + " MB, estimated bake " + std::to_string(plan.bake_ms) + " ms");
+
+        if (!plan.fits)
+            DW_LOG_WARNING("SDF budget too small, every volume is at the coarsest step");
+
+        return steps;
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
@@ -404,6 +1009,18 @@ private:
             }
         }
 
+        // Every mesh is loaded before the first bake so the steps can be planned for the whole scene.
+        std::vector<float> steps = plan_sdf_steps();
+
+        for (uint32_t i = 0; i < m_instances.size(); i++)
+        {
+            if (!bake_sdf(i, steps[i], SDF_PADDING))
+            {
+                DW_LOG_FATAL("Failed to bake SDF: " + m_instances[i].name);
+                return false;
+            }
+        }
+
         m_ground = dw::Mesh::load("mesh/ground.obj");
 
         if (!m_ground)
@@ -419,7 +1036,7 @@ private:
 
     void create_camera()
     {
-        m_main_camera = std::make_unique<dw::Camera>(60.0f, 1.0f, CAMERA_FAR_PLANE, float(m_width) / float(m_height), glm::vec3(0.0f, 3.0f, 15.0f), glm::vec3(-1.0f, 0.0, 0.0f));
+        m_main_camera = std::make_unique<dw::Camera>(60.0f, 1.0f, CAMERA_FAR_PLANE, float(m_width) / float(m_height), CAMERA_START_POSITION, glm::vec3(-1.0f, 0.0, 0.0f));
         m_main_camera->update();
     }
 
@@ -465,6 +1082,10 @@ private:
 
         // Bind SDF texture
         m_mesh_program->set_uniform("u_SDFSoftShadows", m_soft_shadows);
+        m_mesh_program->set_uniform("u_SDFMips", m_sdf_mips);
+        m_mesh_program->set_uniform("u_InstanceBVH", m_use_instance_bvh);
+        m_mesh_program->set_uniform("u_ClipmapLevels", m_use_clipmap && m_clipmap_ready ? static_cast<int>(m_clipmap.num_levels()) : 0);
+        m_mesh_program->set_uniform("u_ClipmapResolution", static_cast<int>(m_clipmap.resolution()));
         m_mesh_program->set_uniform("u_SDFTMin", m_t_min);
         m_mesh_program->set_uniform("u_SDFTMax", m_t_max);
         m_mesh_program->set_uniform("u_SDFSoftShadowsK", m_soft_shadows_k);
@@ -477,11 +1098,23 @@ private:
         m_mesh_program->set_uniform("u_LightInnerCutoff", cosf(glm::radians(m_light_inner_cutoff)));
         m_mesh_program->set_uniform("u_LightOuterCutoff", cosf(glm::radians(m_light_outer_cutoff)));
         m_mesh_program->set_uniform("u_LightRange", m_light_range);
+        m_mesh_program->set_uniform("u_ShadowTiles", m_use_shadow_tiles);
+        m_mesh_program->set_uniform("u_ShadowTilesX", static_cast<int>(m_shadow_tiles.tiles_x));
 
         // Bind uniform buffers.
         m_global_ubo->bind_base(0);
-        m_instance_ubo->bind_base(1);
-        m_sdf_ubo->bind_base(2);
+
+        // Bind storage buffers.
+        m_instance_ssbo->bind_base(GL_SHADER_STORAGE_BUFFER, 1);
+        m_sdf_ssbo->bind_base(GL_SHADER_STORAGE_BUFFER, 2);
+        m_instance_bvh_ssbo->bind_base(GL_SHADER_STORAGE_BUFFER, 3);
+        m_clipmap_ssbo->bind_base(GL_SHADER_STORAGE_BUFFER, 4);
+
+        if (m_use_shadow_tiles)
+        {
+            m_shadow_ranges_ssbo->bind_base(GL_SHADER_STORAGE_BUFFER, 5);
+            m_shadow_instances_ssbo->bind_base(GL_SHADER_STORAGE_BUFFER, 6);
+        }
 
         // Draw scene.
         render_mesh(m_ground, glm::mat4(1.0f), glm::vec3(0.5f));
@@ -501,27 +1134,105 @@ private:
             m_global_ubo->unmap();
         }
 
-        // Instance
+        m_upload_bytes = 0;
+
+        update_textures();
+
+        m_upload_bytes += m_instance_table.flush([&](size_t size) { m_instance_ssbo = dw::gl::Buffer::create(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_STORAGE_BIT, size); },
+                                                 [&](size_t offset, const InstanceUniforms* data, size_t size) { m_instance_ssbo->set_data(offset, size, (void*)data); });
+
+        // Refitting touches most nodes, so the instance BVH is uploaded whole when anything moved.
+        if (m_instance_bvh_dirty)
         {
-            void* ptr = m_instance_ubo->map(GL_WRITE_ONLY);
-            memcpy(ptr, m_instance_uniforms.data(), sizeof(InstanceUniforms) * m_instances.size());
-            m_instance_ubo->unmap();
+            size_t size = sizeof(InstanceBVH::Node) * m_instance_bvh.nodes().size();
+
+            if (!m_instance_bvh_ssbo || m_instance_bvh_capacity < size)
+            {
+                m_instance_bvh_capacity = std::max(size, m_instance_bvh_capacity * 2);
+                m_instance_bvh_ssbo     = dw::gl::Buffer::create(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_STORAGE_BIT, m_instance_bvh_capacity);
+            }
+
+            m_instance_bvh_ssbo->set_data(0, size, (void*)m_instance_bvh.nodes().data());
+
+            m_upload_bytes += size;
+            m_instance_bvh_dirty = false;
         }
+
+        update_clipmap_textures();
+        update_shadow_tile_buffers();
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void update_textures()
+    // The tile lists change with the camera, so they are uploaded every frame while in use.
+    void update_shadow_tile_buffers()
+    {
+        if (!m_use_shadow_tiles)
+            return;
+
+        size_t ranges_size    = sizeof(glm::uvec2) * m_shadow_tiles.ranges.size();
+        size_t instances_size = sizeof(uint32_t) * std::max(m_shadow_tiles.instances.size(), size_t(1));
+
+        if (!m_shadow_ranges_ssbo || m_shadow_ranges_capacity < ranges_size)
+        {
+            m_shadow_ranges_capacity = std::max(ranges_size, m_shadow_ranges_capacity * 2);
+            m_shadow_ranges_ssbo     = dw::gl::Buffer::create(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_STORAGE_BIT, m_shadow_ranges_capacity);
+        }
+
+        if (!m_shadow_instances_ssbo || m_shadow_instances_capacity < instances_size)
+        {
+            m_shadow_instances_capacity = std::max(instances_size, m_shadow_instances_capacity * 2);
+            m_shadow_instances_ssbo     = dw::gl::Buffer::create(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_STORAGE_BIT, m_shadow_instances_capacity);
+        }
+
+        m_shadow_ranges_ssbo->set_data(0, ranges_size, (void*)m_shadow_tiles.ranges.data());
+
+        if (!m_shadow_tiles.instances.empty())
+            m_shadow_instances_ssbo->set_data(0, sizeof(uint32_t) * m_shadow_tiles.instances.size(), (void*)m_shadow_tiles.instances.data());
+
+        m_upload_bytes += ranges_size + sizeof(uint32_t) * m_shadow_tiles.instances.size();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Uploads the regions of the clipmap that were recomposed, straight out of its toroidal storage.
+    void update_clipmap_textures()
     {
-        uint64_t* ptr = (uint64_t*)m_sdf_ubo->map(GL_WRITE_ONLY);
+        uint32_t resolution = m_clipmap.resolution();
 
-        for (int i = 0; i < m_texture_uniforms.size(); i++)
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, resolution);
+        glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, resolution);
+
+        for (const auto& region : m_clipmap.dirty_regions())
         {
-            memcpy(ptr, &m_texture_uniforms[i], sizeof(uint64_t));
-            ptr += 2;
+            const float* data = m_clipmap.data(region.level) + size_t(region.offset.x) + size_t(resolution) * (size_t(region.offset.y) + size_t(resolution) * size_t(region.offset.z));
+
+            glBindTexture(GL_TEXTURE_3D, m_clipmap_textures[region.level]->id());
+            glTexSubImage3D(GL_TEXTURE_3D, 0, region.offset.x, region.offset.y, region.offset.z, region.size.x, region.size.y, region.size.z, GL_RED, GL_FLOAT, data);
+
+            m_upload_bytes += size_t(region.size.x) * size_t(region.size.y) * size_t(region.size.z) * sizeof(float);
         }
 
-        m_sdf_ubo->unmap();
+        glBindTexture(GL_TEXTURE_3D, 0);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, 0);
+
+        m_clipmap.clear_dirty_regions();
+
+        // The origins follow the camera, so the level table is small enough to upload every frame.
+        for (uint32_t i = 0; i < m_clipmap.num_levels(); i++)
+            m_clipmap_levels[i].origin = glm::vec4(glm::vec3(m_clipmap.origin(i)), m_clipmap.voxel_size(i));
+
+        m_clipmap_ssbo->set_data(0, sizeof(ClipmapLevelUniforms) * m_clipmap_levels.size(), m_clipmap_levels.data());
+        m_upload_bytes += sizeof(ClipmapLevelUniforms) * m_clipmap_levels.size();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void update_textures()
+    {
+        m_upload_bytes += m_sdf_table.flush([&](size_t size) { m_sdf_ssbo = dw::gl::Buffer::create(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_STORAGE_BIT, size); },
+                                            [&](size_t offset, const uint64_t* data, size_t size) { m_sdf_ssbo->set_data(offset, size, (void*)data); });
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
@@ -533,19 +1244,34 @@ private:
         m_global_uniforms.cam_pos       = glm::vec4(camera->m_position, 0.0f);
         m_global_uniforms.num_instances = m_instances.size();
 
+        m_instance_boxes.resize(m_instances.size());
+
+        bool moved = false;
+
         for (int i = 0; i < m_instances.size(); i++)
         {
             auto& instance = m_instances[i];
 
-            instance.transform = glm::translate(glm::mat4(1.0f), instance.position);
+            glm::mat4 transform = glm::translate(glm::mat4(1.0f), instance.position);
 
             if (instance.animate)
-                instance.transform = instance.transform * glm::rotate(glm::mat4(1.0f), glm::radians(float(glfwGetTime()) * 10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+                transform = transform * glm::rotate(glm::mat4(1.0f), glm::radians(float(glfwGetTime()) * 10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
             else
-                instance.transform = instance.transform * glm::rotate(glm::mat4(1.0f), glm::radians(instance.rotation), glm::vec3(0.0f, 1.0f, 0.0f));
+                transform = transform * glm::rotate(glm::mat4(1.0f), glm::radians(instance.rotation), glm::vec3(0.0f, 1.0f, 0.0f));
+
+            // Only instances that moved, or were just added, are uploaded again.
+            if (transform == instance.transform && !m_instance_table.is_dirty(i))
+                continue;
+
+            instance.transform = transform;
+            moved              = true;
 
-            m_instance_uniforms[i].inverse_transform = glm::inverse(instance.transform);
-            m_instance_uniforms[i].ws_center         = instance.transform * m_instance_uniforms[i].os_center;
+            m_clipmap_changed.push_back(i);
+
+            InstanceUniforms& uniform = m_instance_table.modify(i);
+
+            uniform.inverse_transform = glm::inverse(instance.transform);
+            uniform.ws_center         = instance.transform * uniform.os_center;
 
             glm::vec3 axis[] = {
                 glm::vec3(1.0f, 0.0f, 0.0f),
@@ -554,8 +1280,89 @@ private:
             };
 
             for (int j = 0; j < 3; j++)
-                m_instance_uniforms[i].ws_axis[j] = glm::vec4(glm::mat3(instance.transform) * axis[j], 0.0f);
+                uniform.ws_axis[j] = glm::vec4(glm::mat3(instance.transform) * axis[j], 0.0f);
+
+            InstanceBox& box = m_instance_boxes[i];
+
+            box.center       = glm::vec3(uniform.ws_center);
+            box.half_extents = glm::vec3(uniform.half_extents);
+
+            for (int j = 0; j < 3; j++)
+                box.axis[j] = glm::vec3(uniform.ws_axis[j]);
+        }
+
+        // The tree only changes shape when instances are added, otherwise the moved boxes are refitted.
+        if (m_instance_bvh.num_instances() != m_instance_boxes.size())
+        {
+            m_instance_bvh.build(m_instance_boxes);
+            m_instance_bvh_dirty = true;
+        }
+        else if (moved)
+        {
+            m_instance_bvh.refit(m_instance_boxes);
+            m_instance_bvh_dirty = true;
         }
+
+        update_clipmap(camera);
+        update_shadow_tiles();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Instance lists of the screen tiles for the spotlight's shadow rays. Everything that can receive a shadow is an instance or
+    // the ground.
+    void update_shadow_tiles()
+    {
+        if (!m_use_shadow_tiles)
+            return;
+
+        glm::vec3 receiver_min = m_ground->min_extents();
+        glm::vec3 receiver_max = m_ground->max_extents();
+
+        for (const auto& box : m_instance_boxes)
+        {
+            glm::vec3 min_extents, max_extents;
+            instance_box_extents(box, min_extents, max_extents);
+
+            receiver_min = glm::min(receiver_min, min_extents);
+            receiver_max = glm::max(receiver_max, max_extents);
+        }
+
+        ShadowLight light;
+
+        light.position       = m_light_pos;
+        light.direction      = glm::normalize(glm::vec3(0.0f, m_light_pitch, -1.0f));
+        light.outer_cutoff   = cosf(glm::radians(m_light_outer_cutoff));
+        light.range          = m_light_range;
+        light.soft_shadows_k = m_soft_shadows ? m_soft_shadows_k : 0.0f;
+
+        build_shadow_tiles(m_instance_boxes, m_instance_bvh, m_global_uniforms.view_proj, m_width, m_height, receiver_min, receiver_max, light, m_shadow_tiles, ShadowCullSettings(), &m_shadow_stats);
+
+        m_profiler.add_time("shadow_tiles", m_shadow_stats.ms);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Recomposes the parts of the clipmap that the camera scrolled into, and the band around every instance that moved or got a
+    // new volume. Instances without a volume have nothing to compose, so until every instance has one the clipmap waits and
+    // keeps collecting the changes, and the shader evaluates the instances.
+    void update_clipmap(dw::Camera* camera)
+    {
+        std::vector<SDFInstance> sdf_instances(m_instances.size());
+
+        for (uint32_t i = 0; i < m_instances.size(); i++)
+        {
+            const SharedSDF& shared = m_sdf_textures[m_instances[i].sdf_idx];
+
+            if (shared.state == SDFState::BOUNDS)
+                return;
+
+            sdf_instances[i] = make_sdf_instance(&shared.volume, m_instances[i].transform);
+        }
+
+        m_clipmap.update(sdf_instances, m_clipmap_changed, camera->m_position, &m_clipmap_stats);
+        m_clipmap_changed.clear();
+        m_clipmap_ready = true;
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
@@ -601,16 +1408,66 @@ private:
     dw::gl::Program::Ptr m_mesh_program;
     dw::gl::Program::Ptr m_bake_sdf_program;
     dw::gl::Buffer::Ptr  m_global_ubo;
-    dw::gl::Buffer::Ptr  m_instance_ubo;
-    dw::gl::Buffer::Ptr  m_sdf_ubo;
+    dw::gl::Buffer::Ptr  m_instance_ssbo;
+    dw::gl::Buffer::Ptr  m_sdf_ssbo;
+    dw::gl::Buffer::Ptr  m_instance_bvh_ssbo;
+    dw::gl::Buffer::Ptr  m_clipmap_ssbo;
+    dw::gl::Buffer::Ptr  m_shadow_ranges_ssbo;
+    dw::gl::Buffer::Ptr  m_shadow_instances_ssbo;
 
     std::vector<Instance>       m_instances;
     dw::Mesh::Ptr               m_ground;
     std::unique_ptr<dw::Camera> m_main_camera;
 
-    GlobalUniforms                m_global_uniforms;
-    std::vector<InstanceUniforms> m_instance_uniforms;
-    std::vector<uint64_t>         m_texture_uniforms;
+    GlobalUniforms                  m_global_uniforms;
+    InstanceTable<InstanceUniforms> m_instance_table;
+    InstanceTable<uint64_t>         m_sdf_table; // Bindless handle of every atlas page.
+    std::vector<InstanceBox>        m_instance_boxes;
+    InstanceBVH                     m_instance_bvh;
+    size_t                          m_instance_bvh_capacity = 0;
+    bool                            m_instance_bvh_dirty    = false;
+    size_t                          m_upload_bytes          = 0; // Bytes written to the storage buffers this frame.
+
+    // Scene SDF clipmap around the camera.
+    SDFClipmap                          m_clipmap;
+    std::vector<dw::gl::Texture3D::Ptr> m_clipmap_textures;
+    std::vector<ClipmapLevelUniforms>   m_clipmap_levels;
+    std::vector<uint32_t>               m_clipmap_changed; // Instances changed since the last clipmap update.
+    SDFClipmapUpdateStats               m_clipmap_stats;
+    bool                                m_clipmap_ready = false; // Set by the first update, once every instance has a volume.
+
+    // Instances each screen tile's shadow rays can reach.
+    ShadowTiles     m_shadow_tiles;
+    ShadowCullStats m_shadow_stats;
+    size_t          m_shadow_ranges_capacity    = 0;
+    size_t          m_shadow_instances_capacity = 0;
+
+    // Baked volumes, one per unique mesh and bake settings.
+    struct SharedSDF
+    {
+        uint64_t                         key;
+        SDFAtlasSlot                     slot;    // Invalid while the state is BOUNDS.
+        SDFVolume                        volume;  // Decoded level 0, which the clipmap is composed from.
+        std::shared_ptr<const MappedSDF> data;
+        SDFGrid                          grid;
+        glm::vec2                        range;
+        uint32_t                         num_levels;
+        float                            padding; // Distance between the mesh bounds and the box of the full bake.
+        SDFState                         state;
+        size_t                           texture_bytes = 0;
+    };
+
+    SDFCache                               m_sdf_cache;
+    std::vector<SharedSDF>                 m_sdf_textures;
+    SDFAtlasPacker                         m_atlas_packer;
+    std::vector<dw::gl::Texture3D::Ptr>    m_atlas_pages;
+    std::vector<glm::ivec3>                m_atlas_page_sizes;
+    std::unordered_map<uint64_t, uint32_t> m_sdf_lookup;
+    std::unique_ptr<AsyncBaker>            m_async_baker; // Declared after the cache it writes to, so it is destroyed first.
+
+    // Startup timing.
+    std::chrono::high_resolution_clock::time_point m_start_time;
+    double                                         m_first_frame_ms = -1.0;
 
     // Camera controls.
     bool  m_mouse_look         = false;
@@ -641,8 +1498,21 @@ private:
     float m_t_min               = 0.2f;
     float m_t_max               = 100.0f;
     bool  m_soft_shadows        = true;
+    bool  m_sdf_mips            = true;
+    bool  m_use_instance_bvh    = true;
+    bool  m_use_clipmap         = true;
+    bool  m_use_shadow_tiles    = true;
     float m_soft_shadows_k      = 5.7f;
     bool  m_draw_bounding_boxes = false;
+    bool  m_cpu_bake            = false;
+    bool  m_sync_bake           = false;
+
+    SDFEncoding m_sdf_encoding  = SDFEncoding::FLOAT32;
+    float       m_sdf_budget_mb = 0.0f; // 0 = every volume at SDF_GRID_STEP_SIZE.
+
+    // Profile
+    Profiler    m_profiler;
+    std::string m_profile_path; // Written at shutdown with --profile.
 };
 
 DW_DECLARE_MAIN(SDFBaking)
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include "mapped_file.h"
+#include <algorithm>
+
+#if defined(_WIN32)
+#    define WIN32_LEAN_AND_MEAN
+#    define NOMINMAX
+#    include <windows.h>
+#    include <direct.h>
+#    include <sys/stat.h>
+#else
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <fcntl.h>
+#    include <unistd.h>
+#    include <errno.h>
+#    include <dirent.h>
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (!data)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    m_file    = file;
+    m_mapping = mapping;
+    m_data    = static_cast<const uint8_t*>(data);
+    m_size    = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping keeps its own reference to the file.
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+        return false;
+
+    m_data = static_cast<const uint8_t*>(data);
+    m_size = static_cast<size_t>(st.st_size);
+#endif
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void MappedFile::close()
+{
+    if (!m_data)
+        return;
+
+#if defined(_WIN32)
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+
+    m_file    = nullptr;
+    m_mapping = nullptr;
+#else
+    munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool file_exists(const std::string& path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool create_directory(const std::string& path)
+{
+#if defined(_WIN32)
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+
+    return file_exists(path);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::vector<std::string> list_files(const std::string& directory, const std::string& extension)
+{
+    std::vector<std::string> files;
+
+    auto matches = [&](const std::string& name) {
+        return name.size() > extension.size() && name.compare(name.size() - extension.size(), extension.size(), extension) == 0;
+    };
+
+#if defined(_WIN32)
+    WIN32_FIND_DATAA entry;
+    HANDLE           find = FindFirstFileA((directory + "/*").c_str(), &entry);
+
+    if (find == INVALID_HANDLE_VALUE)
+        return files;
+
+    do
+    {
+        if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && matches(entry.cFileName))
+            files.push_back(directory + "/" + entry.cFileName);
+    } while (FindNextFileA(find, &entry));
+
+    FindClose(find);
+#else
+    DIR* dir = opendir(directory.c_str());
+
+    if (!dir)
+        return files;
+
+    while (dirent* entry = readdir(dir))
+    {
+        std::string path = directory + "/" + entry->d_name;
+        struct stat st;
+
+        if (matches(entry->d_name) && stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+            files.push_back(path);
+    }
+
+    closedir(dir);
+#endif
+
+    std::sort(files.begin(), files.end());
+
+    return files;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
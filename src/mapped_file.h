@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+// Read-only memory mapping of a whole file.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    inline const uint8_t* data() const { return m_data; }
+    inline size_t         size() const { return m_size; }
+    inline bool           is_open() const { return m_data != nullptr; }
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t         m_size = 0;
+#if defined(_WIN32)
+    void* m_file    = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
+
+bool file_exists(const std::string& path);
+
+// Creates a single directory. Returns true if it exists afterwards.
+bool create_directory(const std::string& path);
+
+// Regular files in a directory whose name ends in extension (e.g. ".obj"), as sorted directory/name paths. Not recursive.
+std::vector<std::string> list_files(const std::string& directory, const std::string& extension);
@@ -0,0 +1,339 @@
+#include "mesh_preprocess.h"
+#include "parallel.h"
+#include "profiler.h"
+
+#include <chrono>
+
+// Cells of the weld grid per axis, so a cell coordinate fits in 21 bits of a key.
+#define WELD_GRID_CELLS (1 << 21)
+
+// Three vertices of a triangle rotated so the smallest comes first, which keeps the winding. Ties go to the lower triangle.
+struct TriangleKey
+{
+    uint32_t v[3];
+    uint32_t triangle;
+
+    inline bool operator<(const TriangleKey& other) const
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            if (v[i] != other.v[i])
+                return v[i] < other.v[i];
+        }
+
+        return triangle < other.triangle;
+    }
+
+    inline bool same_vertices(const TriangleKey& other) const { return v[0] == other.v[0] && v[1] == other.v[1] && v[2] == other.v[2]; }
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static inline float dot2(const glm::vec3& v) { return glm::dot(v, v); }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// The low 21 bits of v spread out to every third bit.
+static uint64_t expand_bits(uint64_t v)
+{
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffull;
+    v = (v | v << 16) & 0x1f0000ff0000ffull;
+    v = (v | v << 8) & 0x100f00f00f00f00full;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+    v = (v | v << 2) & 0x1249249249249249ull;
+
+    return v;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint64_t morton_code(const glm::vec3& p, const glm::vec3& min_extents, const glm::vec3& max_extents)
+{
+    glm::vec3  uvw  = (p - min_extents) / glm::max(max_extents - min_extents, glm::vec3(1e-20f));
+    glm::ivec3 cell = glm::clamp(glm::ivec3(uvw * float(WELD_GRID_CELLS)), glm::ivec3(0), glm::ivec3(WELD_GRID_CELLS - 1));
+
+    return expand_bits(uint64_t(cell.x)) | (expand_bits(uint64_t(cell.y)) << 1) | (expand_bits(uint64_t(cell.z)) << 2);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static inline uint64_t cell_key(const glm::ivec3& cell)
+{
+    return uint64_t(cell.x) | (uint64_t(cell.y) << 21) | (uint64_t(cell.z) << 42);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Maps every referenced vertex to the first vertex of its cluster, vertices that are chained together by distances within
+// tolerance and, with match_normals, equal normals. Unreferenced vertices map to themselves.
+static std::vector<uint32_t> weld_vertices(const SDFMesh& mesh, const std::vector<bool>& used, float tolerance, bool match_normals, uint32_t num_threads)
+{
+    const uint32_t num_vertices = static_cast<uint32_t>(mesh.positions.size());
+
+    glm::vec3 min_extents, max_extents;
+
+    compute_extents(mesh, min_extents, max_extents);
+
+    // Cells a few times the tolerance, so the box of points within it around a vertex is usually inside the vertex's own cell.
+    glm::vec3 size      = max_extents - min_extents;
+    float     cell_size = std::max(4.0f * tolerance, std::max(size.x, std::max(size.y, size.z)) / float(WELD_GRID_CELLS - 1));
+
+    // A mesh without extent still needs cells to compare normals in; any size puts every vertex into the same one.
+    if (cell_size <= 0.0f && match_normals)
+        cell_size = 1.0f;
+
+    std::vector<uint32_t> remap(num_vertices);
+
+    if (cell_size <= 0.0f)
+    {
+        // Every vertex at the same position.
+        uint32_t first = UINT32_MAX;
+
+        for (uint32_t i = 0; i < num_vertices; i++)
+        {
+            if (used[i] && first == UINT32_MAX)
+                first = i;
+
+            remap[i] = used[i] ? first : i;
+        }
+
+        return remap;
+    }
+
+    auto cell_of = [&](const glm::vec3& p) { return glm::clamp(glm::ivec3((p - min_extents) / cell_size), glm::ivec3(0), glm::ivec3(WELD_GRID_CELLS - 1)); };
+
+    std::vector<std::pair<uint64_t, uint32_t>> cells(num_vertices);
+
+    parallel_for(num_vertices, num_threads, [&](uint32_t i) { cells[i] = std::make_pair(used[i] ? cell_key(cell_of(mesh.positions[i])) : UINT64_MAX, i); }, 1024);
+
+    parallel_sort(cells, num_threads);
+
+    const float tolerance_sq = tolerance * tolerance;
+
+    // The first vertex within the tolerance of each one, which may be itself.
+    parallel_for(num_vertices, num_threads, [&](uint32_t i) {
+        remap[i] = i;
+
+        if (!used[i])
+            return;
+
+        const glm::vec3  p     = mesh.positions[i];
+        const glm::ivec3 first = cell_of(p - glm::vec3(tolerance));
+        const glm::ivec3 last  = cell_of(p + glm::vec3(tolerance));
+
+        for (int z = first.z; z <= last.z; z++)
+        {
+            for (int y = first.y; y <= last.y; y++)
+            {
+                for (int x = first.x; x <= last.x; x++)
+                {
+                    uint64_t key = cell_key(glm::ivec3(x, y, z));
+
+                    // Vertices of a cell are sorted by index, so the search stops at i.
+                    for (auto it = std::lower_bound(cells.begin(), cells.end(), std::make_pair(key, 0u)); it != cells.end() && it->first == key && it->second < remap[i]; ++it)
+                    {
+                        glm::vec3 d = mesh.positions[it->second] - p;
+
+                        if (glm::dot(d, d) <= tolerance_sq && (!match_normals || mesh.normals[it->second] == mesh.normals[i]))
+                        {
+                            remap[i] = it->second;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }, 1024);
+
+    // Every vertex maps to a lower one, so one pass in order resolves the chains.
+    for (uint32_t i = 0; i < num_vertices; i++)
+        remap[i] = remap[remap[i]];
+
+    return remap;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool is_degenerate(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    float longest_sq = std::max(dot2(b - a), std::max(dot2(c - b), dot2(a - c)));
+
+    return glm::length(glm::cross(b - a, c - a)) <= MESH_DEGENERATE_RATIO * longest_sq;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void preprocess_mesh(SDFMesh& mesh, const MeshPreprocessSettings& settings, MeshPreprocessStats* stats)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    const uint32_t num_vertices  = static_cast<uint32_t>(mesh.positions.size());
+    const uint32_t num_triangles = mesh.num_triangles();
+
+    MeshPreprocessStats local_stats;
+
+    local_stats.input_vertices  = num_vertices;
+    local_stats.input_triangles = num_triangles;
+
+    std::vector<bool> used(num_vertices, false);
+
+    for (uint32_t index : mesh.indices)
+        used[index] = true;
+
+    glm::vec3 min_extents, max_extents;
+
+    compute_extents(mesh, min_extents, max_extents);
+
+    // Meshes without normals get them computed either way.
+    const bool keep_normals = settings.keep_normals && mesh.normals.size() == mesh.positions.size();
+
+    std::vector<uint32_t> remap = weld_vertices(mesh, used, settings.weld_tolerance * glm::length(max_extents - min_extents), keep_normals, settings.num_threads);
+
+    for (uint32_t i = 0; i < num_vertices; i++)
+    {
+        if (used[i] && remap[i] != i)
+            local_stats.welded_vertices++;
+    }
+
+    // Welded indices, with the triangles that keep their area marked.
+    std::vector<uint32_t> indices(mesh.indices.size());
+    std::vector<uint8_t>  keep(num_triangles);
+
+    parallel_for(num_triangles, settings.num_threads, [&](uint32_t i) {
+        uint32_t a = remap[mesh.indices[3 * i]];
+        uint32_t b = remap[mesh.indices[3 * i + 1]];
+        uint32_t c = remap[mesh.indices[3 * i + 2]];
+
+        indices[3 * i]     = a;
+        indices[3 * i + 1] = b;
+        indices[3 * i + 2] = c;
+
+        keep[i] = a != b && b != c && c != a && !is_degenerate(mesh.positions[a], mesh.positions[b], mesh.positions[c]);
+    }, 1024);
+
+    std::vector<TriangleKey> keys;
+
+    for (uint32_t i = 0; i < num_triangles; i++)
+    {
+        if (!keep[i])
+        {
+            local_stats.degenerate_triangles++;
+            continue;
+        }
+
+        const uint32_t* v     = &indices[3 * i];
+        uint32_t        first = v[0] < v[1] ? (v[0] < v[2] ? 0 : 2) : (v[1] < v[2] ? 1 : 2);
+
+        keys.push_back({ { v[first], v[(first + 1) % 3], v[(first + 2) % 3] }, i });
+    }
+
+    parallel_sort(keys, settings.num_threads);
+
+    for (size_t i = 1; i < keys.size(); i++)
+    {
+        if (keys[i].same_vertices(keys[i - 1]))
+        {
+            keep[keys[i].triangle] = 0;
+            local_stats.duplicate_triangles++;
+        }
+    }
+
+    // Order of the remaining triangles.
+    std::vector<uint32_t> order;
+
+    order.reserve(num_triangles - local_stats.removed_triangles());
+
+    for (uint32_t i = 0; i < num_triangles; i++)
+    {
+        if (keep[i])
+            order.push_back(i);
+    }
+
+    if (settings.reorder)
+    {
+        std::vector<std::pair<uint64_t, uint32_t>> codes(order.size());
+
+        parallel_for(static_cast<uint32_t>(order.size()), settings.num_threads, [&](uint32_t i) {
+            uint32_t  t        = order[i];
+            glm::vec3 centroid = (mesh.positions[indices[3 * t]] + mesh.positions[indices[3 * t + 1]] + mesh.positions[indices[3 * t + 2]]) / 3.0f;
+
+            codes[i] = std::make_pair(morton_code(centroid, min_extents, max_extents), t);
+        }, 1024);
+
+        parallel_sort(codes, settings.num_threads);
+
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = codes[i].second;
+    }
+
+    // Vertices numbered in the order the triangles first use them after reordering, or in their old order otherwise.
+    std::vector<uint32_t> new_index(num_vertices, UINT32_MAX);
+    uint32_t              num_used = 0;
+
+    if (settings.reorder)
+    {
+        for (uint32_t t : order)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                uint32_t& index = new_index[indices[3 * t + j]];
+
+                if (index == UINT32_MAX)
+                    index = num_used++;
+            }
+        }
+    }
+    else
+    {
+        used.assign(num_vertices, false);
+
+        for (uint32_t t : order)
+        {
+            for (int j = 0; j < 3; j++)
+                used[indices[3 * t + j]] = true;
+        }
+
+        for (uint32_t i = 0; i < num_vertices; i++)
+        {
+            if (used[i])
+                new_index[i] = num_used++;
+        }
+    }
+
+    std::vector<glm::vec3> positions(num_used);
+    std::vector<glm::vec3> normals(keep_normals ? num_used : 0);
+
+    for (uint32_t i = 0; i < num_vertices; i++)
+    {
+        if (new_index[i] != UINT32_MAX)
+        {
+            positions[new_index[i]] = mesh.positions[i];
+
+            if (keep_normals)
+                normals[new_index[i]] = mesh.normals[i];
+        }
+    }
+
+    mesh.indices.resize(order.size() * 3);
+
+    parallel_for(static_cast<uint32_t>(order.size()), settings.num_threads, [&](uint32_t i) {
+        for (int j = 0; j < 3; j++)
+            mesh.indices[3 * i + j] = new_index[indices[3 * order[i] + j]];
+    }, 1024);
+
+    mesh.positions = std::move(positions);
+
+    if (keep_normals)
+        mesh.normals = std::move(normals);
+    else
+        compute_vertex_normals(mesh);
+
+    local_stats.unused_vertices = num_vertices - local_stats.welded_vertices - num_used;
+    local_stats.ms              = elapsed_ms(start);
+
+    if (stats)
+        *stats = local_stats;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
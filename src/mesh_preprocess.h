@@ -0,0 +1,40 @@
+#pragma once
+
+#include "sdf_baker.h"
+
+// A triangle is degenerate when twice its area is below this fraction of its longest edge squared, flat enough that the face
+// normal in sdf_triangle() is mostly rounding error.
+#define MESH_DEGENERATE_RATIO 1e-6f
+
+struct MeshPreprocessSettings
+{
+    float    weld_tolerance = 1e-6f; // Vertices closer than this fraction of the bounding box diagonal are merged. 0 = exact only.
+    bool     reorder        = true;  // Sort triangles along a Morton curve through their centroids.
+    bool     keep_normals   = false; // Keep the input normals and only weld vertices whose normals are equal too. For NORMALS signs.
+    uint32_t num_threads    = 0;     // 0 = use all cores.
+};
+
+struct MeshPreprocessStats
+{
+    uint32_t input_vertices       = 0;
+    uint32_t input_triangles      = 0;
+    uint32_t welded_vertices      = 0; // Merged into an earlier vertex within the tolerance.
+    uint32_t unused_vertices      = 0; // Dropped because no remaining triangle refers to them.
+    uint32_t degenerate_triangles = 0; // Repeated vertices after welding, or no area.
+    uint32_t duplicate_triangles  = 0; // Same vertices in the same winding as an earlier triangle.
+    double   ms                   = 0.0;
+
+    inline uint32_t removed_triangles() const { return degenerate_triangles + duplicate_triangles; }
+};
+
+// Cleans a mesh up for baking. Vertices within the weld tolerance of an earlier one are merged into it, then triangles that
+// are degenerate or repeat an earlier one are removed; triangles with the same vertices in the opposite winding are kept, they
+// are the two sides of a sheet. With settings.reorder the remaining triangles are sorted along a Morton curve through their
+// centroids and vertices are renumbered in the order the triangles first use them, so spatially close triangles are close in
+// memory. Vertex normals are recomputed with compute_vertex_normals(), unless settings.keep_normals is set: then vertices that
+// only share a position, like the two sides of a hard edge, stay apart and keep their normals. The surface stays the same up to
+// the weld tolerance, and with keep_normals so do the normals the NORMALS sign mode reads.
+void preprocess_mesh(SDFMesh& mesh, const MeshPreprocessSettings& settings = MeshPreprocessSettings(), MeshPreprocessStats* stats = nullptr);
+
+// Morton code of p inside the box, 21 bits per axis interleaved as ...zyxzyx.
+uint64_t morton_code(const glm::vec3& p, const glm::vec3& min_extents, const glm::vec3& max_extents);
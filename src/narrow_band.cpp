@@ -0,0 +1,189 @@
+#include "narrow_band.h"
+#include "parallel.h"
+
+#include <stddef.h>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void mark_narrow_band(const SDFGrid& grid, const SDFMesh& mesh, float radius, uint32_t num_threads, std::vector<uint8_t>& mask)
+{
+    mask.assign(grid.num_voxels(), 0);
+
+    uint32_t num_triangles = mesh.num_triangles();
+
+    std::vector<glm::ivec3>            voxel_min(num_triangles);
+    std::vector<glm::ivec3>            voxel_max(num_triangles);
+    std::vector<std::vector<uint32_t>> slices(grid.volume_size.z);
+
+    // Voxel range covered by each dilated triangle box, bucketed by z slice so slices can be marked in parallel.
+    for (uint32_t i = 0; i < num_triangles; i++)
+    {
+        const glm::vec3& a = mesh.positions[mesh.indices[3 * i]];
+        const glm::vec3& b = mesh.positions[mesh.indices[3 * i + 1]];
+        const glm::vec3& c = mesh.positions[mesh.indices[3 * i + 2]];
+
+        glm::vec3 lo = (glm::min(glm::min(a, b), c) - glm::vec3(radius) - grid.grid_origin) / grid.grid_step_size;
+        glm::vec3 hi = (glm::max(glm::max(a, b), c) + glm::vec3(radius) - grid.grid_origin) / grid.grid_step_size;
+
+        voxel_min[i] = glm::max(glm::ivec3(glm::ceil(lo)), glm::ivec3(0));
+        voxel_max[i] = glm::min(glm::ivec3(glm::floor(hi)), grid.volume_size - glm::ivec3(1));
+
+        for (int z = voxel_min[i].z; z <= voxel_max[i].z; z++)
+            slices[z].push_back(i);
+    }
+
+    parallel_for(static_cast<uint32_t>(grid.volume_size.z), num_threads, [&](uint32_t z) {
+        for (uint32_t i : slices[z])
+        {
+            for (int y = voxel_min[i].y; y <= voxel_max[i].y; y++)
+            {
+                size_t row = grid.index(0, y, z);
+
+                for (int x = voxel_min[i].x; x <= voxel_max[i].x; x++)
+                    mask[row + x] = 1;
+            }
+        }
+    });
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void fill_far_field(SDFVolume& volume, const std::vector<uint8_t>& mask, float band_radius)
+{
+    const glm::ivec3 size = volume.volume_size;
+    const float      h    = volume.grid_step_size;
+
+    // Unsigned distances to propagate, with the sign kept on the side.
+    std::vector<float>   distance(volume.num_voxels());
+    std::vector<uint8_t> inside(volume.num_voxels());
+
+    for (size_t i = 0; i < volume.num_voxels(); i++)
+    {
+        distance[i] = mask[i] ? fabsf(volume.distances[i]) : SDF_INFINITY;
+        inside[i]   = mask[i] ? volume.distances[i] < 0.0f : 0;
+    }
+
+    // The 13 neighbours that come before a voxel in x, y, z raster order. The backward sweep uses the mirrored offsets.
+    glm::ivec3 offsets[13];
+    ptrdiff_t  linear_offsets[13];
+    float      weights[13];
+    int        num_offsets = 0;
+
+    for (int dz = -1; dz <= 0; dz++)
+    {
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                if (dz == 0 && (dy > 0 || (dy == 0 && dx >= 0)))
+                    continue;
+
+                offsets[num_offsets]        = glm::ivec3(dx, dy, dz);
+                linear_offsets[num_offsets] = ptrdiff_t(dx) + ptrdiff_t(size.x) * (ptrdiff_t(dy) + ptrdiff_t(size.y) * ptrdiff_t(dz));
+                weights[num_offsets]        = h * sqrtf(float(dx * dx + dy * dy + dz * dz));
+                num_offsets++;
+            }
+        }
+    }
+
+    auto sweep = [&](int direction) {
+        bool changed = false;
+
+        int begin_z = direction > 0 ? 0 : size.z - 1;
+        int begin_y = direction > 0 ? 0 : size.y - 1;
+        int begin_x = direction > 0 ? 0 : size.x - 1;
+
+        for (int z = begin_z; z >= 0 && z < size.z; z += direction)
+        {
+            for (int y = begin_y; y >= 0 && y < size.y; y += direction)
+            {
+                bool interior_row = y > 0 && z > 0 && y < size.y - 1 && z < size.z - 1;
+
+                for (int x = begin_x; x >= 0 && x < size.x; x += direction)
+                {
+                    size_t idx = volume.index(x, y, z);
+
+                    if (mask[idx])
+                        continue;
+
+                    float   best        = distance[idx];
+                    uint8_t best_inside = inside[idx];
+
+                    if (interior_row && x > 0 && x < size.x - 1)
+                    {
+                        // All neighbours are inside the volume, skip the bounds checks.
+                        for (int i = 0; i < num_offsets; i++)
+                        {
+                            size_t n_idx     = idx + linear_offsets[i] * direction;
+                            float  candidate = distance[n_idx] + weights[i];
+
+                            if (candidate < best)
+                            {
+                                best        = candidate;
+                                best_inside = inside[n_idx];
+                            }
+                        }
+                    }
+                    else
+                    {
+                        for (int i = 0; i < num_offsets; i++)
+                        {
+                            int nx = x + offsets[i].x * direction;
+                            int ny = y + offsets[i].y * direction;
+                            int nz = z + offsets[i].z * direction;
+
+                            if (nx < 0 || ny < 0 || nz < 0 || nx >= size.x || ny >= size.y || nz >= size.z)
+                                continue;
+
+                            size_t n_idx     = volume.index(nx, ny, nz);
+                            float  candidate = distance[n_idx] + weights[i];
+
+                            if (candidate < best)
+                            {
+                                best        = candidate;
+                                best_inside = inside[n_idx];
+                            }
+                        }
+                    }
+
+                    if (best < distance[idx])
+                    {
+                        distance[idx] = best;
+                        inside[idx]   = best_inside;
+                        changed       = true;
+                    }
+                }
+            }
+        }
+
+        return changed;
+    };
+
+    // Two sweeps give the exact chamfer distance for most inputs. Keep going until nothing changes, so paths that have to turn
+    // back against the sweep order near the volume border are found too.
+    while (true)
+    {
+        bool changed = sweep(1);
+        changed      = sweep(-1) || changed;
+
+        if (!changed)
+            break;
+    }
+
+    // Every unmarked voxel is further than band_radius from the surface. The chamfer distance over-estimates the shortest path
+    // to the band by at most CHAMFER_26_MAX_RATIO, and using the band voxel closest to the surface point instead of the surface
+    // point itself adds at most one voxel diagonal.
+    const float diagonal = sqrtf(3.0f) * h;
+
+    for (size_t i = 0; i < volume.num_voxels(); i++)
+    {
+        if (mask[i])
+            continue;
+
+        float d = distance[i] < SDF_INFINITY ? std::max(band_radius, distance[i] / CHAMFER_26_MAX_RATIO - diagonal) : SDF_INFINITY;
+
+        volume.distances[i] = inside[i] ? -d : d;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "sdf_baker.h"
+
+// Worst case ratio between the 26-neighbour chamfer distance (steps of 1, sqrt(2) and sqrt(3) voxels) and the Euclidean
+// distance. Dividing a chamfer distance by this gives a value that is never larger than the Euclidean distance.
+#define CHAMFER_26_MAX_RATIO 1.1285f
+
+// Marks every voxel whose centre lies within radius of a triangle's bounding box. This is a superset of the voxels that are
+// within radius of the surface, so unmarked voxels are guaranteed to be further than radius away.
+void mark_narrow_band(const SDFGrid& grid, const SDFMesh& mesh, float radius, uint32_t num_threads, std::vector<uint8_t>& mask);
+
+// Fills every voxel that isn't set in mask from the exact values in the band by sweeping a 26-neighbour chamfer distance
+// outwards, and carries the sign of the voxel each distance came from. The unmarked voxels must be further than band_radius
+// from the surface, and the band must be at least one voxel wide. The filled values never overestimate the true distance.
+void fill_far_field(SDFVolume& volume, const std::vector<uint8_t>& mask, float band_radius);
@@ -0,0 +1,372 @@
+#include "obj_loader.h"
+#include "mapped_file.h"
+#include "parallel.h"
+
+#include <string.h>
+
+// Positions and triangles of one chunk. Positive face indices are absolute and stored directly, negative ones are relative to
+// the vertices before the face and can only be resolved once the vertex counts of the earlier chunks are known.
+struct ObjChunk
+{
+    const char*            begin;
+    const char*            end;
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t>  indices;
+    std::vector<uint32_t>  relative_slots;   // Elements of indices that hold a relative index.
+    std::vector<int64_t>   relative_indices; // Index into the chunk's own vertices of each of them, negative for earlier chunks.
+    bool                   valid = true;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static inline bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static inline const char* skip_space(const char* it, const char* end)
+{
+    while (it < end && is_space(*it))
+        it++;
+
+    return it;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static inline const char* skip_line(const char* it, const char* end)
+{
+    const char* newline = static_cast<const char*>(memchr(it, '\n', static_cast<size_t>(end - it)));
+
+    return newline ? newline + 1 : end;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Decimal float without a locale or a terminating zero. Mantissas of up to 19 digits are exact before the final scaling, which
+// covers anything an exporter writes.
+static const char* parse_float(const char* it, const char* end, float& value)
+{
+    static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    bool negative = false;
+
+    if (it < end && (*it == '-' || *it == '+'))
+        negative = *it++ == '-';
+
+    uint64_t mantissa = 0;
+    int      exponent = 0;
+    int      digits   = 0;
+
+    for (; it < end && *it >= '0' && *it <= '9'; it++)
+    {
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + uint64_t(*it - '0');
+            digits += mantissa > 0;
+        }
+        else
+            exponent++;
+    }
+
+    if (it < end && *it == '.')
+    {
+        for (it++; it < end && *it >= '0' && *it <= '9'; it++)
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + uint64_t(*it - '0');
+                digits += mantissa > 0;
+                exponent--;
+            }
+        }
+    }
+
+    if (it < end && (*it == 'e' || *it == 'E'))
+    {
+        bool exponent_negative = false;
+        int  e                 = 0;
+
+        it++;
+
+        if (it < end && (*it == '-' || *it == '+'))
+            exponent_negative = *it++ == '-';
+
+        for (; it < end && *it >= '0' && *it <= '9'; it++)
+            e = std::min(e * 10 + (*it - '0'), 1000);
+
+        exponent += exponent_negative ? -e : e;
+    }
+
+    double v = double(mantissa);
+
+    while (exponent > 22)
+    {
+        v *= 1e22;
+        exponent -= 22;
+    }
+
+    while (exponent < -22)
+    {
+        v /= 1e22;
+        exponent += 22;
+    }
+
+    v = exponent >= 0 ? v * powers[exponent] : v / powers[-exponent];
+
+    value = static_cast<float>(negative ? -v : v);
+
+    return it;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void parse_chunk(ObjChunk& chunk)
+{
+    const char* end = chunk.end;
+
+    // Vertex references of the current polygon.
+    std::vector<int64_t> polygon;
+
+    for (const char* it = chunk.begin; it < end;)
+    {
+        it = skip_space(it, end);
+
+        if (it + 1 < end && it[0] == 'v' && is_space(it[1]))
+        {
+            glm::vec3 p;
+
+            it = parse_float(skip_space(it + 2, end), end, p.x);
+            it = parse_float(skip_space(it, end), end, p.y);
+            it = parse_float(skip_space(it, end), end, p.z);
+
+            chunk.positions.push_back(p);
+        }
+        else if (it + 1 < end && it[0] == 'f' && is_space(it[1]))
+        {
+            polygon.clear();
+
+            for (it = skip_space(it + 2, end); it < end && *it != '\n'; it = skip_space(it, end))
+            {
+                bool    negative = *it == '-';
+                int64_t index    = 0;
+
+                if (negative || *it == '+')
+                    it++;
+
+                for (; it < end && *it >= '0' && *it <= '9'; it++)
+                    index = index * 10 + (*it - '0');
+
+                // Skip the texture coordinate and normal indices.
+                while (it < end && !is_space(*it) && *it != '\n')
+                    it++;
+
+                if (index == 0)
+                {
+                    chunk.valid = false;
+                    continue;
+                }
+
+                polygon.push_back(negative ? -index : index);
+            }
+
+            for (size_t i = 2; i < polygon.size(); i++)
+            {
+                int64_t corners[3] = { polygon[0], polygon[i - 1], polygon[i] };
+
+                for (int64_t corner : corners)
+                {
+                    if (corner > 0)
+                        chunk.indices.push_back(static_cast<uint32_t>(corner - 1));
+                    else
+                    {
+                        chunk.relative_slots.push_back(static_cast<uint32_t>(chunk.indices.size()));
+                        chunk.relative_indices.push_back(int64_t(chunk.positions.size()) + corner);
+                        chunk.indices.push_back(0);
+                    }
+                }
+            }
+        }
+
+        it = skip_line(it, end);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static inline uint32_t hash_position(const glm::vec3& p)
+{
+    uint32_t bits[3];
+
+    memcpy(bits, &p, sizeof(bits));
+
+    uint32_t h = bits[0] * 0x9E3779B1u;
+
+    h = (h ^ (h >> 15) ^ bits[1]) * 0x85EBCA77u;
+    h = (h ^ (h >> 13) ^ bits[2]) * 0xC2B2AE3Du;
+
+    return h ^ (h >> 16);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool parse_obj(const char* data, size_t size, SDFMesh& mesh, uint32_t num_threads, ObjLoadStats* stats)
+{
+    const char* end = data + size;
+
+    // Split at the first line break after every OBJ_CHUNK_SIZE bytes.
+    std::vector<ObjChunk> chunks;
+
+    for (const char* begin = data; begin < end;)
+    {
+        const char* chunk_end = end - begin > OBJ_CHUNK_SIZE ? skip_line(begin + OBJ_CHUNK_SIZE, end) : end;
+
+        chunks.push_back(ObjChunk());
+        chunks.back().begin = begin;
+        chunks.back().end   = chunk_end;
+
+        begin = chunk_end;
+    }
+
+    parallel_for(static_cast<uint32_t>(chunks.size()), num_threads, [&](uint32_t i) { parse_chunk(chunks[i]); });
+
+    // Offsets of every chunk's vertices and indices in the whole file.
+    std::vector<size_t> vertex_offsets(chunks.size() + 1, 0);
+    std::vector<size_t> index_offsets(chunks.size() + 1, 0);
+
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        if (!chunks[i].valid)
+            return false;
+
+        vertex_offsets[i + 1] = vertex_offsets[i] + chunks[i].positions.size();
+        index_offsets[i + 1]  = index_offsets[i] + chunks[i].indices.size();
+    }
+
+    const size_t num_vertices = vertex_offsets.back();
+
+    if (num_vertices >= UINT32_MAX)
+        return false;
+
+    std::vector<glm::vec3> positions(num_vertices);
+
+    mesh.indices.resize(index_offsets.back());
+
+    std::atomic<bool> valid(true);
+
+    parallel_for(static_cast<uint32_t>(chunks.size()), num_threads, [&](uint32_t i) {
+        ObjChunk& chunk = chunks[i];
+
+        for (size_t j = 0; j < chunk.relative_slots.size(); j++)
+        {
+            int64_t index = int64_t(vertex_offsets[i]) + chunk.relative_indices[j];
+
+            if (index < 0)
+                valid = false;
+
+            chunk.indices[chunk.relative_slots[j]] = static_cast<uint32_t>(index);
+        }
+
+        for (uint32_t index : chunk.indices)
+        {
+            if (index >= num_vertices)
+                valid = false;
+        }
+
+        std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + vertex_offsets[i]);
+        std::copy(chunk.indices.begin(), chunk.indices.end(), mesh.indices.begin() + index_offsets[i]);
+
+        // Release the chunk's memory as soon as possible, large files have hundreds of them.
+        std::vector<glm::vec3>().swap(chunk.positions);
+        std::vector<uint32_t>().swap(chunk.indices);
+    });
+
+    if (!valid)
+        return false;
+
+    // Merge referenced vertices with identical positions, keeping the file order of the first occurrence. Unreferenced vertices
+    // would only widen the bounds, and so the volume.
+    std::vector<uint32_t> remap(num_vertices, UINT32_MAX);
+
+    for (uint32_t index : mesh.indices)
+        remap[index] = 0;
+
+    uint32_t table_size = 16;
+
+    while (table_size < 2 * num_vertices)
+        table_size *= 2;
+
+    std::vector<uint32_t> table(table_size, UINT32_MAX);
+
+    mesh.positions.clear();
+
+    uint32_t num_unused = 0;
+
+    for (uint32_t i = 0; i < num_vertices; i++)
+    {
+        if (remap[i] == UINT32_MAX)
+        {
+            num_unused++;
+            continue;
+        }
+
+        glm::vec3 p = positions[i] + glm::vec3(0.0f); // -0 and 0 are the same position.
+        uint32_t  h = hash_position(p) & (table_size - 1);
+
+        while (table[h] != UINT32_MAX && mesh.positions[table[h]] != p)
+            h = (h + 1) & (table_size - 1);
+
+        if (table[h] == UINT32_MAX)
+        {
+            table[h] = static_cast<uint32_t>(mesh.positions.size());
+            mesh.positions.push_back(p);
+        }
+
+        remap[i] = table[h];
+    }
+
+    parallel_for(static_cast<uint32_t>(chunks.size()), num_threads, [&](uint32_t i) {
+        for (size_t j = index_offsets[i]; j < index_offsets[i + 1]; j++)
+            mesh.indices[j] = remap[mesh.indices[j]];
+    });
+
+    compute_vertex_normals(mesh);
+
+    if (stats)
+    {
+        stats->file_bytes         = size;
+        stats->num_chunks         = static_cast<uint32_t>(chunks.size());
+        stats->vertices_read      = static_cast<uint32_t>(num_vertices);
+        stats->unused_vertices    = num_unused;
+        stats->duplicate_vertices = static_cast<uint32_t>(num_vertices) - num_unused - static_cast<uint32_t>(mesh.positions.size());
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool load_obj(const std::string& path, SDFMesh& mesh, uint32_t num_threads, ObjLoadStats* stats)
+{
+    MappedFile file;
+
+    if (!file.open(path))
+        return false;
+
+    return parse_obj(reinterpret_cast<const char*>(file.data()), file.size(), mesh, num_threads, stats);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::string mesh_name(const std::string& path)
+{
+    size_t slash = path.find_last_of("/\\");
+    size_t begin = slash == std::string::npos ? 0 : slash + 1;
+    size_t dot   = path.find_last_of('.');
+
+    return path.substr(begin, dot == std::string::npos || dot < begin ? std::string::npos : dot - begin);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
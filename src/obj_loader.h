@@ -0,0 +1,28 @@
+#pragma once
+
+#include "sdf_baker.h"
+#include <string>
+
+// Files are split into chunks of about this size (at line boundaries) that are parsed independently.
+#define OBJ_CHUNK_SIZE (1024 * 1024)
+
+struct ObjLoadStats
+{
+    size_t   file_bytes         = 0;
+    uint32_t num_chunks         = 0;
+    uint32_t vertices_read      = 0; // "v" lines in the file.
+    uint32_t duplicate_vertices = 0; // Referenced vertices that were merged into an earlier one with the same position.
+    uint32_t unused_vertices    = 0; // Vertices no face refers to, which are dropped.
+};
+
+// Parses the positions and faces of an OBJ file held in memory, on num_threads threads (0 = all cores). Everything else
+// (texture coordinates, normals, groups, materials) is skipped. Polygons are triangulated as fans. Vertices with identical
+// positions are merged and unreferenced ones dropped, so the mesh only holds what the baker reads. Vertex normals are
+// computed from the merged positions. Returns false if a face refers to a vertex that doesn't exist.
+bool parse_obj(const char* data, size_t size, SDFMesh& mesh, uint32_t num_threads = 0, ObjLoadStats* stats = nullptr);
+
+// Memory maps an OBJ file and parses it with parse_obj(). Doesn't need a GL context, unlike dw::Mesh::load().
+bool load_obj(const std::string& path, SDFMesh& mesh, uint32_t num_threads = 0, ObjLoadStats* stats = nullptr);
+
+// File name without directory and extension, which the tools name a mesh's outputs and profiler entries after.
+std::string mesh_name(const std::string& path);
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+#include "job_system.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+inline uint32_t resolve_thread_count(uint32_t num_threads)
+{
+    if (num_threads > 0)
+        return num_threads;
+
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Calls func(i) for every i in [0, count) across num_threads threads (0 = all cores). Items are handed out in small batches
+// from a shared counter so uneven rows do not leave threads idle. The calling thread takes part in the work. Inside a JobSystem
+// job the loop runs on that job's pool instead, and num_threads is ignored.
+template <typename Func>
+void parallel_for(uint32_t count, uint32_t num_threads, Func&& func, uint32_t batch_size = 1)
+{
+    if (JobSystem* job_system = JobSystem::current())
+    {
+        job_system->parallel_for(count, [&](uint32_t i) { func(i); }, batch_size);
+        return;
+    }
+
+    num_threads = std::min(resolve_thread_count(num_threads), std::max(1u, count));
+    batch_size  = std::max(1u, batch_size);
+
+    std::atomic<uint32_t> next(0);
+
+    auto worker = [&]() {
+        while (true)
+        {
+            uint32_t begin = next.fetch_add(batch_size);
+
+            if (begin >= count)
+                break;
+
+            uint32_t end = std::min(count, begin + batch_size);
+
+            for (uint32_t i = begin; i < end; i++)
+                func(i);
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (uint32_t i = 1; i < num_threads; i++)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Sorts values with operator< across num_threads threads (0 = all cores): one range per thread is sorted with std::sort, then
+// neighbouring ranges are merged in rounds, the merges of a round in parallel. Not stable, so equal values need a tie breaker
+// in their ordering for a deterministic result.
+template <typename T>
+void parallel_sort(std::vector<T>& values, uint32_t num_threads)
+{
+    const size_t count      = values.size();
+    const size_t num_ranges = std::min(size_t(resolve_thread_count(num_threads)), std::max(size_t(1), count / 4096));
+    const size_t range_size = (count + num_ranges - 1) / std::max(size_t(1), num_ranges);
+
+    if (num_ranges <= 1)
+    {
+        std::sort(values.begin(), values.end());
+        return;
+    }
+
+    auto range_begin = [&](size_t range) { return values.begin() + std::min(count, range * range_size); };
+
+    parallel_for(static_cast<uint32_t>(num_ranges), num_threads, [&](uint32_t i) { std::sort(range_begin(i), range_begin(i + 1)); });
+
+    for (size_t width = 1; width < num_ranges; width *= 2)
+    {
+        uint32_t num_merges = static_cast<uint32_t>((num_ranges + 2 * width - 1) / (2 * width));
+
+        parallel_for(num_merges, num_threads, [&](uint32_t i) {
+            size_t first = i * 2 * width;
+
+            std::inplace_merge(range_begin(first), range_begin(first + width), range_begin(first + 2 * width));
+        });
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
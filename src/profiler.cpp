@@ -0,0 +1,255 @@
+#include "profiler.h"
+#include "sdf_baker.h"
+#include "ray_march.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Names are written as JSON strings, with quotes, backslashes and control characters escaped.
+static void append_string(std::string& out, const std::string& s)
+{
+    out += '"';
+
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        }
+        else
+            out += c;
+    }
+
+    out += '"';
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// JSON has no infinities or NaNs, they are written as null.
+static void append_number(std::string& out, double value)
+{
+    if (!std::isfinite(value))
+    {
+        out += "null";
+        return;
+    }
+
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.9g", value);
+    out += buffer;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Profiler::add_time(const std::string& name, double ms)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Timer& timer = m_timers[name];
+
+    timer.min_ms = timer.count == 0 ? ms : std::min(timer.min_ms, ms);
+    timer.max_ms = timer.count == 0 ? ms : std::max(timer.max_ms, ms);
+    timer.total_ms += ms;
+    timer.count++;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Profiler::add_counter(const std::string& name, uint64_t value)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_counters[name] += value;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Profiler::set_value(const std::string& name, double value)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_values[name] = value;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Profiler::add_histogram(const std::string& name, const uint64_t* bins, uint32_t num_bins)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<uint64_t>& histogram = m_histograms[name];
+
+    if (histogram.size() < num_bins)
+        histogram.resize(num_bins, 0);
+
+    for (uint32_t i = 0; i < num_bins; i++)
+        histogram[i] += bins[i];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Profiler::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_timers.clear();
+    m_counters.clear();
+    m_values.clear();
+    m_histograms.clear();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::string Profiler::json() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::string out = "{\n  \"timers\": {";
+
+    for (auto it = m_timers.begin(); it != m_timers.end(); ++it)
+    {
+        const Timer& timer = it->second;
+
+        out += it == m_timers.begin() ? "\n    " : ",\n    ";
+        append_string(out, it->first);
+        out += ": {\"count\": " + std::to_string(timer.count) + ", \"total_ms\": ";
+        append_number(out, timer.total_ms);
+        out += ", \"mean_ms\": ";
+        append_number(out, timer.total_ms / double(std::max<uint64_t>(timer.count, 1)));
+        out += ", \"min_ms\": ";
+        append_number(out, timer.min_ms);
+        out += ", \"max_ms\": ";
+        append_number(out, timer.max_ms);
+        out += "}";
+    }
+
+    out += m_timers.empty() ? "},\n  \"counters\": {" : "\n  },\n  \"counters\": {";
+
+    for (auto it = m_counters.begin(); it != m_counters.end(); ++it)
+    {
+        out += it == m_counters.begin() ? "\n    " : ",\n    ";
+        append_string(out, it->first);
+        out += ": " + std::to_string(it->second);
+    }
+
+    out += m_counters.empty() ? "},\n  \"values\": {" : "\n  },\n  \"values\": {";
+
+    for (auto it = m_values.begin(); it != m_values.end(); ++it)
+    {
+        out += it == m_values.begin() ? "\n    " : ",\n    ";
+        append_string(out, it->first);
+        out += ": ";
+        append_number(out, it->second);
+    }
+
+    out += m_values.empty() ? "},\n  \"histograms\": {" : "\n  },\n  \"histograms\": {";
+
+    for (auto it = m_histograms.begin(); it != m_histograms.end(); ++it)
+    {
+        out += it == m_histograms.begin() ? "\n    " : ",\n    ";
+        append_string(out, it->first);
+        out += ": [";
+
+        for (size_t i = 0; i < it->second.size(); i++)
+            out += (i > 0 ? ", " : "") + std::to_string(it->second[i]);
+
+        out += "]";
+    }
+
+    out += m_histograms.empty() ? "}\n}\n" : "\n  }\n}\n";
+
+    return out;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool Profiler::write_json(const std::string& path) const
+{
+    FILE* file = fopen(path.c_str(), "wb");
+
+    if (!file)
+        return false;
+
+    std::string text = json();
+    bool        ok   = fwrite(text.data(), 1, text.size(), file) == text.size();
+
+    fclose(file);
+
+    return ok;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+ProfileScope::ProfileScope(Profiler* profiler, const std::string& name) :
+    m_profiler(profiler), m_name(name), m_start(std::chrono::high_resolution_clock::now())
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+ProfileScope::~ProfileScope()
+{
+    if (m_profiler)
+        m_profiler->add_time(m_name, elapsed_ms());
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+double ProfileScope::elapsed_ms() const
+{
+    return ::elapsed_ms(m_start);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void profile_bake(Profiler& profiler, const std::string& name, const BakeStats& stats, uint64_t num_voxels)
+{
+    profiler.add_time(name, stats.total_ms);
+    profiler.add_time(name + ".bvh", stats.bvh_ms);
+    profiler.add_time(name + ".distance", stats.distance_ms);
+
+    if (stats.winding_number_ms > 0.0)
+        profiler.add_time(name + ".winding_number", stats.winding_number_ms);
+
+    if (stats.band_ms > 0.0 || stats.fill_ms > 0.0)
+    {
+        profiler.add_time(name + ".band", stats.band_ms);
+        profiler.add_time(name + ".fill", stats.fill_ms);
+    }
+
+    profiler.add_counter(name + ".voxels", num_voxels);
+    profiler.add_counter(name + ".exact_voxels", stats.exact_voxels);
+    profiler.add_counter(name + ".queried_voxels", stats.queried_voxels);
+    profiler.add_counter(name + ".nodes_visited", stats.nodes_visited);
+    profiler.add_counter(name + ".triangles_tested", stats.triangles_tested);
+    profiler.add_counter(name + ".sign_mismatches", stats.sign_mismatches);
+
+    profiler.set_value(name + ".voxels_per_second", stats.total_ms > 0.0 ? double(num_voxels) / (stats.total_ms / 1000.0) : 0.0);
+    profiler.set_value(name + ".triangles_per_voxel", stats.triangles_per_voxel());
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void profile_ray_march(Profiler& profiler, const std::string& name, const RayMarchStats& stats, double ms)
+{
+    if (ms >= 0.0)
+        profiler.add_time(name, ms);
+
+    profiler.add_counter(name + ".rays", stats.num_rays);
+    profiler.add_counter(name + ".samples", stats.num_samples);
+    profiler.add_counter(name + ".refills", stats.num_refills);
+    profiler.add_counter(name + ".lane_steps", stats.lane_steps);
+    profiler.add_counter(name + ".nodes_visited", stats.nodes_visited);
+    profiler.add_counter(name + ".instances_evaluated", stats.instances_evaluated);
+    profiler.add_histogram(name + ".steps", stats.step_histogram, RAY_MARCH_STEP_BINS);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+struct BakeStats;
+struct RayMarchStats;
+
+// Milliseconds since start, for the stats of the baker's phases and the tools' timings.
+inline double elapsed_ms(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Named timers, counters, values and histograms, collected from any thread and written out as JSON. Timers accumulate every
+// time added under their name, counters add up, values keep the last one set and histograms add up bin by bin.
+class Profiler
+{
+public:
+    struct Timer
+    {
+        uint64_t count    = 0;
+        double   total_ms = 0.0;
+        double   min_ms   = 0.0;
+        double   max_ms   = 0.0;
+    };
+
+    void add_time(const std::string& name, double ms);
+    void add_counter(const std::string& name, uint64_t value);
+    void set_value(const std::string& name, double value);
+    void add_histogram(const std::string& name, const uint64_t* bins, uint32_t num_bins);
+    void clear();
+
+    // {"timers": {name: {"count", "total_ms", "mean_ms", "min_ms", "max_ms"}}, "counters": {name: n}, "values": {name: x},
+    // "histograms": {name: [n, ...]}}, names in sorted order.
+    std::string json() const;
+    bool        write_json(const std::string& path) const;
+
+private:
+    mutable std::mutex                           m_mutex;
+    std::map<std::string, Timer>                 m_timers;
+    std::map<std::string, uint64_t>              m_counters;
+    std::map<std::string, double>                m_values;
+    std::map<std::string, std::vector<uint64_t>> m_histograms;
+};
+
+// Adds the time between construction and destruction to a timer. Does nothing but measure without a profiler.
+class ProfileScope
+{
+public:
+    ProfileScope(Profiler* profiler, const std::string& name);
+    ~ProfileScope();
+
+    double elapsed_ms() const;
+
+private:
+    Profiler*                                      m_profiler;
+    std::string                                    m_name;
+    std::chrono::high_resolution_clock::time_point m_start;
+};
+
+// Records the phases and queries of a bake under name: name.bvh, name.distance and so on as timers, the counters of the distance
+// queries, and voxels per second and triangles tested per voxel as values.
+void profile_bake(Profiler& profiler, const std::string& name, const BakeStats& stats, uint64_t num_voxels);
+
+// Records the rays, samples and instance queries of a march under name, its steps per ray histogram as name.steps and ms, if
+// not negative, as name's timer.
+void profile_ray_march(Profiler& profiler, const std::string& name, const RayMarchStats& stats, double ms = -1.0);
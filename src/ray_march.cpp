@@ -0,0 +1,414 @@
+#include "ray_march.h"
+#include "parallel.h"
+#include "profiler.h"
+
+#include <chrono>
+
+// What a packet does with a ray that finishes.
+enum class MarchMode
+{
+    SHADOW, // Writes the penumbra factor, 0 on a hit.
+    PRIMARY // Writes the distance to the hit, -1 on a miss.
+};
+
+// Structure of arrays state of the rays in flight. Lanes [0, count) are active.
+struct RayPacket
+{
+    float    ox[RAY_PACKET_WIDTH];
+    float    oy[RAY_PACKET_WIDTH];
+    float    oz[RAY_PACKET_WIDTH];
+    float    dx[RAY_PACKET_WIDTH];
+    float    dy[RAY_PACKET_WIDTH];
+    float    dz[RAY_PACKET_WIDTH];
+    float    t[RAY_PACKET_WIDTH];
+    float    t_max[RAY_PACKET_WIDTH];
+    float    h[RAY_PACKET_WIDTH]; // Last distance, RAY_MARCH_HIT_DISTANCE or less on a hit.
+    float    res[RAY_PACKET_WIDTH];
+    float    truncated[RAY_PACKET_WIDTH]; // 1 when h is only a lower bound from the clipmap's band.
+    uint32_t ray[RAY_PACKET_WIDTH];
+    uint32_t steps[RAY_PACKET_WIDTH];
+    uint32_t count;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RayMarchStats::add(const RayMarchStats& other)
+{
+    num_rays += other.num_rays;
+    num_samples += other.num_samples;
+    num_refills += other.num_refills;
+    lane_steps += other.lane_steps;
+    nodes_visited += other.nodes_visited;
+    instances_evaluated += other.instances_evaluated;
+
+    for (uint32_t i = 0; i < RAY_MARCH_STEP_BINS; i++)
+        step_histogram[i] += other.step_histogram[i];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Scene distance at p, like evaluate_scene_sdf() in mesh_fs.glsl. The instance queries are added to stats.
+static float evaluate_scene(const RayMarchScene& scene, const glm::vec3& p, float early_out, bool& truncated, RayMarchStats& stats)
+{
+    truncated = false;
+
+    if (!scene.bvh)
+    {
+        stats.instances_evaluated += scene.instances->size();
+        return evaluate_scene_sdf(*scene.instances, p).distance;
+    }
+
+    InstanceQueryStats query_stats;
+
+    float h = scene.clipmap ? evaluate_scene_clipmap(*scene.instances, *scene.bvh, *scene.clipmap, p, &truncated, &query_stats) : evaluate_scene_sdf(*scene.instances, *scene.bvh, p, early_out, &query_stats).distance;
+
+    stats.nodes_visited += query_stats.nodes_visited;
+    stats.instances_evaluated += query_stats.instances_evaluated;
+
+    return h;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void load_lane(RayPacket& packet, uint32_t lane, uint32_t ray, const glm::vec3& origin, const glm::vec3& direction, float t_min, float t_max)
+{
+    packet.ox[lane]        = origin.x;
+    packet.oy[lane]        = origin.y;
+    packet.oz[lane]        = origin.z;
+    packet.dx[lane]        = direction.x;
+    packet.dy[lane]        = direction.y;
+    packet.dz[lane]        = direction.z;
+    packet.t[lane]         = t_min;
+    packet.t_max[lane]     = t_max;
+    packet.h[lane]         = SDF_INFINITY;
+    packet.res[lane]       = 1.0f;
+    packet.truncated[lane] = 0.0f;
+    packet.ray[lane]       = ray;
+    packet.steps[lane]     = 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Idle lanes hold values the full width loops can run over without producing infinities: a hit at t = 1 that never moves.
+static void clear_lane(RayPacket& packet, uint32_t lane)
+{
+    load_lane(packet, lane, UINT32_MAX, glm::vec3(0.0f), glm::vec3(0.0f), 1.0f, 1.0f);
+    packet.h[lane] = 0.0f;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void move_lane(RayPacket& packet, uint32_t dst, uint32_t src)
+{
+    packet.ox[dst]        = packet.ox[src];
+    packet.oy[dst]        = packet.oy[src];
+    packet.oz[dst]        = packet.oz[src];
+    packet.dx[dst]        = packet.dx[src];
+    packet.dy[dst]        = packet.dy[src];
+    packet.dz[dst]        = packet.dz[src];
+    packet.t[dst]         = packet.t[src];
+    packet.t_max[dst]     = packet.t_max[src];
+    packet.h[dst]         = packet.h[src];
+    packet.res[dst]       = packet.res[src];
+    packet.truncated[dst] = packet.truncated[src];
+    packet.ray[dst]       = packet.ray[src];
+    packet.steps[dst]     = packet.steps[src];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Marches rays [begin, end) through one packet. A lane whose ray finished takes the next ray of the batch, and once the batch
+// runs out the last active lane moves into it, so every step samples as many rays as are left, up to the packet width. Rays
+// end at their entry of t_max, capped by settings.t_max, or at settings.t_max without one.
+template <MarchMode Mode>
+static void march_batch(const RayMarchScene& scene, const glm::vec3* origins, const glm::vec3* directions, const float* t_max, uint32_t begin, uint32_t end, const RayMarchSettings& settings, float* out, RayMarchStats& stats)
+{
+    const float t_min = Mode == MarchMode::SHADOW ? settings.t_min : 0.0f;
+    const float k     = Mode == MarchMode::SHADOW && settings.soft_shadows ? settings.soft_shadows_k : 0.0f;
+
+    auto ray_t_max = [&](uint32_t ray) { return t_max ? std::min(settings.t_max, t_max[ray]) : settings.t_max; };
+
+    RayPacket packet;
+    uint32_t  next = begin;
+
+    packet.count = 0;
+
+    for (uint32_t l = 0; l < RAY_PACKET_WIDTH; l++)
+        clear_lane(packet, l);
+
+    while (packet.count < RAY_PACKET_WIDTH && next < end)
+    {
+        load_lane(packet, packet.count++, next, origins[next], directions[next], t_min, ray_t_max(next));
+        next++;
+    }
+
+    stats.num_rays += end - begin;
+
+    float px[RAY_PACKET_WIDTH];
+    float py[RAY_PACKET_WIDTH];
+    float pz[RAY_PACKET_WIDTH];
+
+    while (true)
+    {
+        // Retire finished lanes. A refilled lane is checked again, since a ray can finish before its first sample.
+        for (uint32_t l = 0; l < packet.count;)
+        {
+            bool hit = packet.h[l] < RAY_MARCH_HIT_DISTANCE;
+
+            if (!hit && packet.t[l] < packet.t_max[l])
+            {
+                l++;
+                continue;
+            }
+
+            if (Mode == MarchMode::SHADOW)
+                out[packet.ray[l]] = hit ? 0.0f : packet.res[l];
+            else
+                out[packet.ray[l]] = hit ? packet.t[l] : -1.0f;
+
+            stats.step_histogram[ray_march_step_bin(packet.steps[l])]++;
+
+            if (next < end)
+            {
+                load_lane(packet, l, next, origins[next], directions[next], t_min, ray_t_max(next));
+                next++;
+                stats.num_refills++;
+            }
+            else
+            {
+                move_lane(packet, l, packet.count - 1);
+                clear_lane(packet, packet.count - 1);
+                packet.count--;
+            }
+        }
+
+        if (packet.count == 0)
+            break;
+
+        for (uint32_t l = 0; l < RAY_PACKET_WIDTH; l++)
+        {
+            px[l] = packet.ox[l] + packet.dx[l] * packet.t[l];
+            py[l] = packet.oy[l] + packet.dy[l] * packet.t[l];
+            pz[l] = packet.oz[l] + packet.dz[l] * packet.t[l];
+        }
+
+        for (uint32_t l = 0; l < packet.count; l++)
+        {
+            bool truncated;
+
+            packet.h[l]         = evaluate_scene(scene, glm::vec3(px[l], py[l], pz[l]), RAY_MARCH_HIT_DISTANCE, truncated, stats);
+            packet.truncated[l] = truncated ? 1.0f : 0.0f;
+            packet.steps[l]++;
+        }
+
+        stats.num_samples += packet.count;
+        stats.lane_steps += RAY_PACKET_WIDTH;
+
+        // A truncated distance would darken the penumbra of rays that pass nothing within the band. Rays that hit keep their t.
+        for (uint32_t l = 0; l < RAY_PACKET_WIDTH; l++)
+        {
+            float penumbra = packet.truncated[l] > 0.0f || k == 0.0f ? 1.0f : k * packet.h[l] / packet.t[l];
+
+            packet.res[l] = std::min(packet.res[l], penumbra);
+            packet.t[l] += packet.h[l] < RAY_MARCH_HIT_DISTANCE ? 0.0f : packet.h[l];
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+template <MarchMode Mode>
+static void march_rays(const RayMarchScene& scene, const glm::vec3* origins, const glm::vec3* directions, const float* t_max, uint32_t count, const RayMarchSettings& settings, float* out, RayMarchStats* stats)
+{
+    const uint32_t num_batches = (count + RAY_MARCH_BATCH_SIZE - 1) / RAY_MARCH_BATCH_SIZE;
+
+    std::vector<RayMarchStats> batch_stats(num_batches);
+
+    parallel_for(num_batches, settings.num_threads, [&](uint32_t batch) {
+        uint32_t begin = batch * RAY_MARCH_BATCH_SIZE;
+        uint32_t end   = std::min(count, begin + RAY_MARCH_BATCH_SIZE);
+
+        march_batch<Mode>(scene, origins, directions, t_max, begin, end, settings, out, batch_stats[batch]);
+    });
+
+    if (stats)
+    {
+        *stats = RayMarchStats();
+
+        for (const auto& s : batch_stats)
+            stats->add(s);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void march_shadow_rays(const RayMarchScene& scene, const glm::vec3* origins, const glm::vec3* directions, const float* t_max, uint32_t count, const RayMarchSettings& settings, float* visibility, RayMarchStats* stats)
+{
+    march_rays<MarchMode::SHADOW>(scene, origins, directions, t_max, count, settings, visibility, stats);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void march_primary_rays(const RayMarchScene& scene, const glm::vec3* origins, const glm::vec3* directions, uint32_t count, const RayMarchSettings& settings, float* hit_t, RayMarchStats* stats)
+{
+    march_rays<MarchMode::PRIMARY>(scene, origins, directions, nullptr, count, settings, hit_t, stats);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void ambient_occlusion(const RayMarchScene& scene, const glm::vec3* positions, const glm::vec3* normals, uint32_t count, const RayMarchSettings& settings, float* ao, RayMarchStats* stats)
+{
+    const uint32_t num_packets = (count + RAY_PACKET_WIDTH - 1) / RAY_PACKET_WIDTH;
+
+    float max_sum = 0.0f;
+
+    for (int i = 0; i < settings.ao_num_steps; i++)
+        max_sum += 1.0f / float(1 << i) * float(i + 1) * settings.ao_step_size;
+
+    std::vector<RayMarchStats> packet_stats(num_packets);
+
+    // Every lane takes the same fixed steps, so packets never need compacting.
+    parallel_for(num_packets, settings.num_threads, [&](uint32_t packet) {
+        uint32_t begin = packet * RAY_PACKET_WIDTH;
+        uint32_t lanes = std::min(count - begin, uint32_t(RAY_PACKET_WIDTH));
+
+        float sum[RAY_PACKET_WIDTH] = {};
+
+        for (int i = 0; i < settings.ao_num_steps; i++)
+        {
+            const float offset = float(i + 1) * settings.ao_step_size;
+            const float weight = 1.0f / float(1 << i);
+
+            for (uint32_t l = 0; l < lanes; l++)
+            {
+                bool truncated;
+                sum[l] += weight * evaluate_scene(scene, positions[begin + l] + normals[begin + l] * offset, -SDF_INFINITY, truncated, packet_stats[packet]);
+            }
+        }
+
+        for (uint32_t l = 0; l < lanes; l++)
+            ao[begin + l] = std::min(sum[l] / max_sum, 1.0f);
+    }, RAY_MARCH_BATCH_SIZE / RAY_PACKET_WIDTH);
+
+    if (stats)
+    {
+        *stats = RayMarchStats();
+
+        for (const auto& s : packet_stats)
+            stats->add(s);
+
+        stats->num_rays    = count;
+        stats->num_samples = uint64_t(count) * uint64_t(std::max(settings.ao_num_steps, 0));
+        stats->lane_steps  = uint64_t(num_packets) * RAY_PACKET_WIDTH * uint64_t(std::max(settings.ao_num_steps, 0));
+
+        stats->step_histogram[ray_march_step_bin(static_cast<uint32_t>(std::max(settings.ao_num_steps, 0)))] = count;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+glm::vec3 scene_normal(const RayMarchScene& scene, const glm::vec3& ws_p)
+{
+    InstanceHit hit = scene.bvh ? evaluate_scene_sdf(*scene.instances, *scene.bvh, ws_p) : evaluate_scene_sdf(*scene.instances, ws_p);
+
+    if (hit.instance == UINT32_MAX)
+        return glm::vec3(0.0f, 1.0f, 0.0f);
+
+    const SDFInstance& instance = (*scene.instances)[hit.instance];
+
+    glm::vec3 gradient;
+    sample_sdf_gradient(*instance.volume, glm::vec3(instance.inverse_transform * glm::vec4(ws_p, 1.0f)), gradient);
+
+    gradient = glm::mat3(instance.transform) * gradient;
+
+    return glm::length(gradient) > 0.0f ? glm::normalize(gradient) : glm::vec3(0.0f, 1.0f, 0.0f);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void render_shadow_ao(const RayMarchScene& scene, const glm::mat4& view_proj, const glm::vec3& light_pos, uint32_t width, uint32_t height, const RayMarchSettings& settings, ShadowAOBuffers& buffers, ShadowAOStats* stats)
+{
+    const uint32_t  num_pixels = width * height;
+    const glm::mat4 inv        = glm::inverse(view_proj);
+
+    buffers.width  = width;
+    buffers.height = height;
+    buffers.depth.assign(num_pixels, -1.0f);
+    buffers.shadow.assign(num_pixels, 1.0f);
+    buffers.ao.assign(num_pixels, 1.0f);
+
+    std::vector<glm::vec3> origins(num_pixels);
+    std::vector<glm::vec3> directions(num_pixels);
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+        {
+            glm::vec2 ndc  = glm::vec2((float(x) + 0.5f) / float(width), 1.0f - (float(y) + 0.5f) / float(height)) * 2.0f - glm::vec2(1.0f);
+            glm::vec4 near = inv * glm::vec4(ndc.x, ndc.y, -1.0f, 1.0f);
+            glm::vec4 far  = inv * glm::vec4(ndc.x, ndc.y, 1.0f, 1.0f);
+
+            origins[x + y * width]    = glm::vec3(near) / near.w;
+            directions[x + y * width] = glm::normalize(glm::vec3(far) / far.w - origins[x + y * width]);
+        }
+    }
+
+    ShadowAOStats local_stats;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    march_primary_rays(scene, origins.data(), directions.data(), num_pixels, settings, buffers.depth.data(), &local_stats.primary);
+
+    local_stats.primary_ms = elapsed_ms(start);
+
+    // Shadow and AO rays only for the pixels that hit, in a compact list.
+    std::vector<uint32_t>  pixels;
+    std::vector<glm::vec3> positions;
+
+    for (uint32_t i = 0; i < num_pixels; i++)
+    {
+        if (buffers.depth[i] < 0.0f)
+            continue;
+
+        pixels.push_back(i);
+        positions.push_back(origins[i] + directions[i] * buffers.depth[i]);
+    }
+
+    const uint32_t num_hits = static_cast<uint32_t>(pixels.size());
+
+    std::vector<glm::vec3> normals(num_hits);
+    std::vector<glm::vec3> light_directions(num_hits);
+    std::vector<float>     light_distances(num_hits);
+    std::vector<float>     shadow(num_hits);
+    std::vector<float>     ao(num_hits);
+
+    // Shadow rays end at the light like in the viewer, so geometry behind it doesn't shadow the surface.
+    for (uint32_t i = 0; i < num_hits; i++)
+    {
+        light_distances[i]  = glm::length(light_pos - positions[i]);
+        light_directions[i] = (light_pos - positions[i]) / light_distances[i];
+    }
+
+    start = std::chrono::high_resolution_clock::now();
+
+    march_shadow_rays(scene, positions.data(), light_directions.data(), light_distances.data(), num_hits, settings, shadow.data(), &local_stats.shadow);
+
+    local_stats.shadow_ms = elapsed_ms(start);
+    start                 = std::chrono::high_resolution_clock::now();
+
+    parallel_for(num_hits, settings.num_threads, [&](uint32_t i) { normals[i] = scene_normal(scene, positions[i]); }, RAY_MARCH_BATCH_SIZE);
+    ambient_occlusion(scene, positions.data(), normals.data(), num_hits, settings, ao.data(), &local_stats.ao);
+
+    local_stats.ao_ms = elapsed_ms(start);
+
+    for (uint32_t i = 0; i < num_hits; i++)
+    {
+        buffers.shadow[pixels[i]] = shadow[i];
+        buffers.ao[pixels[i]]     = ao[i];
+    }
+
+    if (stats)
+        *stats = local_stats;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
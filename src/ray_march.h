@@ -0,0 +1,105 @@
+#pragma once
+
+#include "sdf_clipmap.h"
+
+// Rays marched side by side by one packet. Lanes are kept in structure of arrays form so the per step arithmetic runs over all
+// of them at once.
+#define RAY_PACKET_WIDTH 8
+
+// Rays handed to a thread at a time. Every batch runs its own packet, which is refilled from the batch as rays finish.
+#define RAY_MARCH_BATCH_SIZE 256
+
+// Distance that counts as a hit, SDF_HIT_DISTANCE in mesh_fs.glsl.
+#define RAY_MARCH_HIT_DISTANCE 0.001f
+
+// Bins of the steps per ray histogram. Bin 0 counts rays that took no step, bin b rays with [2^(b-1), 2^b) steps and the last
+// bin every longer ray.
+#define RAY_MARCH_STEP_BINS 12
+
+// Scene the rays are marched through. Without a BVH every instance is evaluated for every sample, with a clipmap samples read
+// it first like the viewer does with the scene clipmap enabled.
+struct RayMarchScene
+{
+    const std::vector<SDFInstance>* instances = nullptr;
+    const InstanceBVH*              bvh       = nullptr;
+    const SDFClipmap*               clipmap   = nullptr;
+};
+
+// The viewer's uniforms of the same names, with its defaults.
+struct RayMarchSettings
+{
+    float    t_min          = 0.2f;   // u_SDFTMin
+    float    t_max          = 100.0f; // u_SDFTMax
+    bool     soft_shadows   = true;   // u_SDFSoftShadows
+    float    soft_shadows_k = 5.7f;   // u_SDFSoftShadowsK
+    float    ao_step_size   = 0.15f;  // u_AOStepSize
+    int      ao_num_steps   = 8;      // u_AONumSteps
+    uint32_t num_threads    = 0;      // 0 = use all cores.
+};
+
+struct RayMarchStats
+{
+    uint64_t num_rays    = 0;
+    uint64_t num_samples = 0; // Scene SDF evaluations.
+    uint64_t num_refills = 0; // Lanes that took a new ray after theirs finished.
+    uint64_t lane_steps  = 0; // Lanes a packet step had room for, active or not. num_samples / lane_steps is the occupancy.
+
+    uint64_t nodes_visited       = 0; // Instance BVH nodes visited by the samples that evaluated the instances.
+    uint64_t instances_evaluated = 0;
+    uint64_t step_histogram[RAY_MARCH_STEP_BINS] = {}; // Rays by the number of samples they took, see RAY_MARCH_STEP_BINS.
+
+    void add(const RayMarchStats& other);
+};
+
+// Histogram bin of a ray that took num_steps samples.
+inline uint32_t ray_march_step_bin(uint32_t num_steps)
+{
+    uint32_t bin = 0;
+
+    while (num_steps > 0 && bin < RAY_MARCH_STEP_BINS - 1)
+    {
+        num_steps >>= 1;
+        bin++;
+    }
+
+    return bin;
+}
+
+// Shadow rays like shadow_ray_march() in mesh_fs.glsl: 0 for rays that hit, otherwise the soft shadow penumbra factor, or 1
+// with soft shadows off. directions must be normalized. Each ray ends at min(settings.t_max, t_max[i]), the distance to the
+// light like in the viewer, or at settings.t_max when t_max is nullptr.
+void march_shadow_rays(const RayMarchScene& scene, const glm::vec3* origins, const glm::vec3* directions, const float* t_max, uint32_t count, const RayMarchSettings& settings, float* visibility, RayMarchStats* stats = nullptr);
+
+// Sphere traces rays from t = 0 to settings.t_max and writes the distance along each ray to its hit, or -1 for a miss.
+void march_primary_rays(const RayMarchScene& scene, const glm::vec3* origins, const glm::vec3* directions, uint32_t count, const RayMarchSettings& settings, float* hit_t, RayMarchStats* stats = nullptr);
+
+// ambient_occlusion() in mesh_fs.glsl at every position, along its normal.
+void ambient_occlusion(const RayMarchScene& scene, const glm::vec3* positions, const glm::vec3* normals, uint32_t count, const RayMarchSettings& settings, float* ao, RayMarchStats* stats = nullptr);
+
+// Unit normal of the scene at a surface point: the gradient of the closest instance's volume, from sample_sdf_gradient().
+glm::vec3 scene_normal(const RayMarchScene& scene, const glm::vec3& ws_p);
+
+// Per pixel results of render_shadow_ao(), rows from the top of the image. Pixels whose primary ray missed hold -1 in depth and
+// 1 in shadow and ao.
+struct ShadowAOBuffers
+{
+    uint32_t           width  = 0;
+    uint32_t           height = 0;
+    std::vector<float> depth;  // Distance from the near plane along the primary ray.
+    std::vector<float> shadow; // shadow_ray_march() towards the light, before its attenuation.
+    std::vector<float> ao;
+};
+
+struct ShadowAOStats
+{
+    RayMarchStats primary;
+    RayMarchStats shadow;
+    RayMarchStats ao;
+    double        primary_ms = 0.0;
+    double        shadow_ms  = 0.0;
+    double        ao_ms      = 0.0;
+};
+
+// Renders the shadow and AO terms of the viewer's mesh shader headlessly. Surfaces come from primary rays through the pixel
+// centres of view_proj, the camera's view projection matrix, instead of rasterization.
+void render_shadow_ao(const RayMarchScene& scene, const glm::mat4& view_proj, const glm::vec3& light_pos, uint32_t width, uint32_t height, const RayMarchSettings& settings, ShadowAOBuffers& buffers, ShadowAOStats* stats = nullptr);
@@ -0,0 +1,102 @@
+#include "scene_sdf.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+SDFInstance make_sdf_instance(const SDFVolume* volume, const glm::mat4& transform)
+{
+    SDFInstance instance;
+
+    instance.volume            = volume;
+    instance.transform         = transform;
+    instance.inverse_transform = glm::inverse(transform);
+
+    return instance;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+InstanceBox instance_box(const SDFInstance& instance)
+{
+    const SDFVolume& volume = *instance.volume;
+
+    InstanceBox box;
+
+    box.center       = glm::vec3(instance.transform * glm::vec4((volume.min_extents + volume.max_extents) * 0.5f, 1.0f));
+    box.half_extents = (volume.max_extents - volume.min_extents) * 0.5f;
+
+    for (int i = 0; i < 3; i++)
+        box.axis[i] = glm::vec3(instance.transform[i]);
+
+    return box;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float evaluate_mesh_sdf(const SDFInstance& instance, const glm::vec3& ws_p)
+{
+    const SDFVolume& volume = *instance.volume;
+
+    // The transform is rigid, so clamping in object space finds the same closest point as find_closest_point_on_obb().
+    glm::vec3 os_p = glm::vec3(instance.inverse_transform * glm::vec4(ws_p, 1.0f));
+    glm::vec3 q    = glm::clamp(os_p, volume.min_extents, volume.max_extents);
+
+    return glm::length(os_p - q) + sample_sdf(volume, q);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float evaluate_mesh_sdf_gradient(const SDFInstance& instance, const glm::vec3& ws_p, glm::vec3& gradient)
+{
+    const SDFVolume& volume = *instance.volume;
+
+    glm::vec3 os_p = glm::vec3(instance.inverse_transform * glm::vec4(ws_p, 1.0f));
+    glm::vec3 q    = glm::clamp(os_p, volume.min_extents, volume.max_extents);
+    glm::vec3 os_gradient;
+
+    float d      = sample_sdf_gradient(volume, q, os_gradient);
+    float to_box = glm::length(os_p - q);
+
+    // Moving p along a clamped axis doesn't move q.
+    for (int i = 0; i < 3; i++)
+    {
+        if (os_p[i] != q[i])
+            os_gradient[i] = 0.0f;
+    }
+
+    if (to_box > 0.0f)
+        os_gradient += (os_p - q) / to_box;
+
+    gradient = glm::mat3(instance.transform) * os_gradient;
+
+    return to_box + d;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+InstanceHit evaluate_scene_sdf(const std::vector<SDFInstance>& instances, const glm::vec3& ws_p)
+{
+    InstanceHit hit;
+
+    for (uint32_t i = 0; i < instances.size(); i++)
+    {
+        float h = evaluate_mesh_sdf(instances[i], ws_p);
+
+        if (h < hit.distance)
+        {
+            hit.distance = h;
+            hit.instance = i;
+        }
+    }
+
+    return hit;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+InstanceHit evaluate_scene_sdf(const std::vector<SDFInstance>& instances, const InstanceBVH& bvh, const glm::vec3& ws_p, float early_out, InstanceQueryStats* stats)
+{
+    return bvh.nearest_instance(
+        ws_p, [&](uint32_t i) { return evaluate_mesh_sdf(instances[i], ws_p); }, early_out, stats);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "instance_bvh.h"
+#include "sdf_sampler.h"
+
+// A baked volume placed in a scene. Like the viewer's instances, transforms only rotate and translate.
+struct SDFInstance
+{
+    const SDFVolume* volume            = nullptr;
+    glm::mat4        transform         = glm::mat4(1.0f);
+    glm::mat4        inverse_transform = glm::mat4(1.0f);
+};
+
+SDFInstance make_sdf_instance(const SDFVolume* volume, const glm::mat4& transform);
+
+// World space box of an instance's volume, computed like update_transforms() in main.cpp.
+InstanceBox instance_box(const SDFInstance& instance);
+
+// CPU equivalent of evaluate_mesh_sdf() in mesh_fs.glsl: the sampled distance inside the box, and the distance to the box plus
+// the distance at the closest point on it outside.
+float evaluate_mesh_sdf(const SDFInstance& instance, const glm::vec3& ws_p);
+
+// evaluate_mesh_sdf() and its world space gradient. Inside the box this is the gradient of the trilinear sample, outside it the
+// direction away from the box plus the part of the sample's gradient along the faces the closest point can slide on.
+float evaluate_mesh_sdf_gradient(const SDFInstance& instance, const glm::vec3& ws_p, glm::vec3& gradient);
+
+// CPU equivalent of the loop in evaluate_scene_sdf() in mesh_fs.glsl, which evaluates every instance.
+InstanceHit evaluate_scene_sdf(const std::vector<SDFInstance>& instances, const glm::vec3& ws_p);
+
+// Same result through the top level BVH built over instance_box() of every instance. The query stops once the distance drops
+// to early_out or below, so a shadow march can pass its hit distance.
+InstanceHit evaluate_scene_sdf(const std::vector<SDFInstance>& instances, const InstanceBVH& bvh, const glm::vec3& ws_p, float early_out = -SDF_INFINITY, InstanceQueryStats* stats = nullptr);
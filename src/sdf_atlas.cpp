@@ -0,0 +1,307 @@
+#include "sdf_atlas.h"
+
+#include <string.h>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static int round_up(int value, int multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static uint64_t voxel_count(const glm::ivec3& size)
+{
+    return uint64_t(size.x) * uint64_t(size.y) * uint64_t(size.z);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool SDFAtlasPacker::place(uint32_t page, const glm::ivec3& size, glm::ivec3& offset) const
+{
+    const Page&      p     = m_pages[page];
+    const glm::ivec2 cells = glm::ivec2(size) / SDF_ATLAS_ALIGNMENT;
+
+    uint64_t best_voxels = UINT64_MAX;
+    int      best_z      = 0;
+
+    for (int y = 0; y + cells.y <= p.columns.y; y++)
+    {
+        for (int x = 0; x + cells.x <= p.columns.x; x++)
+        {
+            int z = 0;
+
+            for (int cy = y; cy < y + cells.y; cy++)
+            {
+                for (int cx = x; cx < x + cells.x; cx++)
+                    z = std::max(z, p.heights[cx + cy * p.columns.x]);
+            }
+
+            if (z + size.z > SDF_ATLAS_MAX_DEPTH)
+                continue;
+
+            glm::ivec3 candidate = glm::ivec3(x * SDF_ATLAS_ALIGNMENT, y * SDF_ATLAS_ALIGNMENT, z);
+            uint64_t   voxels    = voxel_count(glm::max(p.size, candidate + size));
+
+            if (voxels < best_voxels || (voxels == best_voxels && z < best_z))
+            {
+                best_voxels = voxels;
+                best_z      = z;
+                offset      = candidate;
+            }
+        }
+    }
+
+    return best_voxels != UINT64_MAX;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+SDFAtlasSlot SDFAtlasPacker::insert(const glm::ivec3& volume_size)
+{
+    SDFAtlasSlot slot;
+
+    slot.volume_size = volume_size;
+    slot.size        = glm::ivec3(0);
+
+    for (int i = 0; i < 3; i++)
+        slot.size[i] = round_up(volume_size[i] + 2 * SDF_ATLAS_BORDER, SDF_ATLAS_ALIGNMENT);
+
+    m_volume_voxels += voxel_count(volume_size);
+
+    // The smallest removed slot that is big enough.
+    size_t best_free = m_free.size();
+
+    for (size_t i = 0; i < m_free.size(); i++)
+    {
+        if (glm::all(glm::greaterThanEqual(m_free[i].size, slot.size)) && (best_free == m_free.size() || voxel_count(m_free[i].size) < voxel_count(m_free[best_free].size)))
+            best_free = i;
+    }
+
+    if (best_free < m_free.size())
+    {
+        slot.page   = m_free[best_free].page;
+        slot.offset = m_free[best_free].offset;
+        slot.size   = m_free[best_free].size;
+
+        m_free.erase(m_free.begin() + best_free);
+        m_slot_voxels += voxel_count(slot.size);
+
+        return slot;
+    }
+
+    m_slot_voxels += voxel_count(slot.size);
+
+    for (uint32_t i = 0; i < m_pages.size(); i++)
+    {
+        if (place(i, slot.size, slot.offset))
+        {
+            slot.page = i;
+            break;
+        }
+    }
+
+    // Volumes wider than a page get a page of their own width.
+    if (!slot.valid())
+    {
+        Page page;
+
+        page.columns = glm::max(glm::ivec2(SDF_ATLAS_PAGE_SIZE), glm::ivec2(slot.size)) / SDF_ATLAS_ALIGNMENT;
+        page.heights.assign(page.columns.x * page.columns.y, 0);
+        page.size = glm::ivec3(0);
+
+        m_pages.push_back(page);
+
+        slot.page   = static_cast<uint32_t>(m_pages.size() - 1);
+        slot.offset = glm::ivec3(0);
+    }
+
+    Page&            page  = m_pages[slot.page];
+    const glm::ivec2 first = glm::ivec2(slot.offset) / SDF_ATLAS_ALIGNMENT;
+    const glm::ivec2 cells = glm::ivec2(slot.size) / SDF_ATLAS_ALIGNMENT;
+
+    for (int y = first.y; y < first.y + cells.y; y++)
+    {
+        for (int x = first.x; x < first.x + cells.x; x++)
+            page.heights[x + y * page.columns.x] = slot.offset.z + slot.size.z;
+    }
+
+    page.size = glm::max(page.size, slot.offset + slot.size);
+
+    return slot;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void SDFAtlasPacker::remove(const SDFAtlasSlot& slot)
+{
+    if (!slot.valid())
+        return;
+
+    m_volume_voxels -= voxel_count(slot.volume_size);
+    m_slot_voxels -= voxel_count(slot.size);
+
+    m_free.push_back(slot);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+SDFAtlasStats SDFAtlasPacker::stats() const
+{
+    SDFAtlasStats stats;
+
+    stats.num_pages     = num_pages();
+    stats.volume_voxels = m_volume_voxels;
+    stats.slot_voxels   = m_slot_voxels;
+
+    for (uint32_t i = 0; i < m_pages.size(); i++)
+        stats.page_voxels += voxel_count(page_size(i));
+
+    return stats;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void copy_with_border(const uint8_t* src, const glm::ivec3& size, uint32_t texel_bytes, uint8_t* dst)
+{
+    const glm::ivec3 dst_size = size + glm::ivec3(2 * SDF_ATLAS_BORDER);
+
+    for (int z = 0; z < dst_size.z; z++)
+    {
+        for (int y = 0; y < dst_size.y; y++)
+        {
+            int sz = glm::clamp(z - SDF_ATLAS_BORDER, 0, size.z - 1);
+            int sy = glm::clamp(y - SDF_ATLAS_BORDER, 0, size.y - 1);
+
+            const uint8_t* src_row = src + (size_t(size.x) * (size_t(sy) + size_t(size.y) * size_t(sz))) * texel_bytes;
+            uint8_t*       dst_row = dst + (size_t(dst_size.x) * (size_t(y) + size_t(dst_size.y) * size_t(z))) * texel_bytes;
+
+            for (int x = 0; x < SDF_ATLAS_BORDER; x++)
+            {
+                memcpy(dst_row + x * texel_bytes, src_row, texel_bytes);
+                memcpy(dst_row + (SDF_ATLAS_BORDER + size.x + x) * texel_bytes, src_row + (size.x - 1) * texel_bytes, texel_bytes);
+            }
+
+            memcpy(dst_row + SDF_ATLAS_BORDER * texel_bytes, src_row, size_t(size.x) * texel_bytes);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Copies a box of texels into a page level at offset.
+static void copy_to_page(SDFVolume& page, const glm::ivec3& offset, const glm::ivec3& size, const float* src)
+{
+    for (int z = 0; z < size.z; z++)
+    {
+        for (int y = 0; y < size.y; y++)
+            memcpy(&page.distances[page.index(offset.x, offset.y + y, offset.z + z)], src + size_t(size.x) * (size_t(y) + size_t(size.y) * size_t(z)), size_t(size.x) * sizeof(float));
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t SDFAtlas::add(const SDFPyramid& pyramid)
+{
+    const SDFVolume& volume = pyramid.levels[0];
+
+    Entry entry;
+
+    entry.slot        = m_packer.insert(volume.volume_size);
+    entry.num_levels  = pyramid.num_levels();
+    entry.min_extents = volume.min_extents;
+    entry.max_extents = volume.max_extents;
+
+    if (entry.slot.page >= m_pages.size())
+        m_pages.resize(entry.slot.page + 1, std::vector<SDFVolume>(SDF_PYRAMID_MAX_LEVELS));
+
+    std::vector<SDFVolume>& levels = m_pages[entry.slot.page];
+    glm::ivec3              size   = m_packer.page_size(entry.slot.page);
+
+    // A page that grew is copied into its new size, with its texels at the same coordinates.
+    for (uint32_t i = 0; i < levels.size(); i++)
+    {
+        glm::ivec3 level_size = glm::max(glm::ivec3(1), size >> int(i));
+
+        if (level_size == levels[i].volume_size)
+            continue;
+
+        SDFVolume grown;
+
+        grown.volume_size = level_size;
+        grown.distances.resize(grown.num_voxels(), 0.0f);
+
+        if (!levels[i].distances.empty())
+            copy_to_page(grown, glm::ivec3(0), levels[i].volume_size, levels[i].distances.data());
+
+        levels[i] = std::move(grown);
+    }
+
+    std::vector<float> bordered(size_t(volume.volume_size.x + 2 * SDF_ATLAS_BORDER) * size_t(volume.volume_size.y + 2 * SDF_ATLAS_BORDER) * size_t(volume.volume_size.z + 2 * SDF_ATLAS_BORDER));
+
+    copy_with_border(reinterpret_cast<const uint8_t*>(volume.distances.data()), volume.volume_size, sizeof(float), reinterpret_cast<uint8_t*>(bordered.data()));
+    copy_to_page(levels[0], entry.slot.offset, volume.volume_size + glm::ivec3(2 * SDF_ATLAS_BORDER), bordered.data());
+
+    for (uint32_t i = 1; i < pyramid.num_levels(); i++)
+        copy_to_page(levels[i], entry.slot.offset >> int(i), pyramid.levels[i].volume_size, pyramid.levels[i].distances.data());
+
+    m_entries.push_back(entry);
+
+    return static_cast<uint32_t>(m_entries.size() - 1);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void SDFAtlas::remove(uint32_t entry)
+{
+    m_packer.remove(m_entries[entry].slot);
+    m_entries[entry].slot = SDFAtlasSlot();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float sample_sdf(const SDFAtlas& atlas, uint32_t entry, const glm::vec3& os_p, uint32_t level)
+{
+    const SDFAtlas::Entry& e    = atlas.entry(entry);
+    const SDFVolume&       page = atlas.page(e.slot.page, level);
+
+    glm::vec3 uvw = (os_p - e.min_extents) / (e.max_extents - e.min_extents);
+
+    auto fetch = [&](int x, int y, int z) { return page.voxel(x, y, z); };
+
+    if (level == 0)
+    {
+        // The texel coordinate of uvw * scale + offset in the page, with scale = volume_size / page_size and
+        // offset = (slot offset + border) / page_size.
+        glm::vec3 texel = glm::vec3(e.slot.offset + glm::ivec3(SDF_ATLAS_BORDER)) + uvw * glm::vec3(e.slot.volume_size) - glm::vec3(0.5f);
+
+        return sample_trilinear(page.volume_size, texel, fetch);
+    }
+
+    glm::ivec3 size  = glm::max(glm::ivec3(1), e.slot.volume_size >> int(level));
+    glm::ivec3 texel = glm::clamp(glm::ivec3(uvw * glm::vec3(size)), glm::ivec3(0), size - glm::ivec3(1)) + (e.slot.offset >> int(level));
+
+    return fetch(texel.x, texel.y, texel.z);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float sample_sdf_gradient(const SDFAtlas& atlas, uint32_t entry, const glm::vec3& os_p, glm::vec3& gradient)
+{
+    const SDFAtlas::Entry& e      = atlas.entry(entry);
+    const SDFVolume&       page   = atlas.page(e.slot.page, 0);
+    const glm::ivec3       origin = e.slot.offset + glm::ivec3(SDF_ATLAS_BORDER);
+
+    glm::vec3 box_size = e.max_extents - e.min_extents;
+    glm::vec3 texel    = (os_p - e.min_extents) / box_size * glm::vec3(e.slot.volume_size) - glm::vec3(0.5f);
+
+    // Clamped to the volume rather than the page, the border holds the same texels.
+    float d = sample_trilinear_gradient(e.slot.volume_size, texel, [&](int x, int y, int z) { return page.voxel(origin.x + x, origin.y + y, origin.z + z); }, gradient);
+
+    gradient *= glm::vec3(e.slot.volume_size) / box_size;
+
+    return d;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "sdf_pyramid.h"
+
+// Texels of repeated edge around level 0 of every volume, so linear filtering at its faces reads the volume's own edge, like
+// GL_CLAMP_TO_EDGE on a texture of its own, and never a neighbour.
+#define SDF_ATLAS_BORDER 1
+
+// Slots start and end on multiples of this, 2^(SDF_PYRAMID_MAX_LEVELS - 1), so level l of a volume starts on a texel of mip l
+// of its page at (slot offset >> l) and fits in (slot size >> l).
+#define SDF_ATLAS_ALIGNMENT 16
+
+// Largest width and height, and depth, of a page. A page is only as large as the box around its slots, and a volume that fits in
+// no page starts a new one.
+#define SDF_ATLAS_PAGE_SIZE 256
+#define SDF_ATLAS_MAX_DEPTH 1024
+
+struct SDFAtlasSlot
+{
+    uint32_t   page        = UINT32_MAX;
+    glm::ivec3 offset      = glm::ivec3(0); // Corner of the slot in texels of level 0 of the page.
+    glm::ivec3 size        = glm::ivec3(0); // Multiple of SDF_ATLAS_ALIGNMENT.
+    glm::ivec3 volume_size = glm::ivec3(0); // Level 0 of the volume, which starts at offset + SDF_ATLAS_BORDER.
+
+    inline bool valid() const { return page != UINT32_MAX; }
+};
+
+struct SDFAtlasStats
+{
+    uint32_t num_pages     = 0;
+    uint64_t volume_voxels = 0; // Level 0 of the volumes in the atlas.
+    uint64_t slot_voxels   = 0; // The same with borders and alignment.
+    uint64_t page_voxels   = 0; // Level 0 of all pages at their current size.
+
+    inline double efficiency() const { return page_voxels > 0 ? double(volume_voxels) / double(page_voxels) : 0.0; }
+};
+
+// Places volumes in 3D pages. A page keeps the height of every SDF_ATLAS_ALIGNMENT wide column. A slot sits on the highest
+// column under it and raises the columns it covers, and of all positions it takes the one that keeps the box around the page's
+// slots smallest, then the lowest. Removed slots are remembered and handed to later volumes that fit in them, which is how a
+// coarse bake's slot is reused once the full volume replaces it.
+class SDFAtlasPacker
+{
+public:
+    // Slot for a volume of volume_size texels plus its border.
+    SDFAtlasSlot insert(const glm::ivec3& volume_size);
+
+    void remove(const SDFAtlasSlot& slot);
+
+    // Box around every slot the page ever held, which is the size its texture needs. It never shrinks.
+    inline glm::ivec3 page_size(uint32_t page) const { return m_pages[page].size; }
+
+    SDFAtlasStats stats() const;
+
+    inline uint32_t num_pages() const { return static_cast<uint32_t>(m_pages.size()); }
+
+private:
+    struct Page
+    {
+        glm::ivec2       columns; // Largest width and height in SDF_ATLAS_ALIGNMENT columns.
+        std::vector<int> heights; // Top of every column, in texels.
+        glm::ivec3       size;
+    };
+
+    // Best position for a slot of size in a page, false if it doesn't fit.
+    bool place(uint32_t page, const glm::ivec3& size, glm::ivec3& offset) const;
+
+private:
+    std::vector<Page>         m_pages;
+    std::vector<SDFAtlasSlot> m_free;
+    uint64_t                  m_volume_voxels = 0;
+    uint64_t                  m_slot_voxels   = 0;
+};
+
+// Copies a volume of size texels, texel_bytes each, into dst, which holds size + 2 * SDF_ATLAS_BORDER texels per axis, and
+// repeats the edge texels into the border.
+void copy_with_border(const uint8_t* src, const glm::ivec3& size, uint32_t texel_bytes, uint8_t* dst);
+
+// CPU atlas of float pages, the layout the viewer uploads to its page textures: level 0 of a volume with its border at the
+// slot's offset, and level l of the pyramid at (offset >> l) in mip l of the page.
+class SDFAtlas
+{
+public:
+    struct Entry
+    {
+        SDFAtlasSlot slot;
+        uint32_t     num_levels;
+        glm::vec3    min_extents;
+        glm::vec3    max_extents;
+    };
+
+    // Copies every level of pyramid into the atlas and returns the index of its entry.
+    uint32_t add(const SDFPyramid& pyramid);
+
+    // Frees the slot of an entry for later volumes. The index stays taken.
+    void remove(uint32_t entry);
+
+    inline const Entry&     entry(uint32_t i) const { return m_entries[i]; }
+    inline const SDFVolume& page(uint32_t page, uint32_t level) const { return m_pages[page][level]; }
+    inline SDFAtlasStats    stats() const { return m_packer.stats(); }
+
+private:
+    SDFAtlasPacker                      m_packer;
+    std::vector<Entry>                  m_entries;
+    std::vector<std::vector<SDFVolume>> m_pages; // Mip levels of every page. Only volume_size and distances are used.
+};
+
+// Like sample_sdf_lod() in mesh_fs.glsl on an atlas page: a trilinear sample of level 0 at uvw * scale + offset in the page, or
+// the nearest texel of a coarser level. os_p must be inside the entry's box.
+float sample_sdf(const SDFAtlas& atlas, uint32_t entry, const glm::vec3& os_p, uint32_t level = 0);
+
+// Like sample_sdf_gradient() in mesh_fs.glsl: the distance at level 0 and its object space gradient from the 8 texels of the
+// volume around os_p.
+float sample_sdf_gradient(const SDFAtlas& atlas, uint32_t entry, const glm::vec3& os_p, glm::vec3& gradient);
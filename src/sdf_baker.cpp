@@ -0,0 +1,346 @@
+#include "sdf_baker.h"
+#include "bvh.h"
+#include "winding_number.h"
+#include "narrow_band.h"
+#include "parallel.h"
+#include "profiler.h"
+
+#include <chrono>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static inline float dot2(const glm::vec3& v) { return glm::dot(v, v); }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+SDFMesh make_sdf_mesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices)
+{
+    SDFMesh mesh;
+
+    mesh.positions = positions;
+    mesh.indices   = indices;
+
+    compute_vertex_normals(mesh);
+
+    return mesh;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void compute_vertex_normals(SDFMesh& mesh)
+{
+    mesh.normals.assign(mesh.positions.size(), glm::vec3(0.0f));
+
+    for (uint32_t i = 0; i < mesh.num_triangles(); i++)
+    {
+        uint32_t i0 = mesh.indices[3 * i];
+        uint32_t i1 = mesh.indices[3 * i + 1];
+        uint32_t i2 = mesh.indices[3 * i + 2];
+
+        // Unnormalized cross product, so larger faces contribute more.
+        glm::vec3 n = glm::cross(mesh.positions[i1] - mesh.positions[i0], mesh.positions[i2] - mesh.positions[i0]);
+
+        mesh.normals[i0] += n;
+        mesh.normals[i1] += n;
+        mesh.normals[i2] += n;
+    }
+
+    for (auto& n : mesh.normals)
+    {
+        float len = glm::length(n);
+
+        if (len > 0.0f)
+            n /= len;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void compute_extents(const SDFMesh& mesh, glm::vec3& min_extents, glm::vec3& max_extents)
+{
+    min_extents = glm::vec3(SDF_INFINITY);
+    max_extents = glm::vec3(-SDF_INFINITY);
+
+    for (const auto& p : mesh.positions)
+    {
+        min_extents = glm::min(min_extents, p);
+        max_extents = glm::max(max_extents, p);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+SDFGrid compute_grid(const glm::vec3& mesh_min_extents, const glm::vec3& mesh_max_extents, float grid_step_size, int padding)
+{
+    glm::vec3  min_extents = mesh_min_extents - (glm::vec3(grid_step_size) * float(padding));
+    glm::vec3  max_extents = mesh_max_extents + (glm::vec3(grid_step_size) * float(padding));
+    glm::vec3  grid_origin = min_extents + glm::vec3(grid_step_size / 2.0f);
+    glm::vec3  box_size    = max_extents - min_extents;
+    glm::ivec3 volume_size = glm::ivec3(glm::ceil(box_size / glm::vec3(grid_step_size)));
+
+    SDFGrid grid;
+
+    grid.volume_size    = volume_size;
+    grid.grid_origin    = grid_origin;
+    grid.grid_step_size = grid_step_size;
+    grid.min_extents    = min_extents;
+    grid.max_extents    = max_extents;
+
+    return grid;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float sdf_triangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    glm::vec3 ba  = b - a;
+    glm::vec3 pa  = p - a;
+    glm::vec3 cb  = c - b;
+    glm::vec3 pb  = p - b;
+    glm::vec3 ac  = a - c;
+    glm::vec3 pc  = p - c;
+    glm::vec3 nor = glm::cross(ba, ac);
+
+    return sqrtf(
+        (glm::sign(glm::dot(glm::cross(ba, nor), pa)) + glm::sign(glm::dot(glm::cross(cb, nor), pb)) + glm::sign(glm::dot(glm::cross(ac, nor), pc)) < 2.0f) ?
+            glm::min(glm::min(
+                         dot2(ba * glm::clamp(glm::dot(ba, pa) / dot2(ba), 0.0f, 1.0f) - pa),
+                         dot2(cb * glm::clamp(glm::dot(cb, pb) / dot2(cb), 0.0f, 1.0f) - pb)),
+                     dot2(ac * glm::clamp(glm::dot(ac, pc) / dot2(ac), 0.0f, 1.0f) - pc)) :
+            glm::dot(nor, pa) * glm::dot(nor, pa) / dot2(nor));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool is_front_facing(const glm::vec3& p, const SDFMesh& mesh, uint32_t triangle)
+{
+    uint32_t i0 = mesh.indices[3 * triangle];
+    uint32_t i1 = mesh.indices[3 * triangle + 1];
+    uint32_t i2 = mesh.indices[3 * triangle + 2];
+
+    return glm::dot(glm::normalize(p - mesh.positions[i0]), mesh.normals[i0]) >= 0.0f || glm::dot(glm::normalize(p - mesh.positions[i1]), mesh.normals[i1]) >= 0.0f || glm::dot(glm::normalize(p - mesh.positions[i2]), mesh.normals[i2]) >= 0.0f;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TriangleHit closest_triangle_brute_force(const glm::vec3& p, const SDFMesh& mesh, float max_distance)
+{
+    TriangleHit hit;
+
+    hit.distance = max_distance;
+
+    for (uint32_t i = 0; i < mesh.num_triangles(); i++)
+    {
+        float h = sdf_triangle(p, mesh.positions[mesh.indices[3 * i]], mesh.positions[mesh.indices[3 * i + 1]], mesh.positions[mesh.indices[3 * i + 2]]);
+
+        if (h < hit.distance)
+        {
+            hit.distance = h;
+            hit.triangle = i;
+        }
+    }
+
+    return hit;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float signed_distance(const glm::vec3& p, const SDFMesh& mesh, const BVH& bvh, const WindingNumberTree* winding_number_tree, const BakeSettings& settings)
+{
+    TriangleHit hit = bvh.closest_triangle(p);
+
+    bool front_facing;
+
+    if (settings.sign_mode == SignMode::WINDING_NUMBER)
+        front_facing = !winding_number_tree->is_inside(p, settings.winding_number_beta);
+    else
+        front_facing = hit.triangle == UINT32_MAX || is_front_facing(p, mesh, hit.triangle);
+
+    return front_facing ? hit.distance : -hit.distance;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+SDFVolume bake_sdf(const SDFMesh& mesh, const BakeSettings& settings, BakeStats* stats)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    BakeStats local_stats;
+
+    glm::vec3 mesh_min_extents;
+    glm::vec3 mesh_max_extents;
+
+    compute_extents(mesh, mesh_min_extents, mesh_max_extents);
+
+    SDFVolume volume;
+
+    static_cast<SDFGrid&>(volume) = compute_grid(mesh_min_extents, mesh_max_extents, settings.grid_step_size, settings.padding);
+
+    volume.distances.resize(volume.num_voxels());
+
+    bool use_winding_number = settings.sign_mode == SignMode::WINDING_NUMBER || settings.compare_sign_modes;
+
+    BVH                        bvh;
+    WindingNumberTree          winding_number_tree;
+    std::vector<TriangleBatch> batches;
+
+    auto phase_start = std::chrono::high_resolution_clock::now();
+
+    if (settings.distance_query == DistanceQuery::BVH || use_winding_number)
+        bvh.build(mesh);
+
+    if (settings.distance_query == DistanceQuery::BRUTE_FORCE)
+        batches = make_triangle_batches(mesh);
+
+    local_stats.bvh_ms = elapsed_ms(phase_start);
+
+    if (use_winding_number)
+    {
+        phase_start = std::chrono::high_resolution_clock::now();
+
+        winding_number_tree.build(bvh);
+
+        local_stats.winding_number_ms = elapsed_ms(phase_start);
+    }
+
+    std::atomic<uint64_t> sign_mismatches(0);
+    std::atomic<uint64_t> exact_voxels(0);
+    std::atomic<uint64_t> queried_voxels(0);
+    std::atomic<uint64_t> nodes_visited(0);
+    std::atomic<uint64_t> triangles_tested(0);
+
+    const uint64_t brute_force_tests = uint64_t(batches.size()) * TRIANGLE_BATCH_WIDTH;
+
+    // Writes the signed distance of one voxel. Returns false, leaving the voxel untouched, if no triangle is within max_distance.
+    // Queries are only counted when stats are wanted.
+    auto bake_voxel = [&](int x, int y, int z, float max_distance, uint64_t& mismatches, BVHQueryStats& query_stats) {
+        glm::vec3 p = volume.voxel_position(x, y, z);
+
+        TriangleHit hit;
+
+        if (settings.distance_query == DistanceQuery::BVH)
+            hit = bvh.closest_triangle(p, max_distance, stats ? &query_stats : nullptr);
+        else
+        {
+            hit = closest_triangle_brute_force(p, batches, max_distance);
+            query_stats.triangles_tested += brute_force_tests;
+        }
+
+        if (hit.triangle == UINT32_MAX && max_distance < SDF_INFINITY)
+            return false;
+
+        bool front_facing = true;
+
+        if (settings.sign_mode == SignMode::NORMALS || settings.compare_sign_modes)
+            front_facing = hit.triangle == UINT32_MAX || is_front_facing(p, mesh, hit.triangle);
+
+        if (use_winding_number)
+        {
+            bool outside = !winding_number_tree.is_inside(p, settings.winding_number_beta);
+
+            if (outside != front_facing)
+                mismatches++;
+
+            if (settings.sign_mode == SignMode::WINDING_NUMBER)
+                front_facing = outside;
+        }
+
+        volume.distances[volume.index(x, y, z)] = front_facing ? hit.distance : -hit.distance;
+
+        return true;
+    };
+
+    const uint32_t num_rows = static_cast<uint32_t>(volume.volume_size.y * volume.volume_size.z);
+
+    if (settings.narrow_band > 0)
+    {
+        float band_radius = float(settings.narrow_band) * settings.grid_step_size;
+
+        phase_start = std::chrono::high_resolution_clock::now();
+
+        std::vector<uint8_t> mask;
+        mark_narrow_band(volume, mesh, band_radius, settings.num_threads, mask);
+
+        local_stats.band_ms = elapsed_ms(phase_start);
+        phase_start         = std::chrono::high_resolution_clock::now();
+
+        // Exact distances for the marked voxels. Marked voxels that turn out to be outside the band are left to the fill.
+        parallel_for(num_rows, settings.num_threads, [&](uint32_t row) {
+            int y = static_cast<int>(row % volume.volume_size.y);
+            int z = static_cast<int>(row / volume.volume_size.y);
+
+            uint64_t      row_mismatches = 0;
+            uint64_t      row_exact      = 0;
+            uint64_t      row_queried    = 0;
+            size_t        row_start      = volume.index(0, y, z);
+            BVHQueryStats row_queries;
+
+            for (int x = 0; x < volume.volume_size.x; x++)
+            {
+                if (!mask[row_start + x])
+                    continue;
+
+                row_queried++;
+
+                if (bake_voxel(x, y, z, band_radius, row_mismatches, row_queries))
+                    row_exact++;
+                else
+                    mask[row_start + x] = 0;
+            }
+
+            sign_mismatches += row_mismatches;
+            exact_voxels += row_exact;
+            queried_voxels += row_queried;
+            nodes_visited += row_queries.nodes_visited;
+            triangles_tested += row_queries.triangles_tested;
+        });
+
+        local_stats.distance_ms = elapsed_ms(phase_start);
+        phase_start             = std::chrono::high_resolution_clock::now();
+
+        fill_far_field(volume, mask, band_radius);
+
+        local_stats.fill_ms = elapsed_ms(phase_start);
+    }
+    else
+    {
+        phase_start = std::chrono::high_resolution_clock::now();
+
+        // One work item per row of voxels along x.
+        parallel_for(num_rows, settings.num_threads, [&](uint32_t row) {
+            int y = static_cast<int>(row % volume.volume_size.y);
+            int z = static_cast<int>(row / volume.volume_size.y);
+
+            uint64_t      row_mismatches = 0;
+            BVHQueryStats row_queries;
+
+            for (int x = 0; x < volume.volume_size.x; x++)
+                bake_voxel(x, y, z, SDF_INFINITY, row_mismatches, row_queries);
+
+            sign_mismatches += row_mismatches;
+            nodes_visited += row_queries.nodes_visited;
+            triangles_tested += row_queries.triangles_tested;
+        });
+
+        exact_voxels   = volume.num_voxels();
+        queried_voxels = volume.num_voxels();
+
+        local_stats.distance_ms = elapsed_ms(phase_start);
+    }
+
+    if (stats)
+    {
+        local_stats.sign_mismatches  = settings.compare_sign_modes ? sign_mismatches.load() : 0;
+        local_stats.exact_voxels     = exact_voxels;
+        local_stats.queried_voxels   = queried_voxels;
+        local_stats.nodes_visited    = nodes_visited;
+        local_stats.triangles_tested = triangles_tested;
+        local_stats.total_ms         = elapsed_ms(start);
+
+        *stats = local_stats;
+    }
+
+    return volume;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "sdf_volume.h"
+
+#define SDF_INFINITY 100000000.0f
+
+// Geometry the baker needs: positions and per-vertex normals (used for the sign) plus a triangle list.
+struct SDFMesh
+{
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<uint32_t>  indices;
+
+    inline uint32_t num_triangles() const { return static_cast<uint32_t>(indices.size() / 3); }
+};
+
+// How the closest triangle is found for each voxel.
+enum class DistanceQuery
+{
+    BRUTE_FORCE, // Test every triangle, like bake_sdf_cs.glsl.
+    BVH          // Nearest triangle search through a BVH. Gives the same result.
+};
+
+// How each voxel decides whether it is inside or outside the mesh.
+enum class SignMode
+{
+    NORMALS,       // Vertex normals of the closest triangle, like is_front_facing() in bake_sdf_cs.glsl.
+    WINDING_NUMBER // Generalized winding number. Robust near creases and on open or non-manifold meshes.
+};
+
+struct BakeSettings
+{
+    float         grid_step_size      = 0.025f;
+    int           padding             = 4;
+    uint32_t      num_threads         = 0; // 0 = use all cores.
+    DistanceQuery distance_query      = DistanceQuery::BVH;
+    SignMode      sign_mode           = SignMode::NORMALS;
+    float         winding_number_beta = 2.0f;  // Far field accuracy of the winding number, see WindingNumberTree.
+    bool          compare_sign_modes  = false; // Evaluate both sign modes and count the voxels where they disagree.
+    uint32_t      narrow_band         = 0;     // If > 0, only voxels within this many voxels of the surface get exact distances.
+};
+
+struct BakeStats
+{
+    uint64_t sign_mismatches   = 0; // Only filled in when BakeSettings::compare_sign_modes is set.
+    uint64_t exact_voxels      = 0; // Voxels whose distance was computed against the triangles rather than filled.
+    uint64_t queried_voxels    = 0; // Voxels a distance query ran for, exact ones and narrow band voxels it found outside the band.
+    uint64_t nodes_visited     = 0; // BVH nodes visited by the distance queries, 0 with BRUTE_FORCE.
+    uint64_t triangles_tested  = 0; // Triangle distances evaluated by the distance queries, see BVHQueryStats.
+    double   bvh_ms            = 0.0; // BVH build, or packing the triangle batches with BRUTE_FORCE.
+    double   winding_number_ms = 0.0;
+    double   band_ms           = 0.0; // Marking the narrow band.
+    double   distance_ms       = 0.0; // Exact voxels.
+    double   fill_ms           = 0.0; // Far field of a narrow band bake.
+    double   total_ms          = 0.0;
+
+    // Per distance query, so the triangles tested for voxels that were then left to the fill count in both.
+    inline double triangles_per_voxel() const { return queried_voxels > 0 ? double(triangles_tested) / double(queried_voxels) : 0.0; }
+    inline double nodes_per_voxel() const { return queried_voxels > 0 ? double(nodes_visited) / double(queried_voxels) : 0.0; }
+};
+
+struct TriangleHit
+{
+    float    distance = SDF_INFINITY;
+    uint32_t triangle = UINT32_MAX; // Index of the triangle in the source mesh.
+};
+
+// Builds an SDFMesh from positions and indices. Normals are area weighted averages of the adjacent face normals.
+SDFMesh make_sdf_mesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices);
+
+// Recomputes area weighted vertex normals from the current positions and indices.
+void compute_vertex_normals(SDFMesh& mesh);
+
+// Bounding box of all vertex positions.
+void compute_extents(const SDFMesh& mesh, glm::vec3& min_extents, glm::vec3& max_extents);
+
+// Fills in the grid placement for a mesh bounding box, using the same math as the viewer's bake_sdf().
+SDFGrid compute_grid(const glm::vec3& mesh_min_extents, const glm::vec3& mesh_max_extents, float grid_step_size, int padding);
+
+// Unsigned distance from p to triangle abc. Same expression as sdf_triangle() in bake_sdf_cs.glsl.
+float sdf_triangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
+
+// Sign test against the vertex normals of a triangle. Same expression as is_front_facing() in bake_sdf_cs.glsl.
+bool is_front_facing(const glm::vec3& p, const SDFMesh& mesh, uint32_t triangle);
+
+// Closest triangle to p by testing every triangle in order, the same loop as bake_sdf_cs.glsl.
+TriangleHit closest_triangle_brute_force(const glm::vec3& p, const SDFMesh& mesh, float max_distance = SDF_INFINITY);
+
+class BVH;
+class WindingNumberTree;
+
+// Signed distance from p to the closest triangle in bvh. The sign comes from winding_number_tree when settings.sign_mode is
+// WINDING_NUMBER, and from the vertex normals of the closest triangle otherwise. This is what bake_sdf() writes to a voxel.
+float signed_distance(const glm::vec3& p, const SDFMesh& mesh, const BVH& bvh, const WindingNumberTree* winding_number_tree, const BakeSettings& settings);
+
+// Bakes the mesh into a dense float volume on the CPU using all cores. With the default settings the result matches what
+// bake_sdf_cs.glsl writes. With a narrow band, voxels outside the band are filled by fill_far_field() and hold lower bounds
+// of the true distance, which keeps them safe as sphere tracing step sizes.
+SDFVolume bake_sdf(const SDFMesh& mesh, const BakeSettings& settings, BakeStats* stats = nullptr);
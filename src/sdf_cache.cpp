@@ -0,0 +1,153 @@
+#include "sdf_cache.h"
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#define FNV_OFFSET_BASIS 0xCBF29CE484222325ull
+#define FNV_PRIME 0x100000001B3ull
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static uint64_t hash_bytes(const void* data, size_t size, uint64_t hash)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+template <typename T>
+static uint64_t hash_value(const T& value, uint64_t hash)
+{
+    return hash_bytes(&value, sizeof(T), hash);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint64_t sdf_cache_key(const SDFMesh& mesh, const BakeSettings& settings, SDFEncoding encoding, SDFRangeMode range_mode)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+
+    hash = hash_value(uint32_t(SDF_FILE_VERSION), hash);
+    hash = hash_value(uint64_t(mesh.positions.size()), hash);
+    hash = hash_bytes(mesh.positions.data(), mesh.positions.size() * sizeof(glm::vec3), hash);
+    hash = hash_bytes(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t), hash);
+
+    // Normals only matter when they decide the sign.
+    if (settings.sign_mode == SignMode::NORMALS)
+        hash = hash_bytes(mesh.normals.data(), mesh.normals.size() * sizeof(glm::vec3), hash);
+    else
+        hash = hash_value(settings.winding_number_beta, hash);
+
+    hash = hash_value(settings.grid_step_size, hash);
+    hash = hash_value(settings.padding, hash);
+    hash = hash_value(static_cast<uint32_t>(settings.sign_mode), hash);
+    hash = hash_value(settings.narrow_band, hash);
+    hash = hash_value(static_cast<uint32_t>(encoding), hash);
+
+    // Float encodings have no ranges, whatever the mode.
+    if (encoding == SDFEncoding::UNORM16 || encoding == SDFEncoding::UNORM8)
+        hash = hash_value(static_cast<uint32_t>(range_mode), hash);
+
+    return hash;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+SDFCache::SDFCache(const std::string& directory) :
+    m_directory(directory)
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::string SDFCache::path(uint64_t key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64 ".sdf", key);
+
+    return m_directory + "/" + name;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::shared_ptr<const MappedSDF> SDFCache::map(uint64_t key)
+{
+    auto it = m_loaded.find(key);
+
+    if (it != m_loaded.end())
+    {
+        if (auto sdf = it->second.lock())
+            return sdf;
+    }
+
+    std::string file_path = path(key);
+
+    if (!file_exists(file_path))
+        return nullptr;
+
+    auto sdf = std::make_shared<MappedSDF>();
+
+    // A file from an older version, or one that was cut short, is treated as a miss and gets rebaked.
+    if (!sdf->open(file_path) || sdf->cache_key() != key)
+        return nullptr;
+
+    m_loaded[key] = sdf;
+
+    return sdf;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::shared_ptr<const MappedSDF> SDFCache::find(uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return map(key);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::shared_ptr<const MappedSDF> SDFCache::store(uint64_t key, const QuantizedSDFVolume& volume)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!create_directory(m_directory))
+        return nullptr;
+
+    // Write to a temporary file first so a crash mid-write never leaves a truncated volume under the real name.
+    std::string file_path = path(key);
+    std::string temp_path = file_path + ".tmp";
+
+    if (!write_sdf_file(temp_path, volume, key))
+        return nullptr;
+
+    // Drop the old mapping of this key before replacing its file.
+    m_loaded.erase(key);
+    remove(file_path.c_str());
+
+    if (rename(temp_path.c_str(), file_path.c_str()) != 0)
+        return nullptr;
+
+    return map(key);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::shared_ptr<const MappedSDF> SDFCache::load_or_bake(const SDFMesh& mesh, const BakeSettings& settings, SDFEncoding encoding)
+{
+    uint64_t key = sdf_cache_key(mesh, settings, encoding);
+
+    if (auto sdf = find(key))
+        return sdf;
+
+    return store(key, encode_sdf(bake_sdf(mesh, settings), encoding, SDFRangeMode::PER_VOLUME, nullptr, settings.num_threads));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "sdf_file.h"
+#include "sdf_baker.h"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Hash of everything that changes the baked result: the mesh positions, normals and indices, the bake settings that affect the
+// output, the storage encoding and, for the normalized encodings, the range mode.
+uint64_t sdf_cache_key(const SDFMesh& mesh, const BakeSettings& settings, SDFEncoding encoding, SDFRangeMode range_mode = SDFRangeMode::PER_VOLUME);
+
+// Directory of baked volumes named after their cache key. Volumes are memory mapped when loaded, and a volume that is still
+// in use is handed out again instead of being mapped twice, so every instance of a mesh shares one copy.
+class SDFCache
+{
+public:
+    SDFCache(const std::string& directory = "sdf_cache");
+
+    // The volume for key, or nullptr if it isn't in memory or on disk.
+    std::shared_ptr<const MappedSDF> find(uint64_t key);
+
+    // Writes the volume to disk and returns it mapped from there.
+    std::shared_ptr<const MappedSDF> store(uint64_t key, const QuantizedSDFVolume& volume);
+
+    // Looks the mesh up and only bakes it on a miss.
+    std::shared_ptr<const MappedSDF> load_or_bake(const SDFMesh& mesh, const BakeSettings& settings, SDFEncoding encoding = SDFEncoding::FLOAT32);
+
+    std::string path(uint64_t key) const;
+
+private:
+    std::shared_ptr<const MappedSDF> map(uint64_t key);
+
+private:
+    std::string                                                  m_directory;
+    std::mutex                                                   m_mutex;
+    std::unordered_map<uint64_t, std::weak_ptr<const MappedSDF>> m_loaded;
+};
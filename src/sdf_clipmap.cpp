@@ -0,0 +1,326 @@
+#include "sdf_clipmap.h"
+#include "parallel.h"
+
+#include <algorithm>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+SDFClipmap::SDFClipmap(uint32_t num_levels, uint32_t resolution, float voxel_size, uint32_t num_threads) :
+    m_resolution(resolution), m_num_threads(num_threads)
+{
+    m_levels.resize(num_levels);
+
+    for (uint32_t i = 0; i < num_levels; i++)
+    {
+        m_levels[i].voxel_size = voxel_size * float(1u << i);
+        m_levels[i].origin     = glm::ivec3(0);
+        m_levels[i].distances.resize(size_t(resolution) * size_t(resolution) * size_t(resolution), 0.0f);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+glm::ivec3 SDFClipmap::texel(const glm::ivec3& c) const
+{
+    int        r = static_cast<int>(m_resolution);
+    glm::ivec3 t;
+
+    for (int i = 0; i < 3; i++)
+        t[i] = ((c[i] % r) + r) % r;
+
+    return t;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float SDFClipmap::voxel(uint32_t level, const glm::ivec3& c) const
+{
+    glm::ivec3 t = texel(c);
+
+    return m_levels[level].distances[size_t(t.x) + size_t(m_resolution) * (size_t(t.y) + size_t(m_resolution) * size_t(t.z))];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void SDFClipmap::mark_dirty(uint32_t level, const glm::ivec3& min_voxel, const glm::ivec3& max_voxel)
+{
+    int        r     = static_cast<int>(m_resolution);
+    glm::ivec3 start = texel(min_voxel);
+    glm::ivec3 size  = max_voxel - min_voxel + glm::ivec3(1);
+
+    // A box that crosses the edge of the texture is split there, into up to 2 pieces per axis.
+    int pieces[3][2][2];
+    int num_pieces[3];
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (start[i] + size[i] <= r)
+        {
+            pieces[i][0][0] = start[i];
+            pieces[i][0][1] = size[i];
+            num_pieces[i]   = 1;
+        }
+        else
+        {
+            pieces[i][0][0] = start[i];
+            pieces[i][0][1] = r - start[i];
+            pieces[i][1][0] = 0;
+            pieces[i][1][1] = start[i] + size[i] - r;
+            num_pieces[i]   = 2;
+        }
+    }
+
+    for (int z = 0; z < num_pieces[2]; z++)
+    {
+        for (int y = 0; y < num_pieces[1]; y++)
+        {
+            for (int x = 0; x < num_pieces[0]; x++)
+            {
+                SDFClipmapRegion region;
+
+                region.level  = level;
+                region.offset = glm::ivec3(pieces[0][x][0], pieces[1][y][0], pieces[2][z][0]);
+                region.size   = glm::ivec3(pieces[0][x][1], pieces[1][y][1], pieces[2][z][1]);
+
+                m_dirty_regions.push_back(region);
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint64_t SDFClipmap::compose(uint32_t level, const std::vector<SDFInstance>& instances, glm::ivec3 min_voxel, glm::ivec3 max_voxel)
+{
+    Level& l = m_levels[level];
+
+    min_voxel = glm::max(min_voxel, l.origin);
+    max_voxel = glm::min(max_voxel, l.origin + glm::ivec3(m_resolution - 1));
+
+    if (glm::any(glm::lessThan(max_voxel, min_voxel)))
+        return 0;
+
+    const float band = this->band(level);
+
+    // Instances whose box is further than the band from the region clamp to the band everywhere in it.
+    glm::vec3 region_min = glm::vec3(min_voxel) * l.voxel_size - glm::vec3(band);
+    glm::vec3 region_max = glm::vec3(max_voxel) * l.voxel_size + glm::vec3(band);
+
+    std::vector<uint32_t> candidates;
+
+    for (uint32_t i = 0; i < instances.size(); i++)
+    {
+        glm::vec3 box_min;
+        glm::vec3 box_max;
+
+        instance_box_extents(m_boxes[i], box_min, box_max);
+
+        if (glm::all(glm::lessThanEqual(box_min, region_max)) && glm::all(glm::greaterThanEqual(box_max, region_min)))
+            candidates.push_back(i);
+    }
+
+    const glm::ivec3 size     = max_voxel - min_voxel + glm::ivec3(1);
+    const uint32_t   num_rows = static_cast<uint32_t>(size.y * size.z);
+
+    parallel_for(num_rows, m_num_threads, [&](uint32_t row) {
+        int y = min_voxel.y + static_cast<int>(row % size.y);
+        int z = min_voxel.z + static_cast<int>(row / size.y);
+
+        for (int x = min_voxel.x; x <= max_voxel.x; x++)
+        {
+            glm::ivec3 c = glm::ivec3(x, y, z);
+            glm::vec3  p = glm::vec3(c) * l.voxel_size;
+            float      d = band;
+
+            // Same pruning as InstanceBVH::nearest_instance(), boxes that contain p are always evaluated.
+            for (uint32_t i : candidates)
+            {
+                float box_distance = distance_to_obb(p, m_boxes[i]);
+
+                if (box_distance > INSTANCE_BVH_INSIDE_EPSILON && box_distance >= d)
+                    continue;
+
+                d = std::min(d, evaluate_mesh_sdf(instances[i], p));
+            }
+
+            glm::ivec3 t = texel(c);
+
+            l.distances[size_t(t.x) + size_t(m_resolution) * (size_t(t.y) + size_t(m_resolution) * size_t(t.z))] = d;
+        }
+    });
+
+    mark_dirty(level, min_voxel, max_voxel);
+
+    return uint64_t(size.x) * uint64_t(size.y) * uint64_t(size.z);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint64_t SDFClipmap::compose_box(uint32_t level, const std::vector<SDFInstance>& instances, const glm::vec3& min_extents, const glm::vec3& max_extents)
+{
+    const float voxel_size = m_levels[level].voxel_size;
+    const float band       = this->band(level);
+
+    glm::ivec3 min_voxel = glm::ivec3(glm::floor((min_extents - glm::vec3(band)) / voxel_size));
+    glm::ivec3 max_voxel = glm::ivec3(glm::ceil((max_extents + glm::vec3(band)) / voxel_size));
+
+    return compose(level, instances, min_voxel, max_voxel);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void SDFClipmap::update(const std::vector<SDFInstance>& instances, const std::vector<uint32_t>& changed, const glm::vec3& center, SDFClipmapUpdateStats* stats)
+{
+    std::vector<InstanceBox> previous_boxes;
+
+    previous_boxes.swap(m_boxes);
+    m_boxes.resize(instances.size());
+
+    for (uint32_t i = 0; i < instances.size(); i++)
+        m_boxes[i] = instance_box(instances[i]);
+
+    // Added and removed instances change the scene like moved ones.
+    std::vector<uint32_t> touched = changed;
+
+    for (size_t i = std::min(previous_boxes.size(), m_boxes.size()); i < std::max(previous_boxes.size(), m_boxes.size()); i++)
+        touched.push_back(static_cast<uint32_t>(i));
+
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+
+    SDFClipmapUpdateStats local_stats;
+
+    const int        r    = static_cast<int>(m_resolution);
+    const glm::ivec3 last = glm::ivec3(r - 1);
+
+    for (uint32_t level = 0; level < m_levels.size(); level++)
+    {
+        Level& l = m_levels[level];
+
+        glm::ivec3 origin = glm::ivec3(glm::floor(center / l.voxel_size)) - glm::ivec3(r / 2);
+        glm::ivec3 delta  = origin - l.origin;
+
+        local_stats.total_voxels += l.distances.size();
+
+        if (delta != glm::ivec3(0))
+            local_stats.scrolled_levels++;
+
+        // A level that moved by its whole size has nothing left to keep.
+        if (!m_initialized || glm::any(glm::greaterThanEqual(glm::abs(delta), glm::ivec3(r))))
+        {
+            l.origin = origin;
+            local_stats.recomposed_voxels += compose(level, instances, origin, origin + last);
+            continue;
+        }
+
+        l.origin = origin;
+
+        // The slab that came into view on every axis the level moved along.
+        for (int i = 0; i < 3; i++)
+        {
+            if (delta[i] == 0)
+                continue;
+
+            glm::ivec3 min_voxel = origin;
+            glm::ivec3 max_voxel = origin + last;
+
+            if (delta[i] > 0)
+                min_voxel[i] = origin[i] + r - delta[i];
+            else
+                max_voxel[i] = origin[i] - delta[i] - 1;
+
+            local_stats.recomposed_voxels += compose(level, instances, min_voxel, max_voxel);
+        }
+
+        // The band around where each changed instance was and where it is now. When the two overlap, which is the usual case
+        // for an animated instance, they are composed as one box.
+        const float band = this->band(level);
+
+        for (uint32_t i : touched)
+        {
+            glm::vec3 old_min = glm::vec3(SDF_INFINITY);
+            glm::vec3 old_max = glm::vec3(-SDF_INFINITY);
+            glm::vec3 new_min = glm::vec3(SDF_INFINITY);
+            glm::vec3 new_max = glm::vec3(-SDF_INFINITY);
+
+            if (i < previous_boxes.size())
+                instance_box_extents(previous_boxes[i], old_min, old_max);
+
+            if (i < m_boxes.size())
+                instance_box_extents(m_boxes[i], new_min, new_max);
+
+            bool overlap = glm::all(glm::lessThanEqual(old_min, new_max + glm::vec3(2.0f * band))) && glm::all(glm::greaterThanEqual(old_max, new_min - glm::vec3(2.0f * band)));
+
+            if (overlap)
+                local_stats.recomposed_voxels += compose_box(level, instances, glm::min(old_min, new_min), glm::max(old_max, new_max));
+            else
+            {
+                if (i < previous_boxes.size())
+                    local_stats.recomposed_voxels += compose_box(level, instances, old_min, old_max);
+
+                if (i < m_boxes.size())
+                    local_stats.recomposed_voxels += compose_box(level, instances, new_min, new_max);
+            }
+        }
+    }
+
+    m_initialized = true;
+
+    if (stats)
+        *stats = local_stats;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t SDFClipmap::find_level(const glm::vec3& ws_p) const
+{
+    const glm::vec3 last = glm::vec3(float(m_resolution - 1));
+
+    for (uint32_t level = 0; level < m_levels.size(); level++)
+    {
+        glm::vec3 t = ws_p / m_levels[level].voxel_size - glm::vec3(m_levels[level].origin);
+
+        if (glm::all(glm::greaterThanEqual(t, glm::vec3(0.0f))) && glm::all(glm::lessThan(t, last)))
+            return level;
+    }
+
+    return UINT32_MAX;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float SDFClipmap::sample(uint32_t level, const glm::vec3& ws_p) const
+{
+    const Level& l = m_levels[level];
+
+    glm::vec3 t = ws_p / l.voxel_size - glm::vec3(l.origin);
+
+    return sample_trilinear(glm::ivec3(m_resolution), t, [&](int x, int y, int z) { return voxel(level, l.origin + glm::ivec3(x, y, z)); });
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float evaluate_scene_clipmap(const std::vector<SDFInstance>& instances, const InstanceBVH& bvh, const SDFClipmap& clipmap, const glm::vec3& ws_p, bool* truncated, InstanceQueryStats* stats)
+{
+    if (truncated)
+        *truncated = false;
+
+    uint32_t level = clipmap.find_level(ws_p);
+
+    if (level != UINT32_MAX)
+    {
+        float h = clipmap.sample(level, ws_p);
+
+        if (h > SDF_CLIPMAP_REFINE_VOXELS * clipmap.voxel_size(level))
+        {
+            if (truncated)
+                *truncated = h >= clipmap.band(level);
+
+            return h;
+        }
+    }
+
+    return evaluate_scene_sdf(instances, bvh, ws_p, -SDF_INFINITY, stats).distance;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
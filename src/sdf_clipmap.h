@@ -0,0 +1,100 @@
+#pragma once
+
+#include "scene_sdf.h"
+
+// Default layout: 4 levels of 64^3 voxels, 0.125 apart in level 0 and twice as far apart in every further level, so the
+// coarsest level spans 64 units around the camera.
+#define SDF_CLIPMAP_LEVELS 4
+#define SDF_CLIPMAP_RESOLUTION 64
+#define SDF_CLIPMAP_VOXEL_SIZE 0.125f
+
+// Distances are stored up to this many voxels of their level. Larger ones are clamped to it, so an instance can only change the
+// voxels within the band around its box, which is what keeps updates local.
+#define SDF_CLIPMAP_BAND_VOXELS 8
+
+// Closer to the surface than this many voxels, the interpolation error of a level is a large part of the distance and the
+// instances are evaluated instead.
+#define SDF_CLIPMAP_REFINE_VOXELS 2.0f
+
+// Box of voxels of one level that changed, in texel coordinates of its texture. Never wraps around the texture.
+struct SDFClipmapRegion
+{
+    uint32_t   level;
+    glm::ivec3 offset;
+    glm::ivec3 size;
+};
+
+struct SDFClipmapUpdateStats
+{
+    uint32_t scrolled_levels   = 0; // Levels whose origin moved with the center.
+    uint64_t recomposed_voxels = 0; // Voxels evaluated again, including the ones recomposed twice by overlapping regions.
+    uint64_t total_voxels      = 0; // Voxels of all levels.
+};
+
+// Camera centred clipmap of the scene SDF: every level is a world space grid that stores the minimum over all instances,
+// clamped to the band, at its voxels. A query costs one trilinear sample instead of a distance per instance.
+//
+// Voxel c of a level sits at c * voxel_size in world space, and is stored at c modulo the resolution on every axis, so a level
+// that scrolls with the center keeps its voxels where they are and only the slabs that came into view are composed. The same
+// toroidal addressing is what GL_REPEAT does, so a level's texture is sampled at (ws_p / voxel_size + 0.5) / resolution.
+class SDFClipmap
+{
+public:
+    SDFClipmap(uint32_t num_levels = SDF_CLIPMAP_LEVELS, uint32_t resolution = SDF_CLIPMAP_RESOLUTION, float voxel_size = SDF_CLIPMAP_VOXEL_SIZE, uint32_t num_threads = 0);
+
+    // Centres the levels on center and composes the voxels that need it: all of them on the first update, the slabs that
+    // scrolled into a level, and the band around the previous and current box of every instance in changed. Instances that
+    // were added or removed since the last update count as changed. The volumes of the instances are only read during the call.
+    void update(const std::vector<SDFInstance>& instances, const std::vector<uint32_t>& changed, const glm::vec3& center, SDFClipmapUpdateStats* stats = nullptr);
+
+    // Finest level whose voxels around ws_p are all inside it, UINT32_MAX if ws_p is outside the coarsest one.
+    uint32_t find_level(const glm::vec3& ws_p) const;
+
+    // Trilinear sample of a level, which must contain ws_p. Like textureLod() with GL_LINEAR and GL_REPEAT on its texture.
+    float sample(uint32_t level, const glm::vec3& ws_p) const;
+
+    // Stored value of voxel c, in world voxel coordinates of level. c must be inside the level.
+    float voxel(uint32_t level, const glm::ivec3& c) const;
+
+    // Regions changed since clear_dirty_regions(), for partial texture uploads.
+    inline const std::vector<SDFClipmapRegion>& dirty_regions() const { return m_dirty_regions; }
+    inline void                                 clear_dirty_regions() { m_dirty_regions.clear(); }
+
+    inline uint32_t     num_levels() const { return static_cast<uint32_t>(m_levels.size()); }
+    inline uint32_t     resolution() const { return m_resolution; }
+    inline float        voxel_size(uint32_t level) const { return m_levels[level].voxel_size; }
+    inline float        band(uint32_t level) const { return m_levels[level].voxel_size * float(SDF_CLIPMAP_BAND_VOXELS); }
+    inline glm::ivec3   origin(uint32_t level) const { return m_levels[level].origin; } // World voxel coordinate of the first voxel.
+    inline const float* data(uint32_t level) const { return m_levels[level].distances.data(); }
+
+private:
+    struct Level
+    {
+        float              voxel_size;
+        glm::ivec3         origin;
+        std::vector<float> distances; // resolution^3 voxels, addressed by texel().
+    };
+
+    glm::ivec3 texel(const glm::ivec3& c) const;
+
+    // Composes the voxels of [min_voxel, max_voxel] that are inside the level and marks them dirty.
+    uint64_t compose(uint32_t level, const std::vector<SDFInstance>& instances, glm::ivec3 min_voxel, glm::ivec3 max_voxel);
+
+    // Composes the voxels within the band of a world space box.
+    uint64_t compose_box(uint32_t level, const std::vector<SDFInstance>& instances, const glm::vec3& min_extents, const glm::vec3& max_extents);
+
+    void mark_dirty(uint32_t level, const glm::ivec3& min_voxel, const glm::ivec3& max_voxel);
+
+private:
+    std::vector<Level>            m_levels;
+    uint32_t                      m_resolution;
+    uint32_t                      m_num_threads;
+    bool                          m_initialized = false;
+    std::vector<InstanceBox>      m_boxes; // Boxes of the instances as of the last update.
+    std::vector<SDFClipmapRegion> m_dirty_regions;
+};
+
+// CPU equivalent of evaluate_scene_sdf() in mesh_fs.glsl with the clipmap in use: a single clipmap sample where a level covers
+// ws_p and the sample is more than SDF_CLIPMAP_REFINE_VOXELS voxels from the surface, the instances through the BVH otherwise.
+// truncated is set when the result is the band of a level, and so only a lower bound. stats, if given, counts the BVH query.
+float evaluate_scene_clipmap(const std::vector<SDFInstance>& instances, const InstanceBVH& bvh, const SDFClipmap& clipmap, const glm::vec3& ws_p, bool* truncated = nullptr, InstanceQueryStats* stats = nullptr);
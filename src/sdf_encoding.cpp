@@ -0,0 +1,284 @@
+#include "sdf_encoding.h"
+#include "sdf_baker.h"
+#include "parallel.h"
+
+#include <string.h>
+
+#define HALF_MAX 65504.0f
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint16_t float_to_half(float value)
+{
+    value = std::min(std::max(value, -HALF_MAX), HALF_MAX);
+
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign     = (bits >> 16) & 0x8000u;
+    int32_t  exponent = int32_t((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+
+    if (exponent <= 0)
+    {
+        // Subnormal half, or zero.
+        if (exponent < -10)
+            return static_cast<uint16_t>(sign);
+
+        mantissa |= 0x800000u;
+
+        uint32_t shift     = static_cast<uint32_t>(14 - exponent);
+        uint32_t half_mant = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1u);
+        uint32_t halfway   = 1u << (shift - 1);
+
+        if (remainder > halfway || (remainder == halfway && (half_mant & 1u)))
+            half_mant++;
+
+        return static_cast<uint16_t>(sign | half_mant);
+    }
+
+    // Round to nearest even. A carry out of the mantissa correctly bumps the exponent.
+    uint32_t half      = sign | (uint32_t(exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFFu;
+
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+        half++;
+
+    return static_cast<uint16_t>(half);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float half_to_float(uint16_t value)
+{
+    uint32_t sign     = uint32_t(value & 0x8000u) << 16;
+    uint32_t exponent = (value >> 10) & 0x1Fu;
+    uint32_t mantissa = value & 0x3FFu;
+    uint32_t bits;
+
+    if (exponent == 0)
+    {
+        if (mantissa == 0)
+            bits = sign;
+        else
+        {
+            // Renormalize a subnormal half.
+            exponent = 127 - 15 + 1;
+
+            while ((mantissa & 0x400u) == 0)
+            {
+                mantissa <<= 1;
+                exponent--;
+            }
+
+            bits = sign | (exponent << 23) | ((mantissa & 0x3FFu) << 13);
+        }
+    }
+    else if (exponent == 0x1F)
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    else
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+
+    return result;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t encoding_size(SDFEncoding encoding)
+{
+    switch (encoding)
+    {
+        case SDFEncoding::FLOAT32: return 4;
+        case SDFEncoding::FLOAT16: return 2;
+        case SDFEncoding::UNORM16: return 2;
+        case SDFEncoding::UNORM8: return 1;
+    }
+
+    return 4;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float decode_voxel(SDFEncoding encoding, const uint8_t* data, size_t index, const glm::vec2* range)
+{
+    switch (encoding)
+    {
+        case SDFEncoding::FLOAT32:
+        {
+            float value;
+            memcpy(&value, &data[index * 4], sizeof(value));
+            return value;
+        }
+        case SDFEncoding::FLOAT16:
+        {
+            uint16_t value;
+            memcpy(&value, &data[index * 2], sizeof(value));
+            return half_to_float(value);
+        }
+        case SDFEncoding::UNORM16:
+        {
+            uint16_t value;
+            memcpy(&value, &data[index * 2], sizeof(value));
+            return range->x + range->y * (float(value) / 65535.0f);
+        }
+        case SDFEncoding::UNORM8:
+            return range->x + range->y * (float(data[index]) / 255.0f);
+    }
+
+    return 0.0f;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+SDFVolumeView QuantizedSDFVolume::view() const
+{
+    SDFVolumeView view;
+
+    static_cast<SDFGrid&>(view) = *this;
+
+    view.encoding        = encoding;
+    view.range_mode      = range_mode;
+    view.range_grid_size = range_grid_size;
+    view.ranges          = ranges.empty() ? nullptr : ranges.data();
+    view.data            = data.data();
+
+    return view;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+QuantizedSDFVolume encode_sdf(const SDFVolume& volume, SDFEncoding encoding, SDFRangeMode range_mode, QuantizationError* error, uint32_t num_threads)
+{
+    QuantizedSDFVolume quantized;
+
+    static_cast<SDFGrid&>(quantized) = volume;
+
+    quantized.encoding   = encoding;
+    quantized.range_mode = range_mode;
+    quantized.data.resize(volume.num_voxels() * encoding_size(encoding));
+
+    bool normalized = encoding == SDFEncoding::UNORM16 || encoding == SDFEncoding::UNORM8;
+
+    if (normalized)
+    {
+        quantized.range_grid_size = range_mode == SDFRangeMode::PER_BRICK ? (volume.volume_size + glm::ivec3(SDF_BRICK_SIZE - 1)) / SDF_BRICK_SIZE : glm::ivec3(1);
+
+        // Min and max of the voxels each range covers.
+        std::vector<glm::vec2> min_max(size_t(quantized.range_grid_size.x) * size_t(quantized.range_grid_size.y) * size_t(quantized.range_grid_size.z), glm::vec2(SDF_INFINITY, -SDF_INFINITY));
+
+        for (int z = 0; z < volume.volume_size.z; z++)
+        {
+            for (int y = 0; y < volume.volume_size.y; y++)
+            {
+                for (int x = 0; x < volume.volume_size.x; x++)
+                {
+                    size_t r = range_index(range_mode, quantized.range_grid_size, x, y, z);
+                    float  d = volume.voxel(x, y, z);
+
+                    min_max[r].x = std::min(min_max[r].x, d);
+                    min_max[r].y = std::max(min_max[r].y, d);
+                }
+            }
+        }
+
+        quantized.ranges.resize(min_max.size());
+
+        for (size_t i = 0; i < min_max.size(); i++)
+            quantized.ranges[i] = min_max[i].x <= min_max[i].y ? glm::vec2(min_max[i].x, min_max[i].y - min_max[i].x) : glm::vec2(0.0f);
+    }
+
+    const uint32_t num_rows   = static_cast<uint32_t>(volume.volume_size.y * volume.volume_size.z);
+    const float    max_normal = encoding == SDFEncoding::UNORM16 ? 65535.0f : 255.0f;
+
+    std::vector<float>  row_max_error(num_rows, 0.0f);
+    std::vector<double> row_sum_sq_error(num_rows, 0.0);
+
+    parallel_for(num_rows, num_threads, [&](uint32_t row) {
+        int y = static_cast<int>(row % volume.volume_size.y);
+        int z = static_cast<int>(row / volume.volume_size.y);
+
+        for (int x = 0; x < volume.volume_size.x; x++)
+        {
+            size_t idx = volume.index(x, y, z);
+            float  d   = volume.distances[idx];
+
+            switch (encoding)
+            {
+                case SDFEncoding::FLOAT32:
+                    memcpy(&quantized.data[idx * 4], &d, sizeof(d));
+                    break;
+                case SDFEncoding::FLOAT16:
+                {
+                    uint16_t value = float_to_half(d);
+                    memcpy(&quantized.data[idx * 2], &value, sizeof(value));
+                    break;
+                }
+                case SDFEncoding::UNORM16:
+                case SDFEncoding::UNORM8:
+                {
+                    const glm::vec2& r     = quantized.range(x, y, z);
+                    float            n     = r.y > 0.0f ? glm::clamp((d - r.x) / r.y, 0.0f, 1.0f) : 0.0f;
+                    uint32_t         value = static_cast<uint32_t>(n * max_normal + 0.5f);
+
+                    if (encoding == SDFEncoding::UNORM16)
+                    {
+                        uint16_t value16 = static_cast<uint16_t>(value);
+                        memcpy(&quantized.data[idx * 2], &value16, sizeof(value16));
+                    }
+                    else
+                        quantized.data[idx] = static_cast<uint8_t>(value);
+                    break;
+                }
+            }
+
+            float e = fabsf(quantized.voxel(x, y, z) - d);
+
+            row_max_error[row] = std::max(row_max_error[row], e);
+            row_sum_sq_error[row] += double(e) * double(e);
+        }
+    });
+
+    if (error)
+    {
+        double sum_sq_error = 0.0;
+
+        error->max_error = 0.0f;
+
+        for (uint32_t i = 0; i < num_rows; i++)
+        {
+            error->max_error = std::max(error->max_error, row_max_error[i]);
+            sum_sq_error += row_sum_sq_error[i];
+        }
+
+        error->rms_error = volume.num_voxels() > 0 ? static_cast<float>(sqrt(sum_sq_error / double(volume.num_voxels()))) : 0.0f;
+    }
+
+    return quantized;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+SDFVolume decode_sdf(const SDFVolumeView& volume)
+{
+    SDFVolume decoded;
+
+    static_cast<SDFGrid&>(decoded) = volume;
+    decoded.distances.resize(volume.num_voxels());
+
+    for (int z = 0; z < volume.volume_size.z; z++)
+    {
+        for (int y = 0; y < volume.volume_size.y; y++)
+        {
+            for (int x = 0; x < volume.volume_size.x; x++)
+                decoded.distances[volume.index(x, y, z)] = volume.voxel(x, y, z);
+        }
+    }
+
+    return decoded;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
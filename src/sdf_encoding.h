@@ -0,0 +1,90 @@
+#pragma once
+
+#include "sparse_volume.h"
+
+// Storage format of the voxels of a baked volume.
+enum class SDFEncoding
+{
+    FLOAT32, // GL_R32F, what bake_sdf() produces.
+    FLOAT16, // GL_R16F.
+    UNORM16, // GL_R16, scaled to a distance range.
+    UNORM8   // GL_R8, scaled to a distance range.
+};
+
+// Which voxels share a distance range for the normalized encodings.
+enum class SDFRangeMode
+{
+    PER_VOLUME,
+    PER_BRICK // One range per SDF_BRICK_SIZE^3 block of voxels.
+};
+
+// Index of the range that covers a voxel.
+inline size_t range_index(SDFRangeMode range_mode, const glm::ivec3& range_grid_size, int x, int y, int z)
+{
+    if (range_mode == SDFRangeMode::PER_VOLUME)
+        return 0;
+
+    return size_t(x / SDF_BRICK_SIZE) + size_t(range_grid_size.x) * (size_t(y / SDF_BRICK_SIZE) + size_t(range_grid_size.y) * size_t(z / SDF_BRICK_SIZE));
+}
+
+// Decodes voxel number index of an encoded x-major array. range is only read by the normalized encodings.
+float decode_voxel(SDFEncoding encoding, const uint8_t* data, size_t index, const glm::vec2* range);
+
+// Non-owning view of an encoded volume, for example a QuantizedSDFVolume or a memory mapped SDF file.
+struct SDFVolumeView : public SDFGrid
+{
+    SDFEncoding      encoding        = SDFEncoding::FLOAT32;
+    SDFRangeMode     range_mode      = SDFRangeMode::PER_VOLUME;
+    glm::ivec3       range_grid_size = glm::ivec3(1);
+    const glm::vec2* ranges          = nullptr;
+    const uint8_t*   data            = nullptr;
+
+    inline float voxel(int x, int y, int z) const { return decode_voxel(encoding, data, index(x, y, z), ranges ? &ranges[range_index(range_mode, range_grid_size, x, y, z)] : nullptr); }
+};
+
+// Dense volume stored in one of the SDFEncoding formats. Normalized values decode as range.x + range.y * n, with n in [0, 1].
+struct QuantizedSDFVolume : public SDFGrid
+{
+    SDFEncoding            encoding        = SDFEncoding::FLOAT32;
+    SDFRangeMode           range_mode      = SDFRangeMode::PER_VOLUME;
+    glm::ivec3             range_grid_size = glm::ivec3(1);
+    std::vector<glm::vec2> ranges; // (bias, scale) per volume or per brick. Unused for the float encodings.
+    std::vector<uint8_t>   data;   // Encoded voxels in the same x-major layout as SDFVolume.
+
+    inline const glm::vec2& range(int x, int y, int z) const { return ranges[range_index(range_mode, range_grid_size, x, y, z)]; }
+
+    inline float voxel(int x, int y, int z) const { return decode_voxel(encoding, data.data(), index(x, y, z), ranges.empty() ? nullptr : &range(x, y, z)); }
+
+    SDFVolumeView view() const;
+
+    inline size_t memory_bytes() const { return data.size() + ranges.size() * sizeof(glm::vec2); }
+};
+
+struct QuantizationError
+{
+    float max_error = 0.0f; // Largest absolute difference to the float bake over all voxels.
+    float rms_error = 0.0f;
+};
+
+uint16_t float_to_half(float value);
+float    half_to_float(uint16_t value);
+
+// Bytes per voxel of an encoding.
+uint32_t encoding_size(SDFEncoding encoding);
+
+// Encodes a float volume. The error of every voxel against the float value is measured while encoding.
+QuantizedSDFVolume encode_sdf(const SDFVolume& volume, SDFEncoding encoding, SDFRangeMode range_mode = SDFRangeMode::PER_VOLUME, QuantizationError* error = nullptr, uint32_t num_threads = 0);
+
+// Decodes back to a dense float volume.
+SDFVolume decode_sdf(const SDFVolumeView& volume);
+
+// CPU equivalent of sample_sdf() in mesh_fs.glsl that filters the decoded texels of a quantized volume.
+inline float sample_sdf(const QuantizedSDFVolume& volume, const glm::vec3& os_p)
+{
+    return sample_trilinear(volume.volume_size, texel_coordinate(volume, os_p), [&](int x, int y, int z) { return volume.voxel(x, y, z); });
+}
+
+inline float sample_sdf(const SDFVolumeView& volume, const glm::vec3& os_p)
+{
+    return sample_trilinear(volume.volume_size, texel_coordinate(volume, os_p), [&](int x, int y, int z) { return volume.voxel(x, y, z); });
+}
@@ -0,0 +1,138 @@
+#include "sdf_file.h"
+
+#include <fstream>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static inline uint64_t align_up(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+SDFFileHeader make_sdf_file_header(const SDFVolumeView& volume, uint32_t num_ranges, uint64_t cache_key)
+{
+    SDFFileHeader header = {};
+
+    header.magic          = SDF_FILE_MAGIC;
+    header.version        = SDF_FILE_VERSION;
+    header.grid_step_size = volume.grid_step_size;
+    header.encoding       = static_cast<uint32_t>(volume.encoding);
+    header.range_mode     = static_cast<uint32_t>(volume.range_mode);
+    header.num_ranges     = num_ranges;
+    header.cache_key      = cache_key;
+
+    for (int i = 0; i < 3; i++)
+    {
+        header.volume_size[i]     = volume.volume_size[i];
+        header.grid_origin[i]     = volume.grid_origin[i];
+        header.min_extents[i]     = volume.min_extents[i];
+        header.max_extents[i]     = volume.max_extents[i];
+        header.range_grid_size[i] = volume.range_grid_size[i];
+    }
+
+    header.ranges_offset  = align_up(sizeof(SDFFileHeader), SDF_FILE_ALIGNMENT);
+    header.payload_offset = align_up(header.ranges_offset + num_ranges * sizeof(glm::vec2), SDF_FILE_ALIGNMENT);
+    header.payload_size   = volume.num_voxels() * encoding_size(volume.encoding);
+
+    return header;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool write_sdf_file(const std::string& path, const SDFVolumeView& volume, uint32_t num_ranges, uint64_t cache_key)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    if (!file.is_open())
+        return false;
+
+    SDFFileHeader header = make_sdf_file_header(volume, num_ranges, cache_key);
+    const char    zeros[SDF_FILE_ALIGNMENT] = {};
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(zeros, header.ranges_offset - sizeof(header));
+
+    if (num_ranges > 0)
+        file.write(reinterpret_cast<const char*>(volume.ranges), num_ranges * sizeof(glm::vec2));
+
+    file.write(zeros, header.payload_offset - (header.ranges_offset + num_ranges * sizeof(glm::vec2)));
+    file.write(reinterpret_cast<const char*>(volume.data), header.payload_size);
+
+    return file.good();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool MappedSDF::open(const std::string& path)
+{
+    m_header = nullptr;
+
+    if (!m_file.open(path))
+        return false;
+
+    if (m_file.size() < sizeof(SDFFileHeader))
+        return false;
+
+    const SDFFileHeader* header = reinterpret_cast<const SDFFileHeader*>(m_file.data());
+
+    if (header->magic != SDF_FILE_MAGIC || header->version != SDF_FILE_VERSION || header->encoding > static_cast<uint32_t>(SDFEncoding::UNORM8))
+        return false;
+
+    SDFVolumeView view;
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (header->volume_size[i] <= 0)
+            return false;
+
+        view.volume_size[i]     = header->volume_size[i];
+        view.grid_origin[i]     = header->grid_origin[i];
+        view.min_extents[i]     = header->min_extents[i];
+        view.max_extents[i]     = header->max_extents[i];
+        view.range_grid_size[i] = header->range_grid_size[i];
+    }
+
+    view.grid_step_size = header->grid_step_size;
+    view.encoding       = static_cast<SDFEncoding>(header->encoding);
+    view.range_mode     = static_cast<SDFRangeMode>(header->range_mode);
+
+    // Reject truncated or inconsistent files rather than reading past the mapping.
+    if (header->payload_size != view.num_voxels() * encoding_size(view.encoding))
+        return false;
+
+    if (header->ranges_offset + header->num_ranges * sizeof(glm::vec2) > header->payload_offset || header->payload_offset + header->payload_size > m_file.size())
+        return false;
+
+    if (header->range_mode > static_cast<uint32_t>(SDFRangeMode::PER_BRICK))
+        return false;
+
+    // Normalized encodings need exactly the ranges their mode indexes: one, or one per brick of a brick grid that covers the
+    // volume. Float encodings have none.
+    bool     normalized = view.encoding == SDFEncoding::UNORM16 || view.encoding == SDFEncoding::UNORM8;
+    uint64_t num_ranges = 0;
+
+    if (normalized && view.range_mode == SDFRangeMode::PER_VOLUME)
+        num_ranges = 1;
+    else if (normalized)
+    {
+        if (view.range_grid_size != (view.volume_size + glm::ivec3(SDF_BRICK_SIZE - 1)) / SDF_BRICK_SIZE)
+            return false;
+
+        num_ranges = uint64_t(view.range_grid_size.x) * uint64_t(view.range_grid_size.y) * uint64_t(view.range_grid_size.z);
+    }
+
+    if (header->num_ranges != num_ranges)
+        return false;
+
+    view.ranges = header->num_ranges > 0 ? reinterpret_cast<const glm::vec2*>(m_file.data() + header->ranges_offset) : nullptr;
+    view.data   = m_file.data() + header->payload_offset;
+
+    m_header = header;
+    m_view   = view;
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "sdf_encoding.h"
+#include "mapped_file.h"
+
+#define SDF_FILE_MAGIC 0x31464453u // "SDF1"
+#define SDF_FILE_VERSION 2
+#define SDF_FILE_ALIGNMENT 64
+
+// Header at the start of every .sdf file. It is followed by the distance ranges (for the normalized encodings) and then by
+// the encoded voxels, in the same x-major layout as SDFVolume. Both start at a multiple of SDF_FILE_ALIGNMENT.
+struct SDFFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    int32_t  volume_size[3];
+    float    grid_origin[3];
+    float    grid_step_size;
+    float    min_extents[3];
+    float    max_extents[3];
+    uint32_t encoding;
+    uint32_t range_mode;
+    int32_t  range_grid_size[3];
+    uint32_t num_ranges;
+    uint32_t reserved;
+    uint64_t cache_key;
+    uint64_t ranges_offset;
+    uint64_t payload_offset;
+    uint64_t payload_size;
+};
+
+static_assert(sizeof(SDFFileHeader) == 120, "SDFFileHeader must not contain padding");
+
+// Fills in a header for volume. num_ranges is the number of (bias, scale) pairs that follow it.
+SDFFileHeader make_sdf_file_header(const SDFVolumeView& volume, uint32_t num_ranges, uint64_t cache_key);
+
+bool write_sdf_file(const std::string& path, const SDFVolumeView& volume, uint32_t num_ranges, uint64_t cache_key = 0);
+
+inline bool write_sdf_file(const std::string& path, const QuantizedSDFVolume& volume, uint64_t cache_key = 0)
+{
+    return write_sdf_file(path, volume.view(), static_cast<uint32_t>(volume.ranges.size()), cache_key);
+}
+
+// A .sdf file mapped into memory. The voxels are read straight from the mapping without a copy.
+class MappedSDF
+{
+public:
+    bool open(const std::string& path);
+
+    inline const SDFFileHeader& header() const { return *m_header; }
+    inline const SDFVolumeView& view() const { return m_view; }
+    inline uint64_t             cache_key() const { return m_header->cache_key; }
+
+private:
+    MappedFile           m_file;
+    const SDFFileHeader* m_header = nullptr;
+    SDFVolumeView        m_view;
+};
@@ -0,0 +1,257 @@
+#include "sdf_pyramid.h"
+#include "sdf_baker.h"
+#include "parallel.h"
+
+#include <algorithm>
+
+#define SDF_HIT_DISTANCE 0.001f
+
+// Inclusive range of full resolution voxels along one axis.
+struct VoxelWindow
+{
+    int begin;
+    int end;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Size of a mip level, matching GL.
+static glm::ivec3 level_size(const glm::ivec3& size, uint32_t level)
+{
+    return glm::ivec3(std::max(size.x >> level, 1), std::max(size.y >> level, 1), std::max(size.z >> level, 1));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Voxels along an axis whose minimum bounds each texel of a level with level_size texels on that axis.
+static std::vector<VoxelWindow> voxel_windows(const SDFVolume& volume, int axis, int level_size)
+{
+    const float min_extent = volume.min_extents[axis];
+    const float max_extent = volume.max_extents[axis];
+    const float spacing    = (max_extent - min_extent) / float(level_size);
+    const float origin     = volume.grid_origin[axis];
+    const float step       = volume.grid_step_size;
+    const int   size       = volume.volume_size[axis];
+
+    std::vector<VoxelWindow> windows(level_size);
+
+    for (int i = 0; i < level_size; i++)
+    {
+        // Every point of the texel's cell has a voxel within half a step. Rounding the window outwards only adds voxels, which
+        // keeps the minimum a lower bound.
+        float lo = min_extent + float(i) * spacing;
+        float hi = std::min(lo + spacing, max_extent);
+
+        windows[i].begin = glm::clamp(static_cast<int>(floorf((lo - origin) / step - 0.5f)), 0, size - 1);
+        windows[i].end   = glm::clamp(static_cast<int>(ceilf((hi - origin) / step + 0.5f)), 0, size - 1);
+    }
+
+    return windows;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static SDFVolume build_level(const SDFVolume& volume, const glm::ivec3& size, uint32_t num_threads)
+{
+    const glm::ivec3 full = volume.volume_size;
+
+    std::vector<VoxelWindow> windows_x = voxel_windows(volume, 0, size.x);
+    std::vector<VoxelWindow> windows_y = voxel_windows(volume, 1, size.y);
+    std::vector<VoxelWindow> windows_z = voxel_windows(volume, 2, size.z);
+
+    // The windows form a box, so the minimum is separable: reduce x, then y, then z.
+    std::vector<float> pass_x(size_t(size.x) * size_t(full.y) * size_t(full.z));
+    std::vector<float> pass_y(size_t(size.x) * size_t(size.y) * size_t(full.z));
+
+    parallel_for(static_cast<uint32_t>(full.y * full.z), num_threads, [&](uint32_t row) {
+        int    y   = static_cast<int>(row % full.y);
+        int    z   = static_cast<int>(row / full.y);
+        float* dst = &pass_x[size_t(row) * size_t(size.x)];
+
+        for (int x = 0; x < size.x; x++)
+        {
+            float closest = SDF_INFINITY;
+
+            for (int i = windows_x[x].begin; i <= windows_x[x].end; i++)
+                closest = std::min(closest, volume.voxel(i, y, z));
+
+            dst[x] = closest;
+        }
+    });
+
+    parallel_for(static_cast<uint32_t>(size.y * full.z), num_threads, [&](uint32_t row) {
+        int    y   = static_cast<int>(row % size.y);
+        int    z   = static_cast<int>(row / size.y);
+        float* dst = &pass_y[size_t(row) * size_t(size.x)];
+
+        for (int x = 0; x < size.x; x++)
+        {
+            float closest = SDF_INFINITY;
+
+            for (int i = windows_y[y].begin; i <= windows_y[y].end; i++)
+                closest = std::min(closest, pass_x[size_t(x) + size_t(size.x) * (size_t(i) + size_t(full.y) * size_t(z))]);
+
+            dst[x] = closest;
+        }
+    });
+
+    SDFVolume level;
+
+    glm::vec3 spacing = (volume.max_extents - volume.min_extents) / glm::vec3(size);
+
+    level.volume_size    = size;
+    level.min_extents    = volume.min_extents;
+    level.max_extents    = volume.max_extents;
+    level.grid_origin    = volume.min_extents + spacing * 0.5f;
+    level.grid_step_size = std::max(spacing.x, std::max(spacing.y, spacing.z));
+    level.distances.resize(level.num_voxels());
+
+    // Any point is at most half a step away from a voxel on every axis.
+    const float voxel_slack = sqrtf(3.0f) * 0.5f * volume.grid_step_size;
+
+    parallel_for(static_cast<uint32_t>(size.y * size.z), num_threads, [&](uint32_t row) {
+        int    y   = static_cast<int>(row % size.y);
+        int    z   = static_cast<int>(row / size.y);
+        float* dst = &level.distances[size_t(row) * size_t(size.x)];
+
+        for (int x = 0; x < size.x; x++)
+        {
+            float closest = SDF_INFINITY;
+
+            for (int i = windows_z[z].begin; i <= windows_z[z].end; i++)
+                closest = std::min(closest, pass_y[size_t(x) + size_t(size.x) * (size_t(y) + size_t(size.y) * size_t(i))]);
+
+            dst[x] = closest - voxel_slack;
+        }
+    });
+
+    return level;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+SDFPyramid build_sdf_pyramid(const SDFVolume& volume, uint32_t num_levels, uint32_t num_threads)
+{
+    SDFPyramid pyramid;
+
+    if (num_levels == 0)
+    {
+        num_levels = 1;
+
+        while (num_levels < SDF_PYRAMID_MAX_LEVELS && glm::all(glm::greaterThanEqual(level_size(volume.volume_size, num_levels), glm::ivec3(2))))
+            num_levels++;
+    }
+
+    pyramid.levels.reserve(num_levels);
+    pyramid.levels.push_back(volume);
+    pyramid.error_bounds.push_back(0.0f);
+
+    for (uint32_t i = 1; i < num_levels; i++)
+    {
+        pyramid.levels.push_back(build_level(volume, level_size(volume.volume_size, i), num_threads));
+
+        // The window of a texel reaches at most a spacing plus one and a half steps from any point of its cell, and every texel
+        // was lowered by the distance to the nearest voxel.
+        float spacing = pyramid.levels.back().grid_step_size;
+        pyramid.error_bounds.push_back(sqrtf(3.0f) * (spacing + 2.0f * volume.grid_step_size));
+    }
+
+    return pyramid;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t select_sdf_level(const SDFPyramid& pyramid, float step_hint)
+{
+    for (uint32_t i = pyramid.num_levels() - 1; i > 0; i--)
+    {
+        if (pyramid.error_bounds[i] <= SDF_PYRAMID_ERROR_RATIO * step_hint)
+            return i;
+    }
+
+    return 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+size_t SDFMarchStats::cache_lines()
+{
+    std::sort(lines.begin(), lines.end());
+
+    return static_cast<size_t>(std::unique(lines.begin(), lines.end()) - lines.begin());
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float sample_sdf(const SDFPyramid& pyramid, const glm::vec3& os_p, uint32_t level, SDFMarchStats* stats)
+{
+    const SDFVolume& volume = pyramid.levels[level];
+
+    auto fetch = [&](int x, int y, int z) {
+        const float* texel = &volume.distances[volume.index(x, y, z)];
+
+        if (stats)
+        {
+            stats->fetches++;
+            stats->lines.push_back(reinterpret_cast<uintptr_t>(texel) / SDF_CACHE_LINE_SIZE);
+        }
+
+        return *texel;
+    };
+
+    if (stats)
+        stats->samples++;
+
+    glm::vec3 p       = glm::clamp(os_p, volume.min_extents, volume.max_extents);
+    float     outside = glm::length(os_p - p);
+
+    if (level == 0)
+        return outside + sample_trilinear(volume.volume_size, texel_coordinate(volume, p), fetch);
+
+    glm::ivec3 texel = glm::clamp(glm::ivec3(glm::floor(texel_coordinate(volume, p) + glm::vec3(0.5f))), glm::ivec3(0), volume.volume_size - glm::ivec3(1));
+
+    return outside + fetch(texel.x, texel.y, texel.z);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float sample_sdf_coarse_to_fine(const SDFPyramid& pyramid, const glm::vec3& os_p, float step_hint, SDFMarchStats* stats)
+{
+    const SDFVolume& volume = pyramid.levels[0];
+
+    // Points outside the box are at least as far from the surface as from the box.
+    float    to_box = glm::length(os_p - glm::clamp(os_p, volume.min_extents, volume.max_extents));
+    uint32_t level  = select_sdf_level(pyramid, std::max(step_hint, to_box));
+    float    h      = sample_sdf(pyramid, os_p, level, stats);
+
+    while (level > 0 && h < pyramid.error_bounds[level])
+    {
+        level = std::min(level - 1, select_sdf_level(pyramid, h));
+        h     = sample_sdf(pyramid, os_p, level, stats);
+    }
+
+    return h;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float march_sdf_ray(const SDFPyramid& pyramid, const glm::vec3& ro, const glm::vec3& rd, float t_min, float t_max, bool coarse_to_fine, SDFMarchStats* stats)
+{
+    float step_hint = 0.0f;
+
+    for (float t = t_min; t < t_max;)
+    {
+        glm::vec3 p = ro + rd * t;
+        float     h = coarse_to_fine ? sample_sdf_coarse_to_fine(pyramid, p, step_hint, stats) : sample_sdf(pyramid, p, 0, stats);
+
+        if (h < SDF_HIT_DISTANCE)
+            return t;
+
+        t += h;
+        step_hint = h;
+    }
+
+    return -1.0f;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "sdf_sampler.h"
+
+// Number of levels build_sdf_pyramid() creates by default, including the full resolution level.
+#define SDF_PYRAMID_MAX_LEVELS 5
+
+// A level is used for a step if its worst case underestimate is at most this fraction of the step. Lower values keep steps
+// closer to their full length but switch to the finer levels earlier.
+#define SDF_PYRAMID_ERROR_RATIO 0.5f
+
+#define SDF_CACHE_LINE_SIZE 64
+
+// Mip chain of a volume where every coarser level is conservative: the texel of level l whose cell contains a point inside the
+// volume's box never exceeds the true distance at that point, so a coarse step costs a single unfiltered fetch. Level sizes
+// follow the GL rule max(1, size >> l) so the levels can be uploaded as the mips of the volume's texture.
+struct SDFPyramid
+{
+    // Level 0 is a copy of the baked volume. The grid of a coarser level keeps the extents of the volume; grid_step_size is
+    // the largest of its texel spacings, which can differ per axis because of the rounding of the level sizes.
+    std::vector<SDFVolume> levels;
+    std::vector<float>     error_bounds; // Largest amount a sample of each level can be below the true distance.
+
+    inline uint32_t num_levels() const { return static_cast<uint32_t>(levels.size()); }
+
+    inline size_t memory_bytes() const
+    {
+        size_t bytes = 0;
+
+        for (const auto& level : levels)
+            bytes += level.distances.size() * sizeof(float);
+
+        return bytes;
+    }
+};
+
+// Memory traffic of a set of samples, usually one ray.
+struct SDFMarchStats
+{
+    uint32_t               samples = 0;
+    uint32_t               fetches = 0;
+    std::vector<uintptr_t> lines; // SDF_CACHE_LINE_SIZE byte line of every fetch, over all levels and volumes.
+
+    // Distinct lines the fetches touched. Sorts lines.
+    size_t cache_lines();
+
+    inline size_t bytes_touched() { return cache_lines() * SDF_CACHE_LINE_SIZE; }
+};
+
+// Builds the pyramid of a baked volume. Each texel of a coarser level stores the minimum of the full resolution voxels around
+// its cell, minus the largest distance from a point to its nearest voxel. The baked voxels are taken as exact.
+// num_levels = 0 builds up to SDF_PYRAMID_MAX_LEVELS levels and stops before any dimension would drop below 2 texels.
+SDFPyramid build_sdf_pyramid(const SDFVolume& volume, uint32_t num_levels = 0, uint32_t num_threads = 0);
+
+// Coarsest level that is safe to take a step from when the previous step was step_hint long.
+uint32_t select_sdf_level(const SDFPyramid& pyramid, float step_hint);
+
+// Trilinear sample of level 0 or nearest texel of a coarser level, like sample_sdf_lod() in mesh_fs.glsl. Points outside the
+// box use the distance to the box plus the distance at the closest point on it, like evaluate_mesh_sdf().
+float sample_sdf(const SDFPyramid& pyramid, const glm::vec3& os_p, uint32_t level, SDFMarchStats* stats = nullptr);
+
+// Samples the coarsest level that is safe for a step after one of step_hint, and refines while most of the step would be lost
+// to the level's error. This also keeps a coarse underestimate from being taken for a hit. Like sample_sdf_coarse_to_fine() in
+// mesh_fs.glsl.
+float sample_sdf_coarse_to_fine(const SDFPyramid& pyramid, const glm::vec3& os_p, float step_hint, SDFMarchStats* stats = nullptr);
+
+// Shadow ray march through a single volume in object space, like shadow_ray_march() in mesh_fs.glsl. With coarse_to_fine
+// every step uses sample_sdf_coarse_to_fine() with the previous step as the hint, otherwise every step reads level 0.
+// Returns the distance along the ray of the hit, or a negative value if the ray reached t_max.
+float march_sdf_ray(const SDFPyramid& pyramid, const glm::vec3& ro, const glm::vec3& rd, float t_min, float t_max, bool coarse_to_fine, SDFMarchStats* stats = nullptr);
@@ -0,0 +1,149 @@
+#include "sdf_query.h"
+#include "sparse_volume.h"
+#include "parallel.h"
+#include "profiler.h"
+
+#include <chrono>
+#include <algorithm>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Instance in the high 24 bits, brick of its volume in the low 40, in the order the volume stores them.
+static uint64_t query_key(const std::vector<SDFInstance>& instances, const std::vector<InstanceBox>& boxes, const InstanceBVH& bvh, const glm::vec3& ws_p)
+{
+    // The first box that contains p, or the closest one.
+    InstanceHit hit = bvh.nearest_instance(
+        ws_p, [&](uint32_t i) { return distance_to_obb(ws_p, boxes[i]); }, 0.0f);
+
+    if (hit.instance == UINT32_MAX)
+        return UINT64_MAX;
+
+    const SDFInstance& instance = instances[hit.instance];
+    const SDFVolume&   volume   = *instance.volume;
+
+    glm::vec3  os_p   = glm::vec3(instance.inverse_transform * glm::vec4(ws_p, 1.0f));
+    glm::ivec3 voxel  = glm::clamp(glm::ivec3(texel_coordinate(volume, os_p) + glm::vec3(0.5f)), glm::ivec3(0), volume.volume_size - glm::ivec3(1));
+    glm::ivec3 brick  = voxel / SDF_BRICK_SIZE;
+    glm::ivec3 bricks = (volume.volume_size + glm::ivec3(SDF_BRICK_SIZE - 1)) / SDF_BRICK_SIZE;
+
+    uint64_t index = uint64_t(brick.x) + uint64_t(bricks.x) * (uint64_t(brick.y) + uint64_t(bricks.y) * uint64_t(brick.z));
+
+    return (uint64_t(hit.instance) << 40) | index;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Closest instance to the sphere at center, and the distance and gradient of that instance, from the same evaluations the BVH
+// search makes.
+static SDFQueryResult query(const std::vector<SDFInstance>& instances, const InstanceBVH& bvh, const glm::vec3& center, float radius, InstanceQueryStats& stats)
+{
+    SDFQueryResult result;
+
+    InstanceHit hit = bvh.nearest_instance(
+        center,
+        [&](uint32_t i) {
+            glm::vec3 gradient;
+            float     h = evaluate_mesh_sdf_gradient(instances[i], center, gradient);
+
+            // nearest_instance() keeps the first of equal distances, so does this.
+            if (h < result.distance)
+            {
+                result.distance = h;
+                result.gradient = gradient;
+            }
+
+            return h;
+        },
+        -SDF_INFINITY,
+        &stats);
+
+    result.instance = hit.instance;
+
+    if (hit.instance != UINT32_MAX)
+        result.distance = hit.distance - radius;
+
+    return result;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+template <typename Sphere>
+static void query_spheres(const std::vector<SDFInstance>& instances, const InstanceBVH& bvh, uint32_t count, Sphere&& sphere, SDFQueryResult* results, const SDFQuerySettings& settings, SDFQueryStats* stats)
+{
+    SDFQueryStats local_stats;
+
+    local_stats.num_queries = count;
+
+    std::vector<uint32_t> order(count);
+
+    for (uint32_t i = 0; i < count; i++)
+        order[i] = i;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    if (settings.sort && !instances.empty())
+    {
+        std::vector<InstanceBox> boxes(instances.size());
+
+        for (uint32_t i = 0; i < instances.size(); i++)
+            boxes[i] = instance_box(instances[i]);
+
+        // Keys next to their query index, which also breaks ties in the given order.
+        std::vector<std::pair<uint64_t, uint32_t>> keys(count);
+
+        parallel_for(count, settings.num_threads, [&](uint32_t i) { keys[i] = std::make_pair(query_key(instances, boxes, bvh, glm::vec3(sphere(i))), i); }, SDF_QUERY_BATCH_SIZE);
+
+        std::sort(keys.begin(), keys.end());
+
+        for (uint32_t i = 0; i < count; i++)
+            order[i] = keys[i].second;
+
+        local_stats.sort_ms = elapsed_ms(start);
+    }
+
+    start = std::chrono::high_resolution_clock::now();
+
+    const uint32_t num_batches = (count + SDF_QUERY_BATCH_SIZE - 1) / SDF_QUERY_BATCH_SIZE;
+
+    std::vector<InstanceQueryStats> batch_stats(num_batches);
+
+    parallel_for(num_batches, settings.num_threads, [&](uint32_t batch) {
+        uint32_t end = std::min(count, (batch + 1) * SDF_QUERY_BATCH_SIZE);
+
+        for (uint32_t i = batch * SDF_QUERY_BATCH_SIZE; i < end; i++)
+        {
+            glm::vec4 s = sphere(order[i]);
+
+            results[order[i]] = query(instances, bvh, glm::vec3(s), s.w, batch_stats[batch]);
+        }
+    });
+
+    local_stats.query_ms = elapsed_ms(start);
+
+    for (const auto& s : batch_stats)
+    {
+        local_stats.instances_evaluated += s.instances_evaluated;
+        local_stats.nodes_visited += s.nodes_visited;
+    }
+
+    if (stats)
+        *stats = local_stats;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void query_sdf_points(const std::vector<SDFInstance>& instances, const InstanceBVH& bvh, const glm::vec3* points, uint32_t count, SDFQueryResult* results, const SDFQuerySettings& settings, SDFQueryStats* stats)
+{
+    query_spheres(
+        instances, bvh, count, [&](uint32_t i) { return glm::vec4(points[i], 0.0f); }, results, settings, stats);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void query_sdf_spheres(const std::vector<SDFInstance>& instances, const InstanceBVH& bvh, const glm::vec4* spheres, uint32_t count, SDFQueryResult* results, const SDFQuerySettings& settings, SDFQueryStats* stats)
+{
+    query_spheres(
+        instances, bvh, count, [&](uint32_t i) { return spheres[i]; }, results, settings, stats);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "scene_sdf.h"
+
+// Queries handed to a thread at a time, consecutive in sorted order.
+#define SDF_QUERY_BATCH_SIZE 64
+
+struct SDFQuerySettings
+{
+    uint32_t num_threads = 0;     // 0 = use all cores.
+    bool     sort        = false; // Evaluate queries grouped by instance and brick rather than in the order given. Off by
+                                  // default: on the bundled scenes, keying and sorting cost more than the locality saves.
+};
+
+struct SDFQueryResult
+{
+    float     distance = SDF_INFINITY;    // Signed distance to the closest instance, for spheres from the sphere's surface.
+    glm::vec3 gradient = glm::vec3(0.0f); // World space gradient of the distance, close to unit length. Points away from the surface.
+    uint32_t  instance = UINT32_MAX;      // Closest instance, UINT32_MAX for an empty scene.
+};
+
+struct SDFQueryStats
+{
+    uint64_t num_queries         = 0;
+    uint64_t instances_evaluated = 0;
+    uint64_t nodes_visited       = 0;
+    double   sort_ms             = 0.0; // Finding the instance and brick of every query and sorting by them.
+    double   query_ms            = 0.0;
+};
+
+// Distance, gradient and closest instance of the scene at every world space point, the value evaluate_scene_sdf() finds through
+// the instance BVH. With settings.sort, every query is first keyed by the instance box it is in, or the closest one, and the
+// SDF_BRICK_SIZE^3 brick of that volume it falls in, and queries are evaluated in key order so consecutive ones read the same
+// voxels. results are in the order of points either way.
+void query_sdf_points(const std::vector<SDFInstance>& instances, const InstanceBVH& bvh, const glm::vec3* points, uint32_t count, SDFQueryResult* results, const SDFQuerySettings& settings = SDFQuerySettings(), SDFQueryStats* stats = nullptr);
+
+// The same for spheres given as center and radius in w. The distance is from the sphere's surface, so it is negative when the
+// sphere overlaps an instance, and the gradient is the direction that separates them.
+void query_sdf_spheres(const std::vector<SDFInstance>& instances, const InstanceBVH& bvh, const glm::vec4* spheres, uint32_t count, SDFQueryResult* results, const SDFQuerySettings& settings = SDFQuerySettings(), SDFQueryStats* stats = nullptr);
@@ -0,0 +1,215 @@
+#include "sdf_rebaker.h"
+#include "parallel.h"
+
+#include <algorithm>
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void sort_unique(std::vector<uint32_t>& values)
+{
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+const SDFVolume& SDFRebaker::bake(const SDFMesh& mesh, const BakeSettings& settings, BakeStats* stats)
+{
+    m_mesh     = mesh;
+    m_settings = settings;
+    m_volume   = bake_sdf(mesh, settings, stats);
+
+    m_bvh.build(m_mesh);
+
+    if (m_settings.sign_mode == SignMode::WINDING_NUMBER)
+        m_winding_number_tree.build(m_bvh);
+
+    // Triangles around every vertex, in triangle order so update_normal() sums like compute_vertex_normals().
+    m_vertex_offsets.assign(m_mesh.positions.size() + 1, 0);
+
+    for (uint32_t index : m_mesh.indices)
+        m_vertex_offsets[index + 1]++;
+
+    for (size_t i = 1; i < m_vertex_offsets.size(); i++)
+        m_vertex_offsets[i] += m_vertex_offsets[i - 1];
+
+    std::vector<uint32_t> fill(m_vertex_offsets.begin(), m_vertex_offsets.end() - 1);
+
+    m_vertex_triangles.resize(m_mesh.indices.size());
+
+    for (uint32_t i = 0; i < m_mesh.indices.size(); i++)
+        m_vertex_triangles[fill[m_mesh.indices[i]]++] = i / 3;
+
+    return m_volume;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void SDFRebaker::update_normal(uint32_t vertex)
+{
+    glm::vec3 n = glm::vec3(0.0f);
+
+    for (uint32_t i = m_vertex_offsets[vertex]; i < m_vertex_offsets[vertex + 1]; i++)
+    {
+        uint32_t tri = m_vertex_triangles[i];
+
+        const glm::vec3& a = m_mesh.positions[m_mesh.indices[3 * tri]];
+        const glm::vec3& b = m_mesh.positions[m_mesh.indices[3 * tri + 1]];
+        const glm::vec3& c = m_mesh.positions[m_mesh.indices[3 * tri + 2]];
+
+        n += glm::cross(b - a, c - a);
+    }
+
+    float len = glm::length(n);
+
+    m_mesh.normals[vertex] = len > 0.0f ? n / len : n;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool SDFRebaker::update(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& changed_triangles, RebakeStats* stats)
+{
+    std::vector<uint32_t> moved;
+
+    for (uint32_t tri : changed_triangles)
+    {
+        for (uint32_t j = 0; j < 3; j++)
+        {
+            uint32_t v = m_mesh.indices[3 * tri + j];
+
+            if (positions[v] != m_mesh.positions[v])
+                moved.push_back(v);
+        }
+    }
+
+    sort_unique(moved);
+
+    // Every triangle around a moved vertex changes shape, which changes the normals of all of its corners, which in turn change
+    // the sign test of every triangle around those.
+    std::vector<uint32_t> shape_changed;
+    std::vector<uint32_t> normal_changed;
+    std::vector<uint32_t> affected;
+
+    for (uint32_t v : moved)
+        shape_changed.insert(shape_changed.end(), m_vertex_triangles.begin() + m_vertex_offsets[v], m_vertex_triangles.begin() + m_vertex_offsets[v + 1]);
+
+    sort_unique(shape_changed);
+
+    for (uint32_t tri : shape_changed)
+        normal_changed.insert(normal_changed.end(), m_mesh.indices.begin() + 3 * tri, m_mesh.indices.begin() + 3 * tri + 3);
+
+    sort_unique(normal_changed);
+
+    for (uint32_t v : normal_changed)
+        affected.insert(affected.end(), m_vertex_triangles.begin() + m_vertex_offsets[v], m_vertex_triangles.begin() + m_vertex_offsets[v + 1]);
+
+    sort_unique(affected);
+
+    for (uint32_t v : moved)
+    {
+        if (glm::any(glm::lessThan(positions[v], m_volume.min_extents)) || glm::any(glm::greaterThan(positions[v], m_volume.max_extents)))
+            return false;
+    }
+
+    // Old and new bounds of everything that can change a voxel. A voxel further from them than its stored distance keeps its
+    // closest triangle and sign.
+    glm::vec3 min_extents = glm::vec3(SDF_INFINITY);
+    glm::vec3 max_extents = glm::vec3(-SDF_INFINITY);
+
+    for (uint32_t tri : affected)
+    {
+        for (uint32_t j = 0; j < 3; j++)
+        {
+            uint32_t v = m_mesh.indices[3 * tri + j];
+
+            min_extents = glm::min(min_extents, glm::min(m_mesh.positions[v], positions[v]));
+            max_extents = glm::max(max_extents, glm::max(m_mesh.positions[v], positions[v]));
+        }
+    }
+
+    for (uint32_t v : moved)
+        m_mesh.positions[v] = positions[v];
+
+    for (uint32_t v : normal_changed)
+        update_normal(v);
+
+    m_bvh.refit(m_mesh, shape_changed);
+
+    if (m_settings.sign_mode == SignMode::WINDING_NUMBER)
+        m_winding_number_tree.build(m_bvh);
+
+    const uint32_t num_rows = static_cast<uint32_t>(m_volume.volume_size.y * m_volume.volume_size.z);
+
+    std::vector<int>      row_min_x(num_rows, m_volume.volume_size.x);
+    std::vector<int>      row_max_x(num_rows, -1);
+    std::atomic<uint64_t> rebaked_voxels(0);
+
+    // Voxels of a narrow band bake that are further from the edit than the band only need a lower bound, like the far field.
+    const float band_radius = m_settings.narrow_band > 0 ? float(m_settings.narrow_band) * m_settings.grid_step_size : SDF_INFINITY;
+
+    if (!shape_changed.empty())
+    {
+        parallel_for(num_rows, m_settings.num_threads, [&](uint32_t row) {
+            int y = static_cast<int>(row % m_volume.volume_size.y);
+            int z = static_cast<int>(row / m_volume.volume_size.y);
+
+            uint64_t row_rebaked = 0;
+
+            for (int x = 0; x < m_volume.volume_size.x; x++)
+            {
+                glm::vec3 p = m_volume.voxel_position(x, y, z);
+                float&    d = m_volume.distances[m_volume.index(x, y, z)];
+
+                float to_box_sq = distance_to_box_sq(p, min_extents, max_extents);
+
+                if (to_box_sq > d * d * SDF_REBAKE_SLACK)
+                    continue;
+
+                row_min_x[row] = std::min(row_min_x[row], x);
+                row_max_x[row] = x;
+                row_rebaked++;
+
+                // Outside the band, the edit can only have brought the surface as close as the bounds. The voxel keeps its
+                // side, since only points inside the bounds can change sides.
+                if (to_box_sq > band_radius * band_radius)
+                {
+                    d = d < 0.0f ? -sqrtf(to_box_sq) : sqrtf(to_box_sq);
+                    continue;
+                }
+
+                d = signed_distance(p, m_mesh, m_bvh, &m_winding_number_tree, m_settings);
+            }
+
+            rebaked_voxels += row_rebaked;
+        });
+    }
+
+    if (stats)
+    {
+        stats->changed_triangles  = static_cast<uint32_t>(shape_changed.size());
+        stats->affected_triangles = static_cast<uint32_t>(affected.size());
+        stats->rebaked_voxels     = rebaked_voxels;
+        stats->total_voxels       = m_volume.num_voxels();
+        stats->region_min         = m_volume.volume_size;
+        stats->region_max         = glm::ivec3(-1);
+
+        for (uint32_t row = 0; row < num_rows; row++)
+        {
+            if (row_max_x[row] < 0)
+                continue;
+
+            glm::ivec3 first = glm::ivec3(row_min_x[row], row % m_volume.volume_size.y, row / m_volume.volume_size.y);
+            glm::ivec3 last  = glm::ivec3(row_max_x[row], first.y, first.z);
+
+            stats->region_min = glm::min(stats->region_min, first);
+            stats->region_max = glm::max(stats->region_max, last);
+        }
+
+        if (stats->rebaked_voxels == 0)
+            stats->region_min = glm::ivec3(0);
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
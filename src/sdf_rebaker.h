@@ -0,0 +1,49 @@
+#pragma once
+
+#include "winding_number.h"
+
+// Relative margin on the squared distance when deciding whether an edit can reach a voxel. Like BVH_PRUNE_SLACK, it keeps
+// voxels whose stored distance ties with the edited triangles within rounding.
+#define SDF_REBAKE_SLACK 1.0001f
+
+struct RebakeStats
+{
+    uint32_t   changed_triangles  = 0;              // Triangles whose shape changed.
+    uint32_t   affected_triangles = 0;              // Those plus the triangles whose vertex normals changed.
+    uint64_t   rebaked_voxels     = 0;              // Voxels whose distance was recomputed or lowered.
+    uint64_t   total_voxels       = 0;              // Voxels a full bake computes.
+    glm::ivec3 region_min         = glm::ivec3(0);  // Inclusive voxel bounds of the rebaked voxels, for partial uploads.
+    glm::ivec3 region_max         = glm::ivec3(-1); // Below region_min when nothing was rebaked.
+};
+
+// Keeps a baked volume together with its BVH so the volume can follow edits of the mesh. After a vertex moves, only voxels whose
+// stored distance reaches the old or new bounds of the triangles around it can change, and only those are recomputed, with the
+// refitted BVH. The result is the same as a new bake of the edited mesh into the same grid. With a narrow band, recomputed
+// voxels outside the band get the distance to the edit's bounds instead, which like the far field fill never overestimates.
+class SDFRebaker
+{
+public:
+    // Full bake of mesh. The mesh is copied and kept for later updates.
+    const SDFVolume& bake(const SDFMesh& mesh, const BakeSettings& settings, BakeStats* stats = nullptr);
+
+    // Moves the vertices of changed_triangles to their positions in positions and updates the volume in place. positions holds
+    // every vertex of the mesh, and only the vertices of changed_triangles are read. The grid stays the same, so an edit that
+    // leaves the volume's box is rejected and returns false without changing anything; bake the mesh again in that case.
+    bool update(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& changed_triangles, RebakeStats* stats = nullptr);
+
+    inline const SDFVolume& volume() const { return m_volume; }
+    inline const SDFMesh&   mesh() const { return m_mesh; }
+    inline const BVH&       bvh() const { return m_bvh; }
+
+private:
+    void update_normal(uint32_t vertex);
+
+private:
+    SDFMesh               m_mesh;
+    BakeSettings          m_settings;
+    SDFVolume             m_volume;
+    BVH                   m_bvh;
+    WindingNumberTree     m_winding_number_tree;
+    std::vector<uint32_t> m_vertex_offsets;   // First entry of each vertex in m_vertex_triangles.
+    std::vector<uint32_t> m_vertex_triangles; // Triangles around every vertex.
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "sdf_volume.h"
+
+// Continuous texel coordinate of an object space point, using the same mapping as sample_sdf() in mesh_fs.glsl: the
+// [min_extents, max_extents] box is stretched over the whole texture and texel centres sit at half integers.
+inline glm::vec3 texel_coordinate(const SDFGrid& grid, const glm::vec3& os_p)
+{
+    glm::vec3 uvw = (os_p - grid.min_extents) / (grid.max_extents - grid.min_extents);
+    return uvw * glm::vec3(grid.volume_size) - glm::vec3(0.5f);
+}
+
+// Trilinear filter with clamp to edge addressing, like GL_LINEAR + GL_CLAMP_TO_EDGE. fetch(x, y, z) returns a single texel
+// and is only called with coordinates inside size, which lets the same filter run over any storage layout.
+template <typename Fetch>
+float sample_trilinear(const glm::ivec3& size, const glm::vec3& texel, Fetch&& fetch)
+{
+    glm::vec3  base = glm::floor(texel);
+    glm::vec3  f    = texel - base;
+    glm::ivec3 i0   = glm::clamp(glm::ivec3(base), glm::ivec3(0), size - glm::ivec3(1));
+    glm::ivec3 i1   = glm::clamp(glm::ivec3(base) + glm::ivec3(1), glm::ivec3(0), size - glm::ivec3(1));
+
+    float c000 = fetch(i0.x, i0.y, i0.z);
+    float c100 = fetch(i1.x, i0.y, i0.z);
+    float c010 = fetch(i0.x, i1.y, i0.z);
+    float c110 = fetch(i1.x, i1.y, i0.z);
+    float c001 = fetch(i0.x, i0.y, i1.z);
+    float c101 = fetch(i1.x, i0.y, i1.z);
+    float c011 = fetch(i0.x, i1.y, i1.z);
+    float c111 = fetch(i1.x, i1.y, i1.z);
+
+    float c00 = c000 + (c100 - c000) * f.x;
+    float c10 = c010 + (c110 - c010) * f.x;
+    float c01 = c001 + (c101 - c001) * f.x;
+    float c11 = c011 + (c111 - c011) * f.x;
+
+    float c0 = c00 + (c10 - c00) * f.y;
+    float c1 = c01 + (c11 - c01) * f.y;
+
+    return c0 + (c1 - c0) * f.z;
+}
+
+// The same filter, plus its analytic gradient in texel units from the same 8 texels. The filter is linear along each axis
+// within a cell, so the gradient is exact where a central difference inside the cell would be, and 0 along an axis clamped
+// to the edge. Like sample_sdf_gradient() in mesh_fs.glsl.
+template <typename Fetch>
+float sample_trilinear_gradient(const glm::ivec3& size, const glm::vec3& texel, Fetch&& fetch, glm::vec3& gradient)
+{
+    glm::vec3  base = glm::floor(texel);
+    glm::vec3  f    = texel - base;
+    glm::ivec3 i0   = glm::clamp(glm::ivec3(base), glm::ivec3(0), size - glm::ivec3(1));
+    glm::ivec3 i1   = glm::clamp(glm::ivec3(base) + glm::ivec3(1), glm::ivec3(0), size - glm::ivec3(1));
+
+    float c000 = fetch(i0.x, i0.y, i0.z);
+    float c100 = fetch(i1.x, i0.y, i0.z);
+    float c010 = fetch(i0.x, i1.y, i0.z);
+    float c110 = fetch(i1.x, i1.y, i0.z);
+    float c001 = fetch(i0.x, i0.y, i1.z);
+    float c101 = fetch(i1.x, i0.y, i1.z);
+    float c011 = fetch(i0.x, i1.y, i1.z);
+    float c111 = fetch(i1.x, i1.y, i1.z);
+
+    float c00 = c000 + (c100 - c000) * f.x;
+    float c10 = c010 + (c110 - c010) * f.x;
+    float c01 = c001 + (c101 - c001) * f.x;
+    float c11 = c011 + (c111 - c011) * f.x;
+
+    float c0 = c00 + (c10 - c00) * f.y;
+    float c1 = c01 + (c11 - c01) * f.y;
+
+    float dx0 = (c100 - c000) + ((c110 - c010) - (c100 - c000)) * f.y;
+    float dx1 = (c101 - c001) + ((c111 - c011) - (c101 - c001)) * f.y;
+
+    gradient.x = dx0 + (dx1 - dx0) * f.z;
+    gradient.y = (c10 - c00) + ((c11 - c01) - (c10 - c00)) * f.z;
+    gradient.z = c1 - c0;
+
+    return c0 + (c1 - c0) * f.z;
+}
+
+// CPU equivalent of sample_sdf() in mesh_fs.glsl for a dense volume.
+inline float sample_sdf(const SDFVolume& volume, const glm::vec3& os_p)
+{
+    return sample_trilinear(volume.volume_size, texel_coordinate(volume, os_p), [&](int x, int y, int z) { return volume.voxel(x, y, z); });
+}
+
+// Distance and its gradient in object space units, from the 8 texels sample_sdf() reads. find_closest_point_on_mesh() in
+// mesh_fs.glsl normalizes this gradient instead of taking 6 more samples.
+inline float sample_sdf_gradient(const SDFVolume& volume, const glm::vec3& os_p, glm::vec3& gradient)
+{
+    float d = sample_trilinear_gradient(volume.volume_size, texel_coordinate(volume, os_p), [&](int x, int y, int z) { return volume.voxel(x, y, z); }, gradient);
+
+    gradient *= glm::vec3(volume.volume_size) / (volume.max_extents - volume.min_extents);
+
+    return d;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <stdint.h>
+
+// Placement of a baked volume in object space. Matches the fields the viewer keeps per instance.
+struct SDFGrid
+{
+    glm::ivec3 volume_size    = glm::ivec3(0);
+    glm::vec3  grid_origin    = glm::vec3(0.0f);
+    float      grid_step_size = 0.0f;
+    glm::vec3  min_extents    = glm::vec3(0.0f);
+    glm::vec3  max_extents    = glm::vec3(0.0f);
+
+    inline size_t num_voxels() const { return size_t(volume_size.x) * size_t(volume_size.y) * size_t(volume_size.z); }
+    inline size_t index(int x, int y, int z) const { return size_t(x) + size_t(volume_size.x) * (size_t(y) + size_t(volume_size.y) * size_t(z)); }
+    inline glm::vec3 voxel_position(int x, int y, int z) const { return grid_origin + glm::vec3(grid_step_size) * glm::vec3(glm::ivec3(x, y, z)); }
+};
+
+// Dense signed distance volume. Voxels are stored x-major, then y, then z, which is the layout glTexImage3D expects.
+struct SDFVolume : public SDFGrid
+{
+    std::vector<float> distances;
+
+    inline float voxel(int x, int y, int z) const { return distances[index(x, y, z)]; }
+};
@@ -4,9 +4,15 @@
 // DEFINES ----------------------------------------------------------
 // ------------------------------------------------------------------
 
-#define NUM_INSTANCES 16
-#define NUM_SDFS 16
 #define INFINITY 100000.0f
+#define SDF_PYRAMID_ERROR_RATIO 0.5f
+#define INSTANCE_BVH_INSIDE_EPSILON 1e-4f
+#define INSTANCE_BVH_STACK_SIZE 32
+#define SDF_HIT_DISTANCE 0.001f
+#define SDF_CLIPMAP_REFINE_VOXELS 2.0f
+#define SDF_ATLAS_BORDER 1
+#define SHADOW_TILE_SIZE 16
+#define ALL_INSTANCES uvec2(0, 0xFFFFFFFFu)
 
 // ------------------------------------------------------------------
 // OUTPUT VARIABLES  ------------------------------------------------
@@ -35,6 +41,31 @@ struct Instance
     vec4  ws_center;
     vec4  ws_axis[3];
     ivec4 sdf_idx;
+    vec4  sdf_range;
+    vec4  atlas_scale; // uvw in the volume's box to uvw in its atlas page: uvw * scale + offset.
+    vec4  atlas_offset;
+    ivec4 atlas_origin; // Corner of the volume's slot in its page. Level l of the volume starts at atlas_origin >> l.
+    ivec4 volume_size;
+};
+
+// Node of the top level BVH over the instances, InstanceBVH::Node on the CPU. Interior nodes store the index of their second
+// child in offset, the first child follows the node. Leaves hold a single instance, whose index is in offset.
+struct InstanceBVHNode
+{
+    vec3 min_extents;
+    uint offset;
+    vec3 max_extents;
+    uint count;
+};
+
+// Level of the scene clipmap, see SDFClipmap on the CPU. Voxel c of a level is at c * origin.w in world space and stored at
+// texel c modulo the resolution.
+struct ClipmapLevel
+{
+    vec4  origin; // World voxel coordinate of the first voxel, voxel size in w.
+    uvec2 handle;
+    float band;
+    float padding;
 };
 
 // ------------------------------------------------------------------
@@ -48,18 +79,44 @@ layout(std140, binding = 0) uniform GlobalUniforms
     int  num_instances;
 };
 
-layout(std140, binding = 1) uniform Instances
+layout(std430, binding = 1) buffer Instances
+{
+    Instance instances[];
+};
+
+// Bindless handles of the SDF atlas pages, indexed by Instance::sdf_idx.x.
+layout(std430, binding = 2) buffer SDFTextures
+{
+    uvec2 sdf_handles[];
+};
+
+layout(std430, binding = 3) buffer InstanceBVH
+{
+    InstanceBVHNode instance_bvh_nodes[];
+};
+
+layout(std430, binding = 4) buffer SceneClipmap
+{
+    ClipmapLevel clipmap_levels[];
+};
+
+// First element in shadow_tile_instances and count for every screen tile, see build_shadow_tiles() on the CPU.
+layout(std430, binding = 5) buffer ShadowTileRanges
 {
-    Instance instances[NUM_INSTANCES];
+    uvec2 shadow_tile_ranges[];
 };
 
-layout(std140, binding = 2) uniform SDFTextures
+layout(std430, binding = 6) buffer ShadowTileInstances
 {
-    sampler3D sdf[NUM_SDFS];
+    uint shadow_tile_instances[];
 };
 
 uniform vec3  u_Color;
 uniform bool  u_SDFSoftShadows;
+uniform bool  u_SDFMips;
+uniform bool  u_InstanceBVH;
+uniform int   u_ClipmapLevels; // 0 evaluates the instances for every sample.
+uniform int   u_ClipmapResolution;
 uniform float u_SDFTMin;
 uniform float u_SDFTMax;
 uniform float u_SDFSoftShadowsK;
@@ -72,11 +129,20 @@ uniform vec3  u_LightDirection;
 uniform float u_LightInnerCutoff;
 uniform float u_LightOuterCutoff;
 uniform float u_LightRange;
+uniform bool  u_ShadowTiles;
+uniform int   u_ShadowTilesX;
 
 // ------------------------------------------------------------------
 // FUNCTIONS --------------------------------------------------------
 // ------------------------------------------------------------------
 
+sampler3D sdf_texture(in Instance instance)
+{
+    return sampler3D(sdf_handles[instance.sdf_idx.x]);
+}
+
+// ------------------------------------------------------------------
+
 vec3 transform_point(vec3 ws_p, mat4 t)
 {
     return vec3(t * vec4(ws_p, 1.0f));
@@ -90,28 +156,124 @@ float sample_sdf(in vec3 os_p, in Instance instance)
     vec3 box_size   = instance.half_extents.xyz * 2.0f;
 
     vec3 uvw = (remapped_p / box_size);
-    return textureLod(sdf[instance.sdf_idx.x], uvw, 0.0f).r;
+    return instance.sdf_range.x + instance.sdf_range.y * textureLod(sdf_texture(instance), uvw * instance.atlas_scale.xyz + instance.atlas_offset.xyz, 0.0f).r;
 }
 
 // ------------------------------------------------------------------
 
-bool inside_obb(in vec3 os_p, in Instance instance)
+// sample_sdf() filtered by hand from the 8 texels around os_p, which also gives the analytic gradient of the filter in object
+// space. Clamped to the volume like the border around it in the atlas.
+float sample_sdf_gradient(in vec3 os_p, in Instance instance, out vec3 gradient)
 {
-    vec3 min_extents = instance.os_center.xyz - instance.half_extents.xyz;
-    vec3 max_extents = instance.os_center.xyz + instance.half_extents.xyz;
+    vec3 remapped_p = os_p - (instance.os_center.xyz - instance.half_extents.xyz);
+    vec3 box_size   = instance.half_extents.xyz * 2.0f;
 
-    return all(greaterThanEqual(os_p, min_extents)) && all(lessThanEqual(os_p, max_extents));
+    ivec3 size  = instance.volume_size.xyz;
+    vec3  texel = (remapped_p / box_size) * vec3(size) - vec3(0.5f);
+    vec3  base  = floor(texel);
+    vec3  f     = texel - base;
+    ivec3 i0    = clamp(ivec3(base), ivec3(0), size - ivec3(1)) + instance.atlas_origin.xyz + ivec3(SDF_ATLAS_BORDER);
+    ivec3 i1    = clamp(ivec3(base) + ivec3(1), ivec3(0), size - ivec3(1)) + instance.atlas_origin.xyz + ivec3(SDF_ATLAS_BORDER);
+
+    sampler3D sdf = sdf_texture(instance);
+
+    float c000 = texelFetch(sdf, ivec3(i0.x, i0.y, i0.z), 0).r;
+    float c100 = texelFetch(sdf, ivec3(i1.x, i0.y, i0.z), 0).r;
+    float c010 = texelFetch(sdf, ivec3(i0.x, i1.y, i0.z), 0).r;
+    float c110 = texelFetch(sdf, ivec3(i1.x, i1.y, i0.z), 0).r;
+    float c001 = texelFetch(sdf, ivec3(i0.x, i0.y, i1.z), 0).r;
+    float c101 = texelFetch(sdf, ivec3(i1.x, i0.y, i1.z), 0).r;
+    float c011 = texelFetch(sdf, ivec3(i0.x, i1.y, i1.z), 0).r;
+    float c111 = texelFetch(sdf, ivec3(i1.x, i1.y, i1.z), 0).r;
+
+    float c00 = mix(c000, c100, f.x);
+    float c10 = mix(c010, c110, f.x);
+    float c01 = mix(c001, c101, f.x);
+    float c11 = mix(c011, c111, f.x);
+
+    float c0 = mix(c00, c10, f.y);
+    float c1 = mix(c01, c11, f.y);
+
+    gradient.x = mix(mix(c100 - c000, c110 - c010, f.y), mix(c101 - c001, c111 - c011, f.y), f.z);
+    gradient.y = mix(c10 - c00, c11 - c01, f.z);
+    gradient.z = c1 - c0;
+    gradient *= instance.sdf_range.y * vec3(size) / box_size;
+
+    return instance.sdf_range.x + instance.sdf_range.y * mix(c0, c1, f.z);
+}
+
+// ------------------------------------------------------------------
+
+// Single unfiltered texel of a mip level. The coarser levels hold a conservative pyramid (see sdf_pyramid.h), where the texel
+// whose cell contains a point never exceeds the distance at that point.
+float sample_sdf_lod(in vec3 os_p, in Instance instance, int lod)
+{
+    if (lod == 0)
+        return sample_sdf(os_p, instance);
+
+    vec3 remapped_p = os_p - (instance.os_center.xyz - instance.half_extents.xyz);
+    vec3 box_size   = instance.half_extents.xyz * 2.0f;
+
+    ivec3 size  = max(instance.volume_size.xyz >> lod, ivec3(1));
+    ivec3 texel = clamp(ivec3((remapped_p / box_size) * vec3(size)), ivec3(0), size - ivec3(1)) + (instance.atlas_origin.xyz >> lod);
+
+    return instance.sdf_range.x + instance.sdf_range.y * texelFetch(sdf_texture(instance), texel, lod).r;
+}
+
+// ------------------------------------------------------------------
+
+// Largest amount a texel of a mip level can be below the true distance. Matches build_sdf_pyramid(): the spacing of level lod is
+// the largest of its texel spacings, taken from the level's rounded size like sample_sdf_lod().
+float sdf_error_bound(in Instance instance, int lod)
+{
+    vec3 spacing = (instance.half_extents.xyz * 2.0f) / vec3(max(instance.volume_size.xyz >> lod, ivec3(1)));
+
+    return sqrt(3.0f) * (max(spacing.x, max(spacing.y, spacing.z)) + 2.0f * instance.sdf_range.z);
+}
+
+// ------------------------------------------------------------------
+
+// Coarsest mip level that is safe to take a step from, like select_sdf_level().
+int sdf_lod(in Instance instance, float step_hint)
+{
+    if (!u_SDFMips)
+        return 0;
+
+    for (int lod = instance.sdf_idx.y; lod > 0; lod--)
+    {
+        if (sdf_error_bound(instance, lod) <= SDF_PYRAMID_ERROR_RATIO * step_hint)
+            return lod;
+    }
+
+    return 0;
 }
 
 // ------------------------------------------------------------------
 
-vec3 calculate_normal(in vec3 os_p, in Instance instance)
+// Samples the coarsest level the step allows and refines while most of the step would be lost to the level's error, like
+// march_sdf_ray(). to_box is the distance from the sampled point to the instance's box, which is added to the result.
+float sample_sdf_coarse_to_fine(in vec3 os_p, in Instance instance, float step_hint, float to_box)
 {
-    const float eps = 0.0001f;
-    const vec2  h   = vec2(eps, 0.0f);
-    return normalize(vec3(sample_sdf(os_p + h.xyy, instance) - sample_sdf(os_p - h.xyy, instance),
-                          sample_sdf(os_p + h.yxy, instance) - sample_sdf(os_p - h.yxy, instance),
-                          sample_sdf(os_p + h.yyx, instance) - sample_sdf(os_p - h.yyx, instance)));
+    int   lod = sdf_lod(instance, max(step_hint, to_box));
+    float h   = to_box + sample_sdf_lod(os_p, instance, lod);
+
+    while (lod > 0 && h < sdf_error_bound(instance, lod))
+    {
+        lod = min(lod - 1, sdf_lod(instance, h));
+        h   = to_box + sample_sdf_lod(os_p, instance, lod);
+    }
+
+    return h;
+}
+
+// ------------------------------------------------------------------
+
+bool inside_obb(in vec3 os_p, in Instance instance)
+{
+    vec3 min_extents = instance.os_center.xyz - instance.half_extents.xyz;
+    vec3 max_extents = instance.os_center.xyz + instance.half_extents.xyz;
+
+    return all(greaterThanEqual(os_p, min_extents)) && all(lessThanEqual(os_p, max_extents));
 }
 
 // ------------------------------------------------------------------
@@ -138,23 +300,40 @@ vec3 find_closest_point_on_obb(in vec3 ws_p, in Instance instance)
 
 // ------------------------------------------------------------------
 
+// The normal is the gradient of the same 8 texels the distance comes from, rather than central differences of 6 filtered
+// samples a tiny distance apart, whose differences are mostly the texture unit's fixed point weights.
 vec3 find_closest_point_on_mesh(in vec3 ws_p, in Instance instance)
 {
     vec3 os_p = transform_point(ws_p, instance.inverse_transform);
 
-    float t = sample_sdf(os_p, instance);
+    vec3  gradient;
+    float t = sample_sdf_gradient(os_p, instance, gradient);
 
-    return ws_p - calculate_normal(os_p, instance) * t;
+    return ws_p - normalize(gradient) * t;
 }
 
 // ------------------------------------------------------------------
 
-float evaluate_mesh_sdf(in vec3 ws_p, in Instance instance)
+// Signed distance to the mesh's bounds, which stands in for the volume while it is still being baked (sdf_idx.z = 1). The
+// bounds are the instance's box shrunk by the padding in sdf_range.w.
+float sdf_mesh_bounds(in vec3 os_p, in Instance instance)
+{
+    vec3 q = abs(os_p - instance.os_center.xyz) - (instance.half_extents.xyz - instance.sdf_range.w);
+
+    return length(max(q, vec3(0.0f))) + min(max(q.x, max(q.y, q.z)), 0.0f);
+}
+
+// ------------------------------------------------------------------
+
+float evaluate_mesh_sdf(in vec3 ws_p, in Instance instance, float step_hint)
 {
     vec3 os_p = transform_point(ws_p, instance.inverse_transform);
 
+    if (instance.sdf_idx.z != 0)
+        return sdf_mesh_bounds(os_p, instance);
+
     if (inside_obb(os_p, instance))
-        return sample_sdf(os_p, instance);
+        return sample_sdf_coarse_to_fine(os_p, instance, step_hint, 0.0f);
     else
     {
 #if defined(USE_ACCURATE_DISTANCE)
@@ -166,20 +345,102 @@ float evaluate_mesh_sdf(in vec3 ws_p, in Instance instance)
         return h;
 #else
         vec3 point_on_volume = find_closest_point_on_obb(ws_p, instance);
-        return length(point_on_volume - ws_p) + sample_sdf(transform_point(point_on_volume, instance.inverse_transform), instance);
+        return sample_sdf_coarse_to_fine(transform_point(point_on_volume, instance.inverse_transform), instance, step_hint, length(point_on_volume - ws_p));
 #endif
     }
 }
 
 // ------------------------------------------------------------------
 
-float evaluate_scene_sdf(vec3 ws_p)
+float distance_to_box(vec3 p, vec3 min_extents, vec3 max_extents)
+{
+    return length(max(max(min_extents - p, p - max_extents), vec3(0.0f)));
+}
+
+// ------------------------------------------------------------------
+
+// Nearest instance through the top level BVH, like InstanceBVH::nearest_instance(). Subtrees further away than the current best
+// are skipped, and the traversal stops once the distance drops to early_out.
+float evaluate_scene_sdf_bvh(vec3 ws_p, float step_hint, float early_out)
+{
+    float dist = INFINITY;
+
+    uint stack[INSTANCE_BVH_STACK_SIZE];
+    int  stack_size = 0;
+
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0)
+    {
+        uint            node_idx = stack[--stack_size];
+        InstanceBVHNode node     = instance_bvh_nodes[node_idx];
+
+        // Boxes that contain the point are always visited since the distance inside them can be negative.
+        float d = distance_to_box(ws_p, node.min_extents, node.max_extents);
+
+        if (d > INSTANCE_BVH_INSIDE_EPSILON && d >= dist)
+            continue;
+
+        if (node.count > 0)
+        {
+            dist = min(dist, evaluate_mesh_sdf(ws_p, instances[node.offset], step_hint));
+
+            if (dist <= early_out)
+                break;
+        }
+        else
+        {
+            uint near_idx = node_idx + 1;
+            uint far_idx  = node.offset;
+
+            InstanceBVHNode a = instance_bvh_nodes[near_idx];
+            InstanceBVHNode b = instance_bvh_nodes[far_idx];
+
+            if (distance_to_box(ws_p, b.min_extents, b.max_extents) < distance_to_box(ws_p, a.min_extents, a.max_extents))
+            {
+                uint tmp = near_idx;
+                near_idx = far_idx;
+                far_idx  = tmp;
+            }
+
+            stack[stack_size++] = far_idx;
+            stack[stack_size++] = near_idx;
+        }
+    }
+
+    return dist;
+}
+
+// ------------------------------------------------------------------
+
+// step_hint is the length of the previous step of the march, 0 reads full resolution only. The distance is exact down to
+// early_out, a march can pass its hit distance since it stops below that anyway. tile is a range of shadow_tile_instances to
+// evaluate instead of every instance, or ALL_INSTANCES.
+float evaluate_instances_sdf(vec3 ws_p, float step_hint, float early_out, uvec2 tile)
 {
+    if (tile != ALL_INSTANCES)
+    {
+        float dist = INFINITY;
+
+        for (uint i = 0; i < tile.y; i++)
+        {
+            dist = min(dist, evaluate_mesh_sdf(ws_p, instances[shadow_tile_instances[tile.x + i]], step_hint));
+
+            if (dist <= early_out)
+                break;
+        }
+
+        return dist;
+    }
+
+    if (u_InstanceBVH && num_instances > 0)
+        return evaluate_scene_sdf_bvh(ws_p, step_hint, early_out);
+
     float dist_to_box = INFINITY;
 
     for (int i = 0; i < num_instances; i++)
     {
-        float h = evaluate_mesh_sdf(ws_p, instances[i]);
+        float h = evaluate_mesh_sdf(ws_p, instances[i], step_hint);
 
         if (h < dist_to_box)
             dist_to_box = h;
@@ -190,23 +451,99 @@ float evaluate_scene_sdf(vec3 ws_p)
 
 // ------------------------------------------------------------------
 
-float shadow_ray_march(vec3 ro, vec3 rd, float k)
+// Finest clipmap level whose voxels around ws_p are all inside it, -1 if there is none. Like SDFClipmap::find_level().
+int clipmap_level(vec3 ws_p)
+{
+    for (int i = 0; i < u_ClipmapLevels; i++)
+    {
+        vec3 t = ws_p / clipmap_levels[i].origin.w - clipmap_levels[i].origin.xyz;
+
+        if (all(greaterThanEqual(t, vec3(0.0f))) && all(lessThan(t, vec3(float(u_ClipmapResolution - 1)))))
+            return i;
+    }
+
+    return -1;
+}
+
+// ------------------------------------------------------------------
+
+// GL_REPEAT wraps the voxel coordinate to the texel it is stored at.
+float sample_clipmap(vec3 ws_p, int level)
+{
+    vec3 uvw = (ws_p / clipmap_levels[level].origin.w + 0.5f) / float(u_ClipmapResolution);
+
+    return textureLod(sampler3D(clipmap_levels[level].handle), uvw, 0.0f).r;
+}
+
+// ------------------------------------------------------------------
+
+// One clipmap fetch where a level covers ws_p and the surface is far enough away for its interpolation error not to matter,
+// the instances otherwise, like evaluate_scene_clipmap(). truncated is set when the result is the band of a level, which is
+// only a lower bound of the distance.
+float evaluate_scene_sdf(vec3 ws_p, float step_hint, float early_out, uvec2 tile, out bool truncated)
+{
+    truncated = false;
+
+    int level = clipmap_level(ws_p);
+
+    if (level >= 0)
+    {
+        float h = sample_clipmap(ws_p, level);
+
+        if (h > SDF_CLIPMAP_REFINE_VOXELS * clipmap_levels[level].origin.w)
+        {
+            truncated = h >= clipmap_levels[level].band;
+            return h;
+        }
+    }
+
+    return evaluate_instances_sdf(ws_p, step_hint, early_out, tile);
+}
+
+// ------------------------------------------------------------------
+
+float evaluate_scene_sdf(vec3 ws_p, float step_hint, float early_out)
 {
-    float res = 1.0;
+    bool truncated;
+    return evaluate_scene_sdf(ws_p, step_hint, early_out, ALL_INSTANCES, truncated);
+}
+
+// ------------------------------------------------------------------
+
+// With u_ShadowTiles only the instances listed for the fragment's tile are evaluated, which are all that can come near a ray
+// that ends at the light, so t_max must not be further than the light.
+float shadow_ray_march(vec3 ro, vec3 rd, float k, float t_max)
+{
+    float res       = 1.0;
+    float step_hint = 0.0f;
+    uvec2 tile      = ALL_INSTANCES;
+
+    if (u_ShadowTiles)
+    {
+        ivec2 coord = ivec2(gl_FragCoord.xy) / SHADOW_TILE_SIZE;
+
+        tile = shadow_tile_ranges[coord.x + coord.y * u_ShadowTilesX];
+
+        if (tile.y == 0)
+            return 1.0f;
+    }
 
-    for (float t = u_SDFTMin; t < u_SDFTMax;)
+    for (float t = u_SDFTMin; t < t_max;)
     {
         vec3 p = ro + rd * t;
 
-        float h = evaluate_scene_sdf(p);
+        bool  truncated;
+        float h = evaluate_scene_sdf(p, step_hint, SDF_HIT_DISTANCE, tile, truncated);
 
-        if (h < 0.001f)
+        if (h < SDF_HIT_DISTANCE)
             return 0.0f;
 
-        if (u_SDFSoftShadows)
+        // A truncated distance would darken the penumbra of rays that pass nothing within the band.
+        if (u_SDFSoftShadows && !truncated)
             res = min(res, k * h / t);
 
         t += h;
+        step_hint = h;
     }
 
     return res;
@@ -222,7 +559,7 @@ float ambient_occlusion(vec3 pos, vec3 normal, int num_steps, float step_size)
     for (int i = 0; i < num_steps; i++)
     {
         vec3 p = pos + normal * (i + 1) * step_size;
-        sum += 1. / pow(2., i) * evaluate_scene_sdf(p);
+        sum += 1. / pow(2., i) * evaluate_scene_sdf(p, 0.0f, -INFINITY);
         max_sum += 1. / pow(2., i) * (i + 1) * step_size;
     }
     return min(sum / max_sum, 1.0f);
@@ -243,7 +580,10 @@ void main()
     float epsilon     = u_LightInnerCutoff - u_LightOuterCutoff;
     float attenuation = smoothstep(u_LightRange, 0, distance) * clamp((theta - u_LightOuterCutoff) / epsilon, 0.0, 1.0);
 
-    float shadow = shadow_ray_march(FS_IN_WorldPos, L, u_SDFSoftShadowsK) * attenuation;
+    // Shadow rays end at the light, with or without shadow tiles, so the tiles don't change the image. Unlit fragments are not
+    // marched at all.
+    float t_max  = min(u_SDFTMax, distance);
+    float shadow = attenuation > 0.0f ? shadow_ray_march(FS_IN_WorldPos, L, u_SDFSoftShadowsK, t_max) * attenuation : 0.0f;
     float ao     = u_AO ? ambient_occlusion(FS_IN_WorldPos, FS_IN_Normal, u_AONumSteps, u_AOStepSize) : 1.0f;
 
     FS_OUT_Color = albedo * clamp(dot(N, L), 0.0, 1.0) * shadow + albedo * u_AOStrength * ao;
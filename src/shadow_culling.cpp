@@ -0,0 +1,312 @@
+#include "shadow_culling.h"
+#include "parallel.h"
+#include "profiler.h"
+
+#include <chrono>
+
+// World axes, then the planes through the light and each edge of the receiver box.
+#define SHADOW_VOLUME_MAX_AXES 15
+
+// Hull of a receiver box and a sphere around the light, with its extent along every candidate separating axis.
+struct ShadowVolume
+{
+    glm::vec3 corners[8];
+    glm::vec3 light;
+    float     radius;
+    glm::vec3 axes[SHADOW_VOLUME_MAX_AXES];
+    float     min[SHADOW_VOLUME_MAX_AXES];
+    float     max[SHADOW_VOLUME_MAX_AXES];
+    uint32_t  num_axes;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void project_volume(const ShadowVolume& volume, const glm::vec3& axis, float& min, float& max)
+{
+    min = glm::dot(volume.light, axis) - volume.radius;
+    max = glm::dot(volume.light, axis) + volume.radius;
+
+    for (const auto& corner : volume.corners)
+    {
+        float d = glm::dot(corner, axis);
+
+        min = std::min(min, d);
+        max = std::max(max, d);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void build_shadow_volume(const glm::vec3& min_extents, const glm::vec3& max_extents, const glm::vec3& light, float radius, ShadowVolume& volume)
+{
+    for (int i = 0; i < 8; i++)
+        volume.corners[i] = glm::vec3(i & 1 ? max_extents.x : min_extents.x, i & 2 ? max_extents.y : min_extents.y, i & 4 ? max_extents.z : min_extents.z);
+
+    volume.light    = light;
+    volume.radius   = radius;
+    volume.num_axes = 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        volume.axes[volume.num_axes] = glm::vec3(0.0f);
+        volume.axes[volume.num_axes++][i] = 1.0f;
+    }
+
+    // Corners i and i | bit share an edge.
+    for (int i = 0; i < 8; i++)
+    {
+        for (int bit = 1; bit < 8; bit <<= 1)
+        {
+            if (i & bit)
+                continue;
+
+            glm::vec3 normal = glm::cross(volume.corners[i | bit] - volume.corners[i], volume.corners[i] - light);
+            float     length = glm::length(normal);
+
+            if (length > 1e-6f * glm::length(volume.corners[i] - light) && volume.num_axes < SHADOW_VOLUME_MAX_AXES)
+                volume.axes[volume.num_axes++] = normal / length;
+        }
+    }
+
+    for (uint32_t i = 0; i < volume.num_axes; i++)
+        project_volume(volume, volume.axes[i], volume.min[i], volume.max[i]);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// False only if one of the volume's axes, or one of the box's own, separates the two. Boxes grow by margin on every side.
+static bool overlaps(const ShadowVolume& volume, const glm::vec3& center, const glm::vec3* axis, const glm::vec3& half_extents, float margin, bool box_axes)
+{
+    for (uint32_t i = 0; i < volume.num_axes; i++)
+    {
+        const glm::vec3& n = volume.axes[i];
+
+        float c = glm::dot(center, n);
+        float e = fabsf(glm::dot(axis[0], n)) * (half_extents.x + margin) + fabsf(glm::dot(axis[1], n)) * (half_extents.y + margin) + fabsf(glm::dot(axis[2], n)) * (half_extents.z + margin);
+
+        if (c + e < volume.min[i] || c - e > volume.max[i])
+            return false;
+    }
+
+    if (box_axes)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            float min, max;
+            project_volume(volume, axis[i], min, max);
+
+            float c = glm::dot(center, axis[i]);
+
+            if (c + half_extents[i] + margin < min || c - half_extents[i] - margin > max)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Box around the light's cone up to its range, per axis from the cone direction closest to that axis.
+static void light_extents(const ShadowLight& light, glm::vec3& min_extents, glm::vec3& max_extents)
+{
+    float half_angle = acosf(glm::clamp(light.outer_cutoff, -1.0f, 1.0f));
+
+    for (int i = 0; i < 3; i++)
+    {
+        float max_cos = cosf(std::max(0.0f, acosf(glm::clamp(light.direction[i], -1.0f, 1.0f)) - half_angle));
+        float min_cos = -cosf(std::max(0.0f, acosf(glm::clamp(-light.direction[i], -1.0f, 1.0f)) - half_angle));
+
+        min_extents[i] = light.position[i] + light.range * std::min(0.0f, min_cos);
+        max_extents[i] = light.position[i] + light.range * std::max(0.0f, max_cos);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Whether a sphere touches the light's cone within its range.
+static bool sphere_in_light(const ShadowLight& light, const glm::vec3& center, float radius)
+{
+    glm::vec3 v = center - light.position;
+
+    if (glm::length(v) > light.range + radius)
+        return false;
+
+    // Cones of 90 degrees or more are not worth testing.
+    if (light.outer_cutoff <= 0.0f)
+        return true;
+
+    float cos_angle = light.outer_cutoff;
+    float sin_angle = sqrtf(std::max(0.0f, 1.0f - cos_angle * cos_angle));
+    float along     = glm::dot(v, light.direction);
+    float across    = glm::length(v - along * light.direction);
+
+    // Centres whose closest point on the cone is its apex.
+    if (along * cos_angle + across * sin_angle < 0.0f)
+        return glm::length(v) <= radius;
+
+    return across * cos_angle - along * sin_angle <= radius;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void build_shadow_tiles(const std::vector<InstanceBox>& boxes, const InstanceBVH& bvh, const glm::mat4& view_proj, uint32_t width, uint32_t height, const glm::vec3& receiver_min, const glm::vec3& receiver_max, const ShadowLight& light, ShadowTiles& tiles, const ShadowCullSettings& settings, ShadowCullStats* stats)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    const uint32_t tile_size = std::max(1u, settings.tile_size);
+
+    tiles.tiles_x = (width + tile_size - 1) / tile_size;
+    tiles.tiles_y = (height + tile_size - 1) / tile_size;
+    tiles.ranges.assign(tiles.tiles_x * tiles.tiles_y, glm::uvec2(0));
+    tiles.instances.clear();
+
+    ShadowCullStats local_stats;
+
+    local_stats.num_tiles = tiles.tiles_x * tiles.tiles_y;
+
+    // A soft shadow ray is darkened by occluders up to t / k from the point at t, and no ray is longer than the light's range.
+    const float penumbra = light.soft_shadows_k > 0.0f ? light.range / light.soft_shadows_k : 0.0f;
+
+    std::vector<uint8_t> lit(boxes.size());
+
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        lit[i] = sphere_in_light(light, boxes[i].center, glm::length(boxes[i].half_extents) + SHADOW_CULL_HIT_DISTANCE + penumbra);
+        local_stats.lit_instances += lit[i];
+    }
+
+    // Everything that can receive light.
+    glm::vec3 cone_min, cone_max;
+    light_extents(light, cone_min, cone_max);
+
+    const glm::vec3 lit_min = glm::max(receiver_min, cone_min);
+    const glm::vec3 lit_max = glm::min(receiver_max, cone_max);
+
+    // Clip space w is the view depth, and affine along every ray through a pixel.
+    const glm::vec4 w_row = glm::vec4(view_proj[0][3], view_proj[1][3], view_proj[2][3], view_proj[3][3]);
+    const glm::mat4 inv   = glm::inverse(view_proj);
+
+    float w_min = SDF_INFINITY;
+    float w_max = -SDF_INFINITY;
+
+    for (int i = 0; i < 8; i++)
+    {
+        float w = glm::dot(w_row, glm::vec4(i & 1 ? lit_max.x : lit_min.x, i & 2 ? lit_max.y : lit_min.y, i & 4 ? lit_max.z : lit_min.z, 1.0f));
+
+        w_min = std::min(w_min, w);
+        w_max = std::max(w_max, w);
+    }
+
+    std::vector<std::vector<uint32_t>> lists(local_stats.num_tiles);
+
+    if (glm::all(glm::lessThanEqual(lit_min, lit_max)) && local_stats.lit_instances > 0 && !bvh.nodes().empty())
+    {
+        parallel_for(local_stats.num_tiles, settings.num_threads, [&](uint32_t tile) {
+            uint32_t tx = tile % tiles.tiles_x;
+            uint32_t ty = tile / tiles.tiles_x;
+
+            glm::vec2 ndc_min = glm::vec2(float(tx * tile_size) / float(width), float(ty * tile_size) / float(height)) * 2.0f - glm::vec2(1.0f);
+            glm::vec2 ndc_max = glm::vec2(float(std::min((tx + 1) * tile_size, width)) / float(width), float(std::min((ty + 1) * tile_size, height)) / float(height)) * 2.0f - glm::vec2(1.0f);
+
+            // The tile's frustum between the depths of the lit receivers.
+            glm::vec3 tile_min = glm::vec3(SDF_INFINITY);
+            glm::vec3 tile_max = glm::vec3(-SDF_INFINITY);
+
+            for (int c = 0; c < 4; c++)
+            {
+                glm::vec2 ndc  = glm::vec2(c & 1 ? ndc_max.x : ndc_min.x, c & 2 ? ndc_max.y : ndc_min.y);
+                glm::vec4 near = inv * glm::vec4(ndc, -1.0f, 1.0f);
+                glm::vec4 far  = inv * glm::vec4(ndc, 1.0f, 1.0f);
+
+                glm::vec3 a   = glm::vec3(near) / near.w;
+                glm::vec3 b   = glm::vec3(far) / far.w;
+                float     w_a = glm::dot(w_row, glm::vec4(a, 1.0f));
+                float     w_b = glm::dot(w_row, glm::vec4(b, 1.0f));
+
+                float w_near = std::max(w_min, w_a);
+                float w_far  = std::min(w_max, w_b);
+
+                // Every lit receiver is outside the view depth range.
+                if (w_near > w_far)
+                    return;
+
+                for (float w : { w_near, w_far })
+                {
+                    glm::vec3 p = a + (b - a) * ((w - w_a) / (w_b - w_a));
+
+                    tile_min = glm::min(tile_min, p);
+                    tile_max = glm::max(tile_max, p);
+                }
+            }
+
+            tile_min = glm::max(tile_min, lit_min);
+            tile_max = glm::min(tile_max, lit_max);
+
+            if (glm::any(glm::greaterThan(tile_min, tile_max)))
+                return;
+
+            // A receiver at distance D from the light only darkens from occluders within t / k of the point at t along its ray,
+            // which the hull of the receivers and a sphere of D / k around the light contains.
+            float distance = 0.0f;
+
+            for (int i = 0; i < 8; i++)
+                distance = std::max(distance, glm::length(glm::vec3(i & 1 ? tile_max.x : tile_min.x, i & 2 ? tile_max.y : tile_min.y, i & 4 ? tile_max.z : tile_min.z) - light.position));
+
+            ShadowVolume volume;
+
+            build_shadow_volume(tile_min, tile_max, light.position, light.soft_shadows_k > 0.0f ? distance / light.soft_shadows_k : 0.0f, volume);
+
+            const glm::vec3 world_axes[] = { glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) };
+
+            std::vector<uint32_t>& list = lists[tile];
+
+            uint32_t stack[64];
+            uint32_t stack_size = 0;
+
+            stack[stack_size++] = 0;
+
+            while (stack_size > 0)
+            {
+                const InstanceBVH::Node& node = bvh.nodes()[stack[--stack_size]];
+
+                glm::vec3 center = (node.min_extents + node.max_extents) * 0.5f;
+
+                if (!overlaps(volume, center, world_axes, (node.max_extents - node.min_extents) * 0.5f, SHADOW_CULL_HIT_DISTANCE, false))
+                    continue;
+
+                if (node.is_leaf())
+                {
+                    const InstanceBox& box = boxes[node.offset];
+
+                    if (lit[node.offset] && overlaps(volume, box.center, box.axis, box.half_extents, SHADOW_CULL_HIT_DISTANCE, true))
+                        list.push_back(node.offset);
+
+                    continue;
+                }
+
+                stack[stack_size++] = node.offset;
+                stack[stack_size++] = static_cast<uint32_t>(&node - bvh.nodes().data()) + 1;
+            }
+
+            std::sort(list.begin(), list.end());
+        });
+    }
+
+    for (uint32_t i = 0; i < local_stats.num_tiles; i++)
+    {
+        tiles.ranges[i] = glm::uvec2(static_cast<uint32_t>(tiles.instances.size()), static_cast<uint32_t>(lists[i].size()));
+        tiles.instances.insert(tiles.instances.end(), lists[i].begin(), lists[i].end());
+
+        local_stats.max_tile_count = std::max(local_stats.max_tile_count, static_cast<uint32_t>(lists[i].size()));
+        local_stats.empty_tiles += lists[i].empty() ? 1 : 0;
+    }
+
+    local_stats.num_entries = tiles.instances.size();
+    local_stats.ms          = elapsed_ms(start);
+
+    if (stats)
+        *stats = local_stats;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
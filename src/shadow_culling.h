@@ -0,0 +1,55 @@
+#pragma once
+
+#include "instance_bvh.h"
+
+// Width and height of a screen tile in pixels, SHADOW_TILE_SIZE in mesh_fs.glsl.
+#define SHADOW_TILE_SIZE 16
+
+// Distance below which a shadow ray counts as a hit, SDF_HIT_DISTANCE in mesh_fs.glsl. Instances this close to a tile's shadow
+// volume are kept.
+#define SHADOW_CULL_HIT_DISTANCE 0.001f
+
+// The viewer's spotlight, with the values of its uniforms.
+struct ShadowLight
+{
+    glm::vec3 position       = glm::vec3(0.0f); // u_LightPos
+    glm::vec3 direction      = glm::vec3(0.0f, 0.0f, -1.0f); // u_LightDirection, normalized.
+    float     outer_cutoff   = 0.0f;   // u_LightOuterCutoff, cosine of the cone's half angle.
+    float     range          = 100.0f; // u_LightRange
+    float     soft_shadows_k = 0.0f;   // u_SDFSoftShadowsK, 0 with hard shadows.
+};
+
+struct ShadowCullSettings
+{
+    uint32_t tile_size   = SHADOW_TILE_SIZE;
+    uint32_t num_threads = 0; // 0 = use all cores.
+};
+
+// Instance lists of every screen tile, laid out for upload as two storage buffers. Tiles are numbered row by row from the
+// bottom left of the viewport like gl_FragCoord, tile (x, y) is ranges[x + y * tiles_x].
+struct ShadowTiles
+{
+    uint32_t                tiles_x = 0;
+    uint32_t                tiles_y = 0;
+    std::vector<glm::uvec2> ranges;    // First element in instances and count for every tile.
+    std::vector<uint32_t>   instances; // Instance indices of all tiles back to back, ascending within a tile.
+};
+
+struct ShadowCullStats
+{
+    uint32_t num_tiles      = 0;
+    uint32_t empty_tiles    = 0;
+    uint32_t lit_instances  = 0; // Instances near enough the light's cone and range to be listed by any tile.
+    uint32_t max_tile_count = 0;
+    uint64_t num_entries    = 0;
+    double   ms             = 0.0;
+};
+
+// Lists, for every tile of a width x height viewport, the instances a shadow ray from the tile's pixels towards the light can
+// come near. Only pixels inside the light's cone and range receive light, and a ray from one of them to the light stays inside
+// both, so instances further from them than the hit distance, plus range / k with soft shadows, are dropped first. Each tile's
+// receivers are bounded by the part of its frustum between the nearest and furthest depth of receiver_min and receiver_max, the
+// bounds of everything drawn, inside the cone's box. The shadow volume is the hull of that box and the light, widened towards the
+// light by the largest distance at which a soft shadow penumbra still darkens a ray. Instance boxes are tested against it through
+// the BVH with separating axes. Shadow rays must end at the light.
+void build_shadow_tiles(const std::vector<InstanceBox>& boxes, const InstanceBVH& bvh, const glm::mat4& view_proj, uint32_t width, uint32_t height, const glm::vec3& receiver_min, const glm::vec3& receiver_max, const ShadowLight& light, ShadowTiles& tiles, const ShadowCullSettings& settings = ShadowCullSettings(), ShadowCullStats* stats = nullptr);
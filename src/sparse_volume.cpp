@@ -0,0 +1,88 @@
+#include "sparse_volume.h"
+#include "sdf_baker.h"
+#include "parallel.h"
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+SparseSDFVolume build_sparse_volume(const SDFVolume& volume, float band_distance, uint32_t num_threads)
+{
+    SparseSDFVolume sparse;
+
+    static_cast<SDFGrid&>(sparse) = volume;
+
+    sparse.brick_grid_size = (volume.volume_size + glm::ivec3(SDF_BRICK_SIZE - 1)) / SDF_BRICK_SIZE;
+    sparse.indirection.resize(size_t(sparse.brick_grid_size.x) * size_t(sparse.brick_grid_size.y) * size_t(sparse.brick_grid_size.z));
+
+    uint32_t             num_bricks = sparse.num_bricks();
+    std::vector<uint8_t> keep(num_bricks);
+
+    // Classify bricks in parallel, then hand out pool slots in brick order so the pool layout is deterministic.
+    parallel_for(num_bricks, num_threads, [&](uint32_t brick_idx) {
+        glm::ivec3 brick = glm::ivec3(brick_idx % sparse.brick_grid_size.x, (brick_idx / sparse.brick_grid_size.x) % sparse.brick_grid_size.y, brick_idx / (sparse.brick_grid_size.x * sparse.brick_grid_size.y));
+        glm::ivec3 begin = brick * SDF_BRICK_SIZE;
+        glm::ivec3 end   = glm::min(begin + glm::ivec3(SDF_BRICK_SIZE), volume.volume_size);
+
+        float closest      = SDF_INFINITY;
+        bool  has_positive = false;
+        bool  has_negative = false;
+
+        for (int z = begin.z; z < end.z; z++)
+        {
+            for (int y = begin.y; y < end.y; y++)
+            {
+                for (int x = begin.x; x < end.x; x++)
+                {
+                    float d = volume.voxel(x, y, z);
+
+                    if (fabsf(d) < fabsf(closest))
+                        closest = d;
+
+                    has_positive |= d >= 0.0f;
+                    has_negative |= d < 0.0f;
+                }
+            }
+        }
+
+        keep[brick_idx] = fabsf(closest) <= band_distance || (has_positive && has_negative);
+
+        sparse.indirection[brick_idx].slot         = SDF_FAR_BRICK;
+        sparse.indirection[brick_idx].far_distance = closest;
+    });
+
+    uint32_t num_stored = 0;
+
+    for (uint32_t i = 0; i < num_bricks; i++)
+    {
+        if (keep[i])
+            sparse.indirection[i].slot = num_stored++;
+    }
+
+    sparse.brick_pool.resize(size_t(num_stored) * SDF_BRICK_VOXELS);
+
+    parallel_for(num_bricks, num_threads, [&](uint32_t brick_idx) {
+        uint32_t slot = sparse.indirection[brick_idx].slot;
+
+        if (slot == SDF_FAR_BRICK)
+            return;
+
+        glm::ivec3 brick = glm::ivec3(brick_idx % sparse.brick_grid_size.x, (brick_idx / sparse.brick_grid_size.x) % sparse.brick_grid_size.y, brick_idx / (sparse.brick_grid_size.x * sparse.brick_grid_size.y));
+        float*     dst   = &sparse.brick_pool[size_t(slot) * SDF_BRICK_VOXELS];
+
+        // Bricks on the far border are padded by repeating the edge voxels.
+        for (int z = 0; z < SDF_BRICK_SIZE; z++)
+        {
+            for (int y = 0; y < SDF_BRICK_SIZE; y++)
+            {
+                for (int x = 0; x < SDF_BRICK_SIZE; x++)
+                {
+                    glm::ivec3 v = glm::min(brick * SDF_BRICK_SIZE + glm::ivec3(x, y, z), volume.volume_size - glm::ivec3(1));
+                    *dst++       = volume.voxel(v.x, v.y, v.z);
+                }
+            }
+        }
+    });
+
+    return sparse;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
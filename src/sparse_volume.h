@@ -0,0 +1,49 @@
+#pragma once
+
+#include "sdf_sampler.h"
+
+#define SDF_BRICK_SIZE 8
+#define SDF_BRICK_VOXELS (SDF_BRICK_SIZE * SDF_BRICK_SIZE * SDF_BRICK_SIZE)
+#define SDF_FAR_BRICK 0xFFFFFFFFu
+
+// Sparse signed distance volume. The volume is split into SDF_BRICK_SIZE^3 bricks and only bricks near the surface are kept in
+// the brick pool. Every other brick is replaced by a single distance in the indirection grid.
+struct SparseSDFVolume : public SDFGrid
+{
+    struct Brick
+    {
+        uint32_t slot;         // Index of the brick in the pool, or SDF_FAR_BRICK.
+        float    far_distance; // Value returned for every voxel of a far brick.
+    };
+
+    glm::ivec3         brick_grid_size = glm::ivec3(0);
+    std::vector<Brick> indirection; // One entry per brick, x-major like the voxels.
+    std::vector<float> brick_pool;  // SDF_BRICK_VOXELS floats per stored brick, x-major inside the brick.
+
+    inline uint32_t num_bricks() const { return static_cast<uint32_t>(indirection.size()); }
+    inline uint32_t num_stored_bricks() const { return static_cast<uint32_t>(brick_pool.size() / SDF_BRICK_VOXELS); }
+
+    inline float voxel(int x, int y, int z) const
+    {
+        const Brick& brick = indirection[size_t(x / SDF_BRICK_SIZE) + size_t(brick_grid_size.x) * (size_t(y / SDF_BRICK_SIZE) + size_t(brick_grid_size.y) * size_t(z / SDF_BRICK_SIZE))];
+
+        if (brick.slot == SDF_FAR_BRICK)
+            return brick.far_distance;
+
+        return brick_pool[size_t(brick.slot) * SDF_BRICK_VOXELS + size_t(x % SDF_BRICK_SIZE) + SDF_BRICK_SIZE * (size_t(y % SDF_BRICK_SIZE) + SDF_BRICK_SIZE * size_t(z % SDF_BRICK_SIZE))];
+    }
+
+    inline size_t memory_bytes() const { return indirection.size() * sizeof(Brick) + brick_pool.size() * sizeof(float); }
+    inline size_t dense_memory_bytes() const { return num_voxels() * sizeof(float); }
+};
+
+// Builds a sparse volume from a dense bake. A brick is stored if any of its voxels is within band_distance of the surface or the
+// brick contains a sign change. Other bricks keep the value of their voxel closest to the surface, which is the smallest step a
+// march through the brick would have taken.
+SparseSDFVolume build_sparse_volume(const SDFVolume& volume, float band_distance, uint32_t num_threads = 0);
+
+// CPU equivalent of sample_sdf() in mesh_fs.glsl for a sparse volume. Filtering works across brick borders.
+inline float sample_sdf(const SparseSDFVolume& volume, const glm::vec3& os_p)
+{
+    return sample_trilinear(volume.volume_size, texel_coordinate(volume, os_p), [&](int x, int y, int z) { return volume.voxel(x, y, z); });
+}
@@ -0,0 +1,197 @@
+#include "streaming_bake.h"
+#include "sdf_cache.h"
+#include "bvh.h"
+#include "winding_number.h"
+#include "parallel.h"
+
+#include <fstream>
+#include <string.h>
+#include <stdio.h>
+
+// Contents of the .progress file next to a partial bake.
+struct StreamingProgress
+{
+    uint64_t cache_key;
+    uint64_t completed_slices;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool read_progress(const std::string& path, StreamingProgress& progress)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    return file.read(reinterpret_cast<char*>(&progress), sizeof(progress)) && file.gcount() == sizeof(progress);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool write_progress(const std::string& path, const StreamingProgress& progress)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    return file.write(reinterpret_cast<const char*>(&progress), sizeof(progress)).good();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// z-slices of a partial bake at partial_path that can be kept. Only a file with exactly the expected header, whose progress
+// ends on a slab boundary this bake can continue from, is resumed.
+static int resumable_slices(const std::string& partial_path, const std::string& progress_path, const SDFFileHeader& header, int granularity)
+{
+    StreamingProgress progress;
+
+    if (!file_exists(partial_path) || !read_progress(progress_path, progress) || progress.cache_key != header.cache_key)
+        return 0;
+
+    SDFFileHeader existing;
+    std::ifstream file(partial_path, std::ios::binary);
+
+    if (!file.read(reinterpret_cast<char*>(&existing), sizeof(existing)) || memcmp(&existing, &header, sizeof(header)) != 0)
+        return 0;
+
+    if (progress.completed_slices > uint64_t(header.volume_size[2]) || (progress.completed_slices % granularity != 0 && progress.completed_slices != uint64_t(header.volume_size[2])))
+        return 0;
+
+    return static_cast<int>(progress.completed_slices);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool bake_sdf_streaming(const SDFMesh& mesh, const BakeSettings& settings, SDFEncoding encoding, size_t memory_budget, const std::string& path, StreamingBakeStats* stats)
+{
+    StreamingBakeStats local_stats;
+
+    if (!stats)
+        stats = &local_stats;
+
+    *stats = StreamingBakeStats();
+
+    glm::vec3 mesh_min_extents;
+    glm::vec3 mesh_max_extents;
+
+    compute_extents(mesh, mesh_min_extents, mesh_max_extents);
+
+    const SDFGrid grid        = compute_grid(mesh_min_extents, mesh_max_extents, settings.grid_step_size, settings.padding);
+    const bool    normalized  = encoding == SDFEncoding::UNORM16 || encoding == SDFEncoding::UNORM8;
+    const int     granularity = normalized ? SDF_BRICK_SIZE : 1;
+
+    BVH               bvh;
+    WindingNumberTree winding_number_tree;
+
+    bvh.build(mesh);
+
+    if (settings.sign_mode == SignMode::WINDING_NUMBER)
+        winding_number_tree.build(bvh);
+
+    // Pick the deepest slab that fits next to the structures every slab needs.
+    stats->fixed_bytes = mesh.positions.size() * sizeof(glm::vec3) + mesh.normals.size() * sizeof(glm::vec3) + mesh.indices.size() * sizeof(uint32_t) + bvh.memory_bytes() + winding_number_tree.memory_bytes();
+    stats->slice_bytes = size_t(grid.volume_size.x) * size_t(grid.volume_size.y) * (sizeof(float) + encoding_size(encoding));
+
+    size_t max_depth = memory_budget > stats->fixed_bytes ? (memory_budget - stats->fixed_bytes) / stats->slice_bytes : 0;
+    int    depth     = static_cast<int>(std::min(max_depth, size_t(grid.volume_size.z + granularity - 1))) / granularity * granularity;
+
+    stats->slab_depth = static_cast<uint32_t>(depth);
+    stats->num_voxels = grid.num_voxels();
+    stats->peak_bytes = stats->fixed_bytes + stats->slice_bytes * size_t(std::max(depth, granularity));
+
+    if (depth == 0)
+        return false;
+
+    // Every voxel is baked exactly, like an in-memory bake without a narrow band.
+    BakeSettings key_settings = settings;
+
+    key_settings.narrow_band = 0;
+
+    SDFVolumeView layout;
+
+    static_cast<SDFGrid&>(layout) = grid;
+
+    layout.encoding        = encoding;
+    layout.range_mode      = normalized ? SDFRangeMode::PER_BRICK : SDFRangeMode::PER_VOLUME;
+    layout.range_grid_size = normalized ? (grid.volume_size + glm::ivec3(SDF_BRICK_SIZE - 1)) / SDF_BRICK_SIZE : glm::ivec3(1);
+
+    const uint32_t      num_ranges       = normalized ? static_cast<uint32_t>(layout.range_grid_size.x * layout.range_grid_size.y * layout.range_grid_size.z) : 0;
+    const SDFFileHeader header           = make_sdf_file_header(layout, num_ranges, sdf_cache_key(mesh, key_settings, encoding, layout.range_mode));
+    const std::string   partial_path     = path + ".partial";
+    const std::string   progress_path    = path + ".progress";
+    const size_t        ranges_per_slice = normalized ? size_t(layout.range_grid_size.x) * size_t(layout.range_grid_size.y) : 0;
+
+    int first_slice = resumable_slices(partial_path, progress_path, header, granularity);
+
+    stats->resumed_slices = static_cast<uint32_t>(first_slice);
+
+    if (first_slice == 0)
+    {
+        // Header and zeroed ranges up front, the payload follows slab by slab.
+        std::ofstream     file(partial_path, std::ios::binary | std::ios::trunc);
+        std::vector<char> zeros(header.payload_offset - sizeof(header), 0);
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(zeros.data(), zeros.size());
+
+        if (!file.good())
+            return false;
+    }
+
+    std::fstream file(partial_path, std::ios::binary | std::ios::in | std::ios::out);
+
+    if (!file.is_open())
+        return false;
+
+    for (int z_begin = first_slice; z_begin < grid.volume_size.z; z_begin += depth)
+    {
+        SDFVolume slab;
+
+        static_cast<SDFGrid&>(slab) = grid;
+
+        slab.volume_size.z = std::min(depth, grid.volume_size.z - z_begin);
+        slab.grid_origin.z = grid.grid_origin.z + float(z_begin) * grid.grid_step_size;
+        slab.distances.resize(slab.num_voxels());
+
+        const uint32_t num_rows = static_cast<uint32_t>(slab.volume_size.y * slab.volume_size.z);
+
+        // Positions come from the full grid so the voxels are bitwise the same as in bake_sdf().
+        parallel_for(num_rows, settings.num_threads, [&](uint32_t row) {
+            int y = static_cast<int>(row % slab.volume_size.y);
+            int z = static_cast<int>(row / slab.volume_size.y);
+
+            for (int x = 0; x < slab.volume_size.x; x++)
+                slab.distances[slab.index(x, y, z)] = signed_distance(grid.voxel_position(x, y, z_begin + z), mesh, bvh, &winding_number_tree, settings);
+        });
+
+        QuantizedSDFVolume encoded = encode_sdf(slab, encoding, layout.range_mode, nullptr, settings.num_threads);
+
+        slab.distances.clear();
+        slab.distances.shrink_to_fit();
+
+        if (normalized)
+        {
+            file.seekp(header.ranges_offset + ranges_per_slice * (z_begin / SDF_BRICK_SIZE) * sizeof(glm::vec2));
+            file.write(reinterpret_cast<const char*>(encoded.ranges.data()), encoded.ranges.size() * sizeof(glm::vec2));
+        }
+
+        file.seekp(header.payload_offset + size_t(z_begin) * size_t(grid.volume_size.x) * size_t(grid.volume_size.y) * encoding_size(encoding));
+        file.write(reinterpret_cast<const char*>(encoded.data.data()), encoded.data.size());
+        file.flush();
+
+        // The progress only moves on once the slab is in the file, so an interruption at any point loses at most one slab.
+        if (!file.good() || !write_progress(progress_path, { header.cache_key, uint64_t(z_begin + slab.volume_size.z) }))
+            return false;
+
+        stats->num_slabs++;
+    }
+
+    file.close();
+
+    remove(path.c_str());
+
+    if (rename(partial_path.c_str(), path.c_str()) != 0)
+        return false;
+
+    remove(progress_path.c_str());
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "sdf_file.h"
+#include "sdf_baker.h"
+
+struct StreamingBakeStats
+{
+    uint32_t slab_depth     = 0; // z-slices per slab.
+    uint32_t num_slabs      = 0; // Slabs baked by this call.
+    uint64_t num_voxels     = 0; // Voxels of the whole volume.
+    uint32_t resumed_slices = 0; // z-slices an interrupted bake had already written, which were skipped.
+    size_t   fixed_bytes    = 0; // Mesh and acceleration structures, held for the whole bake.
+    size_t   slice_bytes    = 0; // Working set of one z-slice: float distances plus their encoded copy.
+    size_t   peak_bytes     = 0; // Estimated peak: fixed_bytes plus one slab. When the budget is too small, what one slab needs.
+};
+
+// Bakes the volume in slabs along z and writes each finished slab to the .sdf file at path, so only one slab of voxels is ever in
+// memory. The slabs are as deep as memory_budget allows after the mesh and its acceleration structures.
+//
+// Normalized encodings get PER_BRICK ranges: a per-volume range isn't known until the last voxel is baked. Their slabs are then
+// whole bricks deep. settings.narrow_band is ignored, because the far field fill needs the whole volume; every voxel is exact.
+//
+// While the bake runs, the file is written as path + ".partial", and the count of finished z-slices is kept in
+// path + ".progress". A later bake of the same mesh, settings and encoding continues after the last finished slab, even with a
+// different budget. The finished file is identical to what write_sdf_file() writes for bake_sdf() without a narrow band and
+// encode_sdf() with the same range mode, cache key included, so SDFCache can load it.
+//
+// Returns false if the budget can't hold one slab or the file can't be written.
+bool bake_sdf_streaming(const SDFMesh& mesh, const BakeSettings& settings, SDFEncoding encoding, size_t memory_budget, const std::string& path, StreamingBakeStats* stats = nullptr);
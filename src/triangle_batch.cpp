@@ -0,0 +1,273 @@
+#include "triangle_batch.h"
+#include <algorithm>
+
+// Lanes is the widest float vector the compiler targets, evaluated LANES_WIDTH triangles at a time. Define
+// SDF_BAKER_NO_SIMD to force the scalar path, e.g. to compare it against the vector one.
+#if !defined(SDF_BAKER_NO_SIMD) && defined(__AVX2__)
+#    include <immintrin.h>
+
+#    define LANES_WIDTH 8
+
+typedef __m256 Lanes;
+
+static inline Lanes lanes_load(const float* v) { return _mm256_loadu_ps(v); }
+static inline Lanes lanes_set(float v) { return _mm256_set1_ps(v); }
+static inline void  lanes_store(float* dst, Lanes v) { _mm256_storeu_ps(dst, v); }
+static inline Lanes lanes_add(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+static inline Lanes lanes_sub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+static inline Lanes lanes_mul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+static inline Lanes lanes_min(Lanes a, Lanes b) { return _mm256_min_ps(a, b); }
+static inline Lanes lanes_max(Lanes a, Lanes b) { return _mm256_max_ps(a, b); }
+static inline Lanes lanes_sqrt(Lanes a) { return _mm256_sqrt_ps(a); }
+
+// -1, 0 or 1 per lane, like glm::sign().
+static inline Lanes lanes_sign(Lanes a)
+{
+    const Lanes zero = _mm256_setzero_ps();
+    const Lanes one  = _mm256_set1_ps(1.0f);
+
+    return _mm256_sub_ps(_mm256_and_ps(_mm256_cmp_ps(a, zero, _CMP_GT_OQ), one), _mm256_and_ps(_mm256_cmp_ps(a, zero, _CMP_LT_OQ), one));
+}
+
+// a >= b ? x : y per lane.
+static inline Lanes lanes_select_ge(Lanes a, Lanes b, Lanes x, Lanes y) { return _mm256_blendv_ps(y, x, _mm256_cmp_ps(a, b, _CMP_GE_OQ)); }
+#elif !defined(SDF_BAKER_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#    include <emmintrin.h>
+
+#    define LANES_WIDTH 4
+
+typedef __m128 Lanes;
+
+static inline Lanes lanes_load(const float* v) { return _mm_loadu_ps(v); }
+static inline Lanes lanes_set(float v) { return _mm_set1_ps(v); }
+static inline void  lanes_store(float* dst, Lanes v) { _mm_storeu_ps(dst, v); }
+static inline Lanes lanes_add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+static inline Lanes lanes_sub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+static inline Lanes lanes_mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+static inline Lanes lanes_min(Lanes a, Lanes b) { return _mm_min_ps(a, b); }
+static inline Lanes lanes_max(Lanes a, Lanes b) { return _mm_max_ps(a, b); }
+static inline Lanes lanes_sqrt(Lanes a) { return _mm_sqrt_ps(a); }
+
+static inline Lanes lanes_sign(Lanes a)
+{
+    const Lanes zero = _mm_setzero_ps();
+    const Lanes one  = _mm_set1_ps(1.0f);
+
+    return _mm_sub_ps(_mm_and_ps(_mm_cmpgt_ps(a, zero), one), _mm_and_ps(_mm_cmplt_ps(a, zero), one));
+}
+
+static inline Lanes lanes_select_ge(Lanes a, Lanes b, Lanes x, Lanes y)
+{
+    Lanes mask = _mm_cmpge_ps(a, b);
+    return _mm_or_ps(_mm_and_ps(mask, x), _mm_andnot_ps(mask, y));
+}
+#else
+#    define LANES_WIDTH 1
+
+typedef float Lanes;
+
+static inline Lanes lanes_load(const float* v) { return *v; }
+static inline Lanes lanes_set(float v) { return v; }
+static inline void  lanes_store(float* dst, Lanes v) { *dst = v; }
+static inline Lanes lanes_add(Lanes a, Lanes b) { return a + b; }
+static inline Lanes lanes_sub(Lanes a, Lanes b) { return a - b; }
+static inline Lanes lanes_mul(Lanes a, Lanes b) { return a * b; }
+static inline Lanes lanes_min(Lanes a, Lanes b) { return a < b ? a : b; }
+static inline Lanes lanes_max(Lanes a, Lanes b) { return a > b ? a : b; }
+static inline Lanes lanes_sqrt(Lanes a) { return sqrtf(a); }
+static inline Lanes lanes_sign(Lanes a) { return float(a > 0.0f) - float(a < 0.0f); }
+static inline Lanes lanes_select_ge(Lanes a, Lanes b, Lanes x, Lanes y) { return a >= b ? x : y; }
+#endif
+
+static_assert(TRIANGLE_BATCH_WIDTH % LANES_WIDTH == 0, "A batch must be a whole number of vectors");
+
+struct Lanes3
+{
+    Lanes x;
+    Lanes y;
+    Lanes z;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t triangle_batch_lanes()
+{
+    return LANES_WIDTH;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static inline Lanes3 load3(const float (&v)[3][TRIANGLE_BATCH_WIDTH], uint32_t lane)
+{
+    return { lanes_load(&v[0][lane]), lanes_load(&v[1][lane]), lanes_load(&v[2][lane]) };
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static inline Lanes dot3(const Lanes3& a, const Lanes3& b)
+{
+    return lanes_add(lanes_add(lanes_mul(a.x, b.x), lanes_mul(a.y, b.y)), lanes_mul(a.z, b.z));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Squared distance from the point at pe (relative to the edge start) to the edge e.
+static inline Lanes edge_distance_sq(const Lanes3& e, const Lanes3& pe, Lanes inv_dot2)
+{
+    Lanes  t = lanes_min(lanes_max(lanes_mul(dot3(e, pe), inv_dot2), lanes_set(0.0f)), lanes_set(1.0f));
+    Lanes3 d = { lanes_sub(lanes_mul(e.x, t), pe.x), lanes_sub(lanes_mul(e.y, t), pe.y), lanes_sub(lanes_mul(e.z, t), pe.z) };
+
+    return dot3(d, d);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static inline void store_vec3(float (&dst)[3][TRIANGLE_BATCH_WIDTH], uint32_t lane, const glm::vec3& v)
+{
+    dst[0][lane] = v.x;
+    dst[1][lane] = v.y;
+    dst[2][lane] = v.z;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static inline float safe_inverse(float v)
+{
+    return v > 0.0f ? 1.0f / v : 0.0f;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void pack_triangle_batch(const glm::vec3* vertices, const uint32_t* triangles, uint32_t count, TriangleBatch& batch)
+{
+    for (uint32_t lane = 0; lane < TRIANGLE_BATCH_WIDTH; lane++)
+    {
+        uint32_t i = std::min(lane, count - 1);
+
+        const glm::vec3& a = vertices[3 * i];
+        const glm::vec3& b = vertices[3 * i + 1];
+        const glm::vec3& c = vertices[3 * i + 2];
+
+        glm::vec3 ba  = b - a;
+        glm::vec3 cb  = c - b;
+        glm::vec3 ac  = a - c;
+        glm::vec3 nor = glm::cross(ba, ac);
+        float     len = glm::length(nor);
+
+        store_vec3(batch.a, lane, a);
+        store_vec3(batch.ba, lane, ba);
+        store_vec3(batch.ac, lane, ac);
+        store_vec3(batch.nor, lane, len > 0.0f ? nor / len : glm::vec3(0.0f));
+        store_vec3(batch.edge_nor[0], lane, glm::cross(ba, nor));
+        store_vec3(batch.edge_nor[1], lane, glm::cross(cb, nor));
+        store_vec3(batch.edge_nor[2], lane, glm::cross(ac, nor));
+
+        batch.inv_dot2[0][lane] = safe_inverse(glm::dot(ba, ba));
+        batch.inv_dot2[1][lane] = safe_inverse(glm::dot(cb, cb));
+        batch.inv_dot2[2][lane] = safe_inverse(glm::dot(ac, ac));
+        batch.triangle[lane]    = triangles[i];
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::vector<TriangleBatch> make_triangle_batches(const SDFMesh& mesh)
+{
+    uint32_t num_triangles = mesh.num_triangles();
+
+    std::vector<TriangleBatch> batches((num_triangles + TRIANGLE_BATCH_WIDTH - 1) / TRIANGLE_BATCH_WIDTH);
+
+    glm::vec3 vertices[3 * TRIANGLE_BATCH_WIDTH];
+    uint32_t  triangles[TRIANGLE_BATCH_WIDTH];
+
+    for (uint32_t i = 0; i < batches.size(); i++)
+    {
+        uint32_t first = i * TRIANGLE_BATCH_WIDTH;
+        uint32_t count = std::min(num_triangles - first, static_cast<uint32_t>(TRIANGLE_BATCH_WIDTH));
+
+        for (uint32_t j = 0; j < count; j++)
+        {
+            for (uint32_t k = 0; k < 3; k++)
+                vertices[3 * j + k] = mesh.positions[mesh.indices[3 * (first + j) + k]];
+
+            triangles[j] = first + j;
+        }
+
+        pack_triangle_batch(vertices, triangles, count, batches[i]);
+    }
+
+    return batches;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void sdf_triangle_batch(const glm::vec3& p, const TriangleBatch& batch, float* distances)
+{
+    const Lanes3 point = { lanes_set(p.x), lanes_set(p.y), lanes_set(p.z) };
+    const Lanes  zero  = lanes_set(0.0f);
+
+    for (uint32_t lane = 0; lane < TRIANGLE_BATCH_WIDTH; lane += LANES_WIDTH)
+    {
+        Lanes3 a  = load3(batch.a, lane);
+        Lanes3 ba = load3(batch.ba, lane);
+        Lanes3 ac = load3(batch.ac, lane);
+
+        // The same terms as sdf_triangle(), with b and c expressed through a and the stored edges.
+        Lanes3 cb = { lanes_sub(zero, lanes_add(ba.x, ac.x)), lanes_sub(zero, lanes_add(ba.y, ac.y)), lanes_sub(zero, lanes_add(ba.z, ac.z)) };
+        Lanes3 pa = { lanes_sub(point.x, a.x), lanes_sub(point.y, a.y), lanes_sub(point.z, a.z) };
+        Lanes3 pb = { lanes_sub(pa.x, ba.x), lanes_sub(pa.y, ba.y), lanes_sub(pa.z, ba.z) };
+        Lanes3 pc = { lanes_add(pa.x, ac.x), lanes_add(pa.y, ac.y), lanes_add(pa.z, ac.z) };
+
+        Lanes sides = lanes_add(lanes_add(lanes_sign(dot3(load3(batch.edge_nor[0], lane), pa)), lanes_sign(dot3(load3(batch.edge_nor[1], lane), pb))),
+                                lanes_sign(dot3(load3(batch.edge_nor[2], lane), pc)));
+
+        Lanes plane = dot3(load3(batch.nor, lane), pa);
+        Lanes edges = lanes_min(lanes_min(edge_distance_sq(ba, pa, lanes_load(&batch.inv_dot2[0][lane])),
+                                          edge_distance_sq(cb, pb, lanes_load(&batch.inv_dot2[1][lane]))),
+                                edge_distance_sq(ac, pc, lanes_load(&batch.inv_dot2[2][lane])));
+
+        lanes_store(&distances[lane], lanes_sqrt(lanes_select_ge(sides, lanes_set(2.0f), lanes_mul(plane, plane), edges)));
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool closest_triangle_batch(const glm::vec3& p, const TriangleBatch& batch, TriangleHit& hit)
+{
+    float distances[TRIANGLE_BATCH_WIDTH];
+
+    sdf_triangle_batch(p, batch, distances);
+
+    bool changed = false;
+
+    for (uint32_t lane = 0; lane < TRIANGLE_BATCH_WIDTH; lane++)
+    {
+        float    h   = distances[lane];
+        uint32_t tri = batch.triangle[lane];
+
+        if (h < hit.distance || (h == hit.distance && tri < hit.triangle))
+        {
+            hit.distance = h;
+            hit.triangle = tri;
+            changed      = true;
+        }
+    }
+
+    return changed;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TriangleHit closest_triangle_brute_force(const glm::vec3& p, const std::vector<TriangleBatch>& batches, float max_distance)
+{
+    TriangleHit hit;
+
+    hit.distance = max_distance;
+
+    for (const auto& batch : batches)
+        closest_triangle_batch(p, batch, hit);
+
+    return hit;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "sdf_baker.h"
+
+// Triangles evaluated by one call of sdf_triangle_batch().
+#define TRIANGLE_BATCH_WIDTH 8
+
+// Structure of arrays layout of up to TRIANGLE_BATCH_WIDTH triangles with everything sdf_triangle() derives from the vertices
+// alone computed once, so evaluating a triangle only costs the terms that depend on the query point. Unused lanes repeat the
+// last triangle of the batch, which can never change the closest result.
+struct TriangleBatch
+{
+    float    a[3][TRIANGLE_BATCH_WIDTH];
+    float    ba[3][TRIANGLE_BATCH_WIDTH]; // b - a
+    float    ac[3][TRIANGLE_BATCH_WIDTH]; // a - c. c - b is -(ba + ac).
+    float    nor[3][TRIANGLE_BATCH_WIDTH]; // Unit face normal, 0 for degenerate triangles.
+    float    edge_nor[3][3][TRIANGLE_BATCH_WIDTH]; // cross(edge, nor) for ba, cb and ac. Only the sign of the dot product is used.
+    float    inv_dot2[3][TRIANGLE_BATCH_WIDTH]; // 1 / dot2(edge) for ba, cb and ac, 0 for zero length edges.
+    uint32_t triangle[TRIANGLE_BATCH_WIDTH]; // Source triangle index of each lane.
+};
+
+// Packs count triangles (1 to TRIANGLE_BATCH_WIDTH), given as three consecutive positions each, into a batch. triangles holds
+// the source index of each one.
+void pack_triangle_batch(const glm::vec3* vertices, const uint32_t* triangles, uint32_t count, TriangleBatch& batch);
+
+// Batches of every triangle of a mesh in source order.
+std::vector<TriangleBatch> make_triangle_batches(const SDFMesh& mesh);
+
+// Float lanes of the path sdf_triangle_batch() was compiled for: 8 with AVX2, 4 with SSE2 and 1 for the scalar fallback.
+uint32_t triangle_batch_lanes();
+
+// Unsigned distance from p to every lane of the batch, within float rounding of sdf_triangle(). Uses AVX2 or SSE when the
+// compiler targets them, otherwise a scalar loop over the same precomputed terms.
+void sdf_triangle_batch(const glm::vec3& p, const TriangleBatch& batch, float* distances);
+
+// Updates hit with the closest lane of the batch. Ties go to the lowest triangle index like everywhere else in the baker.
+// Returns true if hit changed.
+bool closest_triangle_batch(const glm::vec3& p, const TriangleBatch& batch, TriangleHit& hit);
+
+// Closest triangle to p over batches from make_triangle_batches(). Same result as closest_triangle_brute_force() up to float
+// rounding.
+TriangleHit closest_triangle_brute_force(const glm::vec3& p, const std::vector<TriangleBatch>& batches, float max_distance = SDF_INFINITY);
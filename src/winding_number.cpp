@@ -0,0 +1,126 @@
+#include "winding_number.h"
+
+#define FOUR_PI 12.566370614359172f
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float solid_angle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    glm::vec3 pa = a - p;
+    glm::vec3 pb = b - p;
+    glm::vec3 pc = c - p;
+
+    float la = glm::length(pa);
+    float lb = glm::length(pb);
+    float lc = glm::length(pc);
+
+    float numerator   = glm::dot(pa, glm::cross(pb, pc));
+    float denominator = la * lb * lc + glm::dot(pa, pb) * lc + glm::dot(pb, pc) * la + glm::dot(pc, pa) * lb;
+
+    return 2.0f * atan2f(numerator, denominator);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void WindingNumberTree::build(const BVH& bvh)
+{
+    m_bvh = &bvh;
+    m_dipoles.resize(bvh.nodes().size());
+
+    if (!m_dipoles.empty())
+        build_node(0);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void WindingNumberTree::build_node(uint32_t node_idx)
+{
+    const BVH::Node& node     = m_bvh->nodes()[node_idx];
+    const auto&      vertices = m_bvh->vertices();
+
+    Dipole& dipole = m_dipoles[node_idx];
+
+    glm::vec3 normal     = glm::vec3(0.0f);
+    glm::vec3 center     = glm::vec3(0.0f);
+    float     total_area = 0.0f;
+
+    if (node.is_leaf())
+    {
+        for (uint32_t i = node.offset; i < node.offset + node.count; i++)
+        {
+            glm::vec3 n    = 0.5f * glm::cross(vertices[3 * i + 1] - vertices[3 * i], vertices[3 * i + 2] - vertices[3 * i]);
+            float     area = glm::length(n);
+
+            normal += n;
+            center += area * (vertices[3 * i] + vertices[3 * i + 1] + vertices[3 * i + 2]) / 3.0f;
+            total_area += area;
+        }
+    }
+    else
+    {
+        uint32_t children[] = { node_idx + 1, node.offset };
+
+        for (uint32_t child : children)
+        {
+            build_node(child);
+
+            const Dipole& child_dipole = m_dipoles[child];
+
+            normal += child_dipole.normal;
+            center += child_dipole.area * child_dipole.center;
+            total_area += child_dipole.area;
+        }
+    }
+
+    dipole.normal = normal;
+    dipole.area   = total_area;
+    dipole.center = total_area > 0.0f ? center / total_area : (node.min_extents + node.max_extents) * 0.5f;
+
+    // Radius of a sphere around the centre that contains the node's bounding box.
+    glm::vec3 corner_distance = glm::max(glm::abs(node.min_extents - dipole.center), glm::abs(node.max_extents - dipole.center));
+    dipole.radius             = glm::length(corner_distance);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float WindingNumberTree::winding_number(const glm::vec3& p, float beta) const
+{
+    if (m_dipoles.empty())
+        return 0.0f;
+
+    const auto& nodes    = m_bvh->nodes();
+    const auto& vertices = m_bvh->vertices();
+
+    float    w = 0.0f;
+    uint32_t stack[64];
+    uint32_t stack_size = 0;
+
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0)
+    {
+        uint32_t         node_idx = stack[--stack_size];
+        const BVH::Node& node     = nodes[node_idx];
+        const Dipole&    dipole   = m_dipoles[node_idx];
+
+        glm::vec3 d     = dipole.center - p;
+        float     d_len = glm::length(d);
+
+        if (d_len > beta * dipole.radius)
+            w += glm::dot(d, dipole.normal) / (FOUR_PI * d_len * d_len * d_len);
+        else if (node.is_leaf())
+        {
+            for (uint32_t i = node.offset; i < node.offset + node.count; i++)
+                w += solid_angle(p, vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2]) / FOUR_PI;
+        }
+        else
+        {
+            stack[stack_size++] = node.offset;
+            stack[stack_size++] = node_idx + 1;
+        }
+    }
+
+    return w;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
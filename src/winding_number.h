@@ -0,0 +1,39 @@
+#pragma once
+
+#include "bvh.h"
+
+// Generalized winding number over the nodes of a BVH. Each node keeps a dipole (area weighted normal sum at the area weighted
+// centroid) and a bounding radius. Nodes that are far enough from the query point are evaluated with the dipole instead of
+// visiting their triangles, so the cost per query grows with the log of the triangle count.
+class WindingNumberTree
+{
+public:
+    // The BVH must stay alive and unchanged while the tree is in use.
+    void build(const BVH& bvh);
+
+    // Winding number at p: ~1 inside a closed, outward facing mesh and ~0 outside. Nodes whose centre is further away than
+    // beta times their radius use the far field approximation. Larger values are more accurate and slower.
+    float winding_number(const glm::vec3& p, float beta = 2.0f) const;
+
+    inline bool is_inside(const glm::vec3& p, float beta = 2.0f) const { return winding_number(p, beta) >= 0.5f; }
+
+    inline size_t memory_bytes() const { return m_dipoles.size() * sizeof(Dipole); }
+
+private:
+    void build_node(uint32_t node_idx);
+
+private:
+    struct Dipole
+    {
+        glm::vec3 center;
+        float     radius;
+        glm::vec3 normal; // Sum of area * unit normal, i.e. half the sum of the unnormalized face normals.
+        float     area;
+    };
+
+    const BVH*          m_bvh = nullptr;
+    std::vector<Dipole> m_dipoles;
+};
+
+// Exact solid angle of triangle abc seen from p, signed by the triangle winding (Van Oosterom and Strackee).
+float solid_angle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);